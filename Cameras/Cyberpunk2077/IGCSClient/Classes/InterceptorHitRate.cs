@@ -0,0 +1,62 @@
+﻿////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace IGCSClient.Classes
+{
+	/// <summary>
+	/// The hits of an interceptor in the camera dll and its hit rates over the last telemetry interval, as reported by the dll.
+	/// </summary>
+	public class InterceptorHitRate
+	{
+		public InterceptorHitRate(string name, ulong numberOfHits, double hitsPerSecond, double hitsPerUpdate)
+		{
+			this.Name = name;
+			this.NumberOfHits = numberOfHits;
+			this.HitsPerSecond = hitsPerSecond;
+			this.HitsPerUpdate = hitsPerUpdate;
+		}
+
+
+		#region Properties
+		public string Name { get; private set; }
+		/// <summary>
+		/// The number of hits since the interceptor was hooked.
+		/// </summary>
+		public ulong NumberOfHits { get; private set; }
+		public double HitsPerSecond { get; private set; }
+		public double HitsPerUpdate { get; private set; }
+		/// <summary>
+		/// Remark to show with the rates, e.g. to spot hooks which aren't hit anymore after a game patch.
+		/// </summary>
+		public string Remarks
+		{
+			get { return this.NumberOfHits == 0 ? "Not hit since it was hooked" : string.Empty; }
+		}
+		#endregion
+	}
+}
@@ -27,6 +27,7 @@
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 using System;
+using System.Collections.Generic;
 using System.Text;
 using IGCSClient.NamedPipeSubSystem;
 
@@ -56,6 +57,7 @@ namespace IGCSClient.Classes
 		#region Members
 		private NamedPipeServer _pipeServer;
 		private NamedPipeClient _pipeClient;
+		private List<InterceptorHitRate> _interceptorHitRatesReceived;
 		#endregion
 
 		internal MessageHandler()
@@ -63,6 +65,7 @@ namespace IGCSClient.Classes
 			this.DisplayNotifications = true;
 			_pipeServer = new NamedPipeServer(ConstantsEnums.DllToClientNamedPipeName);			// for connection from dll to this client. We create and own the pipe
 			_pipeClient = new NamedPipeClient(ConstantsEnums.ClientToDllNamedPipeName);			// for connection from this client to dll. Dll creates and owns the pipe
+			_interceptorHitRatesReceived = new List<InterceptorHitRate>();
 			_pipeServer.MessageReceived += _pipeServer_MessageReceived;
 			_pipeServer.ClientConnectionEstablished += _pipeServer_ClientConnectionEstablished;
 			_pipeClient.ConnectedToPipe += _pipeClient_ConnectedToPipe;
@@ -116,6 +119,86 @@ namespace IGCSClient.Classes
 		}
 
 
+		/// <summary>
+		/// Sends a 2-byte message to signal the dll that it should build the index over the code of the game exe in the background, so pattern queries are fast.
+		/// </summary>
+		public void SendBuildImageIndexAction()
+		{
+			_pipeClient.Send(new IGCSMessage(MessageType.Action, ActionType.BuildImageIndex, null));
+		}
+
+
+		/// <summary>
+		/// Sends a message with as payload the pattern as ascii text. First byte is 'Action', second byte, the id, is QueryImageIndex. The dll reports the
+		/// locations found with an ImageIndexQueryResult message, which is passed to ImageIndexQueryResultFunc.
+		/// </summary>
+		/// <param name="pattern">the pattern to find, in the form "48 8B ?? 10".</param>
+		public void SendQueryImageIndexAction(string pattern)
+		{
+			_pipeClient.Send(new IGCSMessage(MessageType.Action, ActionType.QueryImageIndex, new ASCIIEncoding().GetBytes(pattern)));
+		}
+
+
+		/// <summary>
+		/// Sends a 2-byte message to signal the dll that it should discard the index over the code of the game exe, to release its memory.
+		/// </summary>
+		public void SendDiscardImageIndexAction()
+		{
+			_pipeClient.Send(new IGCSMessage(MessageType.Action, ActionType.DiscardImageIndex, null));
+		}
+
+
+		/// <summary>
+		/// Sends a 2-byte message to signal the dll that it should scan the memory of the game for the camera struct. The dll samples the best candidates
+		/// for a few seconds, in which the camera has to be moved, and reports them as normal text messages.
+		/// </summary>
+		public void SendDiscoverCameraStructAction()
+		{
+			_pipeClient.Send(new IGCSMessage(MessageType.Action, ActionType.DiscoverCameraStruct, null));
+		}
+
+
+		/// <summary>
+		/// Sends a message with as payload the value type and optional range as ascii text. First byte is 'Action', second byte, the id, is StartValueHunt.
+		/// The dll takes a snapshot of the memory of the game, in which every value of the type specified is a candidate.
+		/// </summary>
+		/// <param name="arguments">'float' or 'int', optionally followed by the start and end address in hex, e.g. "float 7FF600000000 7FF700000000".</param>
+		public void SendStartValueHuntAction(string arguments)
+		{
+			_pipeClient.Send(new IGCSMessage(MessageType.Action, ActionType.StartValueHunt, new ASCIIEncoding().GetBytes(arguments)));
+		}
+
+
+		/// <summary>
+		/// Sends a message with as payload the comparison as ascii text. First byte is 'Action', second byte, the id, is NarrowValueHunt. The dll keeps the
+		/// candidates which match the comparison and reports them as normal text messages.
+		/// </summary>
+		/// <param name="comparison">changed, unchanged [epsilon], increased, decreased or equal value [epsilon].</param>
+		public void SendNarrowValueHuntAction(string comparison)
+		{
+			_pipeClient.Send(new IGCSMessage(MessageType.Action, ActionType.NarrowValueHunt, new ASCIIEncoding().GetBytes(comparison)));
+		}
+
+
+		/// <summary>
+		/// Sends a 2-byte message to signal the dll that it should discard the value hunt, to release its memory.
+		/// </summary>
+		public void SendDiscardValueHuntAction()
+		{
+			_pipeClient.Send(new IGCSMessage(MessageType.Action, ActionType.DiscardValueHunt, null));
+		}
+
+
+		/// <summary>
+		/// Sends a 2-byte message to signal the dll that it should report the hits and hit rates of its interceptors. The dll sends them back as
+		/// InterceptorHitRate messages, which are passed to InterceptorHitRatesFunc.
+		/// </summary>
+		public void SendReportInterceptorHitsAction()
+		{
+			_pipeClient.Send(new IGCSMessage(MessageType.Action, ActionType.ReportInterceptorHits, null));
+		}
+
+
 		private void HandleNamedPipeMessageReceived(ContainerEventArgs<byte[]> e)
 		{
 			if(e.Value.Length < 2)
@@ -147,10 +230,77 @@ namespace IGCSClient.Classes
 				case MessageType.ErrorTextMessage:
 					LogHandlerSingleton.Instance().LogLine(asciiEncoding.GetString(e.Value, 1, e.Value.Length-1), "Camera dll", false, true);
 					break;
+				case MessageType.FeatureAvailability:
+					// format: MessageType.FeatureAvailability | feature | 1 if available, 0 otherwise
+					if(e.Value.Length >= 3)
+					{
+						this.FeatureAvailabilityFunc?.Invoke(e.Value[1], e.Value[2] == 1);
+					}
+					break;
+				case MessageType.InterceptorHitRate:
+					HandleInterceptorHitRateMessage(e.Value);
+					break;
+				case MessageType.ImageIndexState:
+					// format: MessageType.ImageIndexState | state | memory used in bytes (8 bytes) | number of bytes of code indexed (8 bytes)
+					if(e.Value.Length >= 18)
+					{
+						this.ImageIndexStateFunc?.Invoke(e.Value[1], BitConverter.ToUInt64(e.Value, 2), BitConverter.ToUInt64(e.Value, 10));
+					}
+					break;
+				case MessageType.ImageIndexQueryResult:
+					HandleImageIndexQueryResultMessage(e.Value);
+					break;
 				// rest are ignored.
 			}
 		}
 
+
+
+		private void HandleInterceptorHitRateMessage(byte[] message)
+		{
+			// format: MessageType.InterceptorHitRate | index | number of interceptors | hits (8 bytes) | hits per second (8 bytes) | hits per camera update (8 bytes) | 
+			// camera updates per second (8 bytes) | name as ascii text. The dll sends one message per interceptor, the rates are passed on when the last one has arrived. 
+			if(message.Length < 35)
+			{
+				return;
+			}
+			int index = message[1];
+			int numberOfInterceptors = message[2];
+			double updatesPerSecond = BitConverter.ToDouble(message, 27);
+			if(index == 0)
+			{
+				_interceptorHitRatesReceived.Clear();
+			}
+			if(numberOfInterceptors > 0)
+			{
+				_interceptorHitRatesReceived.Add(new InterceptorHitRate(new ASCIIEncoding().GetString(message, 35, message.Length - 35), BitConverter.ToUInt64(message, 3), 
+																		BitConverter.ToDouble(message, 11), BitConverter.ToDouble(message, 19)));
+			}
+			if(index >= numberOfInterceptors - 1)
+			{
+				this.InterceptorHitRatesFunc?.Invoke(new List<InterceptorHitRate>(_interceptorHitRatesReceived), updatesPerSecond);
+				_interceptorHitRatesReceived.Clear();
+			}
+		}
+
+
+
+		private void HandleImageIndexQueryResultMessage(byte[] message)
+		{
+			// format: MessageType.ImageIndexQueryResult | number of locations (8 bytes) | query time in ms (8 bytes) | query method | 
+			// offsets from the image start of the first locations (8 bytes each)
+			if(message.Length < 18)
+			{
+				return;
+			}
+			var offsets = new List<ulong>();
+			for(int i = 18; i + 8 <= message.Length; i += 8)
+			{
+				offsets.Add(BitConverter.ToUInt64(message, i));
+			}
+			this.ImageIndexQueryResultFunc?.Invoke(BitConverter.ToUInt64(message, 1), BitConverter.ToDouble(message, 9), message[17], offsets);
+		}
+
 		
 		private void _pipeClient_ConnectedToPipe(object sender, EventArgs e)
 		{
@@ -184,6 +334,25 @@ namespace IGCSClient.Classes
 		/// </summary>
 		public Action ConnectedToNamedPipeFunc { get; set; }
 		public Action<string> NotificationLogFunc { get; set; }
+		/// <summary>
+		/// Func which is called when the dll reports whether a feature is available. The byte is the feature, see GameSpecificFeatureType.
+		/// </summary>
+		public Action<byte, bool> FeatureAvailabilityFunc { get; set; }
+		/// <summary>
+		/// Func which is called when the dll has reported the hits and hit rates of all its interceptors. The double is the number of camera updates per second
+		/// the rates were measured at. The list is empty if no interceptor has been hooked.
+		/// </summary>
+		public Action<List<InterceptorHitRate>, double> InterceptorHitRatesFunc { get; set; }
+		/// <summary>
+		/// Func which is called when the dll reports the state of its image index. The byte is the state, see ImageIndexState, the ulongs are the memory
+		/// used by the index and the number of bytes of code it covers, in bytes.
+		/// </summary>
+		public Action<byte, ulong, ulong> ImageIndexStateFunc { get; set; }
+		/// <summary>
+		/// Func which is called when the dll reports the result of a pattern query. Passed are the number of locations found, the query time in ms, 
+		/// how the locations were found (see ImageIndexQueryMethod) and the offsets from the image start of the first locations.
+		/// </summary>
+		public Action<ulong, double, byte, List<ulong>> ImageIndexQueryResultFunc { get; set; }
 		#endregion
 	}
 }
@@ -70,6 +70,10 @@ namespace IGCSClient
 		public const byte ErrorTextMessage = 5;
 		public const byte DebugTextMessage = 6;
 		public const byte Action = 7;
+		public const byte FeatureAvailability = 8;
+		public const byte InterceptorHitRate = 9;
+		public const byte ImageIndexState = 10;
+		public const byte ImageIndexQueryResult = 11;
 	}
 
 
@@ -135,5 +139,29 @@ namespace IGCSClient
 	{
 		public const byte RehookXInput = 1;
 		public const byte ResizeViewPort = 2;
+		public const byte BuildImageIndex = 3;
+		public const byte QueryImageIndex = 4;
+		public const byte DiscardImageIndex = 5;
+		public const byte DiscoverCameraStruct = 6;
+		public const byte StartValueHunt = 7;
+		public const byte NarrowValueHunt = 8;
+		public const byte DiscardValueHunt = 9;
+		public const byte ReportInterceptorHits = 10;
+	}
+
+
+	public class ImageIndexState
+	{
+		public const byte NotBuilt = 0;
+		public const byte Building = 1;
+		public const byte Built = 2;
+	}
+
+
+	public class ImageIndexQueryMethod
+	{
+		public const byte Index = 0;
+		public const byte ScanIndexNotBuilt = 1;
+		public const byte ScanTooFewConsecutiveBytes = 2;
 	}
 }
@@ -0,0 +1,275 @@
+﻿////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+using System;
+using System.Collections.Generic;
+using System.Globalization;
+using System.Linq;
+using System.Windows;
+using System.Windows.Forms;
+using IGCSClient.Classes;
+using ComboBoxItem = System.Windows.Controls.ComboBoxItem;
+using KeyEventArgs = System.Windows.Input.KeyEventArgs;
+using SelectionChangedEventArgs = System.Windows.Controls.SelectionChangedEventArgs;
+using UserControl = System.Windows.Controls.UserControl;
+
+namespace IGCSClient.Controls
+{
+	/// <summary>
+	/// Interaction logic for DiagnosticsPage.xaml
+	/// </summary>
+	public partial class DiagnosticsPage : UserControl
+	{
+		#region Members
+		private Timer _interceptorHitsRefreshTimer;
+		#endregion
+
+
+		public DiagnosticsPage()
+		{
+			InitializeComponent();
+			_interceptorHitsRefreshTimer = new Timer() { Interval = 2000 };
+			_interceptorHitsRefreshTimer.Tick += _interceptorHitsRefreshTimer_Tick;
+			MessageHandlerSingleton.Instance().InterceptorHitRatesFunc = (h, u) => DisplayInterceptorHitRates(h, u);
+			MessageHandlerSingleton.Instance().ImageIndexStateFunc = (s, m, c) => DisplayImageIndexState(s, m, c);
+			MessageHandlerSingleton.Instance().ImageIndexQueryResultFunc = (n, t, q, o) => DisplayImageIndexQueryResult(n, t, q, o);
+		}
+
+
+		private void DisplayInterceptorHitRates(List<InterceptorHitRate> hitRates, double updatesPerSecond)
+		{
+			if(!this.CheckAccess())
+			{
+				this.Dispatcher?.Invoke(() => DisplayInterceptorHitRates(hitRates, updatesPerSecond));
+				return;
+			}
+			_updatesPerSecondTextBox.Text = updatesPerSecond.ToString("F1");
+			_interceptorHitRatesListView.ItemsSource = hitRates;
+			_interceptorHitsRemarkTextBlock.Text = hitRates.Count <= 0 ? "No interceptors have been hooked." : string.Empty;
+		}
+
+
+		private void DisplayImageIndexState(byte state, ulong memoryUsedInBytes, ulong numberOfIndexedBytes)
+		{
+			if(!this.CheckAccess())
+			{
+				this.Dispatcher?.Invoke(() => DisplayImageIndexState(state, memoryUsedInBytes, numberOfIndexedBytes));
+				return;
+			}
+			switch(state)
+			{
+				case ImageIndexState.Building:
+					_imageIndexStateTextBox.Text = "Building...";
+					break;
+				case ImageIndexState.Built:
+					_imageIndexStateTextBox.Text = "Built";
+					break;
+				default:
+					_imageIndexStateTextBox.Text = "Not built";
+					break;
+			}
+			bool isBuilt = state == ImageIndexState.Built;
+			_imageIndexMemoryUsedTextBox.Text = isBuilt ? string.Format("{0:F1} MB", memoryUsedInBytes / (1024.0 * 1024.0)) : string.Empty;
+			_imageIndexCodeIndexedTextBox.Text = isBuilt ? string.Format("{0:F1} MB", numberOfIndexedBytes / (1024.0 * 1024.0)) : string.Empty;
+		}
+
+
+		private void DisplayImageIndexQueryResult(ulong numberOfLocations, double queryTimeInMs, byte queryMethod, List<ulong> offsets)
+		{
+			if(!this.CheckAccess())
+			{
+				this.Dispatcher?.Invoke(() => DisplayImageIndexQueryResult(numberOfLocations, queryTimeInMs, queryMethod, offsets));
+				return;
+			}
+			string howFound;
+			switch(queryMethod)
+			{
+				case ImageIndexQueryMethod.Index:
+					howFound = "index";
+					break;
+				case ImageIndexQueryMethod.ScanTooFewConsecutiveBytes:
+					howFound = "image scan, pattern has too few consecutive non-wildcard bytes";
+					break;
+				default:
+					howFound = "image scan, index isn't built yet";
+					break;
+			}
+			_queryResultTextBlock.Text = string.Format("{0} location(s) found in {1:F3}ms ({2}).{3}", numberOfLocations, queryTimeInMs, howFound, 
+													   numberOfLocations > (ulong)offsets.Count ? string.Format(" The first {0} are shown.", offsets.Count) : string.Empty);
+			_queryResultLocationsListBox.ItemsSource = offsets.Select(o => string.Format("+0x{0:X}", o)).ToList();
+		}
+
+
+		private void QueryPattern()
+		{
+			var pattern = _queryPatternTextBox.Text.Trim();
+			if(string.IsNullOrEmpty(pattern))
+			{
+				return;
+			}
+			_queryResultTextBlock.Text = "Searching...";
+			_queryResultLocationsListBox.ItemsSource = null;
+			MessageHandlerSingleton.Instance().SendQueryImageIndexAction(pattern);
+		}
+
+
+		private void StartValueHunt()
+		{
+			// format: value type [start address end address], the addresses in hex.
+			var arguments = ((ComboBoxItem)_huntValueTypeComboBox.SelectedItem).Content.ToString();
+			var startAddressText = _huntStartAddressTextBox.Text.Trim();
+			var endAddressText = _huntEndAddressTextBox.Text.Trim();
+			if(!string.IsNullOrEmpty(startAddressText) || !string.IsNullOrEmpty(endAddressText))
+			{
+				ulong startAddress, endAddress;
+				if(!ulong.TryParse(startAddressText, NumberStyles.HexNumber, CultureInfo.InvariantCulture, out startAddress) ||
+				   !ulong.TryParse(endAddressText, NumberStyles.HexNumber, CultureInfo.InvariantCulture, out endAddress) || startAddress >= endAddress)
+				{
+					LogHandlerSingleton.Instance().LogLine("Specify both a start and an end address in hex for the value hunt, with the start before the end, or neither.", 
+														   "Diagnostics", false, true);
+					return;
+				}
+				arguments += string.Format(" {0:X} {1:X}", startAddress, endAddress);
+			}
+			MessageHandlerSingleton.Instance().SendStartValueHuntAction(arguments);
+		}
+
+
+		private void NarrowValueHunt()
+		{
+			// format: comparison [value] [epsilon]. The dll parses the numbers with the C locale, so they're always sent with a '.' as decimal separator.
+			var comparison = ((ComboBoxItem)_huntComparisonComboBox.SelectedItem).Tag.ToString();
+			var arguments = comparison;
+			if(comparison == "equal")
+			{
+				double value;
+				if(!double.TryParse(_huntValueTextBox.Text.Trim(), NumberStyles.Float, CultureInfo.InvariantCulture, out value))
+				{
+					LogHandlerSingleton.Instance().LogLine("Specify the value to compare with, e.g. 90 or 0.5.", "Diagnostics", false, true);
+					return;
+				}
+				arguments += " " + value.ToString("R", CultureInfo.InvariantCulture);
+			}
+			if(comparison == "equal" || comparison == "unchanged")
+			{
+				var epsilonText = _huntEpsilonTextBox.Text.Trim();
+				double epsilon = 0.0;
+				if(!string.IsNullOrEmpty(epsilonText) && 
+				   (!double.TryParse(epsilonText, NumberStyles.Float, CultureInfo.InvariantCulture, out epsilon) || epsilon < 0.0))
+				{
+					LogHandlerSingleton.Instance().LogLine("The epsilon has to be a positive number, e.g. 0.01, or left empty.", "Diagnostics", false, true);
+					return;
+				}
+				arguments += " " + epsilon.ToString("R", CultureInfo.InvariantCulture);
+			}
+			MessageHandlerSingleton.Instance().SendNarrowValueHuntAction(arguments);
+		}
+
+
+		private void _reportInterceptorHitsButton_OnClick(object sender, RoutedEventArgs e)
+		{
+			MessageHandlerSingleton.Instance().SendReportInterceptorHitsAction();
+		}
+
+
+		private void _autoRefreshInterceptorHitsCheckBox_OnCheckedChanged(object sender, RoutedEventArgs e)
+		{
+			_interceptorHitsRefreshTimer.Enabled = _autoRefreshInterceptorHitsCheckBox.IsChecked == true;
+		}
+
+
+		private void _interceptorHitsRefreshTimer_Tick(object sender, EventArgs e)
+		{
+			MessageHandlerSingleton.Instance().SendReportInterceptorHitsAction();
+		}
+
+
+		private void _buildImageIndexButton_OnClick(object sender, RoutedEventArgs e)
+		{
+			MessageHandlerSingleton.Instance().SendBuildImageIndexAction();
+		}
+
+
+		private void _discardImageIndexButton_OnClick(object sender, RoutedEventArgs e)
+		{
+			MessageHandlerSingleton.Instance().SendDiscardImageIndexAction();
+		}
+
+
+		private void _queryPatternButton_OnClick(object sender, RoutedEventArgs e)
+		{
+			QueryPattern();
+		}
+
+
+		private void _queryPatternTextBox_OnKeyDown(object sender, KeyEventArgs e)
+		{
+			if(e.Key == System.Windows.Input.Key.Enter)
+			{
+				QueryPattern();
+			}
+		}
+
+
+		private void _discoverCameraStructButton_OnClick(object sender, RoutedEventArgs e)
+		{
+			MessageHandlerSingleton.Instance().SendDiscoverCameraStructAction();
+		}
+
+
+		private void _startValueHuntButton_OnClick(object sender, RoutedEventArgs e)
+		{
+			StartValueHunt();
+		}
+
+
+		private void _narrowValueHuntButton_OnClick(object sender, RoutedEventArgs e)
+		{
+			NarrowValueHunt();
+		}
+
+
+		private void _discardValueHuntButton_OnClick(object sender, RoutedEventArgs e)
+		{
+			MessageHandlerSingleton.Instance().SendDiscardValueHuntAction();
+		}
+
+
+		private void _huntComparisonComboBox_OnSelectionChanged(object sender, SelectionChangedEventArgs e)
+		{
+			if(_huntValueTextBox == null || _huntEpsilonTextBox == null)
+			{
+				// raised by InitializeComponent, before the text boxes have been created.
+				return;
+			}
+			var comparison = ((ComboBoxItem)_huntComparisonComboBox.SelectedItem).Tag.ToString();
+			_huntValueTextBox.IsEnabled = comparison == "equal";
+			_huntEpsilonTextBox.IsEnabled = comparison == "equal" || comparison == "unchanged";
+		}
+	}
+}
@@ -63,6 +63,7 @@ namespace IGCSClient.Forms
 			TabItemHelper.SetIcon(_aboutTab, new SymbolIcon(Symbol.People));
 			TabItemHelper.SetIcon(_helpTab, new SymbolIcon(Symbol.Help));
 			TabItemHelper.SetIcon(_environmentAdjustmentsTab, new SymbolIcon(Symbol.World));
+			TabItemHelper.SetIcon(_diagnosticsTab, new SymbolIcon(Symbol.View));
 			this.MinHeight = this.Height;
 			this.MinWidth = this.Width;
 		}
@@ -108,8 +109,29 @@ namespace IGCSClient.Forms
 			_configurationTab.IsEnabled = false;
 			_keybindingsTab.IsEnabled = false;
 			_environmentAdjustmentsTab.IsEnabled = false;
+			_diagnosticsTab.IsEnabled = false;
 
 			MessageHandlerSingleton.Instance().NotificationLogFunc = s => DisplayNotification(s);
+			MessageHandlerSingleton.Instance().FeatureAvailabilityFunc = (f, a) => HandleFeatureAvailability(f, a);
+		}
+
+
+		private void HandleFeatureAvailability(byte feature, bool isAvailable)
+		{
+			if(!this.CheckAccess())
+			{
+				this.Dispatcher?.Invoke(()=>HandleFeatureAvailability(feature, isAvailable));
+				return;
+			}
+			switch(feature)
+			{
+				case GameSpecificFeatureType.Hotsampling:
+					_hotsamplingControl.IsEnabled = isAvailable;
+					break;
+				default:
+					_environmentAdjustmentsEditor.SetFeatureAvailability(feature, isAvailable);
+					break;
+			}
 		}
 		
 
@@ -126,6 +148,7 @@ namespace IGCSClient.Forms
 			_configurationTab.IsEnabled = true;
 			_keybindingsTab.IsEnabled = true;
 			_environmentAdjustmentsTab.IsEnabled = true;
+			_diagnosticsTab.IsEnabled = true;
 			// show the resolutions on the hotsampling tab
 			_hotsamplingControl.BindData();
 		}
@@ -93,6 +93,20 @@ namespace IGCSClient.GameSpecific.Classes
 	}
 
 
+	/// <summary>
+	/// Features of the camera dll which depend on hooks which are set in the background. The dll reports per feature whether it's available,
+	/// the controls of a feature are disabled till then.
+	/// </summary>
+	public class GameSpecificFeatureType
+	{
+		public const byte TimeOfDay = 0;
+		public const byte HudToggle = 1;
+		public const byte Timestop = 2;
+		public const byte Weather = 3;
+		public const byte Hotsampling = 4;
+	}
+
+
 	public class GameSpecificSettingType : SettingType
 	{
 		// default settings end at 7
@@ -67,5 +67,24 @@ namespace IGCSClient.GameSpecific.Controls
 				}
 			}
 		}
+
+
+		/// <summary>
+		/// Enables or disables the controls of the feature specified. 
+		/// </summary>
+		/// <param name="feature">the feature, see GameSpecificFeatureType</param>
+		/// <param name="isAvailable">true if the dll has hooked the feature</param>
+		internal void SetFeatureAvailability(byte feature, bool isAvailable)
+		{
+			switch(feature)
+			{
+				case GameSpecificFeatureType.TimeOfDay:
+					_miscellaneousOptionsGroupBox.IsEnabled = isAvailable;
+					break;
+				case GameSpecificFeatureType.Weather:
+					_wetnessOptionsGroupBox.IsEnabled = isAvailable;
+					break;
+			}
+		}
 	}
 }
\ No newline at end of file
@@ -0,0 +1,300 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "AOBApproximateScanner.h"
+#include <algorithm>
+
+namespace IGCS
+{
+	// The Shift-Or automaton does a couple of operations per byte per pattern, so the chunks can be smaller than the ones of the AOBScanEngine.
+	#define AOB_APPROXIMATE_MINIMUM_CHUNK_SIZE						(256 * 1024)
+	#define AOB_APPROXIMATE_CHUNKS_PER_WORKER						4
+
+	AOBApproximateScanner::AOBApproximateScanner(int maxNumberOfMismatches, int maxNumberOfCandidatesPerPattern)
+						: _maxNumberOfMismatches{ std::clamp(maxNumberOfMismatches, 0, AOB_APPROXIMATE_MAX_MISMATCHES) },
+						  _maxNumberOfCandidatesPerPattern{ maxNumberOfCandidatesPerPattern > 0 ? maxNumberOfCandidatesPerPattern : 1 }
+	{
+	}
+
+
+	AOBApproximateScanner::~AOBApproximateScanner()
+	{
+	}
+
+
+	// Registers the pattern specified with the scanner. Returns the id of the pattern, to be used with candidatesOfPattern after the scan.
+	int AOBApproximateScanner::addPattern(const ScanPattern& pattern)
+	{
+		_patterns.emplace_back(pattern);
+		prepareShiftOrPattern(_patterns.back());
+		return static_cast<int>(_patterns.size()) - 1;
+	}
+
+
+	// Scans the ranges specified for candidates of all registered patterns, in chunks on the worker pool specified. A pattern never matches
+	// across the end of a range.
+	void AOBApproximateScanner::scan(const std::vector<AOBScanRange>& ranges, WorkerPool& workerPool)
+	{
+		_candidatesPerPattern.assign(_patterns.size(), std::vector<ApproximateMatch>());
+		_numberOfCandidatesPerPattern.assign(_patterns.size(), 0);
+		size_t totalSize = 0;
+		for (auto& range : ranges)
+		{
+			totalSize += range.size;
+		}
+		const size_t numberOfChunksWanted = static_cast<size_t>(workerPool.numberOfWorkers()) * AOB_APPROXIMATE_CHUNKS_PER_WORKER;
+		size_t chunkSize = totalSize / (numberOfChunksWanted > 0 ? numberOfChunksWanted : 1);
+		if (chunkSize < AOB_APPROXIMATE_MINIMUM_CHUNK_SIZE)
+		{
+			chunkSize = AOB_APPROXIMATE_MINIMUM_CHUNK_SIZE;
+		}
+		// the chunks of a range overlap with the next chunk of the same range only, so patterns never match across the end of a range.
+		struct Chunk
+		{
+			const uint8_t* start;
+			const uint8_t* end;
+			const uint8_t* rangeEnd;
+		};
+		std::vector<Chunk> chunks;
+		for (auto& range : ranges)
+		{
+			if (nullptr == range.start)
+			{
+				continue;
+			}
+			const uint8_t* rangeEnd = range.start + range.size;
+			for (const uint8_t* chunkStart = range.start; chunkStart < rangeEnd; chunkStart += chunkSize)
+			{
+				const uint8_t* chunkEnd = (static_cast<size_t>(rangeEnd - chunkStart) > chunkSize) ? chunkStart + chunkSize : rangeEnd;
+				chunks.push_back({ chunkStart, chunkEnd, rangeEnd });
+			}
+		}
+		std::vector<ChunkScanResult> resultPerChunk(chunks.size());
+		for (size_t chunkIndex = 0; chunkIndex < chunks.size(); chunkIndex++)
+		{
+			ChunkScanResult& chunkResult = resultPerChunk[chunkIndex];
+			const Chunk chunk = chunks[chunkIndex];
+			workerPool.enqueue([this, chunk, &chunkResult] { scanChunk(chunk.start, chunk.end, chunk.rangeEnd, chunkResult); });
+		}
+		workerPool.waitUntilIdle();
+
+		for (size_t patternId = 0; patternId < _patterns.size(); patternId++)
+		{
+			std::vector<ApproximateMatch>& candidates = _candidatesPerPattern[patternId];
+			for (auto& chunkResult : resultPerChunk)
+			{
+				const std::vector<ApproximateMatch>& chunkCandidates = chunkResult.candidatesPerPattern[patternId];
+				candidates.insert(candidates.end(), chunkCandidates.begin(), chunkCandidates.end());
+				_numberOfCandidatesPerPattern[patternId] += chunkResult.numberOfCandidatesPerPattern[patternId];
+			}
+			keepBestCandidates(candidates);
+		}
+	}
+
+
+	// Returns the best candidates found for the pattern with the id specified, best first. 
+	const std::vector<ApproximateMatch>& AOBApproximateScanner::candidatesOfPattern(int patternId) const
+	{
+		static const std::vector<ApproximateMatch> noCandidates;
+		if (patternId < 0 || patternId >= static_cast<int>(_candidatesPerPattern.size()))
+		{
+			return noCandidates;
+		}
+		return _candidatesPerPattern[patternId];
+	}
+
+
+	// Returns the number of candidates found for the pattern with the id specified. This can be more than the number of candidates returned 
+	// by candidatesOfPattern, as only the best ones are kept.
+	int AOBApproximateScanner::numberOfCandidates(int patternId) const
+	{
+		if (patternId < 0 || patternId >= static_cast<int>(_numberOfCandidatesPerPattern.size()))
+		{
+			return 0;
+		}
+		return static_cast<int>(_numberOfCandidatesPerPattern[patternId]);
+	}
+
+
+	// Returns the number of mismatches the pattern with the id specified is allowed to have. 0 means the pattern isn't searched for.
+	int AOBApproximateScanner::maxNumberOfMismatchesOfPattern(int patternId) const
+	{
+		if (patternId < 0 || patternId >= numberOfPatterns())
+		{
+			return 0;
+		}
+		return _patterns[patternId].maxNumberOfMismatches;
+	}
+
+
+	// Returns the candidate which differs 1 byte from its pattern if it's the only candidate that close, or nullptr if there's none or more 
+	// than one, or if the pattern matches exactly. rankedCandidates are the candidates of a pattern as returned by candidatesOfPattern, so
+	// at least 2 candidates have to be kept per pattern for this to see a second one.
+	const ApproximateMatch* AOBApproximateScanner::uniqueCandidateWithOneMismatch(const std::vector<ApproximateMatch>& rankedCandidates)
+	{
+		if (rankedCandidates.empty() || rankedCandidates[0].numberOfMismatches != 1)
+		{
+			return nullptr;
+		}
+		return (rankedCandidates.size() == 1 || rankedCandidates[1].numberOfMismatches > 1) ? &rankedCandidates[0] : nullptr;
+	}
+
+
+	// Determines the number of mismatches allowed for the pattern and builds its byte masks: for each byte value, bit n is 0 if that value
+	// matches byte n of the pattern. Wildcards match every value. 
+	void AOBApproximateScanner::prepareShiftOrPattern(ShiftOrPattern& toPrepare) const
+	{
+		const ScanPattern& pattern = toPrepare.pattern;
+		int numberOfSignificantBytes = 0;
+		for (int i = 0; i < pattern.patternSize(); i++)
+		{
+			if (pattern.patternMask()[i] != 0)
+			{
+				numberOfSignificantBytes++;
+			}
+		}
+		toPrepare.maxNumberOfMismatches = std::min(_maxNumberOfMismatches, numberOfSignificantBytes / AOB_APPROXIMATE_MIN_SIGNIFICANT_BYTES_PER_MISMATCH);
+		for (int value = 0; value < 256; value++)
+		{
+			uint64_t byteMask = ~0ULL;
+			for (int i = 0; i < pattern.patternSize(); i++)
+			{
+				if (pattern.patternMask()[i] == 0 || pattern.bytePattern()[i] == value)
+				{
+					byteMask &= ~(1ULL << i);
+				}
+			}
+			toPrepare.byteMasks[value] = byteMask;
+		}
+	}
+
+
+	void AOBApproximateScanner::scanChunk(const uint8_t* chunkStart, const uint8_t* ownedChunkEnd, const uint8_t* rangeEnd, ChunkScanResult& result) const
+	{
+		result.candidatesPerPattern.assign(_patterns.size(), std::vector<ApproximateMatch>());
+		result.numberOfCandidatesPerPattern.assign(_patterns.size(), 0);
+		for (size_t patternId = 0; patternId < _patterns.size(); patternId++)
+		{
+			const ShiftOrPattern& toMatch = _patterns[patternId];
+			std::vector<ApproximateMatch>& candidates = result.candidatesPerPattern[patternId];
+			uint32_t& numberOfCandidates = result.numberOfCandidatesPerPattern[patternId];
+			// the number of states is a template argument so the state updates are unrolled and the states stay in registers.
+			switch (toMatch.maxNumberOfMismatches)
+			{
+				case 1:
+					scanChunkForPattern<1>(chunkStart, ownedChunkEnd, rangeEnd, toMatch, candidates, numberOfCandidates);
+					break;
+				case 2:
+					scanChunkForPattern<2>(chunkStart, ownedChunkEnd, rangeEnd, toMatch, candidates, numberOfCandidates);
+					break;
+				case 3:
+					scanChunkForPattern<3>(chunkStart, ownedChunkEnd, rangeEnd, toMatch, candidates, numberOfCandidates);
+					break;
+				default:
+					// too short to match approximately.
+					break;
+			}
+			keepBestCandidates(candidates);
+		}
+	}
+
+
+	// Shift-Or with mismatches: state[k] has bit n cleared if the pattern bytes 0..n match the image bytes ending at the current byte with
+	// at most k mismatches. A prefix matches with k mismatches if it's the prefix one byte shorter with k mismatches followed by a matching
+	// byte, or the prefix one byte shorter with k-1 mismatches followed by any byte. A candidate ends at the current byte if the bit of the
+	// last byte of the pattern is cleared in the last state. Only candidates starting before ownedChunkEnd are reported, the bytes after it
+	// are only read to complete those.
+	template<int MaxNumberOfMismatches>
+	void AOBApproximateScanner::scanChunkForPattern(const uint8_t* chunkStart, const uint8_t* ownedChunkEnd, const uint8_t* rangeEnd, const ShiftOrPattern& toMatch,
+												 std::vector<ApproximateMatch>& candidates, uint32_t& numberOfCandidates) const
+	{
+		const int patternSize = toMatch.pattern.patternSize();
+		if (rangeEnd - chunkStart < patternSize)
+		{
+			return;
+		}
+		const uint64_t lastByteBit = 1ULL << (patternSize - 1);
+		const uint8_t* scanEnd = (rangeEnd - ownedChunkEnd > patternSize - 1) ? ownedChunkEnd + patternSize - 1 : rangeEnd;
+		uint64_t states[MaxNumberOfMismatches + 1];
+		for (int k = 0; k <= MaxNumberOfMismatches; k++)
+		{
+			states[k] = ~0ULL;
+		}
+		for (const uint8_t* current = chunkStart; current < scanEnd; current++)
+		{
+			const uint64_t byteMask = toMatch.byteMasks[*current];
+			uint64_t previousStateWithOneMismatchLess = states[0];
+			states[0] = (states[0] << 1) | byteMask;
+			for (int k = 1; k <= MaxNumberOfMismatches; k++)
+			{
+				const uint64_t previousState = states[k];
+				states[k] = ((states[k] << 1) | byteMask) & (previousStateWithOneMismatchLess << 1);
+				previousStateWithOneMismatchLess = previousState;
+			}
+			if (0 == (states[MaxNumberOfMismatches] & lastByteBit))
+			{
+				numberOfCandidates++;
+				recordCandidate(current - (patternSize - 1), toMatch, candidates);
+				if (candidates.size() >= static_cast<size_t>(_maxNumberOfCandidatesPerPattern) * 4)
+				{
+					keepBestCandidates(candidates);
+				}
+			}
+		}
+	}
+
+
+	// Records the candidate at the location specified with its mismatches, which are determined by comparing the pattern with the image.
+	void AOBApproximateScanner::recordCandidate(const uint8_t* location, const ShiftOrPattern& toMatch, std::vector<ApproximateMatch>& candidates) const
+	{
+		const ScanPattern& pattern = toMatch.pattern;
+		ApproximateMatch candidate{ location, 0, 0 };
+		for (int i = 0; i < pattern.patternSize(); i++)
+		{
+			if ((location[i] & pattern.patternMask()[i]) != pattern.bytePattern()[i])
+			{
+				candidate.numberOfMismatches++;
+				candidate.mismatchMask |= (1ULL << i);
+			}
+		}
+		candidates.push_back(candidate);
+	}
+
+
+	// Sorts the candidates on number of mismatches, then location, and keeps the best ones.
+	void AOBApproximateScanner::keepBestCandidates(std::vector<ApproximateMatch>& candidates) const
+	{
+		std::sort(candidates.begin(), candidates.end(), [](const ApproximateMatch& a, const ApproximateMatch& b)
+				  {
+					  return a.numberOfMismatches != b.numberOfMismatches ? a.numberOfMismatches < b.numberOfMismatches : a.location < b.location;
+				  });
+		if (candidates.size() > static_cast<size_t>(_maxNumberOfCandidatesPerPattern))
+		{
+			candidates.resize(_maxNumberOfCandidatesPerPattern);
+		}
+	}
+}
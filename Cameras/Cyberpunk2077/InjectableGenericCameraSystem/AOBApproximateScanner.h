@@ -0,0 +1,104 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "ScanPattern.h"
+#include "AOBScanEngine.h"
+#include "WorkerPool.h"
+
+namespace IGCS
+{
+	// The maximum number of mismatching bytes a candidate location can have. 
+	#define AOB_APPROXIMATE_MAX_MISMATCHES					3
+	// A pattern needs at least this many non-wildcard bytes per allowed mismatch, otherwise it matches too many locations to be of any use. 
+	#define AOB_APPROXIMATE_MIN_SIGNIFICANT_BYTES_PER_MISMATCH		6
+
+	// A location where a pattern matches with at most the allowed number of mismatching bytes. 
+	struct ApproximateMatch
+	{
+		const uint8_t* location;
+		int numberOfMismatches;
+		uint64_t mismatchMask;		// bit n is set if byte n of the pattern doesn't match the byte in the image.
+	};
+
+	// Searches an image for locations which are close to a set of AOB patterns, e.g. patterns which stopped matching after a game update
+	// changed a byte or two in the code they were written for. Each pattern is matched with a bit-parallel Shift-Or automaton which tracks 
+	// for 0..k mismatches at the same time which prefixes of the pattern end at the current byte, so the image is read once per pattern
+	// with a handful of shifts and ands per byte. Wildcards match every byte. As patterns are at most 64 bytes, the states fit in a 64-bit word.
+	// The number of mismatches allowed per pattern is limited by its number of non-wildcard bytes, so short patterns don't match everywhere.
+	// The candidates of each pattern are ranked on number of mismatches, then on location. Like the AOBScanEngine, the image can be scanned
+	// in overlapping chunks on a WorkerPool, where a candidate is owned by the chunk its location is in.
+	class AOBApproximateScanner
+	{
+	public:
+		AOBApproximateScanner(int maxNumberOfMismatches, int maxNumberOfCandidatesPerPattern);
+		~AOBApproximateScanner();
+
+		int addPattern(const ScanPattern& pattern);
+		void scan(const std::vector<AOBScanRange>& ranges, WorkerPool& workerPool);
+		const std::vector<ApproximateMatch>& candidatesOfPattern(int patternId) const;
+		int numberOfCandidates(int patternId) const;
+		int maxNumberOfMismatchesOfPattern(int patternId) const;
+		int numberOfPatterns() const { return static_cast<int>(_patterns.size()); }
+
+		static const ApproximateMatch* uniqueCandidateWithOneMismatch(const std::vector<ApproximateMatch>& rankedCandidates);
+
+	private:
+		struct ShiftOrPattern
+		{
+			ShiftOrPattern(const ScanPattern& toMatch) : pattern{ toMatch } {}
+
+			ScanPattern pattern;
+			int maxNumberOfMismatches = 0;		// 0 means the pattern is too short to be matched approximately and is skipped.
+			uint64_t byteMasks[256];			// per byte value a 0 bit for every position in the pattern the value matches.
+		};
+
+		// The candidates found in a chunk of the image, per pattern. Each chunk has its own, so chunks can be scanned in parallel.
+		struct ChunkScanResult
+		{
+			std::vector<std::vector<ApproximateMatch>> candidatesPerPattern;
+			std::vector<uint32_t> numberOfCandidatesPerPattern;
+		};
+
+		void prepareShiftOrPattern(ShiftOrPattern& toPrepare) const;
+		void scanChunk(const uint8_t* chunkStart, const uint8_t* ownedChunkEnd, const uint8_t* rangeEnd, ChunkScanResult& result) const;
+		template<int MaxNumberOfMismatches>
+		void scanChunkForPattern(const uint8_t* chunkStart, const uint8_t* ownedChunkEnd, const uint8_t* rangeEnd, const ShiftOrPattern& toMatch,
+								 std::vector<ApproximateMatch>& candidates, uint32_t& numberOfCandidates) const;
+		void recordCandidate(const uint8_t* location, const ShiftOrPattern& toMatch, std::vector<ApproximateMatch>& candidates) const;
+		void keepBestCandidates(std::vector<ApproximateMatch>& candidates) const;
+
+		std::vector<ShiftOrPattern> _patterns;
+		std::vector<std::vector<ApproximateMatch>> _candidatesPerPattern;
+		std::vector<uint32_t> _numberOfCandidatesPerPattern;
+		int _maxNumberOfMismatches;
+		int _maxNumberOfCandidatesPerPattern;
+	};
+}
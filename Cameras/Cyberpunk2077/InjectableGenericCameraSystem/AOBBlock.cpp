@@ -34,9 +34,20 @@
 namespace IGCS
 {
 	AOBBlock::AOBBlock(string blockName, string bytePatternAsString, int occurrence)
-									: _blockName{ blockName }, _bytePatternAsString{ bytePatternAsString }, _customOffset{ 0 }, _occurrence{ occurrence },
-									  _bytePattern{ nullptr }, _patternMask{ nullptr }, _locationInImage{ nullptr }
+									: _blockName{ blockName }, _customOffset{ 0 }, _locationInImage{ nullptr }, _found{ false }, _foundApproximately{ false },
+									  _isNonCritical{ false }, _includeNonCodeSections{ false },
+									  _patternIndexThatMatched{ -1 }
 	{
+		addAlternative(bytePatternAsString, occurrence);
+	}
+
+
+	AOBBlock::AOBBlock(string blockName, const ScanPattern& pattern)
+									: _blockName{ blockName }, _customOffset{ 0 }, _locationInImage{ nullptr }, _found{ false }, _foundApproximately{ false },
+									  _isNonCritical{ false }, _includeNonCodeSections{ false },
+									  _patternIndexThatMatched{ -1 }
+	{
+		addAlternative(pattern);
 	}
 
 
@@ -45,64 +56,148 @@ namespace IGCS
 	}
 
 
-	bool AOBBlock::scan(LPBYTE imageAddress, DWORD imageSize)
+	// Adds an alternative AOB pattern + occurrence. Will be used if a previous pattern failed. 
+	void AOBBlock::addAlternative(string bytePatternAsString, int occurrence)
 	{
-		createAOBPatternFromStringPattern(_bytePatternAsString);
-		LPBYTE aobPatternLocation = Utils::findAOBPattern(imageAddress, imageSize, this);
-		if (nullptr == aobPatternLocation)
+		ScanPattern toAdd(bytePatternAsString, occurrence);
+		if (!toAdd.isValid())
 		{
-			MessageHandler::logError("Can't find pattern for block '%s'! Hook not set.", _blockName.c_str());
-			return false;
+			MessageHandler::logError("Pattern '%s' for block '%s' is malformed and is ignored.", bytePatternAsString.c_str(), _blockName.c_str());
+			return;
 		}
-		else
+		_scanPatterns.push_back(toAdd);
+	}
+
+
+	// Adds an alternative pattern, e.g. one compiled at compile time with compileScanPattern. Will be used if a previous pattern failed.
+	void AOBBlock::addAlternative(const ScanPattern& pattern)
+	{
+		if (!pattern.isValid())
 		{
-			MessageHandler::logDebug("Pattern for block '%s' found at address: %p", _blockName.c_str(), (void*)aobPatternLocation);
+			MessageHandler::logError("A pattern for block '%s' is malformed and is ignored.", _blockName.c_str());
+			return;
 		}
-		_locationInImage = aobPatternLocation;
-		return true;
+		_scanPatterns.push_back(pattern);
 	}
-	
 
-	// Creates an aob_pattern struct which is usable with an aob scan. The pattern given is in the form of "aa bb ??" where '??' is a byte
-	// which has to be skipped in the comparison, and 'aa' and 'bb' are hexadecimal bytes which have to have that value at that position.
-	// If a '|' is specified in the pattern, the position of the byte following it is the start offset returned by the aob scanner, instead of
-	// the position of the first byte of the pattern. 
-	void AOBBlock::createAOBPatternFromStringPattern(string pattern)
+
+	// Resolves this block with the results of a multi-pattern scan. locationPerScanPattern contains for each scan pattern of this block, 
+	// in the same order as scanPatterns(), the location found or nullptr if that pattern wasn't found. The first pattern found wins.
+	// numberOfMatchesPerScanPattern contains for each scan pattern how many times it matched in the image. It can be empty if that's not
+	// known, e.g. when the locations come from the cache. 
+	bool AOBBlock::processScanResults(const vector<LPBYTE>& locationPerScanPattern, const vector<int>& numberOfMatchesPerScanPattern)
 	{
-		int index = 0;
-		char* pChar = &pattern[0];
+		for (int patternIndex = 0; patternIndex < static_cast<int>(locationPerScanPattern.size()) && patternIndex < static_cast<int>(_scanPatterns.size()); patternIndex++)
+		{
+			if (nullptr != locationPerScanPattern[patternIndex])
+			{
+				if (patternIndex < static_cast<int>(numberOfMatchesPerScanPattern.size()))
+				{
+					reportAmbiguousPattern(patternIndex, numberOfMatchesPerScanPattern[patternIndex]);
+				}
+				return handleLocationFound(patternIndex, locationPerScanPattern[patternIndex]);
+			}
+		}
+		return handleLocationNotFound();
+	}
 
-		_patternSize = static_cast<int>(pattern.size());
-		_bytePattern = (LPBYTE)calloc(0x1, _patternSize);
-		_patternMask = (char*)calloc(0x1, _patternSize);
-		_customOffset = 0;
 
-		while (*pChar)
+	// Resolves this block, which wasn't found, with the results of an approximate scan. candidatesPerScanPattern contains for each scan pattern
+	// of this block, in the same order as scanPatterns(), the ranked candidate locations which differ a few bytes from that pattern. 
+	// The candidates are reported, so a new pattern can be written for them. If acceptUniqueCandidate is true and a pattern which should 
+	// match once has exactly one candidate which differs 1 byte (and no other candidates that close), the block is resolved to that candidate.
+	// Patterns are tried in order, like with an exact scan.
+	bool AOBBlock::processApproximateScanResults(const vector<vector<ApproximateMatch>>& candidatesPerScanPattern, bool acceptUniqueCandidate)
+	{
+		bool candidateAccepted = false;
+		for (int patternIndex = 0; patternIndex < static_cast<int>(candidatesPerScanPattern.size()) && patternIndex < static_cast<int>(_scanPatterns.size()); patternIndex++)
 		{
-			if (*pChar == ' ')
+			const vector<ApproximateMatch>& candidates = candidatesPerScanPattern[patternIndex];
+			reportApproximateCandidates(patternIndex, candidates);
+			if (candidateAccepted || !acceptUniqueCandidate || _scanPatterns[patternIndex].occurrence() != 1 || candidates.empty())
 			{
-				pChar++;
 				continue;
 			}
-
-			if (*pChar == '|')
+			const ApproximateMatch* candidateToAccept = AOBApproximateScanner::uniqueCandidateWithOneMismatch(candidates);
+			if (nullptr != candidateToAccept)
 			{
-				pChar++;
-				_customOffset = index;
-				continue;
+				handleLocationFound(patternIndex, const_cast<LPBYTE>(candidateToAccept->location));
+				_foundApproximately = true;
+				MessageHandler::logError("Block '%s' is hooked at %p, which differs 1 byte from pattern %d. Please verify the camera works as expected.",
+										 _blockName.c_str(), (void*)candidateToAccept->location, patternIndex);
+				candidateAccepted = true;
 			}
+		}
+		return _found || _isNonCritical;
+	}
 
-			if (*pChar == '?')
+
+	// Forgets the location found, e.g. because the module the block is in was unloaded, so the block is resolved again by the next scan.
+	void AOBBlock::resetLocation()
+	{
+		_patternIndexThatMatched = -1;
+		_customOffset = 0;
+		_locationInImage = nullptr;
+		_found = false;
+		_foundApproximately = false;
+	}
+
+
+	bool AOBBlock::handleLocationFound(int patternIndex, LPBYTE location)
+	{
+		_patternIndexThatMatched = patternIndex;
+		_customOffset = _scanPatterns[patternIndex].customOffset();
+		_locationInImage = location;
+		_found = true;
+		_foundApproximately = false;
+		MessageHandler::logDebug("Pattern for block '%s' found at address: %p", _blockName.c_str(), (void*)location);
+		return true;
+	}
+
+
+	// A pattern is expected to match exactly 'occurrence' times. If it matches more often, e.g. after a game update, the occurrence used
+	// might not be the location the pattern was written for anymore, so that's reported instead of silently hooking a different location.
+	void AOBBlock::reportAmbiguousPattern(int patternIndex, int numberOfMatches)
+	{
+		const int occurrence = _scanPatterns[patternIndex].occurrence();
+		if (numberOfMatches <= occurrence)
+		{
+			return;
+		}
+		MessageHandler::logError("Pattern %d for block '%s' matches %d times, but %d matches were expected. Using match %d, which might be the wrong location.",
+								 patternIndex, _blockName.c_str(), numberOfMatches, occurrence, occurrence);
+	}
+
+
+	// Logs the candidates of the pattern specified, with the bytes at each candidate location. Bytes which differ from the pattern are 
+	// between brackets.
+	void AOBBlock::reportApproximateCandidates(int patternIndex, const vector<ApproximateMatch>& candidates)
+	{
+		if (candidates.empty())
+		{
+			return;
+		}
+		const ScanPattern& pattern = _scanPatterns[patternIndex];
+		MessageHandler::logLine("Pattern %d for block '%s' wasn't found. Closest locations:", patternIndex, _blockName.c_str());
+		for (auto& candidate : candidates)
+		{
+			string bytesAtCandidate;
+			for (int i = 0; i < pattern.patternSize(); i++)
 			{
-				_patternMask[index++] += '?';
-				pChar += 2;
-				continue;
+				const bool isMismatch = (candidate.mismatchMask & (1ULL << i)) != 0;
+				bytesAtCandidate += Utils::formatString(isMismatch ? "[%02X] " : "%02X ", candidate.location[i]).c_str();
 			}
-
-			_patternMask[index] = 'x';
-			_bytePattern[index++] = (Utils::CharToByte(pChar[0]) << 4) + Utils::CharToByte(pChar[1]);
-			pChar += 2;
+			MessageHandler::logLine("  %p, %d byte(s) differ: %s", (void*)candidate.location, candidate.numberOfMismatches, bytesAtCandidate.c_str());
 		}
 	}
 
+
+	bool AOBBlock::handleLocationNotFound()
+	{
+		_patternIndexThatMatched = -1;
+		_found = false;
+		MessageHandler::logError("Can't find pattern for block '%s'! Hook not set.", _blockName.c_str());
+		// non-critical blocks silently 'succeed' so they don't make the whole scan fail.
+		return _isNonCritical;
+	}
 }
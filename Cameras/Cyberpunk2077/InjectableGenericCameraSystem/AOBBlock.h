@@ -28,6 +28,8 @@
 #pragma once
 #include "AOBBlock.h"
 #include "Utils.h"
+#include "ScanPattern.h"
+#include "AOBApproximateScanner.h"
 
 using namespace std;
 
@@ -37,27 +39,45 @@ namespace IGCS
 	{
 	public:
 		AOBBlock(string blockName, string bytePatternAsString, int occurrence);
+		AOBBlock(string blockName, const ScanPattern& pattern);
 		~AOBBlock();
 
-		bool scan(LPBYTE imageAddress, DWORD imageSize);
+		bool processScanResults(const vector<LPBYTE>& locationPerScanPattern, const vector<int>& numberOfMatchesPerScanPattern);
+		bool processApproximateScanResults(const vector<vector<ApproximateMatch>>& candidatesPerScanPattern, bool acceptUniqueCandidate);
+		void addAlternative(string bytePatternAsString, int occurrence);
+		void addAlternative(const ScanPattern& pattern);
+		const vector<ScanPattern>& scanPatterns() { return _scanPatterns; }
+		const string& blockName() { return _blockName; }
 		LPBYTE locationInImage() { return _locationInImage; }
-		LPBYTE bytePattern() { return _bytePattern; }
-		int occurrence() { return _occurrence; }
-		int patternSize() { return _patternSize; }
-		char* patternMask() { return _patternMask; }
 		int customOffset() { return _customOffset; }
 		LPBYTE absoluteAddress() { return (LPBYTE)(_locationInImage + (DWORD)customOffset()); }
+		bool found() { return _found; }
+		bool foundApproximately() { return _foundApproximately; }
+		void markAsNonCritical() { _isNonCritical = true; }
+		bool isNonCritical() { return _isNonCritical; }
+		void includeNonCodeSections() { _includeNonCodeSections = true; }
+		bool scansNonCodeSections() { return _includeNonCodeSections; }
+		int patternIndexThatMatched() { return _patternIndexThatMatched; }
+		void targetModule(const string& moduleName) { _moduleName = moduleName; }
+		const string& moduleName() { return _moduleName; }
+		bool isInHostImage() { return _moduleName.empty(); }
+		void resetLocation();
 
 	private:
-		void createAOBPatternFromStringPattern(string pattern);
+		bool handleLocationFound(int patternIndex, LPBYTE location);
+		void reportAmbiguousPattern(int patternIndex, int numberOfMatches);
+		bool handleLocationNotFound();
+		void reportApproximateCandidates(int patternIndex, const vector<ApproximateMatch>& candidates);
 
+		bool _found;
+		bool _foundApproximately;		// if true, the location doesn't match the pattern exactly but is the only candidate close to it.
+		bool _isNonCritical;
+		bool _includeNonCodeSections;		// if false (default) only the executable sections of the image are scanned.
 		string _blockName;
-		string _bytePatternAsString;
-		LPBYTE _bytePattern;
-		char* _patternMask;
-		int _patternSize;
+		string _moduleName;		// the module the block is in, e.g. a dll of the game. Empty (default) is the host image.
+		vector<ScanPattern> _scanPatterns;		// first is the main pattern, the others are alternatives which are used if the ones before them failed.
 		int _customOffset;
-		int _occurrence;		// starts at 1: if there are more occurrences, and e.g. the 3rd has to be picked, set this to 3.
+		int _patternIndexThatMatched;
 		LPBYTE _locationInImage;	// the location to use after the scan has been completed.
 	};
 
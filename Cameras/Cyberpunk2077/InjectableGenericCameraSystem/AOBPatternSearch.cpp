@@ -0,0 +1,377 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "AOBPatternSearch.h"
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+	#define IGCS_AOB_SIMD_SUPPORTED
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+		// MSVC allows AVX2 intrinsics in any function, gcc/clang need them to be enabled per function.
+		#define IGCS_TARGET_AVX2
+	#else
+		#define IGCS_TARGET_AVX2	__attribute__((target("avx2")))
+	#endif
+#endif
+
+namespace IGCS
+{
+	// number of slices and their size sampled from the image to build the frequency table. Sampling 1MB is plenty to get the distribution of
+	// the bytes in an image and it's much cheaper than reading the whole image.
+	#define FREQUENCY_TABLE_NUMBER_OF_SLICES			256
+	#define FREQUENCY_TABLE_SLICE_SIZE					4096
+
+	ByteFrequencyTable::ByteFrequencyTable()
+	{
+		// without an image, all bytes are equally rare.
+		for (int i = 0; i < 256; i++)
+		{
+			_frequencies[i] = 1;
+		}
+	}
+
+
+	ByteFrequencyTable::~ByteFrequencyTable()
+	{
+	}
+
+
+	void ByteFrequencyTable::buildFromImage(const uint8_t* imageAddress, size_t imageSize)
+	{
+		memset(_frequencies, 0, sizeof(_frequencies));
+		if (nullptr == imageAddress)
+		{
+			return;
+		}
+		const size_t totalSampleSize = static_cast<size_t>(FREQUENCY_TABLE_NUMBER_OF_SLICES) * FREQUENCY_TABLE_SLICE_SIZE;
+		if (imageSize <= totalSampleSize)
+		{
+			for (size_t i = 0; i < imageSize; i++)
+			{
+				_frequencies[imageAddress[i]]++;
+			}
+			return;
+		}
+		const size_t stride = imageSize / FREQUENCY_TABLE_NUMBER_OF_SLICES;
+		for (size_t slice = 0; slice < FREQUENCY_TABLE_NUMBER_OF_SLICES; slice++)
+		{
+			const uint8_t* sliceStart = imageAddress + (slice * stride);
+			for (size_t i = 0; i < FREQUENCY_TABLE_SLICE_SIZE; i++)
+			{
+				_frequencies[sliceStart[i]]++;
+			}
+		}
+	}
+}
+
+
+namespace IGCS::AOBPatternSearch
+{
+	static bool matchesScalar(const uint8_t* location, const PreparedPattern& pattern)
+	{
+		const uint8_t* bytePattern = pattern.paddedBytePattern.data();
+		const uint8_t* patternMask = pattern.paddedPatternMask.data();
+		for (int i = 0; i < pattern.patternSize; i++)
+		{
+			if ((location[i] & patternMask[i]) != bytePattern[i])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+
+	static const uint8_t* findPatternScalar(const uint8_t* start, const uint8_t* end, const PreparedPattern& pattern)
+	{
+		if (end - start < pattern.patternSize)
+		{
+			return nullptr;
+		}
+		const uint8_t* lastCandidate = end - pattern.patternSize;
+		for (const uint8_t* candidate = start; candidate <= lastCandidate; candidate++)
+		{
+			if (candidate[pattern.firstAnchorIndex] == pattern.firstAnchorByte && candidate[pattern.secondAnchorIndex] == pattern.secondAnchorByte &&
+				matchesScalar(candidate, pattern))
+			{
+				return candidate;
+			}
+		}
+		return nullptr;
+	}
+
+
+#ifdef IGCS_AOB_SIMD_SUPPORTED
+	static inline int indexOfLowestSetBit(uint32_t value)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, value);
+		return static_cast<int>(index);
+#else
+		return __builtin_ctz(value);
+#endif
+	}
+
+
+	static bool cpuSupportsAVX2()
+	{
+#if defined(_MSC_VER)
+		int cpuInfo[4];
+		__cpuid(cpuInfo, 0);
+		if (cpuInfo[0] < 7)
+		{
+			return false;
+		}
+		__cpuid(cpuInfo, 1);
+		const bool osUsesXSave = (cpuInfo[2] & (1 << 27)) != 0;
+		const bool cpuHasAVX = (cpuInfo[2] & (1 << 28)) != 0;
+		__cpuidex(cpuInfo, 7, 0);
+		const bool cpuHasAVX2 = (cpuInfo[1] & (1 << 5)) != 0;
+		if (!(osUsesXSave && cpuHasAVX && cpuHasAVX2))
+		{
+			return false;
+		}
+		// the OS has to save the ymm registers on a context switch too.
+		return (_xgetbv(0) & 0x6) == 0x6;
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+
+
+	// Verifies the complete pattern at location with masked 16-byte compares. Falls back to the scalar compare if the padded pattern would read past end.
+	static inline bool matchesSSE2(const uint8_t* location, const uint8_t* end, const PreparedPattern& pattern)
+	{
+		const size_t paddedSize = pattern.paddedBytePattern.size();
+		if (static_cast<size_t>(end - location) < paddedSize)
+		{
+			return matchesScalar(location, pattern);
+		}
+		const uint8_t* bytePattern = pattern.paddedBytePattern.data();
+		const uint8_t* patternMask = pattern.paddedPatternMask.data();
+		for (size_t offset = 0; offset < paddedSize; offset += 16)
+		{
+			const __m128i imageBytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(location + offset));
+			const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(patternMask + offset));
+			const __m128i expected = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytePattern + offset));
+			const __m128i equal = _mm_cmpeq_epi8(_mm_and_si128(imageBytes, mask), expected);
+			if (_mm_movemask_epi8(equal) != 0xFFFF)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+
+	static const uint8_t* findPatternSSE2(const uint8_t* start, const uint8_t* end, const PreparedPattern& pattern)
+	{
+		if (end - start < pattern.patternSize)
+		{
+			return nullptr;
+		}
+		const uint8_t* lastCandidate = end - pattern.patternSize;
+		const __m128i firstAnchor = _mm_set1_epi8(static_cast<char>(pattern.firstAnchorByte));
+		const __m128i secondAnchor = _mm_set1_epi8(static_cast<char>(pattern.secondAnchorByte));
+		const uint8_t* candidates = start;
+		// as long as all 16 candidates are valid candidates, the loads at the anchor indices stay inside the image.
+		for (; lastCandidate - candidates >= 15; candidates += 16)
+		{
+			const __m128i firstBlock = _mm_loadu_si128(reinterpret_cast<const __m128i*>(candidates + pattern.firstAnchorIndex));
+			const __m128i secondBlock = _mm_loadu_si128(reinterpret_cast<const __m128i*>(candidates + pattern.secondAnchorIndex));
+			uint32_t hits = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(firstBlock, firstAnchor), _mm_cmpeq_epi8(secondBlock, secondAnchor))));
+			while (0 != hits)
+			{
+				const uint8_t* candidate = candidates + indexOfLowestSetBit(hits);
+				if (matchesSSE2(candidate, end, pattern))
+				{
+					return candidate;
+				}
+				hits &= hits - 1;
+			}
+		}
+		return findPatternScalar(candidates, end, pattern);
+	}
+
+
+	IGCS_TARGET_AVX2
+	static const uint8_t* findPatternAVX2(const uint8_t* start, const uint8_t* end, const PreparedPattern& pattern)
+	{
+		if (end - start < pattern.patternSize)
+		{
+			return nullptr;
+		}
+		const uint8_t* lastCandidate = end - pattern.patternSize;
+		const __m256i firstAnchor = _mm256_set1_epi8(static_cast<char>(pattern.firstAnchorByte));
+		const __m256i secondAnchor = _mm256_set1_epi8(static_cast<char>(pattern.secondAnchorByte));
+		const uint8_t* candidates = start;
+		for (; lastCandidate - candidates >= 31; candidates += 32)
+		{
+			const __m256i firstBlock = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(candidates + pattern.firstAnchorIndex));
+			const __m256i secondBlock = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(candidates + pattern.secondAnchorIndex));
+			uint32_t hits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(firstBlock, firstAnchor), _mm256_cmpeq_epi8(secondBlock, secondAnchor))));
+			while (0 != hits)
+			{
+				const uint8_t* candidate = candidates + indexOfLowestSetBit(hits);
+				if (matchesSSE2(candidate, end, pattern))
+				{
+					return candidate;
+				}
+				hits &= hits - 1;
+			}
+		}
+		return findPatternSSE2(candidates, end, pattern);
+	}
+#endif
+
+
+	// Prepares the pattern for the kernels: picks the two rarest non-wildcard bytes according to the frequencies specified as anchors and pads
+	// the pattern. If the pattern has just one non-wildcard byte, both anchors are that byte.
+	PreparedPattern preparePattern(const ScanPattern& pattern, const ByteFrequencyTable& frequencies)
+	{
+		PreparedPattern toReturn;
+		toReturn.patternSize = pattern.patternSize();
+		const size_t paddedSize = ((static_cast<size_t>(toReturn.patternSize) + 15) / 16) * 16;
+		toReturn.paddedBytePattern.assign(paddedSize, 0);
+		toReturn.paddedPatternMask.assign(paddedSize, 0);
+		if (toReturn.patternSize <= 0)
+		{
+			return toReturn;
+		}
+		memcpy(toReturn.paddedBytePattern.data(), pattern.bytePattern(), toReturn.patternSize);
+		memcpy(toReturn.paddedPatternMask.data(), pattern.patternMask(), toReturn.patternSize);
+
+		int rarestIndex = -1;
+		int secondRarestIndex = -1;
+		for (int i = 0; i < toReturn.patternSize; i++)
+		{
+			if (pattern.patternMask()[i] != 0xFF)
+			{
+				continue;
+			}
+			const uint32_t frequency = frequencies.frequencyOf(pattern.bytePattern()[i]);
+			if (rarestIndex < 0 || frequency < frequencies.frequencyOf(pattern.bytePattern()[rarestIndex]))
+			{
+				secondRarestIndex = rarestIndex;
+				rarestIndex = i;
+				continue;
+			}
+			if (secondRarestIndex < 0 || frequency < frequencies.frequencyOf(pattern.bytePattern()[secondRarestIndex]))
+			{
+				secondRarestIndex = i;
+			}
+		}
+		if (rarestIndex < 0)
+		{
+			// only wildcards. Anchor on the first byte with a mask of 0, which matches everything
+			rarestIndex = 0;
+		}
+		if (secondRarestIndex < 0)
+		{
+			secondRarestIndex = rarestIndex;
+		}
+		toReturn.firstAnchorIndex = rarestIndex;
+		toReturn.firstAnchorByte = toReturn.paddedBytePattern[rarestIndex];
+		toReturn.secondAnchorIndex = secondRarestIndex;
+		toReturn.secondAnchorByte = toReturn.paddedBytePattern[secondRarestIndex];
+		return toReturn;
+	}
+
+
+	// Returns the first location in [start, end) where the pattern matches, or nullptr if there's no match.
+	const uint8_t* findPattern(const uint8_t* start, const uint8_t* end, const PreparedPattern& pattern, SearchKernel kernel)
+	{
+		if (nullptr == start || pattern.patternSize <= 0)
+		{
+			return nullptr;
+		}
+		if (!isKernelSupported(kernel))
+		{
+			kernel = SearchKernel::Scalar;
+		}
+#ifdef IGCS_AOB_SIMD_SUPPORTED
+		if (SearchKernel::Best == kernel)
+		{
+			kernel = isKernelSupported(SearchKernel::AVX2) ? SearchKernel::AVX2 : SearchKernel::SSE2;
+		}
+		switch (kernel)
+		{
+		case SearchKernel::AVX2:
+			return findPatternAVX2(start, end, pattern);
+		case SearchKernel::SSE2:
+			return findPatternSSE2(start, end, pattern);
+		default:
+			break;
+		}
+#endif
+		return findPatternScalar(start, end, pattern);
+	}
+
+
+	bool isKernelSupported(SearchKernel kernel)
+	{
+		switch (kernel)
+		{
+		case SearchKernel::Scalar:
+		case SearchKernel::Best:
+			return true;
+#ifdef IGCS_AOB_SIMD_SUPPORTED
+		case SearchKernel::SSE2:
+			// part of x64
+			return true;
+		case SearchKernel::AVX2:
+		{
+			static const bool avx2Supported = cpuSupportsAVX2();
+			return avx2Supported;
+		}
+#endif
+		default:
+			return false;
+		}
+	}
+
+
+	const char* kernelName(SearchKernel kernel)
+	{
+		switch (kernel)
+		{
+		case SearchKernel::Scalar:
+			return "Scalar";
+		case SearchKernel::SSE2:
+			return "SSE2";
+		case SearchKernel::AVX2:
+			return "AVX2";
+		case SearchKernel::Best:
+			return "Best";
+		default:
+			return "Unknown";
+		}
+	}
+}
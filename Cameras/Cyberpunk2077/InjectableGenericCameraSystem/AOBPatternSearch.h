@@ -0,0 +1,79 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "ScanPattern.h"
+
+namespace IGCS
+{
+	// Sampled frequencies of each byte value in an image. Used to pick the rarest bytes of a pattern as anchors for the search kernels.
+	class ByteFrequencyTable
+	{
+	public:
+		ByteFrequencyTable();
+		~ByteFrequencyTable();
+
+		void buildFromImage(const uint8_t* imageAddress, size_t imageSize);
+		uint32_t frequencyOf(uint8_t value) const { return _frequencies[value]; }
+
+	private:
+		uint32_t _frequencies[256];
+	};
+}
+
+namespace IGCS::AOBPatternSearch
+{
+	enum class SearchKernel : uint8_t
+	{
+		Scalar = 0,
+		SSE2 = 1,
+		AVX2 = 2,
+		Best = 3,		// the fastest kernel supported by the cpu we're running on.
+	};
+
+	// A scan pattern prepared for the search kernels. The kernels look for the two rarest non-wildcard bytes of the pattern at the same time
+	// and only verify the complete pattern at locations where both are present. The pattern bytes and mask are padded to a multiple of 16
+	// so the verification can be done with masked 16-byte compares.
+	struct PreparedPattern
+	{
+		int patternSize = 0;
+		int firstAnchorIndex = 0;
+		uint8_t firstAnchorByte = 0;
+		int secondAnchorIndex = 0;
+		uint8_t secondAnchorByte = 0;
+		std::vector<uint8_t> paddedBytePattern;
+		std::vector<uint8_t> paddedPatternMask;
+	};
+
+	PreparedPattern preparePattern(const ScanPattern& pattern, const ByteFrequencyTable& frequencies);
+	const uint8_t* findPattern(const uint8_t* start, const uint8_t* end, const PreparedPattern& pattern, SearchKernel kernel = SearchKernel::Best);
+	bool isKernelSupported(SearchKernel kernel);
+	const char* kernelName(SearchKernel kernel);
+}
@@ -0,0 +1,71 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include "ScanPattern.h"
+#include "GameConstants.h"
+
+namespace IGCS::GameSpecific
+{
+	// Critical blocks are needed for the camera itself, they're resolved and hooked before the camera can be used. Non-critical blocks are only
+	// needed for additional features (time of day, HUD toggle etc.), they're resolved and hooked in the background after that.
+	enum class AOBBlockKind : uint8_t
+	{
+		Critical,
+		NonCritical,
+	};
+
+	// An AOB block of the game: the key of the block, the pattern to scan for, whether the block is critical and the module the block is in.
+	// Blocks without a module are in the host image. Blocks in other modules, e.g. "AnselSDK64.dll", are scanned concurrently with the host 
+	// image if the module is loaded at startup, otherwise when the module is loaded.
+	struct AOBPatternDefinition
+	{
+		const char* blockName;
+		ScanPattern pattern;
+		AOBBlockKind kind;
+		const char* moduleName = nullptr;
+	};
+
+	// The patterns of all AOB blocks of the game. The patterns are compiled at compile time, so a malformed pattern is a compile error. 
+	// Multiple definitions with the same block name are alternatives of that block, in the order they're specified. This header doesn't
+	// depend on windows headers, so tools can use the pattern set too.
+	inline constexpr AOBPatternDefinition aobPatternDefinitions[] =
+	{
+		{ ACTIVECAM_ADDRESS_INTERCEPT_KEY, compileScanPattern("0F 11 42 10 48 8B 03 | FF 90 58 02 00 00 F3 0F 11 46 20 48 8D 54 24 20 48 8B 03 48 8B CB", 1), AOBBlockKind::Critical },
+		{ ACTIVECAM_CAMERA_WRITE1_INTERCEPT_KEY, compileScanPattern("F2 0F 11 83 E0 00 00 00 0F 28 44 24 30 89 8B E8 00 00 00 0F 11 83 F0 00 00 00", 2), AOBBlockKind::Critical },	// 2 entries, we need the second one
+		{ PMSTRUCT_ADDRESS_INTERCEPT_KEY, compileScanPattern("49 8B 4E 40 48 8D 95 90 00 00 00 41 88 9E FB 02 00 00", 1), AOBBlockKind::Critical },
+		// the coord factor is data, but the pattern is the instruction reading it, so it's found in the code sections like the other blocks.
+		{ COORD_FACTOR_ADDRESS_KEY, compileScanPattern("F3 44 0F 10 1D | ?? ?? ?? ?? 48 85 C0 74 38", 1), AOBBlockKind::Critical },
+		{ RESOLUTION_STRUCT_ADDRESS_INTERCEPT_KEY, compileScanPattern("8B 81 84 00 00 00 89 41 44 8B 81 88 00 00 00 89 41 40", 1), AOBBlockKind::NonCritical },
+		{ TOD_READ_INTERCEPT_KEY, compileScanPattern("48 8B DA 48 8B 01 FF 90 F8 00 00 00 48 8B C3", 1), AOBBlockKind::NonCritical },
+		{ PLAY_WIDGETBUCKET_READ_INTERCEPT_KEY, compileScanPattern("88 81 B1 00 00 00 48 89 BC 24 98 00 00 00 48 8B 7C 24 20", 1), AOBBlockKind::NonCritical },
+		{ PM_WIDGETBUCKET_READ_INTERCEPT_KEY, compileScanPattern("74 0A 80 7A 40 00 74 04 B3 01 EB 02 32 DB 48 8B 49 40 0F B6 D3", 1), AOBBlockKind::NonCritical },
+		{ FOV_PLAY_WRITE_INTERCEPT_KEY, compileScanPattern("F3 0F 11 9F 5C 02 00 00 48 8B 8F B0 01 00 00", 1), AOBBlockKind::Critical },
+		{ TIMESTOP_STRUCT_INTERCEPT_KEY, compileScanPattern("44 8B 49 1C 48 85 D2 75 07 45 85 C9", 1), AOBBlockKind::NonCritical },
+		{ WEATHER_STRUCT_INTERCEPT_KEY, compileScanPattern("F3 0F 11 96 F0 00 00 00 F3 0F 5C C2 F3 0F 10 8D 3C 0A 00 00", 1), AOBBlockKind::NonCritical },
+	};
+}
@@ -0,0 +1,218 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "AOBScanCache.h"
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace IGCS
+{
+	// first line of the cache file. Bump the version if the format changes, older files are then ignored.
+	#define AOB_CACHE_FILE_HEADER			"IGCS_AOB_CACHE 1"
+	#define CODE_HASH_PRIME1				0x9E3779B185EBCA87ULL
+	#define CODE_HASH_PRIME2				0xC2B2AE3D27D4EB4FULL
+
+	AOBScanCache::AOBScanCache()
+	{
+	}
+
+
+	AOBScanCache::~AOBScanCache()
+	{
+	}
+
+
+	// Returns true if all fields of the line just read from cacheFile were read and nothing follows them. Every line is written with a
+	// line end, so a line without one, at the end of the file, is the remainder of a truncated write: its last field could be cut short 
+	// and still parse.
+	static bool isCompleteLine(std::istringstream& line, const std::ifstream& cacheFile)
+	{
+		if (line.fail() || cacheFile.eof())
+		{
+			return false;
+		}
+		line >> std::ws;
+		return line.eof();
+	}
+
+
+	// Loads the cache file specified. Returns true if the file exists and was created for the module identity specified, false otherwise,
+	// in which case the cache is empty.
+	bool AOBScanCache::load(const std::filesystem::path& cacheFilename, const ModuleIdentity& moduleIdentity)
+	{
+		clear(moduleIdentity);
+		std::ifstream cacheFile(cacheFilename);
+		if (!cacheFile)
+		{
+			return false;
+		}
+		std::string line;
+		if (!std::getline(cacheFile, line) || line != AOB_CACHE_FILE_HEADER)
+		{
+			return false;
+		}
+		ModuleIdentity identityInFile;
+		if (!std::getline(cacheFile, line))
+		{
+			return false;
+		}
+		std::istringstream identityLine(line);
+		std::string keyword;
+		identityLine >> keyword >> std::hex >> identityInFile.timeDateStamp >> identityInFile.sizeOfImage >> identityInFile.codeHash;
+		if (!isCompleteLine(identityLine, cacheFile) || keyword != "module" || identityInFile != moduleIdentity)
+		{
+			return false;
+		}
+		// one line per block: name, pattern hash, rva, pattern index, custom offset
+		while (std::getline(cacheFile, line))
+		{
+			std::istringstream blockLine(line);
+			std::string blockName;
+			CachedBlockLocation location;
+			blockLine >> blockName >> std::hex >> location.patternHash >> location.rva >> std::dec >> location.patternIndex >> location.customOffset;
+			if (!isCompleteLine(blockLine, cacheFile))
+			{
+				// corrupt file, don't trust any of it.
+				_locationPerBlockName.clear();
+				return false;
+			}
+			_locationPerBlockName[blockName] = location;
+		}
+		return true;
+	}
+
+
+	bool AOBScanCache::save(const std::filesystem::path& cacheFilename) const
+	{
+		std::ofstream cacheFile(cacheFilename, std::ios::trunc);
+		if (!cacheFile)
+		{
+			return false;
+		}
+		cacheFile << AOB_CACHE_FILE_HEADER << "\n";
+		cacheFile << "module " << std::hex << _moduleIdentity.timeDateStamp << " " << _moduleIdentity.sizeOfImage << " " << _moduleIdentity.codeHash << "\n";
+		for (auto& nameLocationPair : _locationPerBlockName)
+		{
+			const CachedBlockLocation& location = nameLocationPair.second;
+			cacheFile << nameLocationPair.first << " " << std::hex << location.patternHash << " " << location.rva << " " << std::dec
+					  << location.patternIndex << " " << location.customOffset << "\n";
+		}
+		return static_cast<bool>(cacheFile);
+	}
+
+
+	// Empties the cache and makes it a cache for the module identity specified.
+	void AOBScanCache::clear(const ModuleIdentity& moduleIdentity)
+	{
+		_moduleIdentity = moduleIdentity;
+		_locationPerBlockName.clear();
+	}
+
+
+	const CachedBlockLocation* AOBScanCache::findBlockLocation(const std::string& blockName) const
+	{
+		auto it = _locationPerBlockName.find(blockName);
+		return it == _locationPerBlockName.end() ? nullptr : &it->second;
+	}
+
+
+	// Same as findBlockLocation, but only returns the cached location if it's still valid for the patterns of the block specified: the pattern
+	// which matched is still the same pattern with the same custom offset, and the bytes at the cached location in the image still match it.
+	const CachedBlockLocation* AOBScanCache::findValidBlockLocation(const std::string& blockName, const std::vector<ScanPattern>& scanPatterns, 
+																	 const uint8_t* imageBase, size_t imageSize) const
+	{
+		const CachedBlockLocation* toReturn = findBlockLocation(blockName);
+		if (nullptr == toReturn || toReturn->patternIndex < 0 || toReturn->patternIndex >= static_cast<int>(scanPatterns.size()))
+		{
+			return nullptr;
+		}
+		const ScanPattern& pattern = scanPatterns[toReturn->patternIndex];
+		if (toReturn->patternHash != pattern.patternHash() || toReturn->customOffset != pattern.customOffset() ||
+			static_cast<size_t>(toReturn->rva) + pattern.patternSize() > imageSize || !pattern.matchesAt(imageBase + toReturn->rva))
+		{
+			return nullptr;
+		}
+		return toReturn;
+	}
+
+
+	void AOBScanCache::setBlockLocation(const std::string& blockName, const CachedBlockLocation& location)
+	{
+		_locationPerBlockName[blockName] = location;
+	}
+
+
+	// Determines the identity of the module mapped at imageBase. The code hash hashes the code of the module 8 bytes at a time in 4 independent
+	// lanes, which runs at memory speed, so it's a fraction of the cost of a scan. The code is what memorySource returns as the ranges to scan,
+	// so only the readable parts of the executable sections and regions are read, and a packed or protected image with guard or no-access
+	// pages in its code doesn't fault before it's scanned. The start and size of every range are hashed too, so a hole moving changes the hash.
+	ModuleIdentity AOBScanCache::determineModuleIdentity(const uint8_t* imageBase, size_t imageSize, const MemorySource& memorySource)
+	{
+		ModuleIdentity toReturn;
+		// the headers can only be read if the image starts with a readable range.
+		const std::vector<AOBScanRange> readableRanges = memorySource.determineScanRanges(imageBase, imageSize, true);
+		const size_t readableHeaderSize = (!readableRanges.empty() && readableRanges.front().start == imageBase) ? readableRanges.front().size : 0;
+		PEImageInfo imageInfo;
+		if (!imageInfo.parse(imageBase, readableHeaderSize))
+		{
+			return toReturn;
+		}
+		toReturn.timeDateStamp = imageInfo.timeDateStamp();
+		toReturn.sizeOfImage = imageInfo.sizeOfImage();
+		uint64_t lanes[4] = { CODE_HASH_PRIME1, CODE_HASH_PRIME2, CODE_HASH_PRIME1 ^ CODE_HASH_PRIME2, ~CODE_HASH_PRIME1 };
+		for (auto& range : memorySource.determineScanRanges(imageBase, imageSize, false))
+		{
+			const uint8_t* current = range.start;
+			const uint8_t* end = current + range.size;
+			for (; end - current >= 32; current += 32)
+			{
+				for (int lane = 0; lane < 4; lane++)
+				{
+					uint64_t value;
+					memcpy(&value, current + (lane * 8), sizeof(value));
+					lanes[lane] = (lanes[lane] ^ value) * CODE_HASH_PRIME1;
+					lanes[lane] ^= lanes[lane] >> 29;
+				}
+			}
+			for (; current < end; current++)
+			{
+				lanes[0] = (lanes[0] ^ *current) * CODE_HASH_PRIME2;
+			}
+			lanes[1] ^= range.size;
+			lanes[2] = (lanes[2] ^ static_cast<uint64_t>(range.start - imageBase)) * CODE_HASH_PRIME2;
+		}
+		uint64_t hash = 0;
+		for (int lane = 0; lane < 4; lane++)
+		{
+			hash = (hash ^ lanes[lane]) * CODE_HASH_PRIME2;
+			hash ^= hash >> 31;
+		}
+		toReturn.codeHash = hash;
+		return toReturn;
+	}
+}
@@ -0,0 +1,87 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+#include "MemorySource.h"
+#include "PEImageInfo.h"
+#include "ScanPattern.h"
+
+namespace IGCS
+{
+	// Identifies a module's exact build: the linker timestamp and image size from the PE headers plus a hash of the code in its executable sections.
+	struct ModuleIdentity
+	{
+		uint32_t timeDateStamp = 0;
+		uint32_t sizeOfImage = 0;
+		uint64_t codeHash = 0;
+
+		bool operator==(const ModuleIdentity& other) const
+		{
+			return timeDateStamp == other.timeDateStamp && sizeOfImage == other.sizeOfImage && codeHash == other.codeHash;
+		}
+		bool operator!=(const ModuleIdentity& other) const { return !(*this == other); }
+	};
+
+	// The resolved location of an AOB block, relative to the image start.
+	struct CachedBlockLocation
+	{
+		uint64_t patternHash = 0;		// ScanPattern::patternHash() of the pattern which matched, so a changed pattern in the dll invalidates the cached location.
+		uint32_t rva = 0;
+		int patternIndex = 0;			// the index of the alternative which matched
+		int customOffset = 0;
+	};
+
+	// Cache of resolved AOB block locations per module build, persisted in a small text file. Used to skip the scan on a warm start: the
+	// cached locations are only valid for the same module identity and are still verified against their pattern before they're used.
+	class AOBScanCache
+	{
+	public:
+		AOBScanCache();
+		~AOBScanCache();
+
+		bool load(const std::filesystem::path& cacheFilename, const ModuleIdentity& moduleIdentity);
+		bool save(const std::filesystem::path& cacheFilename) const;
+		void clear(const ModuleIdentity& moduleIdentity);
+		const CachedBlockLocation* findBlockLocation(const std::string& blockName) const;
+		const CachedBlockLocation* findValidBlockLocation(const std::string& blockName, const std::vector<ScanPattern>& scanPatterns, const uint8_t* imageBase,
+														  size_t imageSize) const;
+		void setBlockLocation(const std::string& blockName, const CachedBlockLocation& location);
+		int numberOfBlockLocations() const { return static_cast<int>(_locationPerBlockName.size()); }
+
+		static ModuleIdentity determineModuleIdentity(const uint8_t* imageBase, size_t imageSize, const MemorySource& memorySource);
+
+	private:
+		ModuleIdentity _moduleIdentity;
+		std::map<std::string, CachedBlockLocation> _locationPerBlockName;
+	};
+}
@@ -0,0 +1,523 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "AOBScanEngine.h"
+#include <cstring>
+#include <deque>
+
+namespace IGCS
+{
+	// Anchors longer than this don't make the automaton more selective in practice, they only add states.
+	#define AOB_ANCHOR_MAX_LENGTH		16
+	// Smaller chunks than this don't win anything anymore, the per chunk overhead and overlap start to dominate.
+	#define AOB_SCAN_MINIMUM_CHUNK_SIZE			(1024 * 1024)
+	// More chunks than workers, so the load stays balanced when chunks take uneven time, e.g. as one has far more anchor hits to verify: a
+	// worker which is done early picks up another chunk.
+	#define AOB_SCAN_CHUNKS_PER_WORKER			4
+	// Matches of a pattern beyond this number (or beyond its occurrence, if that's larger) are counted but their location isn't recorded, so
+	// a pattern which matches everywhere doesn't blow up the index.
+	#define AOB_MAX_RECORDED_MATCHES_PER_PATTERN	64
+	// The search kernels sweep a range in blocks of this size, all patterns per block, so the block is still in the cache for the next pattern.
+	#define AOB_SEARCH_KERNEL_BLOCK_SIZE			(256 * 1024)
+
+	AOBScanEngine::AOBScanEngine() : _indexBase{ nullptr }, _maxPatternSize{ 0 }, _compiled{ false }, _scanMethod{ ScanMethod::Automatic }, _useSearchKernels{ false }
+	{
+		memset(_isAnchorStartByte, 0, sizeof(_isAnchorStartByte));
+	}
+
+
+	AOBScanEngine::~AOBScanEngine()
+	{
+	}
+
+
+	// Registers the pattern specified with the engine. Returns the id of the pattern, to be used with locationOfPattern after the scan. 
+	int AOBScanEngine::addPattern(const ScanPattern& pattern)
+	{
+		_patterns.emplace_back(pattern);
+		_compiled = false;
+		return static_cast<int>(_patterns.size()) - 1;
+	}
+
+
+	// Compiles all registered patterns into the automaton. Called by scan if the engine isn't compiled yet.
+	void AOBScanEngine::compile()
+	{
+		_maxPatternSize = 0;
+		for (auto& anchoredPattern : _patterns)
+		{
+			determineAnchor(anchoredPattern);
+			const int occurrence = anchoredPattern.pattern.occurrence();
+			anchoredPattern.maxNumberOfRecordedMatches = occurrence > AOB_MAX_RECORDED_MATCHES_PER_PATTERN ? occurrence : AOB_MAX_RECORDED_MATCHES_PER_PATTERN;
+			if (anchoredPattern.pattern.patternSize() > _maxPatternSize)
+			{
+				_maxPatternSize = anchoredPattern.pattern.patternSize();
+			}
+		}
+		buildAutomaton();
+		_compiled = true;
+	}
+
+
+	// Sweeps the image once and records for every registered pattern all its matches in the match index.
+	void AOBScanEngine::scan(const uint8_t* imageAddress, size_t imageSize)
+	{
+		scan(std::vector<AOBScanRange>{ { imageAddress, imageSize } });
+	}
+
+
+	// Same as scan, but splits the image in chunks which are scanned in parallel on the worker pool specified. 
+	void AOBScanEngine::scan(const uint8_t* imageAddress, size_t imageSize, WorkerPool& workerPool)
+	{
+		scan(std::vector<AOBScanRange>{ { imageAddress, imageSize } }, workerPool);
+	}
+
+
+	// Sweeps the ranges specified, in the order specified. Occurrences are counted over all ranges, so the ranges have to be in image order.
+	// A pattern never matches across the end of a range.
+	void AOBScanEngine::scan(const std::vector<AOBScanRange>& ranges)
+	{
+		prepareScan(ranges);
+		std::vector<RangeScanResult> resultPerRange(1);
+		initializeRangeScanResult(resultPerRange[0]);
+		for (auto& range : ranges)
+		{
+			if (nullptr == range.start)
+			{
+				continue;
+			}
+			scanRange(range.start, range.start + range.size, range.start + range.size, resultPerRange[0]);
+		}
+		buildMatchIndex(ranges.empty() ? nullptr : ranges.front().start, resultPerRange);
+	}
+
+
+	// Same as scan(ranges), but splits the ranges in chunks which are scanned in parallel on the worker pool specified. 
+	void AOBScanEngine::scan(const std::vector<AOBScanRange>& ranges, WorkerPool& workerPool)
+	{
+		size_t totalSize = 0;
+		for (auto& range : ranges)
+		{
+			totalSize += range.size;
+		}
+		const size_t numberOfChunksWanted = static_cast<size_t>(workerPool.numberOfWorkers()) * AOB_SCAN_CHUNKS_PER_WORKER;
+		size_t chunkSize = totalSize / (numberOfChunksWanted > 0 ? numberOfChunksWanted : 1);
+		if (chunkSize < AOB_SCAN_MINIMUM_CHUNK_SIZE)
+		{
+			chunkSize = AOB_SCAN_MINIMUM_CHUNK_SIZE;
+		}
+		if (totalSize <= chunkSize)
+		{
+			scan(ranges);
+			return;
+		}
+		prepareScan(ranges);
+		// the chunks of a range overlap with the next chunk of the same range only, so patterns never match across the end of a range.
+		struct Chunk
+		{
+			const uint8_t* start;
+			const uint8_t* end;
+			const uint8_t* rangeEnd;
+		};
+		std::vector<Chunk> chunks;
+		for (auto& range : ranges)
+		{
+			if (nullptr == range.start)
+			{
+				continue;
+			}
+			const uint8_t* rangeEnd = range.start + range.size;
+			for (const uint8_t* chunkStart = range.start; chunkStart < rangeEnd; chunkStart += chunkSize)
+			{
+				const uint8_t* chunkEnd = (static_cast<size_t>(rangeEnd - chunkStart) > chunkSize) ? chunkStart + chunkSize : rangeEnd;
+				chunks.push_back({ chunkStart, chunkEnd, rangeEnd });
+			}
+		}
+		std::vector<RangeScanResult> resultPerChunk(chunks.size());
+		for (size_t chunkIndex = 0; chunkIndex < chunks.size(); chunkIndex++)
+		{
+			RangeScanResult& chunkResult = resultPerChunk[chunkIndex];
+			initializeRangeScanResult(chunkResult);
+			const Chunk chunk = chunks[chunkIndex];
+			workerPool.enqueue([this, chunk, &chunkResult] { scanRange(chunk.start, chunk.end, chunk.rangeEnd, chunkResult); });
+		}
+		workerPool.waitUntilIdle();
+
+		buildMatchIndex(ranges.front().start, resultPerChunk);
+	}
+
+
+	// Returns the location of the occurrence requested by the pattern with the id specified or nullptr if that occurrence wasn't found.
+	const uint8_t* AOBScanEngine::locationOfPattern(int patternId) const
+	{
+		if (patternId < 0 || patternId >= numberOfPatterns())
+		{
+			return nullptr;
+		}
+		return matchLocation(patternId, _patterns[patternId].pattern.occurrence() - 1);
+	}
+
+
+	// Returns the location of the match with the index specified (0 is the first match in the image) of the pattern with the id specified. Returns
+	// nullptr if there's no such match or its location wasn't recorded, see numberOfRecordedMatches.
+	const uint8_t* AOBScanEngine::matchLocation(int patternId, int matchIndex) const
+	{
+		if (matchIndex < 0 || matchIndex >= numberOfRecordedMatches(patternId))
+		{
+			return nullptr;
+		}
+		return _indexBase + _recordedMatchOffsets[_recordedMatchStart[patternId] + matchIndex];
+	}
+
+
+	// Returns the number of times the pattern with the id specified matched in the last scan.
+	int AOBScanEngine::numberOfMatches(int patternId) const
+	{
+		if (patternId < 0 || patternId >= static_cast<int>(_numberOfMatchesPerPattern.size()))
+		{
+			return 0;
+		}
+		return static_cast<int>(_numberOfMatchesPerPattern[patternId]);
+	}
+
+
+	// Returns the number of matches of the pattern with the id specified of which the location is recorded. This is the number of matches, capped at
+	// the larger of the occurrence of the pattern and AOB_MAX_RECORDED_MATCHES_PER_PATTERN.
+	int AOBScanEngine::numberOfRecordedMatches(int patternId) const
+	{
+		if (patternId < 0 || patternId + 1 >= static_cast<int>(_recordedMatchStart.size()))
+		{
+			return 0;
+		}
+		return static_cast<int>(_recordedMatchStart[patternId + 1] - _recordedMatchStart[patternId]);
+	}
+
+
+	// Picks the longest run of non-wildcard bytes in the pattern as its anchor. Patterns with only wildcards don't get an anchor and are never found.
+	void AOBScanEngine::determineAnchor(AnchoredPattern& toAnchor)
+	{
+		const ScanPattern& pattern = toAnchor.pattern;
+		const uint8_t* mask = pattern.patternMask();
+		int bestOffset = 0;
+		int bestLength = 0;
+		int runStart = 0;
+		for (int i = 0; i <= pattern.patternSize(); i++)
+		{
+			if (i < pattern.patternSize() && mask[i] == 0xFF)
+			{
+				continue;
+			}
+			if (i - runStart > bestLength)
+			{
+				bestOffset = runStart;
+				bestLength = i - runStart;
+			}
+			runStart = i + 1;
+		}
+		toAnchor.anchorOffset = bestOffset;
+		toAnchor.anchorLength = bestLength > AOB_ANCHOR_MAX_LENGTH ? AOB_ANCHOR_MAX_LENGTH : bestLength;
+	}
+
+
+	int AOBScanEngine::addTrieState()
+	{
+		_transitions.insert(_transitions.end(), 256, -1);
+		return static_cast<int>(_transitions.size() / 256) - 1;
+	}
+
+
+	// Builds the Aho-Corasick automaton over the anchors of all patterns. Missing transitions are filled in with the transitions of the
+	// failure state, so the scan loop only has to do a single table lookup per byte.
+	void AOBScanEngine::buildAutomaton()
+	{
+		_transitions.clear();
+		memset(_isAnchorStartByte, 0, sizeof(_isAnchorStartByte));
+		std::vector<std::vector<int32_t>> outputsPerState;
+		addTrieState();
+		outputsPerState.emplace_back();
+
+		// first the trie with all anchors
+		for (int patternId = 0; patternId < numberOfPatterns(); patternId++)
+		{
+			const AnchoredPattern& anchoredPattern = _patterns[patternId];
+			if (anchoredPattern.anchorLength <= 0)
+			{
+				continue;
+			}
+			const uint8_t* anchor = anchoredPattern.pattern.bytePattern() + anchoredPattern.anchorOffset;
+			_isAnchorStartByte[anchor[0]] = true;
+			int state = 0;
+			for (int i = 0; i < anchoredPattern.anchorLength; i++)
+			{
+				if (_transitions[(state << 8) + anchor[i]] < 0)
+				{
+					const int newState = addTrieState();
+					outputsPerState.emplace_back();
+					_transitions[(state << 8) + anchor[i]] = newState;
+				}
+				state = _transitions[(state << 8) + anchor[i]];
+			}
+			outputsPerState[state].push_back(patternId);
+		}
+
+		// then the failure links, breadth first, so the failure state of a state is always completed before the state itself.
+		const int numberOfStates = static_cast<int>(_transitions.size() / 256);
+		std::vector<int32_t> failureState(numberOfStates, 0);
+		std::deque<int32_t> statesToProcess;
+		for (int byteValue = 0; byteValue < 256; byteValue++)
+		{
+			const int32_t nextState = _transitions[byteValue];
+			if (nextState < 0)
+			{
+				_transitions[byteValue] = 0;
+				continue;
+			}
+			statesToProcess.push_back(nextState);
+		}
+		while (!statesToProcess.empty())
+		{
+			const int32_t state = statesToProcess.front();
+			statesToProcess.pop_front();
+			for (int byteValue = 0; byteValue < 256; byteValue++)
+			{
+				const int32_t nextState = _transitions[(state << 8) + byteValue];
+				const int32_t nextStateOfFailure = _transitions[(failureState[state] << 8) + byteValue];
+				if (nextState < 0)
+				{
+					_transitions[(state << 8) + byteValue] = nextStateOfFailure;
+					continue;
+				}
+				failureState[nextState] = nextStateOfFailure;
+				const std::vector<int32_t>& outputsOfFailure = outputsPerState[nextStateOfFailure];
+				outputsPerState[nextState].insert(outputsPerState[nextState].end(), outputsOfFailure.begin(), outputsOfFailure.end());
+				statesToProcess.push_back(nextState);
+			}
+		}
+
+		// flatten the outputs so the scan loop can test a state for outputs with two lookups.
+		_outputStart.assign(static_cast<size_t>(numberOfStates) + 1, 0);
+		_outputPatternIds.clear();
+		for (int state = 0; state < numberOfStates; state++)
+		{
+			_outputStart[state] = static_cast<int32_t>(_outputPatternIds.size());
+			_outputPatternIds.insert(_outputPatternIds.end(), outputsPerState[state].begin(), outputsPerState[state].end());
+		}
+		_outputStart[numberOfStates] = static_cast<int32_t>(_outputPatternIds.size());
+	}
+
+
+	// Compiles the engine if needed and determines the scan method. If the search kernels are used, the patterns are prepared for them with the
+	// byte frequencies of the largest range, which is normally the code section.
+	void AOBScanEngine::prepareScan(const std::vector<AOBScanRange>& ranges)
+	{
+		if (!_compiled)
+		{
+			compile();
+		}
+		_useSearchKernels = ScanMethod::SearchKernels == _scanMethod || (ScanMethod::Automatic == _scanMethod && numberOfPatterns() <= AOB_SEARCH_KERNEL_MAX_PATTERNS);
+		if (_useSearchKernels)
+		{
+			const AOBScanRange* largestRange = nullptr;
+			for (auto& range : ranges)
+			{
+				if (nullptr != range.start && (nullptr == largestRange || range.size > largestRange->size))
+				{
+					largestRange = &range;
+				}
+			}
+			ByteFrequencyTable frequencies;
+			if (nullptr != largestRange)
+			{
+				frequencies.buildFromImage(largestRange->start, largestRange->size);
+			}
+			for (auto& anchoredPattern : _patterns)
+			{
+				anchoredPattern.preparedPattern = AOBPatternSearch::preparePattern(anchoredPattern.pattern, frequencies);
+			}
+		}
+		_indexBase = nullptr;
+		_recordedMatchStart.assign(_patterns.size() + 1, 0);
+		_recordedMatchOffsets.clear();
+		_numberOfMatchesPerPattern.assign(_patterns.size(), 0);
+	}
+
+
+	void AOBScanEngine::initializeRangeScanResult(RangeScanResult& toInitialize) const
+	{
+		toInitialize.locationsPerPattern.assign(_patterns.size(), std::vector<const uint8_t*>());
+		toInitialize.numberOfMatchesPerPattern.assign(_patterns.size(), 0);
+	}
+
+
+	// Merges the results of the ranges scanned, in range order, into the match index. Offsets are relative to indexBase, which is the start of
+	// the first range, so the index only needs 4 bytes per match. 
+	void AOBScanEngine::buildMatchIndex(const uint8_t* indexBase, const std::vector<RangeScanResult>& resultPerRange)
+	{
+		_indexBase = indexBase;
+		_recordedMatchOffsets.clear();
+		for (int patternId = 0; patternId < numberOfPatterns(); patternId++)
+		{
+			_recordedMatchStart[patternId] = static_cast<uint32_t>(_recordedMatchOffsets.size());
+			const size_t maxNumberOfRecordedMatches = static_cast<size_t>(_patterns[patternId].maxNumberOfRecordedMatches);
+			uint32_t numberOfMatches = 0;
+			for (auto& rangeResult : resultPerRange)
+			{
+				numberOfMatches += rangeResult.numberOfMatchesPerPattern[patternId];
+				for (auto location : rangeResult.locationsPerPattern[patternId])
+				{
+					if (_recordedMatchOffsets.size() - _recordedMatchStart[patternId] >= maxNumberOfRecordedMatches)
+					{
+						break;
+					}
+					_recordedMatchOffsets.push_back(static_cast<uint32_t>(location - indexBase));
+				}
+			}
+			_numberOfMatchesPerPattern[patternId] = numberOfMatches;
+		}
+		_recordedMatchStart[numberOfPatterns()] = static_cast<uint32_t>(_recordedMatchOffsets.size());
+	}
+
+
+	// Sweeps the range [rangeStart, ownedRangeEnd) plus the overlap with the next range and records the matches of the patterns which
+	// start inside the range. The overlap is the longest pattern minus 1, so every pattern starting in the range can be seen completely.
+	void AOBScanEngine::scanRange(const uint8_t* rangeStart, const uint8_t* ownedRangeEnd, const uint8_t* imageEnd, RangeScanResult& result) const
+	{
+		if (_useSearchKernels)
+		{
+			scanRangeWithSearchKernels(rangeStart, ownedRangeEnd, imageEnd, result);
+			return;
+		}
+		const uint8_t* end = ownedRangeEnd;
+		if (_maxPatternSize > 1)
+		{
+			end = (static_cast<size_t>(imageEnd - ownedRangeEnd) > static_cast<size_t>(_maxPatternSize - 1)) ? ownedRangeEnd + (_maxPatternSize - 1) : imageEnd;
+		}
+		const int32_t* transitions = _transitions.data();
+		const int32_t* outputStart = _outputStart.data();
+		const uint8_t* current = rangeStart;
+		int32_t state = 0;
+		while (current < end)
+		{
+			if (0 == state)
+			{
+				// in the root state, skip all bytes which can't start an anchor.
+				while (current < end && !_isAnchorStartByte[*current])
+				{
+					current++;
+				}
+				if (current >= end)
+				{
+					break;
+				}
+			}
+			state = transitions[(state << 8) + *current];
+			if (outputStart[state] != outputStart[state + 1])
+			{
+				handleAnchorHit(state, current, rangeStart, ownedRangeEnd, imageEnd, result);
+			}
+			current++;
+		}
+	}
+
+
+	// Called when the automaton reached a state with outputs. anchorEnd points to the last byte of the anchor(s) found. Verifies the
+	// complete pattern of each anchor found and records it as a match if it matches and starts in the range. 
+	void AOBScanEngine::handleAnchorHit(int state, const uint8_t* anchorEnd, const uint8_t* rangeStart, const uint8_t* ownedRangeEnd, const uint8_t* imageEnd,
+										RangeScanResult& result) const
+	{
+		const size_t anchorEndOffset = static_cast<size_t>(anchorEnd - rangeStart);
+		const size_t ownedRangeSize = static_cast<size_t>(ownedRangeEnd - rangeStart);
+		const size_t rangeSizeToImageEnd = static_cast<size_t>(imageEnd - rangeStart);
+		for (int32_t i = _outputStart[state]; i < _outputStart[state + 1]; i++)
+		{
+			const int patternId = _outputPatternIds[i];
+			const AnchoredPattern& anchoredPattern = _patterns[patternId];
+			const size_t distanceToPatternStart = static_cast<size_t>(anchoredPattern.anchorOffset) + anchoredPattern.anchorLength - 1;
+			if (anchorEndOffset < distanceToPatternStart)
+			{
+				// starts before the range, so it's owned by the previous range
+				continue;
+			}
+			const size_t patternStartOffset = anchorEndOffset - distanceToPatternStart;
+			if (patternStartOffset >= ownedRangeSize)
+			{
+				// starts in the overlap, so it's owned by the next range
+				continue;
+			}
+			if (patternStartOffset + anchoredPattern.pattern.patternSize() > rangeSizeToImageEnd)
+			{
+				continue;
+			}
+			if (!anchoredPattern.pattern.matchesAt(rangeStart + patternStartOffset))
+			{
+				continue;
+			}
+			recordMatch(patternId, rangeStart + patternStartOffset, result);
+		}
+	}
+
+
+	// Same as scanRange, but searches each pattern on its own with the search kernels, block by block. In a block, a pattern is searched up to
+	// the end of its last possible location which starts in the block, so the ownership of matches is the same as with the automaton and the
+	// matches of a pattern are recorded in image order. Patterns without an anchor, i.e. with only wildcards, are skipped, as the automaton
+	// never finds them either.
+	void AOBScanEngine::scanRangeWithSearchKernels(const uint8_t* rangeStart, const uint8_t* ownedRangeEnd, const uint8_t* imageEnd, RangeScanResult& result) const
+	{
+		for (const uint8_t* blockStart = rangeStart; blockStart < ownedRangeEnd; blockStart += AOB_SEARCH_KERNEL_BLOCK_SIZE)
+		{
+			const uint8_t* ownedBlockEnd = (static_cast<size_t>(ownedRangeEnd - blockStart) > AOB_SEARCH_KERNEL_BLOCK_SIZE) ? blockStart + AOB_SEARCH_KERNEL_BLOCK_SIZE 
+																														 : ownedRangeEnd;
+			for (int patternId = 0; patternId < numberOfPatterns(); patternId++)
+			{
+				const AnchoredPattern& anchoredPattern = _patterns[patternId];
+				if (anchoredPattern.anchorLength <= 0)
+				{
+					continue;
+				}
+				const size_t overlap = static_cast<size_t>(anchoredPattern.pattern.patternSize()) - 1;
+				const uint8_t* end = (static_cast<size_t>(imageEnd - ownedBlockEnd) > overlap) ? ownedBlockEnd + overlap : imageEnd;
+				const uint8_t* location = AOBPatternSearch::findPattern(blockStart, end, anchoredPattern.preparedPattern);
+				while (nullptr != location && location < ownedBlockEnd)
+				{
+					recordMatch(patternId, location, result);
+					location = AOBPatternSearch::findPattern(location + 1, end, anchoredPattern.preparedPattern);
+				}
+			}
+		}
+	}
+
+
+	void AOBScanEngine::recordMatch(int patternId, const uint8_t* location, RangeScanResult& result) const
+	{
+		result.numberOfMatchesPerPattern[patternId]++;
+		std::vector<const uint8_t*>& locations = result.locationsPerPattern[patternId];
+		if (static_cast<int>(locations.size()) < _patterns[patternId].maxNumberOfRecordedMatches)
+		{
+			locations.push_back(location);
+		}
+	}
+}
@@ -0,0 +1,137 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "ScanPattern.h"
+#include "AOBPatternSearch.h"
+#include "WorkerPool.h"
+
+namespace IGCS
+{
+	// Up to this number of patterns, a sweep per pattern with the search kernels of AOBPatternSearch is faster than a single sweep with the
+	// automaton: the automaton looks at every byte, the kernels at 16 or 32 bytes at a time. On a 256MB image the kernels are about 5x 
+	// faster with 11 patterns and still 2.5x with 64. They break even at about 180 patterns, which leaves room for images with more 
+	// common anchor bytes.
+	#define AOB_SEARCH_KERNEL_MAX_PATTERNS		64
+
+	// A range of an image to scan, e.g. a section.
+	struct AOBScanRange
+	{
+		const uint8_t* start;
+		size_t size;
+	};
+
+	// Scans an image for a set of AOB patterns in a single sweep. Every registered pattern is anchored on its longest run of
+	// non-wildcard bytes and all anchors are compiled into one Aho-Corasick automaton. While sweeping the image, the automaton
+	// reports anchor hits, after which the full pattern, wildcards included, is verified at the implied start location. 
+	// Every match of every pattern is recorded in a single pass into a compact index, in image order, so the n-th occurrence of a
+	// pattern is a lookup and is the same location a sequential scan for that pattern would return. The index also knows how
+	// many times each pattern matched, so a pattern which matches more often than expected (e.g. after a game update) can be reported.
+	// With only a few patterns, like the blocks of a camera, the automaton is slower than searching each pattern on its own with the SIMD
+	// rare-byte kernels of AOBPatternSearch, so by default the engine then sweeps each range once per pattern with those kernels, see ScanMethod.
+	// The results, the index and the chunking are the same for both methods.
+	// The image can also be scanned in chunks on a WorkerPool. Chunks overlap by the longest pattern, and a match is owned by the chunk
+	// its pattern starts in, so every match is found exactly once. The matches of the chunks are merged in chunk order, which keeps
+	// the occurrence order the same as with the single threaded sweep.
+	class AOBScanEngine
+	{
+	public:
+		enum class ScanMethod : uint8_t
+		{
+			Automatic = 0,		// the search kernels for up to AOB_SEARCH_KERNEL_MAX_PATTERNS patterns, the automaton for more.
+			Automaton = 1,
+			SearchKernels = 2,
+		};
+
+		AOBScanEngine();
+		~AOBScanEngine();
+
+		int addPattern(const ScanPattern& pattern);
+		void compile();
+		void scan(const uint8_t* imageAddress, size_t imageSize);
+		void scan(const uint8_t* imageAddress, size_t imageSize, WorkerPool& workerPool);
+		void scan(const std::vector<AOBScanRange>& ranges);
+		void scan(const std::vector<AOBScanRange>& ranges, WorkerPool& workerPool);
+		const uint8_t* locationOfPattern(int patternId) const;
+		const uint8_t* matchLocation(int patternId, int matchIndex) const;
+		int numberOfMatches(int patternId) const;
+		int numberOfRecordedMatches(int patternId) const;
+		int numberOfPatterns() const { return static_cast<int>(_patterns.size()); }
+		void setScanMethod(ScanMethod method) { _scanMethod = method; }
+		bool usesSearchKernels() const { return _useSearchKernels; }
+
+	private:
+		struct AnchoredPattern
+		{
+			AnchoredPattern(const ScanPattern& toAnchor) : pattern{ toAnchor } {}
+
+			ScanPattern pattern;
+			int anchorOffset = 0;		// offset of the first anchor byte in the pattern
+			int anchorLength = 0;
+			int maxNumberOfRecordedMatches = 0;
+			AOBPatternSearch::PreparedPattern preparedPattern;		// only prepared if the search kernels are used.
+		};
+
+		// The matches found in a range of the image. Each chunk has its own, so chunks can be scanned in parallel.
+		struct RangeScanResult
+		{
+			std::vector<std::vector<const uint8_t*>> locationsPerPattern;		// the first maxNumberOfRecordedMatches matches, in image order
+			std::vector<uint32_t> numberOfMatchesPerPattern;
+		};
+
+		void determineAnchor(AnchoredPattern& toAnchor);
+		void buildAutomaton();
+		int addTrieState();
+		void prepareScan(const std::vector<AOBScanRange>& ranges);
+		void initializeRangeScanResult(RangeScanResult& toInitialize) const;
+		void buildMatchIndex(const uint8_t* indexBase, const std::vector<RangeScanResult>& resultPerRange);
+		void scanRange(const uint8_t* rangeStart, const uint8_t* ownedRangeEnd, const uint8_t* imageEnd, RangeScanResult& result) const;
+		void scanRangeWithSearchKernels(const uint8_t* rangeStart, const uint8_t* ownedRangeEnd, const uint8_t* imageEnd, RangeScanResult& result) const;
+		void recordMatch(int patternId, const uint8_t* location, RangeScanResult& result) const;
+		void handleAnchorHit(int state, const uint8_t* anchorEnd, const uint8_t* rangeStart, const uint8_t* ownedRangeEnd, const uint8_t* imageEnd,
+							 RangeScanResult& result) const;
+
+		std::vector<AnchoredPattern> _patterns;
+		std::vector<int32_t> _transitions;			// per state 256 entries, each the state to go to for that byte.
+		std::vector<int32_t> _outputStart;			// per state the start index in _outputPatternIds. state n's outputs end at _outputStart[n+1]
+		std::vector<int32_t> _outputPatternIds;
+		bool _isAnchorStartByte[256];
+		// the match index. Per pattern the recorded matches as offsets from _indexBase, pattern n's start at _recordedMatchStart[n] and 
+		// end at _recordedMatchStart[n+1].
+		const uint8_t* _indexBase;
+		std::vector<uint32_t> _recordedMatchStart;
+		std::vector<uint32_t> _recordedMatchOffsets;
+		std::vector<uint32_t> _numberOfMatchesPerPattern;
+		int _maxPatternSize;
+		bool _compiled;
+		ScanMethod _scanMethod;
+		bool _useSearchKernels;			// determined per scan from _scanMethod.
+	};
+}
@@ -45,11 +45,12 @@ namespace IGCS::GameSpecific::CameraManipulator
 
 	bool isPhotomodeActivated()
 	{
-		if(nullptr==g_pmStructAddress)
+		const LPBYTE pmStructAddress = loadAcquire(g_controlBlock.pmStructAddress);
+		if(nullptr==pmStructAddress)
 		{
 			return false;
 		}
-		return *(g_pmStructAddress + PM_ACTIVATED_BIT_IN_STRUCT_OFFSET) == (uint8_t)1;
+		return *(pmStructAddress + PM_ACTIVATED_BIT_IN_STRUCT_OFFSET) == (uint8_t)1;
 	}
 
 
@@ -79,14 +80,14 @@ namespace IGCS::GameSpecific::CameraManipulator
 	{
 		MessageHandler::logDebug("Debug info");
 		MessageHandler::logDebug("---------------------------------");
-		MessageHandler::logDebug("PM struct address: %p", (void*)g_pmStructAddress);
-		MessageHandler::logDebug("Active cam struct address: %p", (void*)g_activeCamStructAddress);
-		MessageHandler::logDebug("Resolution struct address: %p", (void*)g_resolutionStructAddress);
-		MessageHandler::logDebug("Time of Day struct address: %p", (void*)g_todStructAddress);
-		MessageHandler::logDebug("Play Hud Widget Bucket address: %p", (void*)g_playHudWidgetAddress);
-		MessageHandler::logDebug("Photomode Hud Widget Bucket address: %p", (void*)g_pmHudWidgetAddress);
+		MessageHandler::logDebug("PM struct address: %p", (void*)loadAcquire(g_controlBlock.pmStructAddress));
+		MessageHandler::logDebug("Active cam struct address: %p", (void*)loadAcquire(g_controlBlock.activeCamStructAddress));
+		MessageHandler::logDebug("Resolution struct address: %p", (void*)loadAcquire(g_controlBlock.resolutionStructAddress));
+		MessageHandler::logDebug("Time of Day struct address: %p", (void*)loadAcquire(g_controlBlock.todStructAddress));
+		MessageHandler::logDebug("Play Hud Widget Bucket address: %p", (void*)loadAcquire(g_controlBlock.playHudWidgetAddress));
+		MessageHandler::logDebug("Photomode Hud Widget Bucket address: %p", (void*)loadAcquire(g_controlBlock.pmHudWidgetAddress));
 		MessageHandler::logDebug("Current fov offset: %x", getFovOffsetInActiveCameraStruct());
-		MessageHandler::logDebug("Camera enabled: %d", g_cameraEnabled);
+		MessageHandler::logDebug("Camera enabled: %d", loadAcquire(g_controlBlock.cameraEnabled));
 		MessageHandler::logDebug("---------------------------------");
 	}
 
@@ -99,18 +100,19 @@ namespace IGCS::GameSpecific::CameraManipulator
 	
 	void resizeViewPort(int newWidth, int newHeight)
 	{
-		if(nullptr==g_resolutionStructAddress)
+		const LPBYTE resolutionStructAddress = loadAcquire(g_controlBlock.resolutionStructAddress);
+		if(nullptr==resolutionStructAddress)
 		{
 			return;
 		}
-		*reinterpret_cast<int*>(g_resolutionStructAddress + WIDTH_IN_STRUCT_OFFSET) = newWidth;
-		*reinterpret_cast<int*>(g_resolutionStructAddress + HEIGHT_IN_STRUCT_OFFSET) = newHeight;
+		*reinterpret_cast<int*>(resolutionStructAddress + WIDTH_IN_STRUCT_OFFSET) = newWidth;
+		*reinterpret_cast<int*>(resolutionStructAddress + HEIGHT_IN_STRUCT_OFFSET) = newHeight;
 	}
 
 
 	void updateCameraDataInGameData(Camera& camera)
 	{
-		if (!g_cameraEnabled)
+		if (!loadAcquire(g_controlBlock.cameraEnabled))
 		{
 			return;
 		}
@@ -130,12 +132,13 @@ namespace IGCS::GameSpecific::CameraManipulator
 
 	void changeTimeOfDayUsingAmount(float amount)
 	{
-		if(nullptr==g_todStructAddress)
+		const LPBYTE todStructAddress = loadAcquire(g_controlBlock.todStructAddress);
+		if(nullptr==todStructAddress)
 		{
 			return;
 		}
 		// calculate current time of day, then apply the amount to that, then add the # of days again, so we stay within the same day.
-		int* todAddress = reinterpret_cast<int*>(g_todStructAddress + TOD_IN_STRUCT_OFFSET);
+		int* todAddress = reinterpret_cast<int*>(todStructAddress + TOD_IN_STRUCT_OFFSET);
 		const int currentToDInSeconds = *todAddress;
 		// strip off time in the current day. this will lose the time in the current day, which is fine, as we'll set those with the specified tod
 		const int todWithoutDays = currentToDInSeconds % 86400;
@@ -147,25 +150,28 @@ namespace IGCS::GameSpecific::CameraManipulator
 	
 	void toggleHud(bool showHud)
 	{
+		const LPBYTE playHudWidgetAddress = loadAcquire(g_controlBlock.playHudWidgetAddress);
+		const LPBYTE pmHudWidgetAddress = loadAcquire(g_controlBlock.pmHudWidgetAddress);
 		uint8_t newValue = showHud ? (uint8_t)1 : (uint8_t)0;
-		if(nullptr!=g_playHudWidgetAddress)
+		if(nullptr!=playHudWidgetAddress)
 		{
-			*(g_playHudWidgetAddress + HUD_TOGGLE_SWITCH_IN_BUCKETS_OFFSET) = newValue;
+			*(playHudWidgetAddress + HUD_TOGGLE_SWITCH_IN_BUCKETS_OFFSET) = newValue;
 		}
-		if(nullptr!=g_pmHudWidgetAddress && isPhotomodeActivated())
+		if(nullptr!=pmHudWidgetAddress && isPhotomodeActivated())
 		{
-			*(g_pmHudWidgetAddress + HUD_TOGGLE_SWITCH_IN_BUCKETS_OFFSET) = newValue;
+			*(pmHudWidgetAddress + HUD_TOGGLE_SWITCH_IN_BUCKETS_OFFSET) = newValue;
 		}
 	}
 
 	
 	bool gameIsPaused()
 	{
-		if(nullptr==g_timestopStructAddress)
+		const LPBYTE timestopStructAddress = loadAcquire(g_controlBlock.timestopStructAddress);
+		if(nullptr==timestopStructAddress)
 		{
 			return false;
 		}
-		return (*(g_timestopStructAddress + TIMESTOP_BYTE_IN_STRUCT_OFFSET) == (uint8_t)1);
+		return (*(timestopStructAddress + TIMESTOP_BYTE_IN_STRUCT_OFFSET) == (uint8_t)1);
 	}
 
 	
@@ -183,27 +189,30 @@ namespace IGCS::GameSpecific::CameraManipulator
 	
 	void setTimeStopValue(bool pauseGame)
 	{
-		if (nullptr == g_timestopStructAddress)
+		const LPBYTE timestopStructAddress = loadAcquire(g_controlBlock.timestopStructAddress);
+		if (nullptr == timestopStructAddress)
 		{
 			return;
 		}
-		*(g_timestopStructAddress + TIMESTOP_BYTE_IN_STRUCT_OFFSET) = pauseGame ? (uint8_t)1 : (uint8_t)0;
+		*(timestopStructAddress + TIMESTOP_BYTE_IN_STRUCT_OFFSET) = pauseGame ? (uint8_t)1 : (uint8_t)0;
 	}
 
 
 	void applySettingsToGameState()
 	{
+		const LPBYTE todStructAddress = loadAcquire(g_controlBlock.todStructAddress);
+		const LPBYTE weatherStructAddress = loadAcquire(g_controlBlock.weatherStructAddress);
 		Settings& currentSettings = Globals::instance().settings();
-		if (currentSettings.timeOfDayChanged && nullptr != g_todStructAddress)
+		if (currentSettings.timeOfDayChanged && nullptr != todStructAddress)
 		{
-			int* todAddress = reinterpret_cast<int*>(g_todStructAddress + TOD_IN_STRUCT_OFFSET);
+			int* todAddress = reinterpret_cast<int*>(todStructAddress + TOD_IN_STRUCT_OFFSET);
 			const int currentToDInSeconds = *todAddress;
 			// strip off time in the current day. this will lose the time in the current day, which is fine, as we'll set those with the specified tod
 			const int todWithoutDays = currentToDInSeconds % 86400;	
 			const int todInDays = currentToDInSeconds - todWithoutDays;
 			*todAddress = (todInDays + (int)(currentSettings.timeOfDay * 3600.0f));
 		}
-		if(currentSettings.wetnessSettingsChanged && nullptr != g_weatherStructAddress)
+		if(currentSettings.wetnessSettingsChanged && nullptr != weatherStructAddress)
 		{
 			static float moistureValueSave = 0.0f;
 			static bool cacheMoistureValue = true;
@@ -212,18 +221,18 @@ namespace IGCS::GameSpecific::CameraManipulator
 			{
 				if (cacheMoistureValue)
 				{
-					moistureValueSave = *reinterpret_cast<float*>(g_weatherStructAddress + MOISTURE_IN_STRUCT_OFFSET);
+					moistureValueSave = *reinterpret_cast<float*>(weatherStructAddress + MOISTURE_IN_STRUCT_OFFSET);
 					cacheMoistureValue = false;
 				}
-				g_wetness_StreetWetnessFactor = currentSettings.wetness_StreetWetnessFactor;
-				*reinterpret_cast<float*>(g_weatherStructAddress + PUDDLE_SIZE_IN_STRUCT_OFFSET) = currentSettings.wetness_PuddleSize;
-				g_wetness_OverrideParameters = (uint8_t)1;
+				storeRelease(g_controlBlock.wetnessStreetWetnessFactor, currentSettings.wetness_StreetWetnessFactor);
+				*reinterpret_cast<float*>(weatherStructAddress + PUDDLE_SIZE_IN_STRUCT_OFFSET) = currentSettings.wetness_PuddleSize;
+				storeRelease(g_controlBlock.wetnessOverrideParameters, (uint8_t)1);
 			}
 			else
 			{
 				// reset the moisture value to the value it had
-				*reinterpret_cast<float*>(g_weatherStructAddress + MOISTURE_IN_STRUCT_OFFSET) = moistureValueSave;
-				g_wetness_OverrideParameters = (uint8_t)0;
+				*reinterpret_cast<float*>(weatherStructAddress + MOISTURE_IN_STRUCT_OFFSET) = moistureValueSave;
+				storeRelease(g_controlBlock.wetnessOverrideParameters, (uint8_t)0);
 				cacheMoistureValue = true;
 			}
 		}
@@ -234,11 +243,12 @@ namespace IGCS::GameSpecific::CameraManipulator
 	// Resets the FOV to the one it got when we enabled the camera
 	void resetFoV()
 	{
-		if (g_activeCamStructAddress == nullptr)
+		const LPBYTE activeCamStructAddress = loadAcquire(g_controlBlock.activeCamStructAddress);
+		if (activeCamStructAddress == nullptr)
 		{
 			return;
 		}
-		float* fovAddress = reinterpret_cast<float*>(g_activeCamStructAddress + getFovOffsetInActiveCameraStruct());
+		float* fovAddress = reinterpret_cast<float*>(activeCamStructAddress + getFovOffsetInActiveCameraStruct());
 		*fovAddress = _originalCameraData._fov;
 	}
 
@@ -246,11 +256,12 @@ namespace IGCS::GameSpecific::CameraManipulator
 	// changes the FoV with the specified amount
 	void changeFoV(float amount)
 	{
-		if (g_activeCamStructAddress == nullptr)
+		const LPBYTE activeCamStructAddress = loadAcquire(g_controlBlock.activeCamStructAddress);
+		if (activeCamStructAddress == nullptr)
 		{
 			return;
 		}
-		float* fovAddress = reinterpret_cast<float*>(g_activeCamStructAddress + getFovOffsetInActiveCameraStruct());
+		float* fovAddress = reinterpret_cast<float*>(activeCamStructAddress + getFovOffsetInActiveCameraStruct());
 		float newValue = *fovAddress + amount;
 		if (newValue < 0.001f)
 		{
@@ -262,18 +273,20 @@ namespace IGCS::GameSpecific::CameraManipulator
 
 	float getCurrentFoV()
 	{
-		if (nullptr == g_activeCamStructAddress)
+		const LPBYTE activeCamStructAddress = loadAcquire(g_controlBlock.activeCamStructAddress);
+		if (nullptr == activeCamStructAddress)
 		{
 			return DEFAULT_FOV_DEGREES;
 		}
-		float* fovAddress = reinterpret_cast<float*>(g_activeCamStructAddress + getFovOffsetInActiveCameraStruct());
+		float* fovAddress = reinterpret_cast<float*>(activeCamStructAddress + getFovOffsetInActiveCameraStruct());
 		return *fovAddress;
 	}
 	
 
 	XMFLOAT3 getCurrentCameraCoords()
 	{
-		int* coordsInMemory = reinterpret_cast<int*>(g_activeCamStructAddress + COORDS_IN_CAMSTRUCT_OFFSET);
+		const LPBYTE activeCamStructAddress = loadAcquire(g_controlBlock.activeCamStructAddress);
+		int* coordsInMemory = reinterpret_cast<int*>(activeCamStructAddress + COORDS_IN_CAMSTRUCT_OFFSET);
 		return XMFLOAT3(convertPackedInt32ToFloat(coordsInMemory[0]), convertPackedInt32ToFloat(coordsInMemory[1]), convertPackedInt32ToFloat(coordsInMemory[2]));
 	}
 
@@ -281,7 +294,8 @@ namespace IGCS::GameSpecific::CameraManipulator
 	// newCoords are the new coordinates for the camera in worldspace. 
 	void writeNewCameraValuesToGameData(XMFLOAT3 newCoords, XMVECTOR newLookQuaternion)
 	{
-		if (!isCameraFound())
+		const LPBYTE activeCamStructAddress = loadAcquire(g_controlBlock.activeCamStructAddress);
+		if (nullptr == activeCamStructAddress)
 		{
 			return;
 		}
@@ -289,12 +303,12 @@ namespace IGCS::GameSpecific::CameraManipulator
 		XMFLOAT4 qAsFloat4;
 		XMStoreFloat4(&qAsFloat4, newLookQuaternion);
 
-		int* coordsInMemory = reinterpret_cast<int*>(g_activeCamStructAddress + COORDS_IN_CAMSTRUCT_OFFSET);
+		int* coordsInMemory = reinterpret_cast<int*>(activeCamStructAddress + COORDS_IN_CAMSTRUCT_OFFSET);
 		coordsInMemory[0] = convertFloatToPackedInt32(newCoords.x);
 		coordsInMemory[1] = convertFloatToPackedInt32(newCoords.y);
 		coordsInMemory[2] = convertFloatToPackedInt32(newCoords.z);
 
-		float* quaternionInMemory = reinterpret_cast<float*>(g_activeCamStructAddress + QUATERNION_IN_CAMSTRUCT_OFFSET);
+		float* quaternionInMemory = reinterpret_cast<float*>(activeCamStructAddress + QUATERNION_IN_CAMSTRUCT_OFFSET);
 		quaternionInMemory[0] = qAsFloat4.x;
 		quaternionInMemory[1] = qAsFloat4.y;
 		quaternionInMemory[2] = qAsFloat4.z;
@@ -304,35 +318,37 @@ namespace IGCS::GameSpecific::CameraManipulator
 
 	bool isCameraFound()
 	{
-		return nullptr != g_activeCamStructAddress;
+		return nullptr != loadAcquire(g_controlBlock.activeCamStructAddress);
 	}
 
 
 	void displayCameraStructAddress()
 	{
-		MessageHandler::logDebug("Camera struct address: %p", (void*)g_activeCamStructAddress);
+		MessageHandler::logDebug("Camera struct address: %p", (void*)loadAcquire(g_controlBlock.activeCamStructAddress));
 	}
 
 
 	void restoreGameCameraDataWithCachedData(GameCameraData& source)
 	{
-		if (!isCameraFound())
+		const LPBYTE activeCamStructAddress = loadAcquire(g_controlBlock.activeCamStructAddress);
+		if (nullptr == activeCamStructAddress)
 		{
 			return;
 		}
-		source.RestoreData(reinterpret_cast<float*>(g_activeCamStructAddress + QUATERNION_IN_CAMSTRUCT_OFFSET), reinterpret_cast<int*>(g_activeCamStructAddress + COORDS_IN_CAMSTRUCT_OFFSET),
-						   reinterpret_cast<float*>(g_activeCamStructAddress + getFovOffsetInActiveCameraStruct()));
+		source.RestoreData(reinterpret_cast<float*>(activeCamStructAddress + QUATERNION_IN_CAMSTRUCT_OFFSET), reinterpret_cast<int*>(activeCamStructAddress + COORDS_IN_CAMSTRUCT_OFFSET),
+						   reinterpret_cast<float*>(activeCamStructAddress + getFovOffsetInActiveCameraStruct()));
 	}
 
 
 	void cacheGameCameraDataInCache(GameCameraData& destination)
 	{
-		if (!isCameraFound())
+		const LPBYTE activeCamStructAddress = loadAcquire(g_controlBlock.activeCamStructAddress);
+		if (nullptr == activeCamStructAddress)
 		{
 			return;
 		}
-		destination.CacheData(reinterpret_cast<float*>(g_activeCamStructAddress + QUATERNION_IN_CAMSTRUCT_OFFSET), reinterpret_cast<int*>(g_activeCamStructAddress + COORDS_IN_CAMSTRUCT_OFFSET),
-							  reinterpret_cast<float*>(g_activeCamStructAddress + getFovOffsetInActiveCameraStruct()));
+		destination.CacheData(reinterpret_cast<float*>(activeCamStructAddress + QUATERNION_IN_CAMSTRUCT_OFFSET), reinterpret_cast<int*>(activeCamStructAddress + COORDS_IN_CAMSTRUCT_OFFSET),
+							  reinterpret_cast<float*>(activeCamStructAddress + getFovOffsetInActiveCameraStruct()));
 	}
 
 
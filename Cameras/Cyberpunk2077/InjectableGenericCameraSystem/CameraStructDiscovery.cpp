@@ -0,0 +1,320 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+#include "CameraStructDiscovery.h"
+#include "MessageHandler.h"
+#include "Utils.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <string>
+
+using namespace std;
+
+namespace IGCS
+{
+	#define CAMERA_DISCOVERY_CHUNK_SIZE					(1024 * 1024)
+	#define CAMERA_DISCOVERY_MAX_CANDIDATES_PER_CHUNK	256
+	// camera data has lookalikes all over the heap, e.g. the transforms of bones, so a lot of candidates are re-validated to be sure the
+	// live camera is among them.
+	#define CAMERA_DISCOVERY_MAX_CANDIDATES				4096
+	#define CAMERA_DISCOVERY_NUMBER_OF_SAMPLES			40
+	#define CAMERA_DISCOVERY_SAMPLE_INTERVAL_IN_MS		50
+	// a candidate which is invalid in more samples than this is dropped. A sample taken while the game writes the struct can be invalid.
+	#define CAMERA_DISCOVERY_MAX_INVALID_SAMPLES		3
+	#define CAMERA_DISCOVERY_MAX_REPORTED_CANDIDATES	10
+	// the bytes compared between samples start this many bytes before the candidate, so they cover the layout and the position next to it.
+	#define CAMERA_DISCOVERY_COMPARED_BYTES_BEFORE		16
+	#define CAMERA_DISCOVERY_COMPARED_BYTES				80
+
+	// A chunk of a memory region to scan, in parallel with the other chunks.
+	struct DiscoveryChunk
+	{
+		const uint8_t* start;
+		size_t size;
+		const uint8_t* regionStart;
+		const uint8_t* regionEnd;
+	};
+
+
+	// Copies the memory of [start, start + size) into buffer. Memory can be freed by the game while it's read, so it's not read directly but
+	// with ReadProcessMemory, which fails instead of crashing the game.
+	static bool copyMemory(const uint8_t* start, size_t size, uint8_t* buffer)
+	{
+		SIZE_T numberOfBytesRead = 0;
+		return ReadProcessMemory(GetCurrentProcess(), start, buffer, size, &numberOfBytesRead) && numberOfBytesRead == size;
+	}
+
+
+	CameraStructDiscovery::CameraStructDiscovery() : _isRunning(false), _isStopping(false)
+	{
+	}
+
+
+	CameraStructDiscovery::~CameraStructDiscovery()
+	{
+		if (_discoveryThread.joinable())
+		{
+			_discoveryThread.join();
+		}
+	}
+
+
+	CameraStructDiscovery& CameraStructDiscovery::instance()
+	{
+		static CameraStructDiscovery theInstance;
+		return theInstance;
+	}
+
+
+	void CameraStructDiscovery::startDiscovery()
+	{
+		if (_isStopping)
+		{
+			return;
+		}
+		if (_isRunning.exchange(true))
+		{
+			MessageHandler::logLine("Camera struct discovery is already running.");
+			return;
+		}
+		if (_discoveryThread.joinable())
+		{
+			// previous discovery is done, as _isRunning was false.
+			_discoveryThread.join();
+		}
+		_discoveryThread = thread([this] { discover(); _isRunning = false; });
+	}
+
+
+	// Cancels a running discovery and waits for its thread. Called when the dll is unloaded, after the named pipe listener has been stopped,
+	// so no new discovery is started. The scan skips the chunks it hasn't scanned yet and the re-validation stops before the next sample.
+	void CameraStructDiscovery::stop()
+	{
+		_isStopping = true;
+		if (_discoveryThread.joinable())
+		{
+			_discoveryThread.join();
+		}
+	}
+
+
+	void CameraStructDiscovery::discover()
+	{
+		MessageHandler::logLine("Camera struct discovery started, scanning the memory of the game...");
+		const auto scanStartTime = chrono::steady_clock::now();
+		size_t numberOfBytesScanned = 0;
+		vector<CameraStructCandidate> candidates = scanMemory(numberOfBytesScanned);
+		if (_isStopping)
+		{
+			MessageHandler::logLine("Camera struct discovery stopped.");
+			return;
+		}
+		const double scanTimeInMs = chrono::duration<double, milli>(chrono::steady_clock::now() - scanStartTime).count();
+		MessageHandler::logLine("Scanned %.1f MB of memory in %.0fms (%.2f GB/s), %zu candidates found.", numberOfBytesScanned / (1024.0 * 1024.0), scanTimeInMs,
+								scanTimeInMs > 0.0 ? numberOfBytesScanned / (scanTimeInMs * 1000000.0) : 0.0, candidates.size());
+		if (candidates.empty())
+		{
+			return;
+		}
+		MessageHandler::addNotification("Camera discovery: move the camera around for a few seconds");
+		vector<int> numberOfChanges;
+		revalidateCandidates(candidates, numberOfChanges);
+		if (_isStopping)
+		{
+			MessageHandler::logLine("Camera struct discovery stopped.");
+			return;
+		}
+		MessageHandler::logLine("%zu candidates are still valid after %d samples. Best candidates (the live camera changes while it's moved):", candidates.size(),
+								CAMERA_DISCOVERY_NUMBER_OF_SAMPLES);
+		for (size_t i = 0; i < candidates.size() && i < CAMERA_DISCOVERY_MAX_REPORTED_CANDIDATES; i++)
+		{
+			const CameraStructCandidate& candidate = candidates[i];
+			const string positionText = candidate.hasPosition ? to_string(candidate.positionOffset) : "none";
+			const string fovText = candidate.hasFov ? to_string(candidate.fovOffset) : "none";
+			MessageHandler::logLine("    0x%llX: %s, score %.0f, changed in %d samples, position at %s, fov at %s", static_cast<unsigned long long>(candidate.address),
+									CameraStructScanner::layoutName(candidate.kind), candidate.score, numberOfChanges[i], positionText.c_str(), fovText.c_str());
+		}
+		MessageHandler::addNotification("Camera discovery done, see the log for the candidates");
+	}
+
+
+	// Scans the memory of the process which can contain game data (see Utils::determineGameDataRanges) in parallel and returns the best candidates, sorted on score.
+	vector<CameraStructCandidate> CameraStructDiscovery::scanMemory(size_t& numberOfBytesScanned)
+	{
+		numberOfBytesScanned = 0;
+		WorkerPool workerPool(WorkerPool::defaultNumberOfWorkers());
+		// the buffers the chunks are copied into are allocated before the memory is enumerated, so they can be left out of the scan: they'd 
+		// contain copies of the camera data otherwise.
+		const size_t bufferSize = CAMERA_DISCOVERY_CHUNK_SIZE + 2 * CAMERA_SCAN_MARGIN;
+		const size_t buffersSize = bufferSize * workerPool.numberOfWorkers();
+		uint8_t* buffers = static_cast<uint8_t*>(VirtualAlloc(nullptr, buffersSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+		if (nullptr == buffers)
+		{
+			MessageHandler::logError("Couldn't allocate the buffers for the camera struct discovery.");
+			return {};
+		}
+		vector<uint8_t*> freeBuffers;
+		for (int i = 0; i < workerPool.numberOfWorkers(); i++)
+		{
+			freeBuffers.push_back(buffers + i * bufferSize);
+		}
+		vector<DiscoveryChunk> chunks;
+		for (auto& range : Utils::determineGameDataRanges())
+		{
+			const uint8_t* rangeEnd = range.start + range.size;
+			if (range.start < buffers + buffersSize && buffers < rangeEnd)
+			{
+				continue;
+			}
+			for (const uint8_t* chunkStart = range.start; chunkStart < rangeEnd; chunkStart += CAMERA_DISCOVERY_CHUNK_SIZE)
+			{
+				chunks.push_back({ chunkStart, min(static_cast<size_t>(rangeEnd - chunkStart), static_cast<size_t>(CAMERA_DISCOVERY_CHUNK_SIZE)), range.start, rangeEnd });
+			}
+		}
+
+		mutex resultsMutex;
+		vector<CameraStructCandidate> toReturn;
+		for (auto& chunk : chunks)
+		{
+			workerPool.enqueue([&, chunk]
+				{
+					if (_isStopping)
+					{
+						return;
+					}
+					uint8_t* buffer = nullptr;
+					{
+						// there are as many buffers as workers, so there's always one free.
+						lock_guard<mutex> lock(resultsMutex);
+						buffer = freeBuffers.back();
+						freeBuffers.pop_back();
+					}
+					// the margin around the chunk is copied as well, so layouts on the border of the chunk are scored the same as the others.
+					const uint8_t* copyStart = chunk.start - min(static_cast<size_t>(chunk.start - chunk.regionStart), static_cast<size_t>(CAMERA_SCAN_MARGIN));
+					const uint8_t* copyEnd = chunk.start + chunk.size + min(static_cast<size_t>(chunk.regionEnd - (chunk.start + chunk.size)), static_cast<size_t>(CAMERA_SCAN_MARGIN));
+					vector<CameraStructCandidate> chunkCandidates;
+					const bool isCopied = copyMemory(copyStart, copyEnd - copyStart, buffer);
+					if (isCopied)
+					{
+						const size_t ownedStart = chunk.start - copyStart;
+						CameraStructScanner::scanBuffer(buffer, copyEnd - copyStart, ownedStart, ownedStart + chunk.size, reinterpret_cast<uintptr_t>(copyStart), chunkCandidates);
+						CameraStructScanner::keepBestCandidates(chunkCandidates, CAMERA_DISCOVERY_MAX_CANDIDATES_PER_CHUNK);
+					}
+					lock_guard<mutex> lock(resultsMutex);
+					freeBuffers.push_back(buffer);
+					toReturn.insert(toReturn.end(), chunkCandidates.begin(), chunkCandidates.end());
+					numberOfBytesScanned += isCopied ? chunk.size : 0;
+				});
+		}
+		workerPool.waitUntilIdle();
+		VirtualFree(buffers, 0, MEM_RELEASE);
+		CameraStructScanner::keepBestCandidates(toReturn, CAMERA_DISCOVERY_MAX_CANDIDATES);
+		return toReturn;
+	}
+
+
+	// Samples the memory of the candidates a number of times and counts in how many samples the layout and position changed. Candidates which
+	// aren't valid anymore are removed. The remaining candidates are sorted on the number of changes, then on score, and numberOfChanges is
+	// filled with the number of changes per candidate.
+	void CameraStructDiscovery::revalidateCandidates(vector<CameraStructCandidate>& candidates, vector<int>& numberOfChanges)
+	{
+		struct SampledCandidate
+		{
+			CameraStructCandidate candidate;
+			uint8_t lastComparedBytes[CAMERA_DISCOVERY_COMPARED_BYTES];
+			int numberOfChanges;
+			int numberOfInvalidSamples;
+			bool hasBeenSampled;
+		};
+		vector<SampledCandidate> sampledCandidates;
+		for (auto& candidate : candidates)
+		{
+			sampledCandidates.push_back({ candidate, {}, 0, 0, false });
+		}
+		// the fov and position are re-determined in each sample, so the same margin as in the scan is read around the candidate.
+		uint8_t sample[2 * CAMERA_SCAN_MARGIN];
+		for (int sampleIndex = 0; sampleIndex < CAMERA_DISCOVERY_NUMBER_OF_SAMPLES && !_isStopping; sampleIndex++)
+		{
+			if (sampleIndex > 0)
+			{
+				this_thread::sleep_for(chrono::milliseconds(CAMERA_DISCOVERY_SAMPLE_INTERVAL_IN_MS));
+			}
+			for (auto& sampledCandidate : sampledCandidates)
+			{
+				if (sampledCandidate.numberOfInvalidSamples > CAMERA_DISCOVERY_MAX_INVALID_SAMPLES)
+				{
+					continue;
+				}
+				CameraStructCandidate& candidate = sampledCandidate.candidate;
+				CameraStructCandidate sampleCandidate = candidate;
+				const uint8_t* address = reinterpret_cast<const uint8_t*>(candidate.address);
+				size_t sampleSize = sizeof(sample);
+				size_t sampleOffset = CAMERA_SCAN_MARGIN;
+				if (!copyMemory(address - sampleOffset, sampleSize, sample))
+				{
+					// the margin crosses the border of the region of the candidate, so only the compared bytes are read, which means no fov.
+					sampleSize = CAMERA_DISCOVERY_COMPARED_BYTES;
+					sampleOffset = CAMERA_DISCOVERY_COMPARED_BYTES_BEFORE;
+					if (!copyMemory(address - sampleOffset, sampleSize, sample))
+					{
+						sampleSize = 0;
+					}
+				}
+				if (0 == sampleSize || CameraStructScanner::scoreCandidate(sample, sampleSize, sampleOffset, sampleCandidate) <= 0.0f)
+				{
+					sampledCandidate.numberOfInvalidSamples++;
+					continue;
+				}
+				const uint8_t* comparedBytes = sample + sampleOffset - CAMERA_DISCOVERY_COMPARED_BYTES_BEFORE;
+				if (sampledCandidate.hasBeenSampled && 0 != memcmp(comparedBytes, sampledCandidate.lastComparedBytes, CAMERA_DISCOVERY_COMPARED_BYTES))
+				{
+					sampledCandidate.numberOfChanges++;
+				}
+				memcpy(sampledCandidate.lastComparedBytes, comparedBytes, CAMERA_DISCOVERY_COMPARED_BYTES);
+				sampledCandidate.hasBeenSampled = true;
+				candidate = sampleCandidate;
+			}
+		}
+		sampledCandidates.erase(remove_if(sampledCandidates.begin(), sampledCandidates.end(), [](const SampledCandidate& c) { return c.numberOfInvalidSamples > CAMERA_DISCOVERY_MAX_INVALID_SAMPLES; }),
+								sampledCandidates.end());
+		stable_sort(sampledCandidates.begin(), sampledCandidates.end(), [](const SampledCandidate& a, const SampledCandidate& b)
+			{
+				return a.numberOfChanges > b.numberOfChanges || (a.numberOfChanges == b.numberOfChanges && a.candidate.score > b.candidate.score);
+			});
+		candidates.clear();
+		numberOfChanges.clear();
+		for (auto& sampledCandidate : sampledCandidates)
+		{
+			candidates.push_back(sampledCandidate.candidate);
+			numberOfChanges.push_back(sampledCandidate.numberOfChanges);
+		}
+	}
+}
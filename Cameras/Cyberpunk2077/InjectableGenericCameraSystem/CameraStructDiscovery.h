@@ -0,0 +1,61 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include "stdafx.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "CameraStructScanner.h"
+
+namespace IGCS
+{
+	// Discovery mode for porting the camera to a game: sweeps the writable memory of the process for layouts which look like camera data with 
+	// the CameraStructScanner, and re-validates the best candidates over a couple of seconds, during which the user moves the camera. The 
+	// live camera is among the candidates which stay valid and change between samples. Runs on a background thread, started over the named 
+	// pipe, and reports the results in the log of the client.
+	class CameraStructDiscovery
+	{
+	public:
+		CameraStructDiscovery();
+		~CameraStructDiscovery();
+
+		static CameraStructDiscovery& instance();
+
+		void startDiscovery();
+		void stop();
+
+	private:
+		void discover();
+		std::vector<CameraStructCandidate> scanMemory(size_t& numberOfBytesScanned);
+		void revalidateCandidates(std::vector<CameraStructCandidate>& candidates, std::vector<int>& numberOfChanges);
+
+		std::atomic<bool> _isRunning;
+		std::atomic<bool> _isStopping;
+		std::thread _discoveryThread;
+	};
+}
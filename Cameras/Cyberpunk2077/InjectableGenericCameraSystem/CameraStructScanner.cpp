@@ -0,0 +1,404 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "CameraStructScanner.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+	// SSE2 is part of x64, so no cpu check is needed.
+	#define IGCS_CAMERA_SCAN_SIMD_SUPPORTED
+	#include <emmintrin.h>
+	// the flush to zero and denormals are zero bits of the MXCSR register.
+	#define CAMERA_SCAN_FLUSH_DENORMALS_MASK		0x8040
+#endif
+
+namespace IGCS::CameraStructScanner
+{
+	// max. deviation from 1 of the squared length of a unit vector, and from 0 of the dot product of two orthogonal rows.
+	#define CAMERA_SCAN_UNIT_TOLERANCE			0.002f
+	#define CAMERA_SCAN_ORTHOGONAL_TOLERANCE	0.002f
+	// coordinates of a position are within this range and are 0 or at least the minimum. Values outside it are more likely to be something
+	// else, e.g. integers or pointers read as floats. A position has to be at least the minimum distance from the origin, as unit vectors (e.g.
+	// normals) next to each other look like a position next to a quaternion otherwise.
+	#define CAMERA_SCAN_MAX_COORDINATE			1.0e6f
+	#define CAMERA_SCAN_MIN_COORDINATE			1.0e-4f
+	#define CAMERA_SCAN_MIN_DISTANCE_TO_ORIGIN	2.0f
+	#define CAMERA_SCAN_ROTATION_SCORE			10.0f
+	#define CAMERA_SCAN_QUATERNION_SCORE		6.0f
+	#define CAMERA_SCAN_POSITION_SCORE			3.0f
+	#define CAMERA_SCAN_FRACTIONAL_SCORE		1.0f		// a position with a fraction in a coordinate, integer coordinates are more likely something else
+	#define CAMERA_SCAN_PADDING_SCORE			1.0f		// the 4th float of every row of a 3x4 matrix is 0
+	#define CAMERA_SCAN_FOV_SCORE				1.0f
+
+	static inline float readFloat(const uint8_t* buffer, size_t offset)
+	{
+		float toReturn;
+		memcpy(&toReturn, buffer + offset, sizeof(toReturn));
+		return toReturn;
+	}
+
+
+	static bool isUnitVector(const float* values, int numberOfComponents)
+	{
+		float squaredLength = 0.0f;
+		for (int i = 0; i < numberOfComponents; i++)
+		{
+			squaredLength += values[i] * values[i];
+		}
+		// NaN fails this test as well.
+		return fabsf(squaredLength - 1.0f) < CAMERA_SCAN_UNIT_TOLERANCE;
+	}
+
+
+	// True if all values are (nearly) 0, 1 or -1, like the rows of an identity matrix.
+	static bool isAxisAligned(const float* values, int numberOfValues)
+	{
+		for (int i = 0; i < numberOfValues; i++)
+		{
+			const float absoluteValue = fabsf(values[i]);
+			if (absoluteValue > 1.0e-3f && fabsf(absoluteValue - 1.0f) > 1.0e-3f)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+
+	static bool isPlausiblePosition(const uint8_t* buffer, size_t bufferSize, size_t offset, bool& hasFraction)
+	{
+		if (offset + 3 * sizeof(float) > bufferSize)
+		{
+			return false;
+		}
+		float squaredDistanceToOrigin = 0.0f;
+		hasFraction = false;
+		for (int i = 0; i < 3; i++)
+		{
+			const float coordinate = readFloat(buffer, offset + i * sizeof(float));
+			if (!std::isfinite(coordinate) || fabsf(coordinate) > CAMERA_SCAN_MAX_COORDINATE || (coordinate != 0.0f && fabsf(coordinate) < CAMERA_SCAN_MIN_COORDINATE))
+			{
+				return false;
+			}
+			squaredDistanceToOrigin += coordinate * coordinate;
+			hasFraction |= coordinate != floorf(coordinate);
+		}
+		return squaredDistanceToOrigin >= CAMERA_SCAN_MIN_DISTANCE_TO_ORIGIN * CAMERA_SCAN_MIN_DISTANCE_TO_ORIGIN;
+	}
+
+
+	static bool isFovLike(float value)
+	{
+		// degrees or radians, 20-130 degrees.
+		return (value >= 20.0f && value <= 130.0f) || (value >= 0.35f && value <= 2.27f);
+	}
+
+
+	// Looks for the float which looks like a fov nearest to the layout at offset, within CAMERA_SCAN_MARGIN bytes of it. The layout itself and
+	// the 16 bytes of its position aren't searched.
+	static void findFov(const uint8_t* buffer, size_t bufferSize, size_t offset, size_t layoutSize, CameraStructCandidate& candidate)
+	{
+		candidate.hasFov = false;
+		for (int distance = 4; distance <= CAMERA_SCAN_MARGIN; distance += 4)
+		{
+			const int fovOffsets[2] = { -distance, static_cast<int>(layoutSize) + distance - 4 };
+			for (int fovOffset : fovOffsets)
+			{
+				if ((fovOffset < 0 && static_cast<size_t>(-fovOffset) > offset) || offset + fovOffset + sizeof(float) > bufferSize)
+				{
+					continue;
+				}
+				if (candidate.hasPosition && fovOffset >= candidate.positionOffset && fovOffset < candidate.positionOffset + 16)
+				{
+					continue;
+				}
+				if (isFovLike(readFloat(buffer, offset + fovOffset)))
+				{
+					candidate.hasFov = true;
+					candidate.fovOffset = fovOffset;
+					return;
+				}
+			}
+		}
+	}
+
+
+	static size_t layoutSizeOf(CameraLayoutKind kind)
+	{
+		switch (kind)
+		{
+		case CameraLayoutKind::Matrix3x4:
+			return 12 * sizeof(float);
+		case CameraLayoutKind::Matrix3x3:
+			return 9 * sizeof(float);
+		default:
+			return 4 * sizeof(float);
+		}
+	}
+
+
+	static float scoreMatrix(const uint8_t* buffer, size_t bufferSize, size_t offset, int strideInFloats, CameraStructCandidate& candidate)
+	{
+		const size_t rowStride = strideInFloats * sizeof(float);
+		if (offset + 2 * rowStride + 3 * sizeof(float) > bufferSize)
+		{
+			return 0.0f;
+		}
+		float rows[3][3];
+		for (int row = 0; row < 3; row++)
+		{
+			for (int column = 0; column < 3; column++)
+			{
+				rows[row][column] = readFloat(buffer, offset + row * rowStride + column * sizeof(float));
+			}
+			if (!isUnitVector(rows[row], 3))
+			{
+				return 0.0f;
+			}
+		}
+		for (int first = 0; first < 3; first++)
+		{
+			for (int second = first + 1; second < 3; second++)
+			{
+				const float dot = rows[first][0] * rows[second][0] + rows[first][1] * rows[second][1] + rows[first][2] * rows[second][2];
+				if (fabsf(dot) > CAMERA_SCAN_ORTHOGONAL_TOLERANCE)
+				{
+					return 0.0f;
+				}
+			}
+		}
+		if (isAxisAligned(&rows[0][0], 9))
+		{
+			return 0.0f;
+		}
+		float score = CAMERA_SCAN_ROTATION_SCORE;
+		if (strideInFloats == 4 && offset + 3 * rowStride <= bufferSize)
+		{
+			bool isPadded = true;
+			for (int row = 0; row < 3; row++)
+			{
+				isPadded &= readFloat(buffer, offset + row * rowStride + 3 * sizeof(float)) == 0.0f;
+			}
+			score += isPadded ? CAMERA_SCAN_PADDING_SCORE : 0.0f;
+		}
+		// the position is the row after the rotation, like the translation row of a 4x4 matrix.
+		bool hasFraction = false;
+		candidate.hasPosition = isPlausiblePosition(buffer, bufferSize, offset + 3 * rowStride, hasFraction);
+		if (candidate.hasPosition)
+		{
+			candidate.positionOffset = static_cast<int>(3 * rowStride);
+			score += CAMERA_SCAN_POSITION_SCORE + (hasFraction ? CAMERA_SCAN_FRACTIONAL_SCORE : 0.0f);
+		}
+		return score;
+	}
+
+
+	static float scoreQuaternion(const uint8_t* buffer, size_t bufferSize, size_t offset, CameraStructCandidate& candidate)
+	{
+		if (offset + 4 * sizeof(float) > bufferSize)
+		{
+			return 0.0f;
+		}
+		float quaternion[4];
+		memcpy(quaternion, buffer + offset, sizeof(quaternion));
+		if (!isUnitVector(quaternion, 4) || isAxisAligned(quaternion, 4))
+		{
+			return 0.0f;
+		}
+		// a unit vector of 4 floats on its own is too common, it has to have a position right before or after it.
+		bool hasFraction = false;
+		if (offset >= 4 * sizeof(float) && isPlausiblePosition(buffer, bufferSize, offset - 4 * sizeof(float), hasFraction))
+		{
+			candidate.positionOffset = -static_cast<int>(4 * sizeof(float));
+		}
+		else if (isPlausiblePosition(buffer, bufferSize, offset + 4 * sizeof(float), hasFraction))
+		{
+			candidate.positionOffset = static_cast<int>(4 * sizeof(float));
+		}
+		else
+		{
+			return 0.0f;
+		}
+		candidate.hasPosition = true;
+		return CAMERA_SCAN_QUATERNION_SCORE + CAMERA_SCAN_POSITION_SCORE + (hasFraction ? CAMERA_SCAN_FRACTIONAL_SCORE : 0.0f);
+	}
+
+
+	// Scores the candidate as the layout of its kind at offset in buffer. Returns the score, which is 0 if the layout isn't there. Also used to
+	// re-validate a candidate found earlier with a fresh copy of its memory.
+	float scoreCandidate(const uint8_t* buffer, size_t bufferSize, size_t offset, CameraStructCandidate& candidate)
+	{
+		candidate.hasPosition = false;
+		candidate.hasFov = false;
+		float score = 0.0f;
+		switch (candidate.kind)
+		{
+		case CameraLayoutKind::Matrix3x4:
+			score = scoreMatrix(buffer, bufferSize, offset, 4, candidate);
+			break;
+		case CameraLayoutKind::Matrix3x3:
+			score = scoreMatrix(buffer, bufferSize, offset, 3, candidate);
+			break;
+		case CameraLayoutKind::QuaternionAndPosition:
+			score = scoreQuaternion(buffer, bufferSize, offset, candidate);
+			break;
+		}
+		if (score > 0.0f)
+		{
+			findFov(buffer, bufferSize, offset, layoutSizeOf(candidate.kind), candidate);
+			score += candidate.hasFov ? CAMERA_SCAN_FOV_SCORE : 0.0f;
+		}
+		candidate.score = score;
+		return score;
+	}
+
+
+	// Checks all layouts at offset and adds the best scoring one, if any, to candidates. Returns the size of the layout added, 0 if none was added.
+	static size_t addBestCandidateAt(const uint8_t* buffer, size_t bufferSize, size_t offset, uintptr_t bufferAddress, std::vector<CameraStructCandidate>& candidates)
+	{
+		static const CameraLayoutKind kindsToCheck[] = { CameraLayoutKind::Matrix3x4, CameraLayoutKind::Matrix3x3, CameraLayoutKind::QuaternionAndPosition };
+		CameraStructCandidate best;
+		for (CameraLayoutKind kind : kindsToCheck)
+		{
+			CameraStructCandidate candidate;
+			candidate.address = bufferAddress + offset;
+			candidate.kind = kind;
+			if (scoreCandidate(buffer, bufferSize, offset, candidate) > best.score)
+			{
+				best = candidate;
+			}
+		}
+		if (best.score <= 0.0f)
+		{
+			return 0;
+		}
+		candidates.push_back(best);
+		return layoutSizeOf(best.kind);
+	}
+
+
+	// Scans the 4-byte aligned positions in [ownedStart, ownedEnd) of buffer for camera layouts and adds the ones found to candidates. The bytes
+	// outside the owned range are only read to verify and score the layouts, so overlapping buffers can be scanned in parallel. bufferAddress 
+	// is the address the buffer was copied from, the addresses of the candidates are based on it.
+	void scanBuffer(const uint8_t* buffer, size_t bufferSize, size_t ownedStart, size_t ownedEnd, uintptr_t bufferAddress, 
+					std::vector<CameraStructCandidate>& candidates)
+	{
+		ownedEnd = ownedEnd > bufferSize ? bufferSize : ownedEnd;
+		size_t position = (ownedStart + 3) & ~static_cast<size_t>(3);
+#ifdef IGCS_CAMERA_SCAN_SIMD_SUPPORTED
+		// most of the memory isn't floats, and integers and pointers read as floats are often denormals. Arithmetic with denormals is very slow,
+		// so they're flushed to zero while scanning. That doesn't change the outcome, denormals aren't part of camera data.
+		const unsigned int controlStatusToRestore = _mm_getcsr();
+		_mm_setcsr(controlStatusToRestore | CAMERA_SCAN_FLUSH_DENORMALS_MASK);
+		// 4 positions at a time: the squared length of the 3 and 4 floats starting at each position, from 4 loads shifted by one float.
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 tolerance = _mm_set1_ps(CAMERA_SCAN_UNIT_TOLERANCE);
+		const __m128 absoluteMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+		while (position < ownedEnd && position + 7 * sizeof(float) <= bufferSize)
+		{
+			const __m128 first = _mm_loadu_ps(reinterpret_cast<const float*>(buffer + position));
+			const __m128 second = _mm_loadu_ps(reinterpret_cast<const float*>(buffer + position + 4));
+			const __m128 third = _mm_loadu_ps(reinterpret_cast<const float*>(buffer + position + 8));
+			const __m128 fourth = _mm_loadu_ps(reinterpret_cast<const float*>(buffer + position + 12));
+			const __m128 squaredLength3 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(first, first), _mm_mul_ps(second, second)), _mm_mul_ps(third, third));
+			const __m128 squaredLength4 = _mm_add_ps(squaredLength3, _mm_mul_ps(fourth, fourth));
+			const __m128 isUnit3 = _mm_cmplt_ps(_mm_and_ps(_mm_sub_ps(squaredLength3, one), absoluteMask), tolerance);
+			const __m128 isUnit4 = _mm_cmplt_ps(_mm_and_ps(_mm_sub_ps(squaredLength4, one), absoluteMask), tolerance);
+			int unitMask = _mm_movemask_ps(_mm_or_ps(isUnit3, isUnit4));
+			size_t nextPosition = position + 4 * sizeof(float);
+			while (0 != unitMask)
+			{
+				int lane = 0;
+				while (0 == (unitMask & (1 << lane)))
+				{
+					lane++;
+				}
+				unitMask &= ~(1 << lane);
+				const size_t offset = position + lane * sizeof(float);
+				if (offset >= ownedEnd)
+				{
+					break;
+				}
+				const size_t layoutSize = addBestCandidateAt(buffer, bufferSize, offset, bufferAddress, candidates);
+				if (layoutSize > 0)
+				{
+					// the rows of the layout found aren't the start of another layout.
+					nextPosition = offset + layoutSize;
+					break;
+				}
+			}
+			position = nextPosition;
+		}
+		_mm_setcsr(controlStatusToRestore);
+#endif
+		for (; position < ownedEnd && position + 3 * sizeof(float) <= bufferSize; position += sizeof(float))
+		{
+			const size_t layoutSize = addBestCandidateAt(buffer, bufferSize, position, bufferAddress, candidates);
+			if (layoutSize > 0)
+			{
+				position += layoutSize - sizeof(float);
+			}
+		}
+	}
+
+
+	// Keeps the candidates with the highest score, sorted on score, highest first.
+	void keepBestCandidates(std::vector<CameraStructCandidate>& candidates, size_t maxNumberOfCandidates)
+	{
+		const auto isBetter = [](const CameraStructCandidate& a, const CameraStructCandidate& b)
+			{
+				return a.score > b.score || (a.score == b.score && a.address < b.address);
+			};
+		if (candidates.size() > maxNumberOfCandidates)
+		{
+			std::partial_sort(candidates.begin(), candidates.begin() + maxNumberOfCandidates, candidates.end(), isBetter);
+			candidates.resize(maxNumberOfCandidates);
+		}
+		else
+		{
+			std::sort(candidates.begin(), candidates.end(), isBetter);
+		}
+	}
+
+
+	const char* layoutName(CameraLayoutKind kind)
+	{
+		switch (kind)
+		{
+		case CameraLayoutKind::Matrix3x4:
+			return "3x4 rotation matrix";
+		case CameraLayoutKind::Matrix3x3:
+			return "3x3 rotation matrix";
+		case CameraLayoutKind::QuaternionAndPosition:
+			return "quaternion and position";
+		default:
+			return "?";
+		}
+	}
+}
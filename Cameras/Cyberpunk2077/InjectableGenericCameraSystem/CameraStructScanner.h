@@ -0,0 +1,72 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace IGCS
+{
+	// The layouts of camera data the scanner recognizes.
+	enum class CameraLayoutKind : uint8_t
+	{
+		Matrix3x4 = 0,				// 3 orthonormal rows of 3 floats with a stride of 4 floats, e.g. the rotation part of a 4x4 matrix
+		Matrix3x3 = 1,				// 3 orthonormal rows of 3 floats, packed
+		QuaternionAndPosition = 2,	// a unit quaternion with a float3 position right before or after it
+	};
+
+	// A location in memory which looks like camera data, with the offsets of the position and fov found near it, relative to the location.
+	struct CameraStructCandidate
+	{
+		uintptr_t address = 0;
+		CameraLayoutKind kind = CameraLayoutKind::Matrix3x4;
+		float score = 0.0f;
+		bool hasPosition = false;
+		int positionOffset = 0;
+		bool hasFov = false;
+		int fovOffset = 0;
+	};
+}
+
+// Heuristic scanner for camera data in memory, e.g. the heap of the game, to find a camera struct without a debugger. Every 4-byte aligned 
+// position is checked for the start of a unit vector of 3 or 4 floats with SSE2, 4 positions at a time. Only at these positions the complete
+// layouts are verified and scored: orthonormal rotation rows, or a unit quaternion next to a plausible position, with bonuses for a position 
+// and a float which looks like a field of view (in degrees or radians) near it. Axis aligned rotations (e.g. identity matrices, which are 
+// everywhere) are skipped. Doesn't depend on windows headers so it can be used by tools outside the camera dll too.
+namespace IGCS::CameraStructScanner
+{
+	// The number of bytes around a candidate the scanner looks at, so a buffer has to contain this many bytes before and after the positions to
+	// check to find everything a scan of the whole memory would find.
+	#define CAMERA_SCAN_MARGIN			512
+
+	void scanBuffer(const uint8_t* buffer, size_t bufferSize, size_t ownedStart, size_t ownedEnd, uintptr_t bufferAddress, 
+					std::vector<CameraStructCandidate>& candidates);
+	float scoreCandidate(const uint8_t* buffer, size_t bufferSize, size_t offset, CameraStructCandidate& candidate);
+	void keepBestCandidates(std::vector<CameraStructCandidate>& candidates, size_t maxNumberOfCandidates);
+	const char* layoutName(CameraLayoutKind kind);
+}
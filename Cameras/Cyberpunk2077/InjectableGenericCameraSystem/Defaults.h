@@ -36,6 +36,14 @@ namespace IGCS
 	#define FRAME_SLEEP								8		// in milliseconds
 	#define IGCS_SUPPORT_RAWKEYBOARDINPUT			true	// if set to false, raw keyboard input is ignored.
 	#define IGCS_MAX_MESSAGE_SIZE					4*1024	// in bytes
+	#define IGCS_AOB_CACHE_FILENAME					"IGCS_aobcache.txt"		// stored next to the game exe
+	#define IGCS_AOB_APPROXIMATE_MAX_MISMATCHES		2		// max. number of bytes a candidate location of a pattern which wasn't found can differ.
+	#define IGCS_AOB_APPROXIMATE_MAX_CANDIDATES		5		// max. number of candidate locations reported per pattern which wasn't found.
+	#define IGCS_AOB_APPROXIMATE_AUTO_ACCEPT		false	// if set to true, a block is hooked at the candidate if there's only one which differs 1 byte.
+	#define IGCS_BUILD_IMAGE_INDEX_AT_STARTUP		false	// if set to true, the index for pattern queries is built after the hooks are set, otherwise at the first query.
+	#define IGCS_HOOK_WATCHDOG_INTERVAL				2000	// in milliseconds. Interval in which the patched code sites are verified by the main loop.
+	#define IGCS_INTERCEPTOR_TELEMETRY_INTERVAL		1000	// in milliseconds. Interval over which the hit rates of the interceptors are measured.
+	#define IGCS_UNLOAD_GRACE_PERIOD				250		// in milliseconds. Time given to game threads inside an interceptor or detour to leave it after the hooks are removed at unload.
 
 	// Keyboard system control
 	#define IGCS_KEY_CAMERA_ENABLE					VK_INSERT
@@ -110,11 +118,51 @@ namespace IGCS
 		ErrorTextMessage = 5,
 		DebugTextMessage= 6,
 		Action = 7,
+		FeatureAvailability = 8,
+		InterceptorHitRate = 9,
+		ImageIndexState = 10,
+		ImageIndexQueryResult = 11,
 	};
 
 	enum class ActionMessageType : uint8_t
 	{
 		RehookXInput = 1,
 		ResizeViewport = 2,
+		BuildImageIndex = 3,
+		QueryImageIndex = 4,		// payload is the pattern as ascii text, e.g. "48 8B ?? 10"
+		DiscardImageIndex = 5,
+		DiscoverCameraStruct = 6,
+		StartValueHunt = 7,			// payload is the value type as ascii text, 'float' or 'int', optionally followed by a start and end address in hex
+		NarrowValueHunt = 8,		// payload is the comparison as ascii text, e.g. "changed" or "equal 90 0.01"
+		DiscardValueHunt = 9,
+		ReportInterceptorHits = 10,
+	};
+
+	enum class ImageIndexState : uint8_t
+	{
+		NotBuilt = 0,
+		Building = 1,
+		Built = 2,
+	};
+
+	// How the locations of a pattern sent with a QueryImageIndex action were found.
+	enum class ImageIndexQueryMethod : uint8_t
+	{
+		Index = 0,
+		ScanIndexNotBuilt = 1,
+		ScanTooFewConsecutiveBytes = 2,		// the pattern has no run of non-wildcard bytes long enough to be looked up in the index
+	};
+
+	// Features which depend on non-critical AOB blocks. These are unavailable till their blocks have been found and hooked in the background.
+	enum class FeatureType : uint8_t
+	{
+		TimeOfDay = 0,
+		HudToggle = 1,
+		Timestop = 2,
+		Weather = 3,
+		Hotsampling = 4,
+
+		// add more here
+		Amount,
 	};
 }
\ No newline at end of file
@@ -29,65 +29,585 @@
 #include "GameImageHooker.h"
 #include "Defaults.h"
 #include "MessageHandler.h"
+#include "X64InstructionDecoder.h"
+#include "HookTransaction.h"
+#include "HookWatchdog.h"
+#include "InterceptorStubBuilder.h"
+#include "InterceptorTelemetry.h"
+#include "Globals.h"
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+
+using namespace std;
 
 namespace IGCS::GameImageHooker
 {
-	// Sets a jmp qword ptr [address] statement at hostImageAddress + startOffset for x64 and a jmp <relative address> for x86
-	void setHook(LPBYTE hostImageAddress, DWORD startOffset, DWORD continueOffset, LPBYTE* interceptionContinue, void* asmFunction)
+#ifdef _WIN64
+	// jmp qword ptr [0] (6 bytes) followed by the 8 byte address to jump to.
+	#define HOOK_SIZE		14
+#else
+	// jmp <relative address>
+	#define HOOK_SIZE		5
+#endif
+	// Interceptor stubs are generated within this distance of their hook, so the rip relative operands and branches of the instructions they
+	// copy, which refer to the image of the game, can still be relocated.
+	#define STUB_ARENA_MAX_DISTANCE		0x40000000
+	#define STUB_ARENA_SIZE				0x10000
+	// The number of times a site overwritten by something else is patched again. After that it's left alone, as something else apparently 
+	// wants to hook the same code.
+	#define HOOK_WATCHDOG_MAX_REINSTALLS	2
+
+	// The original and last written value of a byte of code we patched.
+	struct PatchedByte
 	{
-		if (hostImageAddress == nullptr)
+		uint8_t originalValue;
+		uint8_t patchedValue;
+	};
+
+	static VirtualProtectPatchBackend _patchBackend;
+	// the transaction the patches of the current thread are collected in, if any. Hooks are set from several threads (main and background), 
+	// so every thread has its own.
+	static thread_local unique_ptr<HookTransaction> _currentTransaction;
+	// held while code of the game is written and while the bytes written are recorded, restored or verified, so the protection changes and 
+	// writes of one thread never interleave with those of another, e.g. two threads patching sites on the same page, each restoring the 
+	// protection of the page while the other is still writing to it.
+	static mutex _patchMutex;
+	// every byte we patched, so all sites can be restored when the dll is unloaded. Per byte, so a site patched twice, e.g. nopped and later
+	// written with its original bytes again, is restored to the bytes of the game. Guarded by _patchMutex.
+	static map<uint8_t*, PatchedByte> _patchedBytes;
+	// verifies the sites in _patchedBytes, except the ones given up on. Guarded by _patchMutex too.
+	static HookWatchdog _hookWatchdog;
+	static map<uint8_t*, int> _numberOfReinstallsPerSite;
+	static set<uint8_t*> _sitesGivenUpOn;
+	static bool _logNextVerification = false;		// set when the watched sites change, so the time a verification takes is logged.
+
+	// A block of memory near a game image in which interceptor stubs are generated. Every stub gets its own pages, which are made executable
+	// once the stub is written, so a page is never writable while code on it can run. Stubs aren't freed when their hook is uninstalled, as a 
+	// game thread might still be in one: the arenas are released with releaseStubArenas when the dll is unloaded, after a grace period, 
+	// except the ones with a stub that replays a call.
+	struct StubArena
+	{
+		LPBYTE start;
+		size_t size;
+		size_t used;
+		bool containsReplayedCall;		// true if a stub in the arena replays a call, so a return address can point into the arena.
+	};
+
+	static mutex _stubArenasMutex;
+	static vector<StubArena> _stubArenas;
+
+	// Returns the sites we patched, i.e. the runs of consecutive bytes in _patchedBytes. The caller has to hold _patchMutex.
+	static vector<CodePatch> collectPatchedSites()
+	{
+		vector<CodePatch> toReturn;
+		for (auto& addressBytePair : _patchedBytes)
+		{
+			if (toReturn.empty() || toReturn.back().address + toReturn.back().patchedBytes.size() != addressBytePair.first)
+			{
+				toReturn.push_back({ addressBytePair.first, {}, {} });
+			}
+			toReturn.back().patchedBytes.push_back(addressBytePair.second.patchedValue);
+			toReturn.back().originalBytes.push_back(addressBytePair.second.originalValue);
+		}
+		return toReturn;
+	}
+
+
+	// Makes the watchdog verify the sites we patched, except the ones given up on. The caller has to hold _patchMutex.
+	static void updateWatchedSites()
+	{
+		vector<CodePatch> sites = collectPatchedSites();
+		auto isGivenUpOn = [](const CodePatch& site) { return _sitesGivenUpOn.count(site.address) > 0; };
+		sites.erase(remove_if(sites.begin(), sites.end(), isGivenUpOn), sites.end());
+		_hookWatchdog.watch(sites);
+		_logNextVerification = true;
+	}
+
+
+	// Applies and commits the transaction specified and records the bytes it patched. Returns false if nothing was written. The caller has to 
+	// hold _patchMutex.
+	static bool applyTransactionWhileLocked(HookTransaction& transaction)
+	{
+		if (!transaction.apply())
+		{
+			MessageHandler::logError("Couldn't write %zu code patches, none were applied: %s", transaction.numberOfPatches(), transaction.errorDescription().c_str());
+			return false;
+		}
+		transaction.commit();
+		for (auto& patch : transaction.patches())
+		{
+			for (size_t i = 0; i < patch.patchedBytes.size(); i++)
+			{
+				// try_emplace keeps the original value of a byte patched before.
+				auto insertResult = _patchedBytes.try_emplace(patch.address + i, PatchedByte{ patch.originalBytes[i], patch.patchedBytes[i] });
+				insertResult.first->second.patchedValue = patch.patchedBytes[i];
+			}
+		}
+		updateWatchedSites();
+		return true;
+	}
+
+
+	static bool applyTransaction(HookTransaction& transaction)
+	{
+		lock_guard<mutex> lock(_patchMutex);
+		return applyTransactionWhileLocked(transaction);
+	}
+
+
+	// Writes the bytes specified at address. If a transaction was begun on this thread, the bytes are added to it and written when it's committed, 
+	// otherwise they're written right away.
+	static bool writePatch(LPBYTE address, const uint8_t* bytes, size_t length)
+	{
+		if (nullptr != _currentTransaction)
+		{
+			if (!_currentTransaction->addPatch(address, bytes, length))
+			{
+				MessageHandler::logError("Couldn't add the patch at address %p to the transaction: %s", (void*)address, _currentTransaction->errorDescription().c_str());
+				return false;
+			}
+			return true;
+		}
+		HookTransaction transaction(_patchBackend);
+		transaction.addPatch(address, bytes, length);
+		return applyTransaction(transaction);
+	}
+
+
+	// Begins a transaction on the calling thread: hooks and writes are collected until commitTransaction is called, and are then applied together.
+	void beginTransaction()
+	{
+		_currentTransaction = make_unique<HookTransaction>(_patchBackend);
+	}
+
+
+	// Applies the hooks and writes collected since beginTransaction as a unit. Returns false if they couldn't be written, in which case none of 
+	// them is applied.
+	bool commitTransaction()
+	{
+		if (nullptr == _currentTransaction)
+		{
+			return false;
+		}
+		unique_ptr<HookTransaction> transaction = move(_currentTransaction);
+		if (0 == transaction->numberOfPatches())
+		{
+			return true;
+		}
+		if (!applyTransaction(*transaction))
+		{
+			return false;
+		}
+		MessageHandler::logDebug("%zu code patches applied on %zu pages.", transaction->numberOfPatches(), transaction->numberOfPages());
+		return true;
+	}
+
+
+	// Restores the original bytes of every site we patched, so the dll can be unloaded while the game keeps running. A site which was changed
+	// by something else after we patched it is left alone.
+	void uninstallAllHooks()
+	{
+		lock_guard<mutex> lock(_patchMutex);
+		vector<CodePatch> patches = collectPatchedSites();
+		size_t numberOfPatchesSkipped = 0;
+		const size_t numberOfPatchesRestored = uninstallCodePatches(_patchBackend, patches, numberOfPatchesSkipped);
+		_patchedBytes.clear();
+		updateWatchedSites();
+		MessageHandler::logLine("%zu patched code sites restored, %zu skipped as they were changed by something else.", numberOfPatchesRestored, numberOfPatchesSkipped);
+	}
+
+
+	// Forgets the sites we patched in [start, start + size), e.g. the memory of a module which was unloaded, so they're no longer verified by
+	// the watchdog nor restored by uninstallAllHooks: the memory is gone or will be reused by something else.
+	void forgetPatchesInRange(LPBYTE start, size_t size)
+	{
+		lock_guard<mutex> lock(_patchMutex);
+		const auto firstByte = _patchedBytes.lower_bound(start);
+		const auto lastByte = _patchedBytes.lower_bound(start + size);
+		const size_t numberOfBytesForgotten = distance(firstByte, lastByte);
+		_patchedBytes.erase(firstByte, lastByte);
+		_numberOfReinstallsPerSite.erase(_numberOfReinstallsPerSite.lower_bound(start), _numberOfReinstallsPerSite.lower_bound(start + size));
+		_sitesGivenUpOn.erase(_sitesGivenUpOn.lower_bound(start), _sitesGivenUpOn.lower_bound(start + size));
+		if (numberOfBytesForgotten > 0)
+		{
+			updateWatchedSites();
+			MessageHandler::logDebug("%zu patched code bytes in %p-%p forgotten.", numberOfBytesForgotten, (void*)start, (void*)(start + size));
+		}
+	}
+
+
+	// Releases the stub arenas, so unloading and injecting the dll again doesn't leave the arenas of every previous run behind. Only call 
+	// this after uninstallAllHooks and a grace period, so no game thread is still in one of the stubs.
+	// Arenas with a stub that replays a displaced call, e.g. the call qword ptr [rax+258h] of the active camera hook, are kept reserved:
+	// the callee returns into the stub, and a game thread blocked in the callee, e.g. on a lock, can be in there for longer than any grace
+	// period. Freeing the arena would make that thread return into unmapped memory. Such an arena is leaked each time the dll is unloaded.
+	void releaseStubArenas()
+	{
+		lock_guard<mutex> lock(_stubArenasMutex);
+		int numberOfArenasKept = 0;
+		for (auto& arena : _stubArenas)
+		{
+			if (arena.containsReplayedCall)
+			{
+				numberOfArenasKept++;
+				continue;
+			}
+			VirtualFree(arena.start, 0, MEM_RELEASE);
+		}
+		if (numberOfArenasKept > 0)
+		{
+			MessageHandler::logDebug("%d interceptor stub arena(s) kept reserved, as a replayed call might still return into them.", numberOfArenasKept);
+		}
+		_stubArenas.clear();
+	}
+
+
+	// Verifies that the sites we patched still contain the bytes we wrote. Sites overwritten by something else, e.g. an overlay, are patched
+	// again, up to HOOK_WATCHDOG_MAX_REINSTALLS times, after which they're left alone. Either way a notification is shown, as the camera 
+	// might not work properly anymore. Called at a low frequency from the main loop: the verification is a single pass over the watched sites.
+	// The sites are patched again in one transaction, without releasing the lock, so no other thread can patch or restore them in between.
+	void verifyHooks()
+	{
+		lock_guard<mutex> lock(_patchMutex);
+		const auto verificationStart = chrono::high_resolution_clock::now();
+		const bool areSitesIntact = _hookWatchdog.verify();
+		if (_logNextVerification)
+		{
+			const double verificationTime = chrono::duration<double, micro>(chrono::high_resolution_clock::now() - verificationStart).count();
+			MessageHandler::logDebug("Hook watchdog verified %zu code sites (%zu lanes) in %.2f microseconds.", _hookWatchdog.numberOfSites(), 
+									 _hookWatchdog.numberOfLanes(), verificationTime);
+			_logNextVerification = false;
+		}
+		if (areSitesIntact)
 		{
 			return;
 		}
-		LPBYTE startOfHookAddress = hostImageAddress + startOffset;
-		// interception continue isn't always specified, i.e. in the case of when the intercepted block by itself issues a ret.
-		if (nullptr != interceptionContinue)
+		HookTransaction reinstallTransaction(_patchBackend);
+		bool isSiteGivenUpOn = false;
+		for (size_t siteIndex : _hookWatchdog.determineTamperedSites())
 		{
-			*interceptionContinue = startOfHookAddress + continueOffset;
+			const CodePatch& site = _hookWatchdog.site(siteIndex);
+			int& numberOfReinstalls = _numberOfReinstallsPerSite[site.address];
+			if (numberOfReinstalls < HOOK_WATCHDOG_MAX_REINSTALLS)
+			{
+				numberOfReinstalls++;
+				reinstallTransaction.addPatch(site.address, site.patchedBytes.data(), site.patchedBytes.size());
+				MessageHandler::logError("The patched code at address %p was overwritten by something else. Patching it again.", (void*)site.address);
+			}
+			else
+			{
+				_sitesGivenUpOn.insert(site.address);
+				isSiteGivenUpOn = true;
+				MessageHandler::logError("The patched code at address %p was overwritten again by something else. It's left alone from now on.", (void*)site.address);
+			}
+		}
+		if (isSiteGivenUpOn)
+		{
+			updateWatchedSites();
+			MessageHandler::addNotification("A hook was overwritten by another tool: the camera might not work properly.");
+		}
+		// the sites patched again are watched again by applyTransactionWhileLocked.
+		if (reinstallTransaction.numberOfPatches() > 0 && applyTransactionWhileLocked(reinstallTransaction))
+		{
+			MessageHandler::addNotification("A hook was overwritten by another tool and has been restored.");
+		}
+	}
+
+
+	// Allocates a stub arena in a free region within STUB_ARENA_MAX_DISTANCE of address. Free regions below address are tried first, closest 
+	// first, then the ones above it. Returns nullptr if there's no free region nearby.
+	static LPBYTE allocateStubArenaNear(LPBYTE address)
+	{
+		SYSTEM_INFO systemInfo;
+		GetSystemInfo(&systemInfo);
+		const uintptr_t granularity = systemInfo.dwAllocationGranularity;
+		const uintptr_t target = reinterpret_cast<uintptr_t>(address);
+		const uintptr_t lowest = max(reinterpret_cast<uintptr_t>(systemInfo.lpMinimumApplicationAddress), target > STUB_ARENA_MAX_DISTANCE ? target - STUB_ARENA_MAX_DISTANCE : 0);
+		const uintptr_t highest = min(reinterpret_cast<uintptr_t>(systemInfo.lpMaximumApplicationAddress), target + STUB_ARENA_MAX_DISTANCE);
+		MEMORY_BASIC_INFORMATION memoryInfo;
+		for (uintptr_t candidate = (target / granularity) * granularity; candidate >= lowest + granularity; candidate -= granularity)
+		{
+			if (0 == VirtualQuery(reinterpret_cast<LPCVOID>(candidate), &memoryInfo, sizeof(memoryInfo)))
+			{
+				break;
+			}
+			if (MEM_FREE == memoryInfo.State)
+			{
+				LPVOID arena = VirtualAlloc(reinterpret_cast<LPVOID>(candidate), STUB_ARENA_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+				if (nullptr != arena)
+				{
+					return reinterpret_cast<LPBYTE>(arena);
+				}
+			}
+			else
+			{
+				// skip the rest of the allocation, allocation bases are aligned on the granularity.
+				candidate = min(candidate, reinterpret_cast<uintptr_t>(memoryInfo.AllocationBase));
+			}
+		}
+		for (uintptr_t candidate = ((target + granularity - 1) / granularity) * granularity; candidate + STUB_ARENA_SIZE <= highest; candidate += granularity)
+		{
+			if (0 == VirtualQuery(reinterpret_cast<LPCVOID>(candidate), &memoryInfo, sizeof(memoryInfo)))
+			{
+				break;
+			}
+			if (MEM_FREE == memoryInfo.State)
+			{
+				LPVOID arena = VirtualAlloc(reinterpret_cast<LPVOID>(candidate), STUB_ARENA_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+				if (nullptr != arena)
+				{
+					return reinterpret_cast<LPBYTE>(arena);
+				}
+			}
+			else
+			{
+				// continue at the first granularity boundary after the region.
+				const uintptr_t regionEnd = reinterpret_cast<uintptr_t>(memoryInfo.BaseAddress) + memoryInfo.RegionSize;
+				candidate = max(candidate, ((regionEnd + granularity - 1) / granularity) * granularity - granularity);
+			}
+		}
+		return nullptr;
+	}
+
+
+	// Returns true if one of the instructions in the continueOffset bytes at startOfHookAddress, which the stub of the hook replays, is a call.
+	static bool replaysCall(LPBYTE startOfHookAddress, DWORD continueOffset)
+	{
+		for (DWORD offset = 0; offset < continueOffset; )
+		{
+			X64Instruction decoded;
+			if (!X64InstructionDecoder::decode(startOfHookAddress + offset, continueOffset - offset, decoded))
+			{
+				// can't tell what's replayed, so assume the worst.
+				return true;
+			}
+			if (X64InstructionDecoder::isCall(decoded))
+			{
+				return true;
+			}
+			offset += decoded.length;
+		}
+		return false;
+	}
+
+
+	// Generates the stub of the interceptor described by interceptor, for the hook at startOfHookAddress which continues at continueOffset, in
+	// a stub arena near the hook. The stub counts its hits in the hit counter of the interceptor's block. Returns the address of the stub or 
+	// nullptr if it couldn't be generated.
+	static LPBYTE generateInterceptorStub(LPBYTE startOfHookAddress, DWORD continueOffset, const InterceptorDescriptor& interceptor)
+	{
+		lock_guard<mutex> lock(_stubArenasMutex);
+		SYSTEM_INFO systemInfo;
+		GetSystemInfo(&systemInfo);
+		const size_t pageSize = systemInfo.dwPageSize;
+		// the size of a stub is only known once it's generated, at the address it's placed at. Most stubs fit in a page, so an arena with room
+		// for a page is picked first. If the stub turns out to be larger, it's generated again in an arena with room for its size.
+		size_t requiredSize = pageSize;
+		auto isUsable = [startOfHookAddress, &requiredSize](const StubArena& arena)
+		{
+			const LPBYTE nextStubAddress = arena.start + arena.used;
+			const uintptr_t distance = nextStubAddress > startOfHookAddress ? nextStubAddress - startOfHookAddress : startOfHookAddress - nextStubAddress;
+			return arena.used + requiredSize <= arena.size && distance < STUB_ARENA_MAX_DISTANCE;
+		};
+		uint64_t* hitCounter = InterceptorTelemetry::instance().registerInterceptor(interceptor.blockName);
+		vector<StubArena>::iterator arena;
+		LPBYTE stubAddress = nullptr;
+		vector<uint8_t> stubCode;
+		size_t stubSize = 0;
+		while (true)
+		{
+			arena = find_if(_stubArenas.begin(), _stubArenas.end(), isUsable);
+			if (arena == _stubArenas.end())
+			{
+				if (requiredSize > STUB_ARENA_SIZE)
+				{
+					MessageHandler::logError("The interceptor stub for block %s is too large: %zu bytes.", interceptor.blockName, stubCode.size());
+					return nullptr;
+				}
+				LPBYTE arenaStart = allocateStubArenaNear(startOfHookAddress);
+				if (nullptr == arenaStart)
+				{
+					MessageHandler::logError("Couldn't allocate memory for interceptor stubs near address %p.", (void*)startOfHookAddress);
+					return nullptr;
+				}
+				_stubArenas.push_back({ arenaStart, STUB_ARENA_SIZE, 0, false });
+				arena = _stubArenas.end() - 1;
+			}
+			stubAddress = arena->start + arena->used;
+			string errorDescription;
+			if (!InterceptorStubBuilder::buildStub(interceptor, startOfHookAddress, continueOffset, &g_controlBlock.cameraEnabled, hitCounter, reinterpret_cast<uintptr_t>(stubAddress), 
+												   stubCode, errorDescription))
+			{
+				MessageHandler::logError("Couldn't generate the interceptor stub for block %s: %s", interceptor.blockName, errorDescription.c_str());
+				return nullptr;
+			}
+			stubSize = ((stubCode.size() + pageSize - 1) / pageSize) * pageSize;
+			if (arena->used + stubSize <= arena->size)
+			{
+				break;
+			}
+			requiredSize = stubSize;
+		}
+		memcpy(stubAddress, stubCode.data(), stubCode.size());
+		DWORD previousProtection;
+		if (!VirtualProtect(stubAddress, stubSize, PAGE_EXECUTE_READ, &previousProtection))
+		{
+			MessageHandler::logError("Couldn't make the interceptor stub for block %s executable.", interceptor.blockName);
+			return nullptr;
+		}
+		FlushInstructionCache(GetCurrentProcess(), stubAddress, stubCode.size());
+		arena->used += stubSize;
+		arena->containsReplayedCall |= replaysCall(startOfHookAddress, continueOffset);
+		MessageHandler::logDebug("Interceptor stub for block %s generated at %p, %zu bytes.", interceptor.blockName, (void*)stubAddress, stubCode.size());
+		return stubAddress;
+	}
+
+
+	// Checks whether the code continuing at continueOffset after the hook at startOfHookAddress doesn't start in the middle of an instruction 
+	// and whether the hook doesn't overwrite more than the bytes up to continueOffset. If either is the case, the game will crash once the hook is hit
+	static bool isValidHookSpan(LPBYTE startOfHookAddress, DWORD continueOffset)
+	{
+		if (continueOffset < HOOK_SIZE)
+		{
+			MessageHandler::logError("Hook at address %p would overwrite %d bytes but continues at offset 0x%x. Hook not set.", (void*)startOfHookAddress, HOOK_SIZE, continueOffset);
+			return false;
 		}
+#ifdef _WIN64
+		if (!X64InstructionDecoder::isInstructionBoundary(startOfHookAddress, continueOffset + X64_MAX_INSTRUCTION_LENGTH, continueOffset))
+		{
+			MessageHandler::logError("Hook at address %p continues at offset 0x%x which isn't the start of an instruction. Hook not set.", (void*)startOfHookAddress, continueOffset);
+			return false;
+		}
+#endif
+		return true;
+	}
+
+
+	// Writes a jmp qword ptr [address] statement at startOfHookAddress for x64 and a jmp <relative address> for x86, jumping to target. Returns
+	// false if the jmp couldn't be written or added to the transaction of this thread.
+	static bool writeHookJump(LPBYTE startOfHookAddress, void* target)
+	{
 #ifdef _WIN64
 		// x64
-		uint8_t instruction[14];	// 6 bytes of the jmp qword ptr [0] and 8 bytes for the real address which is stored right after the 6 bytes of jmp qword ptr [0] bytes 
+		uint8_t instruction[HOOK_SIZE];	// 6 bytes of the jmp qword ptr [0] and 8 bytes for the real address which is stored right after the 6 bytes of jmp qword ptr [0] bytes 
 								// write bytes of jmp qword ptr [address], which is jmp qword ptr 0 offset.
 		memcpy(instruction, jmpFarInstructionBytes, sizeof(jmpFarInstructionBytes));
 		// now write the address. Do this with a recast of the pointer to an __int64 pointer to avoid endianmess.
 		__int64* targetAddressLocationInInstruction = (__int64*)(&instruction[6]);
-		__int64 targetAddress = (__int64)asmFunction;
+		__int64 targetAddress = (__int64)target;
 #else	
 		// x86
 		// we will write a jmp <relative address> as x86 doesn't have a jmp <absolute address>. 
-		// calculate this relative address by using Destination - Current, which is: &asmFunction - (<base> + startOffset + 5), as jmp <relative> is 5 bytes.
-		uint8_t instruction[5];
+		// calculate this relative address by using Destination - Current, which is: &target - (<hook address> + 5), as jmp <relative> is 5 bytes.
+		uint8_t instruction[HOOK_SIZE];
 		instruction[0] = 0xE9;	// JMP relative
-		DWORD targetAddress = (DWORD)asmFunction - (((DWORD)startOfHookAddress) + 5);
+		DWORD targetAddress = (DWORD)target - (((DWORD)startOfHookAddress) + 5);
 		DWORD* targetAddressLocationInInstruction = (DWORD*)&instruction[1];
 #endif
 		targetAddressLocationInInstruction[0] = targetAddress;	// write bytes this way to avoid endianess
-		SIZE_T noBytesWritten;
-		BOOL result = WriteProcessMemory(OpenProcess(PROCESS_VM_OPERATION | PROCESS_VM_WRITE, FALSE, GetCurrentProcessId()), startOfHookAddress, instruction, sizeof(instruction), &noBytesWritten);
-		if (result)
+		if (!writePatch(startOfHookAddress, instruction, sizeof(instruction)))
 		{
-			MessageHandler::logDebug("Hook set to address: %p", (void*)startOfHookAddress);
+			return false;
 		}
-		else
+		MessageHandler::logDebug(nullptr == _currentTransaction ? "Hook set to address: %p" : "Hook to address %p added to the transaction", (void*)startOfHookAddress);
+		return true;
+	}
+
+
+	// Sets a jmp qword ptr [address] statement at hostImageAddress + startOffset for x64 and a jmp <relative address> for x86. Returns false if
+	// the hook wasn't set. If a transaction was begun on this thread, true means the hook was added to it: it's set if the transaction commits.
+	bool setHook(LPBYTE hostImageAddress, DWORD startOffset, DWORD continueOffset, LPBYTE* interceptionContinue, void* asmFunction)
+	{
+		if (hostImageAddress == nullptr)
 		{
-			MessageHandler::logError("Couldn't write to process memory, so couldn't set hook. Error code: %010x", GetLastError());
+			return false;
 		}
+		LPBYTE startOfHookAddress = hostImageAddress + startOffset;
+		// interception continue isn't always specified, i.e. in the case of when the intercepted block by itself issues a ret.
+		if (nullptr != interceptionContinue)
+		{
+			if (!isValidHookSpan(startOfHookAddress, continueOffset))
+			{
+				return false;
+			}
+			*interceptionContinue = startOfHookAddress + continueOffset;
+		}
+		return writeHookJump(startOfHookAddress, asmFunction);
 	}
 	
 
 	// Sets a jmp qword ptr [address] statement at baseAddress + startOffset for x64 and a jmp <relative address> for x86
-	void setHook(AOBBlock* hookData, DWORD continueOffset, LPBYTE* interceptionContinue, void* asmFunction)
+	bool setHook(AOBBlock* hookData, DWORD continueOffset, LPBYTE* interceptionContinue, void* asmFunction)
+	{
+		return setHook(hookData->locationInImage(), hookData->customOffset(), continueOffset, interceptionContinue, asmFunction);
+	}
+
+
+	// Sets a jmp qword ptr [address] statement at baseAddress + startOffset for x64 and continues after the whole instructions the jmp overwrites. 
+	// Use this only if the asmFunction replicates exactly the instructions overwritten by the hook.
+	bool setHook(AOBBlock* hookData, LPBYTE* interceptionContinue, void* asmFunction)
+	{
+#ifdef _WIN64
+		LPBYTE startOfHookAddress = hookData->locationInImage() + hookData->customOffset();
+		int continueOffset = X64InstructionDecoder::determineInstructionSpan(startOfHookAddress, HOOK_SIZE + X64_MAX_INSTRUCTION_LENGTH, HOOK_SIZE);
+		if (continueOffset < 0)
+		{
+			MessageHandler::logError("Couldn't decode the instructions at address %p for block %s. Hook not set.", (void*)startOfHookAddress, hookData->blockName().c_str());
+			return false;
+		}
+#else
+		int continueOffset = HOOK_SIZE;
+#endif
+		return setHook(hookData, static_cast<DWORD>(continueOffset), interceptionContinue, asmFunction);
+	}
+
+
+	// Generates the stub of the interceptor described by interceptor and sets a jmp qword ptr [address] statement to it at baseAddress + startOffset.
+	// The stub continues at the continue offset of the interceptor, or after the whole instructions the jmp overwrites if that's 0. No asm 
+	// function is needed for such interceptors. Returns false if the hook wasn't set, e.g. because the stub couldn't be generated.
+	bool setHook(AOBBlock* hookData, const InterceptorDescriptor& interceptor)
 	{
-		setHook(hookData->locationInImage(), hookData->customOffset(), continueOffset, interceptionContinue, asmFunction);
+		if (nullptr == hookData->locationInImage())
+		{
+			return false;
+		}
+#ifdef _WIN64
+		LPBYTE startOfHookAddress = hookData->locationInImage() + hookData->customOffset();
+		int continueOffset = static_cast<int>(interceptor.continueOffset);
+		if (0 == continueOffset)
+		{
+			continueOffset = X64InstructionDecoder::determineInstructionSpan(startOfHookAddress, HOOK_SIZE + X64_MAX_INSTRUCTION_LENGTH, HOOK_SIZE);
+			if (continueOffset < 0)
+			{
+				MessageHandler::logError("Couldn't decode the instructions at address %p for block %s. Hook not set.", (void*)startOfHookAddress, hookData->blockName().c_str());
+				return false;
+			}
+		}
+		else if (!isValidHookSpan(startOfHookAddress, interceptor.continueOffset))
+		{
+			return false;
+		}
+		LPBYTE stubAddress = generateInterceptorStub(startOfHookAddress, static_cast<DWORD>(continueOffset), interceptor);
+		return nullptr != stubAddress && writeHookJump(startOfHookAddress, stubAddress);
+#else
+		MessageHandler::logError("Interceptor stubs are only generated for x64. Hook for block %s not set.", hookData->blockName().c_str());
+		return false;
+#endif
 	}
 
 
 	// Writes the bytes pointed at by bufferToWrite starting at address startAddress, for the length in 'length'.
 	void writeRange(LPBYTE startAddress, uint8_t* bufferToWrite, int length)
 	{
-		SIZE_T noBytesWritten;
-		WriteProcessMemory(OpenProcess(PROCESS_VM_OPERATION | PROCESS_VM_WRITE, FALSE, GetCurrentProcessId()), startAddress, bufferToWrite, length, &noBytesWritten);
+		if (length <= 0)
+		{
+			return;
+		}
+		writePatch(startAddress, bufferToWrite, length);
 	}
 
 
@@ -101,20 +621,13 @@ namespace IGCS::GameImageHooker
 	// Writes NOP opcodes to a range of memory.
 	void nopRange(LPBYTE startAddress, int length)
 	{
-		uint8_t* nopBuffer;
-		if (length < 0 || length>1024)
+		if (length <= 0 || length>1024)
 		{
 			// no can/wont do 
 			return;
 		}
-		nopBuffer = (uint8_t*)malloc(length * sizeof(uint8_t));
-		for (int i = 0; i < length; i++)
-		{
-			nopBuffer[i] = 0x90;
-		}
-		SIZE_T noBytesWritten;
-		WriteProcessMemory(OpenProcess(PROCESS_VM_OPERATION | PROCESS_VM_WRITE, FALSE, GetCurrentProcessId()), startAddress, nopBuffer, length, &noBytesWritten);
-		free(nopBuffer);
+		vector<uint8_t> nopBuffer(length, 0x90);
+		writePatch(startAddress, nopBuffer.data(), nopBuffer.size());
 	}
 
 
@@ -27,13 +27,22 @@
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma once
 #include "AOBBlock.h"
+#include "InterceptorStubBuilder.h"
 
 namespace IGCS::GameImageHooker
 {
+	void beginTransaction();
+	bool commitTransaction();
+	void uninstallAllHooks();
+	void forgetPatchesInRange(LPBYTE start, size_t size);
+	void releaseStubArenas();
+	void verifyHooks();
 	void nopRange(LPBYTE startAddress, int length);
 	void nopRange(AOBBlock* hookData, int length);
-	void setHook(LPBYTE hostImageAddress, DWORD startOffset, DWORD continueOffset, LPBYTE* interceptionContinue, void* asmFunction);
-	void setHook(AOBBlock* hookData, DWORD continueOffset, LPBYTE* interceptionContinue, void* asmFunction);
+	bool setHook(LPBYTE hostImageAddress, DWORD startOffset, DWORD continueOffset, LPBYTE* interceptionContinue, void* asmFunction);
+	bool setHook(AOBBlock* hookData, DWORD continueOffset, LPBYTE* interceptionContinue, void* asmFunction);
+	bool setHook(AOBBlock* hookData, LPBYTE* interceptionContinue, void* asmFunction);
+	bool setHook(AOBBlock* hookData, const InterceptorDescriptor& interceptor);
 	void writeRange(LPBYTE startAddress, uint8_t* bufferToWrite, int length);
 	void writeRange(AOBBlock* hookData, uint8_t* bufferToWrite, int length);
 }
@@ -30,22 +30,16 @@
 #include "GameConstants.h"
 
 //--------------------------------------------------------------------------------------------------------------------------------
-// data shared with asm functions. This is allocated here, 'C' style and not in some datastructure as passing that to 
-// MASM is rather tedious. 
+// data shared with asm functions and generated interceptor stubs. This is allocated here, 'C' style, so MASM can refer to it by name. 
 extern "C" {
-	uint8_t g_cameraEnabled = 0;
-	uint8_t g_wetness_OverrideParameters = 0;
-	float g_wetness_StreetWetnessFactor = 0.0f;
-	LPBYTE g_pmStructAddress = nullptr;
-	LPBYTE g_activeCamStructAddress = nullptr;
-	LPBYTE g_resolutionStructAddress = nullptr;
-	LPBYTE g_todStructAddress = nullptr;
-	LPBYTE g_playHudWidgetAddress = nullptr;
-	LPBYTE g_pmHudWidgetAddress = nullptr;
-	LPBYTE g_timestopStructAddress = nullptr;
-	LPBYTE g_weatherStructAddress = nullptr;
+	IGCS::ControlBlock g_controlBlock;
 }
 
+// The offsets of the fields used in Interceptor.asm.
+static_assert(offsetof(IGCS::ControlBlock, wetnessOverrideParameters) == 0x09, "Update CONTROLBLOCK_WETNESS_OVERRIDEPARAMETERS in Interceptor.asm");
+static_assert(offsetof(IGCS::ControlBlock, wetnessStreetWetnessFactor) == 0x0C, "Update CONTROLBLOCK_WETNESS_STREETWETNESSFACTOR in Interceptor.asm");
+static_assert(offsetof(IGCS::ControlBlock, weatherStructAddress) == 0x200, "Update CONTROLBLOCK_WEATHERSTRUCTADDRESS in Interceptor.asm");
+
 namespace IGCS
 {
 	Globals::Globals()
@@ -35,17 +35,52 @@
 #include <map>
 #include "Settings.h"
 
-extern "C" uint8_t g_cameraEnabled;
-extern "C" uint8_t g_wetness_OverrideParameters;
-extern "C" float g_wetness_StreetWetnessFactor;
-extern "C" LPBYTE g_pmStructAddress;
-extern "C" LPBYTE g_activeCamStructAddress;
-extern "C" LPBYTE g_resolutionStructAddress;
-extern "C" LPBYTE g_todStructAddress;
-extern "C" LPBYTE g_playHudWidgetAddress;
-extern "C" LPBYTE g_pmHudWidgetAddress;
-extern "C" LPBYTE g_timestopStructAddress;
-extern "C" LPBYTE g_weatherStructAddress;
+namespace IGCS
+{
+	// Bump when the layout of the ControlBlock changes. The offsets used in Interceptor.asm have to be updated with it.
+	#define IGCS_CONTROL_BLOCK_VERSION		1
+	#define IGCS_CACHE_LINE_SIZE			64
+
+	// The data shared between the system's threads, the generated interceptor stubs and the asm interceptors. The flags are written by the
+	// main thread and read by the interceptors. The addresses are written by the interceptors, on the game's threads and often several times
+	// per frame, and read by the main thread, so each of them has a cache line of its own and a write to one doesn't evict the lines the
+	// other threads read. The interceptors use plain movs, which are acquire loads and release stores on x64; the system's code has to use
+	// loadAcquire and storeRelease below so the compiler doesn't reorder or tear the accesses either.
+	struct alignas(IGCS_CACHE_LINE_SIZE) ControlBlock
+	{
+		uint32_t version = IGCS_CONTROL_BLOCK_VERSION;
+		uint32_t size = sizeof(ControlBlock);
+		// written by the main thread. The wetness override flag is stored after the factor, so an interceptor which sees the flag set sees the factor too.
+		uint8_t cameraEnabled = 0;
+		uint8_t wetnessOverrideParameters = 0;
+		float wetnessStreetWetnessFactor = 0.0f;
+		// written by the interceptors.
+		alignas(IGCS_CACHE_LINE_SIZE) LPBYTE activeCamStructAddress = nullptr;
+		alignas(IGCS_CACHE_LINE_SIZE) LPBYTE pmStructAddress = nullptr;
+		alignas(IGCS_CACHE_LINE_SIZE) LPBYTE resolutionStructAddress = nullptr;
+		alignas(IGCS_CACHE_LINE_SIZE) LPBYTE todStructAddress = nullptr;
+		alignas(IGCS_CACHE_LINE_SIZE) LPBYTE playHudWidgetAddress = nullptr;
+		alignas(IGCS_CACHE_LINE_SIZE) LPBYTE pmHudWidgetAddress = nullptr;
+		alignas(IGCS_CACHE_LINE_SIZE) LPBYTE timestopStructAddress = nullptr;
+		alignas(IGCS_CACHE_LINE_SIZE) LPBYTE weatherStructAddress = nullptr;
+	};
+
+
+	// Reads a value of the control block which is written by another thread.
+	template<typename T> T loadAcquire(const T& source)
+	{
+		return atomic_ref<T>(const_cast<T&>(source)).load(memory_order_acquire);
+	}
+
+
+	// Writes a value of the control block which is read by another thread.
+	template<typename T> void storeRelease(T& destination, T value)
+	{
+		atomic_ref<T>(destination).store(value, memory_order_release);
+	}
+}
+
+extern "C" IGCS::ControlBlock g_controlBlock;
 
 namespace IGCS
 {
@@ -73,6 +108,8 @@ namespace IGCS
 		bool keyboardMouseControlCamera() const { return _settings.cameraControlDevice == DEVICE_ID_KEYBOARD_MOUSE || _settings.cameraControlDevice == DEVICE_ID_ALL; }
 		bool controllerControlsCamera() const { return _settings.cameraControlDevice == DEVICE_ID_GAMEPAD || _settings.cameraControlDevice == DEVICE_ID_ALL; }
 		ActionData* getActionData(ActionType type);
+		bool isFeatureAvailable(FeatureType feature) const { return _featureAvailable[static_cast<int>(feature)]; }
+		void featureAvailable(FeatureType feature, bool value) { _featureAvailable[static_cast<int>(feature)] = value; }
 		void handleSettingMessage(uint8_t payload[], DWORD payloadLength);
 		void handleKeybindingMessage(uint8_t payload[], DWORD payloadLength);
 
@@ -86,5 +123,6 @@ namespace IGCS
 		Settings _settings;
 		map<ActionType, ActionData*> _keyBindingPerActionType;
 		bool _hudVisible = true;
+		atomic_bool _featureAvailable[static_cast<int>(FeatureType::Amount)] = {};		// set from the thread which hooks the non-critical blocks.
 	};
 }
\ No newline at end of file
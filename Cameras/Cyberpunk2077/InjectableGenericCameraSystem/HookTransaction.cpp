@@ -0,0 +1,290 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "HookTransaction.h"
+#include "MemorySource.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#ifdef _WIN32
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#include <windows.h>
+#endif
+#ifdef __linux__
+	#include <sys/mman.h>
+	#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace IGCS
+{
+	// A block of bytes to write over code.
+	struct CodeWrite
+	{
+		uint8_t* address;
+		const vector<uint8_t>* bytes;
+	};
+
+	static string formatError(const char* fmt, const void* address)
+	{
+		char buffer[256];
+		snprintf(buffer, sizeof(buffer), fmt, address);
+		return buffer;
+	}
+
+
+	// Writes the blocks specified. Every page the blocks touch is made writable first, and only if that succeeds for all pages the blocks are 
+	// written. Afterwards the protection of the pages is restored and the instruction cache is flushed once, over the range spanning all blocks.
+	// Returns false if nothing was written.
+	static bool writeCodeBlocks(CodePatchBackend& backend, const vector<CodeWrite>& writes, size_t& numberOfPages, string& errorDescription)
+	{
+		numberOfPages = 0;
+		if (writes.empty())
+		{
+			return true;
+		}
+		const uintptr_t pageMask = ~static_cast<uintptr_t>(backend.pageSize() - 1);
+		vector<uint8_t*> pages;
+		uint8_t* rangeStart = writes[0].address;
+		uint8_t* rangeEnd = writes[0].address;
+		for (auto& write : writes)
+		{
+			uint8_t* writeEnd = write.address + write.bytes->size();
+			for (uintptr_t page = reinterpret_cast<uintptr_t>(write.address) & pageMask; page < reinterpret_cast<uintptr_t>(writeEnd); page += backend.pageSize())
+			{
+				pages.push_back(reinterpret_cast<uint8_t*>(page));
+			}
+			rangeStart = min(rangeStart, write.address);
+			rangeEnd = max(rangeEnd, writeEnd);
+		}
+		sort(pages.begin(), pages.end());
+		pages.erase(unique(pages.begin(), pages.end()), pages.end());
+		vector<uint32_t> previousProtections(pages.size());
+		for (size_t i = 0; i < pages.size(); i++)
+		{
+			if (!backend.makePageWritable(pages[i], previousProtections[i]))
+			{
+				errorDescription = formatError("Couldn't make the page at %p writable.", pages[i]);
+				while (i-- > 0)
+				{
+					backend.restorePageProtection(pages[i], previousProtections[i]);
+				}
+				return false;
+			}
+		}
+		for (auto& write : writes)
+		{
+			memcpy(write.address, write.bytes->data(), write.bytes->size());
+		}
+		for (size_t i = 0; i < pages.size(); i++)
+		{
+			if (!backend.restorePageProtection(pages[i], previousProtections[i]))
+			{
+				// the code is written, so this isn't a failure of the write, but the page stays writable.
+				errorDescription = formatError("Couldn't restore the protection of the page at %p.", pages[i]);
+			}
+		}
+		backend.flushInstructionCache(rangeStart, rangeEnd - rangeStart);
+		numberOfPages = pages.size();
+		return true;
+	}
+
+
+	HookTransaction::HookTransaction(CodePatchBackend& backend) : _backend(backend), _numberOfPages(0), _isApplied(false), _isCommitted(false)
+	{
+	}
+
+
+	// A transaction which was applied but not committed is rolled back.
+	HookTransaction::~HookTransaction()
+	{
+		if (_isApplied && !_isCommitted)
+		{
+			rollback();
+		}
+	}
+
+
+	// Adds a patch which writes the bytes specified at address. Returns false if the transaction was already applied or if the patch overlaps
+	// a patch added before, as the original bytes of the second patch would be the bytes of the first one.
+	bool HookTransaction::addPatch(uint8_t* address, const uint8_t* bytes, size_t length)
+	{
+		if (_isApplied || nullptr == address || 0 == length)
+		{
+			return false;
+		}
+		for (auto& patch : _patches)
+		{
+			if (address < patch.address + patch.patchedBytes.size() && patch.address < address + length)
+			{
+				_errorDescription = formatError("The patch at %p overlaps another patch in the same transaction.", address);
+				return false;
+			}
+		}
+		_patches.push_back({ address, vector<uint8_t>(bytes, bytes + length), vector<uint8_t>() });
+		return true;
+	}
+
+
+	// Saves the original bytes of all patches and writes the patches. Returns false if the patches couldn't be written, in which case none of
+	// them was.
+	bool HookTransaction::apply()
+	{
+		if (_isApplied)
+		{
+			return true;
+		}
+		vector<CodeWrite> writes;
+		for (auto& patch : _patches)
+		{
+			patch.originalBytes.assign(patch.address, patch.address + patch.patchedBytes.size());
+			writes.push_back({ patch.address, &patch.patchedBytes });
+		}
+		_isApplied = writeCodeBlocks(_backend, writes, _numberOfPages, _errorDescription);
+		return _isApplied;
+	}
+
+
+	// Keeps the applied patches. Afterwards they can only be undone with uninstallCodePatches.
+	void HookTransaction::commit()
+	{
+		_isCommitted = _isApplied;
+	}
+
+
+	// Restores the original bytes of all patches if the transaction was applied but not committed.
+	bool HookTransaction::rollback()
+	{
+		if (!_isApplied || _isCommitted)
+		{
+			return false;
+		}
+		vector<CodeWrite> writes;
+		for (auto& patch : _patches)
+		{
+			writes.push_back({ patch.address, &patch.originalBytes });
+		}
+		size_t numberOfPages = 0;
+		if (!writeCodeBlocks(_backend, writes, numberOfPages, _errorDescription))
+		{
+			return false;
+		}
+		_isApplied = false;
+		return true;
+	}
+
+
+	// Restores the original bytes of the committed patches specified, in one write. A patch whose bytes were changed after it was applied, e.g.
+	// by another tool, is skipped, as restoring it would break the other change. Returns the number of patches restored.
+	size_t uninstallCodePatches(CodePatchBackend& backend, const vector<CodePatch>& patches, size_t& numberOfPatchesSkipped)
+	{
+		numberOfPatchesSkipped = 0;
+		vector<CodeWrite> writes;
+		for (auto& patch : patches)
+		{
+			if (0 != memcmp(patch.address, patch.patchedBytes.data(), patch.patchedBytes.size()))
+			{
+				numberOfPatchesSkipped++;
+				continue;
+			}
+			writes.push_back({ patch.address, &patch.originalBytes });
+		}
+		size_t numberOfPages = 0;
+		string errorDescription;
+		return writeCodeBlocks(backend, writes, numberOfPages, errorDescription) ? writes.size() : 0;
+	}
+
+
+#ifdef _WIN32
+	size_t VirtualProtectPatchBackend::pageSize() const
+	{
+		SYSTEM_INFO systemInfo;
+		GetSystemInfo(&systemInfo);
+		return systemInfo.dwPageSize;
+	}
+
+
+	bool VirtualProtectPatchBackend::makePageWritable(uint8_t* pageStart, uint32_t& previousProtection)
+	{
+		DWORD protection = 0;
+		if (!VirtualProtect(pageStart, pageSize(), PAGE_EXECUTE_READWRITE, &protection))
+		{
+			return false;
+		}
+		previousProtection = protection;
+		return true;
+	}
+
+
+	bool VirtualProtectPatchBackend::restorePageProtection(uint8_t* pageStart, uint32_t previousProtection)
+	{
+		DWORD protection = 0;
+		return VirtualProtect(pageStart, pageSize(), previousProtection, &protection);
+	}
+
+
+	void VirtualProtectPatchBackend::flushInstructionCache(const uint8_t* start, size_t size)
+	{
+		FlushInstructionCache(GetCurrentProcess(), start, size);
+	}
+#endif
+
+
+#ifdef __linux__
+	size_t MprotectPatchBackend::pageSize() const
+	{
+		return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	}
+
+
+	bool MprotectPatchBackend::makePageWritable(uint8_t* pageStart, uint32_t& previousProtection)
+	{
+		vector<MemoryRegion> regions;
+		if (!ProcMapsMemorySource().enumerateRegions(pageStart, pageSize(), regions) || regions.size() != 1 || regions[0].start != pageStart)
+		{
+			return false;
+		}
+		previousProtection = (regions[0].isReadable ? PROT_READ : 0) | (regions[0].isWritable ? PROT_WRITE : 0) | (regions[0].isExecutable ? PROT_EXEC : 0);
+		return 0 == mprotect(pageStart, pageSize(), PROT_READ | PROT_WRITE | PROT_EXEC);
+	}
+
+
+	bool MprotectPatchBackend::restorePageProtection(uint8_t* pageStart, uint32_t previousProtection)
+	{
+		return 0 == mprotect(pageStart, pageSize(), static_cast<int>(previousProtection));
+	}
+
+
+	void MprotectPatchBackend::flushInstructionCache(const uint8_t* start, size_t size)
+	{
+		__builtin___clear_cache(reinterpret_cast<char*>(const_cast<uint8_t*>(start)), reinterpret_cast<char*>(const_cast<uint8_t*>(start + size)));
+	}
+#endif
+}
@@ -0,0 +1,112 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace IGCS
+{
+	// The platform operations needed to patch code: making pages writable and back, and flushing the instruction cache. Pluggable, so the
+	// transaction logic doesn't depend on windows and can be used and checked outside the camera dll too.
+	class CodePatchBackend
+	{
+	public:
+		virtual ~CodePatchBackend() {}
+
+		virtual size_t pageSize() const = 0;
+		// Makes the page at pageStart writable and returns its previous protection in previousProtection.
+		virtual bool makePageWritable(uint8_t* pageStart, uint32_t& previousProtection) = 0;
+		virtual bool restorePageProtection(uint8_t* pageStart, uint32_t previousProtection) = 0;
+		virtual void flushInstructionCache(const uint8_t* start, size_t size) = 0;
+	};
+
+#ifdef _WIN32
+	// Patches code in the current process with VirtualProtect.
+	class VirtualProtectPatchBackend : public CodePatchBackend
+	{
+	public:
+		size_t pageSize() const override;
+		bool makePageWritable(uint8_t* pageStart, uint32_t& previousProtection) override;
+		bool restorePageProtection(uint8_t* pageStart, uint32_t previousProtection) override;
+		void flushInstructionCache(const uint8_t* start, size_t size) override;
+	};
+#endif
+
+#ifdef __linux__
+	// Patches code in the current process with mprotect, the previous protection is read from /proc/self/maps. Used to check the transaction
+	// logic on a scratch code page on Linux.
+	class MprotectPatchBackend : public CodePatchBackend
+	{
+	public:
+		size_t pageSize() const override;
+		bool makePageWritable(uint8_t* pageStart, uint32_t& previousProtection) override;
+		bool restorePageProtection(uint8_t* pageStart, uint32_t previousProtection) override;
+		void flushInstructionCache(const uint8_t* start, size_t size) override;
+	};
+#endif
+
+	// A patch of code: the bytes written at address and the bytes which were there before.
+	struct CodePatch
+	{
+		uint8_t* address;
+		std::vector<uint8_t> patchedBytes;
+		std::vector<uint8_t> originalBytes;
+	};
+
+	// Applies a set of code patches, e.g. the hooks of a game, as a unit. All pages touched are made writable first, one protection change per
+	// page, and only if that succeeded for every page the patches are written, after which the protection of every page is restored and the
+	// instruction cache is flushed once. So either all patches are applied or none. The original bytes are saved when the patches are applied,
+	// so they can be rolled back, and after a commit, uninstalled with uninstallCodePatches.
+	class HookTransaction
+	{
+	public:
+		explicit HookTransaction(CodePatchBackend& backend);
+		~HookTransaction();
+
+		bool addPatch(uint8_t* address, const uint8_t* bytes, size_t length);
+		bool apply();
+		void commit();
+		bool rollback();
+		size_t numberOfPatches() const { return _patches.size(); }
+		size_t numberOfPages() const { return _numberOfPages; }
+		const std::vector<CodePatch>& patches() const { return _patches; }
+		const std::string& errorDescription() const { return _errorDescription; }
+
+	private:
+		CodePatchBackend& _backend;
+		std::vector<CodePatch> _patches;
+		size_t _numberOfPages;
+		bool _isApplied;
+		bool _isCommitted;
+		std::string _errorDescription;
+	};
+
+	size_t uninstallCodePatches(CodePatchBackend& backend, const std::vector<CodePatch>& patches, size_t& numberOfPatchesSkipped);
+}
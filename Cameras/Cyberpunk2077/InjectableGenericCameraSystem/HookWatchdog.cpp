@@ -0,0 +1,127 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "HookWatchdog.h"
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__x86_64__)
+	// SSE2 is part of x64, so no cpu check is needed.
+	#define IGCS_HOOK_WATCHDOG_SIMD_SUPPORTED
+	#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace IGCS
+{
+	// Replaces the sites watched with the sites specified: the patched bytes of each site are expected at its address.
+	void HookWatchdog::watch(const vector<CodePatch>& sites)
+	{
+		_sites = sites;
+		_laneAddresses.clear();
+		_laneSites.clear();
+		_expectedBytes.clear();
+		_laneMasks.clear();
+		for (size_t siteIndex = 0; siteIndex < _sites.size(); siteIndex++)
+		{
+			const CodePatch& site = _sites[siteIndex];
+			const size_t siteLength = site.patchedBytes.size();
+			for (size_t offset = 0; offset < siteLength; offset += HOOK_WATCHDOG_LANE_SIZE)
+			{
+				// a lane with less than 16 bytes of the site left ends at the end of the site.
+				const size_t bytesInLane = min(siteLength - offset, static_cast<size_t>(HOOK_WATCHDOG_LANE_SIZE));
+				const ptrdiff_t laneStart = static_cast<ptrdiff_t>(offset + bytesInLane) - HOOK_WATCHDOG_LANE_SIZE;
+				_laneAddresses.push_back(site.address + laneStart);
+				_laneSites.push_back(siteIndex);
+				for (ptrdiff_t i = 0; i < HOOK_WATCHDOG_LANE_SIZE; i++)
+				{
+					const bool isSiteByte = laneStart + i >= static_cast<ptrdiff_t>(offset);
+					_expectedBytes.push_back(isSiteByte ? site.patchedBytes[laneStart + i] : 0);
+					_laneMasks.push_back(isSiteByte ? 0xFF : 0);
+				}
+			}
+		}
+	}
+
+
+	// Returns true if all sites still contain the bytes we wrote. The differences of all lanes are or-ed together, so the pass has no 
+	// branches except the loop.
+	bool HookWatchdog::verify() const
+	{
+#ifdef IGCS_HOOK_WATCHDOG_SIMD_SUPPORTED
+		__m128i differences = _mm_setzero_si128();
+		for (size_t lane = 0; lane < _laneAddresses.size(); lane++)
+		{
+			const __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_laneAddresses[lane]));
+			const __m128i expected = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_expectedBytes.data() + lane * HOOK_WATCHDOG_LANE_SIZE));
+			const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_laneMasks.data() + lane * HOOK_WATCHDOG_LANE_SIZE));
+			differences = _mm_or_si128(differences, _mm_and_si128(_mm_xor_si128(current, expected), mask));
+		}
+		return _mm_movemask_epi8(_mm_cmpeq_epi8(differences, _mm_setzero_si128())) == 0xFFFF;
+#else
+		uint8_t differences = 0;
+		for (size_t lane = 0; lane < _laneAddresses.size(); lane++)
+		{
+			for (size_t i = 0; i < HOOK_WATCHDOG_LANE_SIZE; i++)
+			{
+				const size_t index = lane * HOOK_WATCHDOG_LANE_SIZE + i;
+				differences |= (_laneAddresses[lane][i] ^ _expectedBytes[index]) & _laneMasks[index];
+			}
+		}
+		return differences == 0;
+#endif
+	}
+
+
+	// Returns the indices of the sites which don't contain the bytes we wrote anymore. Only needed after verify failed.
+	vector<size_t> HookWatchdog::determineTamperedSites() const
+	{
+		vector<size_t> toReturn;
+		for (size_t lane = 0; lane < _laneAddresses.size(); lane++)
+		{
+			if (!isLaneIntact(lane) && (toReturn.empty() || toReturn.back() != _laneSites[lane]))
+			{
+				toReturn.push_back(_laneSites[lane]);
+			}
+		}
+		return toReturn;
+	}
+
+
+	bool HookWatchdog::isLaneIntact(size_t lane) const
+	{
+		for (size_t i = 0; i < HOOK_WATCHDOG_LANE_SIZE; i++)
+		{
+			const size_t index = lane * HOOK_WATCHDOG_LANE_SIZE + i;
+			if (((_laneAddresses[lane][i] ^ _expectedBytes[index]) & _laneMasks[index]) != 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
@@ -0,0 +1,63 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include "HookTransaction.h"
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace IGCS
+{
+	// The number of bytes of a site verified per lane.
+	#define HOOK_WATCHDOG_LANE_SIZE		16
+
+	// Verifies that the code sites we patched still contain the bytes we wrote, so hooks overwritten by e.g. an overlay are noticed. The 
+	// sites are kept in a compact table of 16 byte lanes, each with the address to read, the expected bytes and a mask of the bytes which 
+	// belong to the site, so all sites are verified in a single pass without branches per site. A lane of a site shorter than 16 bytes 
+	// ends at the end of the site and also reads the bytes before it, which are masked out: these are code of the same image, so they're
+	// readable. Doesn't depend on windows headers, so it can be used and checked outside the camera dll too.
+	class HookWatchdog
+	{
+	public:
+		void watch(const std::vector<CodePatch>& sites);
+		bool verify() const;
+		std::vector<size_t> determineTamperedSites() const;
+		size_t numberOfSites() const { return _sites.size(); }
+		size_t numberOfLanes() const { return _laneAddresses.size(); }
+		const CodePatch& site(size_t index) const { return _sites[index]; }
+
+	private:
+		bool isLaneIntact(size_t lane) const;
+
+		std::vector<CodePatch> _sites;
+		std::vector<const uint8_t*> _laneAddresses;
+		std::vector<size_t> _laneSites;			// the index of the site of each lane.
+		std::vector<uint8_t> _expectedBytes;	// HOOK_WATCHDOG_LANE_SIZE per lane.
+		std::vector<uint8_t> _laneMasks;		// HOOK_WATCHDOG_LANE_SIZE per lane, 0xFF for the bytes of the site.
+	};
+}
@@ -0,0 +1,252 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "ImageIndex.h"
+#include "AOBPatternSearch.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+using namespace std;
+
+namespace IGCS
+{
+	static inline uint32_t bucketOfGram(const uint8_t* gramStart)
+	{
+		uint32_t gram;
+		memcpy(&gram, gramStart, sizeof(gram));
+		return (gram * 0x9E3779B1u) >> (32 - IMAGE_INDEX_BUCKET_BITS);
+	}
+
+
+	ImageIndex::ImageIndex() : _base(nullptr)
+	{
+	}
+
+
+	ImageIndex::~ImageIndex()
+	= default;
+
+
+	// Builds the index over the ranges specified. Two passes over the ranges: the first counts the grams per bucket, the second stores the 
+	// positions, so the posting lists are one contiguous array without per-bucket allocations.
+	void ImageIndex::build(const vector<AOBScanRange>& rangesToIndex)
+	{
+		_ranges.clear();
+		for (auto& range : rangesToIndex)
+		{
+			if (nullptr != range.start && range.size > 0)
+			{
+				_ranges.push_back(range);
+			}
+		}
+		sort(_ranges.begin(), _ranges.end(), [](const AOBScanRange& a, const AOBScanRange& b) { return a.start < b.start; });
+		_base = _ranges.empty() ? nullptr : _ranges.front().start;
+		// positions are 32 bit offsets from the first range, ranges beyond that can't be indexed. An image is smaller than 4GB so this won't happen.
+		_ranges.erase(remove_if(_ranges.begin(), _ranges.end(), [this](const AOBScanRange& range)
+					  {
+						  return static_cast<size_t>(range.start - _base) + range.size > numeric_limits<uint32_t>::max();
+					  }), _ranges.end());
+
+		_bucketStarts.assign(IMAGE_INDEX_NUMBER_OF_BUCKETS + 1, 0);
+		for (auto& range : _ranges)
+		{
+			const size_t rangeStartOffset = static_cast<size_t>(range.start - _base);
+			const size_t rangeEndOffset = rangeStartOffset + range.size;
+			for (size_t offset = (rangeStartOffset + IMAGE_INDEX_SAMPLE_STRIDE - 1) / IMAGE_INDEX_SAMPLE_STRIDE * IMAGE_INDEX_SAMPLE_STRIDE; 
+				 offset + IMAGE_INDEX_GRAM_SIZE <= rangeEndOffset; offset += IMAGE_INDEX_SAMPLE_STRIDE)
+			{
+				_bucketStarts[bucketOfGram(_base + offset) + 1]++;
+			}
+		}
+		for (size_t bucket = 1; bucket < _bucketStarts.size(); bucket++)
+		{
+			_bucketStarts[bucket] += _bucketStarts[bucket - 1];
+		}
+		_positions.assign(_bucketStarts.back(), 0);
+		vector<uint32_t> nextPositionInBucket(_bucketStarts.begin(), _bucketStarts.end() - 1);
+		for (auto& range : _ranges)
+		{
+			const size_t rangeStartOffset = static_cast<size_t>(range.start - _base);
+			const size_t rangeEndOffset = rangeStartOffset + range.size;
+			for (size_t offset = (rangeStartOffset + IMAGE_INDEX_SAMPLE_STRIDE - 1) / IMAGE_INDEX_SAMPLE_STRIDE * IMAGE_INDEX_SAMPLE_STRIDE; 
+				 offset + IMAGE_INDEX_GRAM_SIZE <= rangeEndOffset; offset += IMAGE_INDEX_SAMPLE_STRIDE)
+			{
+				_positions[nextPositionInBucket[bucketOfGram(_base + offset)]++] = static_cast<uint32_t>(offset);
+			}
+		}
+	}
+
+
+	// Finds all matches of the pattern specified. A match has its non-wildcard run at some offset in the image, and exactly one of the 
+	// IMAGE_INDEX_SAMPLE_STRIDE alignments of the run has its grams sampled for that match. So per alignment the gram with the smallest
+	// posting list is looked up, and every match is found exactly once.
+	void ImageIndex::findAll(const ScanPattern& pattern, ImageIndexQueryResult& result) const
+	{
+		result.locations.clear();
+		result.usedIndex = false;
+		result.numberOfCandidates = 0;
+		if (!pattern.isValid() || _ranges.empty())
+		{
+			return;
+		}
+		const uint8_t* bytePattern = pattern.bytePattern();
+		const uint8_t* patternMask = pattern.patternMask();
+		int longestRunStart = 0;
+		int longestRunLength = 0;
+		for (int i = 0; i < pattern.patternSize();)
+		{
+			if (patternMask[i] != 0xFF)
+			{
+				i++;
+				continue;
+			}
+			int runLength = 0;
+			while (i + runLength < pattern.patternSize() && patternMask[i + runLength] == 0xFF)
+			{
+				runLength++;
+			}
+			if (runLength > longestRunLength)
+			{
+				longestRunStart = i;
+				longestRunLength = runLength;
+			}
+			i += runLength;
+		}
+		if (longestRunLength < IMAGE_INDEX_MIN_RUN_LENGTH)
+		{
+			findAllByScanning(_ranges, pattern, result.locations);
+			return;
+		}
+		result.usedIndex = true;
+		for (int alignment = 0; alignment < IMAGE_INDEX_SAMPLE_STRIDE; alignment++)
+		{
+			int gramOffset = -1;
+			uint32_t gramBucket = 0;
+			uint32_t smallestBucketSize = numeric_limits<uint32_t>::max();
+			for (int offset = longestRunStart + alignment; offset + IMAGE_INDEX_GRAM_SIZE <= longestRunStart + longestRunLength; offset += IMAGE_INDEX_SAMPLE_STRIDE)
+			{
+				const uint32_t bucket = bucketOfGram(bytePattern + offset);
+				const uint32_t bucketSize = _bucketStarts[bucket + 1] - _bucketStarts[bucket];
+				if (bucketSize < smallestBucketSize)
+				{
+					gramOffset = offset;
+					gramBucket = bucket;
+					smallestBucketSize = bucketSize;
+				}
+			}
+			for (uint32_t i = _bucketStarts[gramBucket]; i < _bucketStarts[gramBucket + 1]; i++)
+			{
+				const uint32_t gramPosition = _positions[i];
+				if (gramPosition < static_cast<uint32_t>(gramOffset))
+				{
+					continue;
+				}
+				const uint8_t* candidate = _base + (gramPosition - gramOffset);
+				result.numberOfCandidates++;
+				if (nullptr != findContainingRange(candidate, pattern.patternSize()) && pattern.matchesAt(candidate))
+				{
+					result.locations.push_back(candidate);
+				}
+			}
+		}
+		sort(result.locations.begin(), result.locations.end());
+	}
+
+
+	size_t ImageIndex::memoryUsageInBytes() const
+	{
+		return sizeof(ImageIndex) + _ranges.capacity() * sizeof(AOBScanRange) + _bucketStarts.capacity() * sizeof(uint32_t) + _positions.capacity() * sizeof(uint32_t);
+	}
+
+
+	size_t ImageIndex::numberOfIndexedBytes() const
+	{
+		size_t toReturn = 0;
+		for (auto& range : _ranges)
+		{
+			toReturn += range.size;
+		}
+		return toReturn;
+	}
+
+
+	// Finds all matches of the pattern specified by scanning the ranges, for patterns which can't be looked up in the index or when there's
+	// no index.
+	void ImageIndex::findAllByScanning(const vector<AOBScanRange>& rangesToScan, const ScanPattern& pattern, vector<const uint8_t*>& locations)
+	{
+		locations.clear();
+		if (!pattern.isValid())
+		{
+			return;
+		}
+		const AOBScanRange* largestRange = nullptr;
+		for (auto& range : rangesToScan)
+		{
+			if (nullptr == largestRange || range.size > largestRange->size)
+			{
+				largestRange = &range;
+			}
+		}
+		if (nullptr == largestRange)
+		{
+			return;
+		}
+		ByteFrequencyTable frequencies;
+		frequencies.buildFromImage(largestRange->start, largestRange->size);
+		const AOBPatternSearch::PreparedPattern preparedPattern = AOBPatternSearch::preparePattern(pattern, frequencies);
+		for (auto& range : rangesToScan)
+		{
+			const uint8_t* rangeEnd = range.start + range.size;
+			const uint8_t* current = range.start;
+			while (current < rangeEnd)
+			{
+				const uint8_t* location = AOBPatternSearch::findPattern(current, rangeEnd, preparedPattern);
+				if (nullptr == location)
+				{
+					break;
+				}
+				locations.push_back(location);
+				current = location + 1;
+			}
+		}
+		sort(locations.begin(), locations.end());
+	}
+
+
+	// Returns the range which contains length bytes starting at location, or nullptr if there's none.
+	const AOBScanRange* ImageIndex::findContainingRange(const uint8_t* location, size_t length) const
+	{
+		auto rangeAfter = upper_bound(_ranges.begin(), _ranges.end(), location, [](const uint8_t* toFind, const AOBScanRange& range) { return toFind < range.start; });
+		if (rangeAfter == _ranges.begin())
+		{
+			return nullptr;
+		}
+		const AOBScanRange& range = *(rangeAfter - 1);
+		return (location + length <= range.start + range.size) ? &range : nullptr;
+	}
+}
@@ -0,0 +1,78 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "AOBScanEngine.h"
+#include "ScanPattern.h"
+
+namespace IGCS
+{
+	#define IMAGE_INDEX_GRAM_SIZE				4			// in bytes
+	#define IMAGE_INDEX_SAMPLE_STRIDE			4			// only grams starting at a multiple of this are indexed
+	#define IMAGE_INDEX_BUCKET_BITS				20
+	#define IMAGE_INDEX_NUMBER_OF_BUCKETS		(1 << IMAGE_INDEX_BUCKET_BITS)
+	// A pattern needs a run of this many non-wildcard bytes to be looked up in the index, as only then one of its grams is always sampled.
+	#define IMAGE_INDEX_MIN_RUN_LENGTH			(IMAGE_INDEX_GRAM_SIZE + IMAGE_INDEX_SAMPLE_STRIDE - 1)
+
+	struct ImageIndexQueryResult
+	{
+		std::vector<const uint8_t*> locations;		// start of every match, ascending
+		bool usedIndex = false;						// false if the pattern had no run long enough and the ranges were scanned instead
+		size_t numberOfCandidates = 0;				// locations verified against the complete pattern
+	};
+
+	// Compact index over a set of memory ranges, e.g. the executable sections of the host image, to find all matches of an ad-hoc pattern
+	// without scanning the ranges. The index is a posting list of the 4-byte grams starting at every 4th byte, bucketed on a hash of the
+	// gram. A query picks the smallest bucket for each of the 4 alignments of the longest non-wildcard run of the pattern and verifies the
+	// complete pattern only at the locations in those buckets. The ranges aren't copied, they have to stay readable while the index is used.
+	// Built once, after which it's read-only and can be queried from multiple threads.
+	class ImageIndex
+	{
+	public:
+		ImageIndex();
+		~ImageIndex();
+
+		void build(const std::vector<AOBScanRange>& rangesToIndex);
+		void findAll(const ScanPattern& pattern, ImageIndexQueryResult& result) const;
+		size_t memoryUsageInBytes() const;
+		size_t numberOfIndexedGrams() const { return _positions.size(); }
+		size_t numberOfIndexedBytes() const;
+
+		static void findAllByScanning(const std::vector<AOBScanRange>& rangesToScan, const ScanPattern& pattern, std::vector<const uint8_t*>& locations);
+
+	private:
+		const AOBScanRange* findContainingRange(const uint8_t* location, size_t length) const;
+
+		std::vector<AOBScanRange> _ranges;			// sorted on start
+		const uint8_t* _base;						// start of the first range, positions are offsets from this address
+		std::vector<uint32_t> _bucketStarts;		// index in _positions of the first position of each bucket, plus one past the last bucket
+		std::vector<uint32_t> _positions;
+	};
+}
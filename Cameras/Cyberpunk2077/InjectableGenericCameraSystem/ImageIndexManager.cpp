@@ -0,0 +1,210 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+#include "ImageIndexManager.h"
+#include "MessageHandler.h"
+#include "NamedPipeManager.h"
+#include "Utils.h"
+#include <chrono>
+
+using namespace std;
+
+namespace IGCS
+{
+	#define IMAGE_INDEX_MAX_REPORTED_LOCATIONS		32
+
+	ImageIndexManager::ImageIndexManager() : _hostImageAddress(nullptr), _hostImageSize(0), _isBuilding(false)
+	{
+	}
+
+
+	ImageIndexManager::~ImageIndexManager()
+	{
+		if (_buildThread.joinable())
+		{
+			_buildThread.join();
+		}
+	}
+
+
+	ImageIndexManager& ImageIndexManager::instance()
+	{
+		static ImageIndexManager theInstance;
+		return theInstance;
+	}
+
+
+	void ImageIndexManager::initialize(LPBYTE hostImageAddress, DWORD hostImageSize)
+	{
+		_hostImageAddress = hostImageAddress;
+		_hostImageSize = hostImageSize;
+	}
+
+
+	// Builds the index on the calling thread. If a build is already running or the index is already there, nothing is done.
+	void ImageIndexManager::buildIndex()
+	{
+		{
+			lock_guard<mutex> lock(_indexMutex);
+			if (_isBuilding || nullptr != _index || nullptr == _hostImageAddress)
+			{
+				return;
+			}
+			_isBuilding = true;
+		}
+		reportState(ImageIndexState::Building, nullptr);
+		const auto buildStartTime = chrono::steady_clock::now();
+		auto newIndex = make_shared<ImageIndex>();
+		newIndex->build(Utils::determineScanRanges(_hostImageAddress, _hostImageSize, false));
+		const double buildTimeInMs = chrono::duration<double, milli>(chrono::steady_clock::now() - buildStartTime).count();
+		{
+			lock_guard<mutex> lock(_indexMutex);
+			_index = newIndex;
+			_isBuilding = false;
+		}
+		MessageHandler::logLine("Image index built in %.0fms: %zu grams over %zu bytes of code, using %.1f MB of memory.", buildTimeInMs, 
+								newIndex->numberOfIndexedGrams(), newIndex->numberOfIndexedBytes(), newIndex->memoryUsageInBytes() / (1024.0 * 1024.0));
+		reportState(ImageIndexState::Built, newIndex.get());
+	}
+
+
+	// Starts the build of the index on a background thread. If a build is already running or the index is already there, its state is reported
+	// again, so a client which connected later is in sync.
+	void ImageIndexManager::buildIndexInBackground()
+	{
+		lock_guard<mutex> lock(_indexMutex);
+		if (_isBuilding || nullptr != _index)
+		{
+			reportState(_isBuilding ? ImageIndexState::Building : ImageIndexState::Built, _index.get());
+			return;
+		}
+		if (_buildThread.joinable())
+		{
+			// previous build is done, as _isBuilding is false.
+			_buildThread.join();
+		}
+		_buildThread = thread([this] { buildIndex(); });
+	}
+
+
+	// Waits for a build running in the background and discards the index. Called when the dll is unloaded, after the named pipe listener has
+	// been stopped, so no new build is started.
+	void ImageIndexManager::stop()
+	{
+		thread buildThread;
+		{
+			lock_guard<mutex> lock(_indexMutex);
+			buildThread.swap(_buildThread);
+		}
+		if (buildThread.joinable())
+		{
+			buildThread.join();
+		}
+		lock_guard<mutex> lock(_indexMutex);
+		_index.reset();
+	}
+
+
+	void ImageIndexManager::discardIndex()
+	{
+		shared_ptr<const ImageIndex> toDiscard;
+		{
+			lock_guard<mutex> lock(_indexMutex);
+			toDiscard.swap(_index);
+		}
+		reportState(ImageIndexState::NotBuilt, nullptr);
+		if (nullptr == toDiscard)
+		{
+			MessageHandler::logLine("There's no image index to discard.");
+			return;
+		}
+		// the memory is released when the last query which still uses it is done.
+		MessageHandler::logLine("Image index discarded, %.1f MB of memory released.", toDiscard->memoryUsageInBytes() / (1024.0 * 1024.0));
+	}
+
+
+	// Finds all locations of the pattern specified, in the form "aa bb ?? cc", in the code of the host image and reports them, as offsets
+	// from the image start, to the client.
+	void ImageIndexManager::queryPattern(const string& patternAsString)
+	{
+		const ScanPattern pattern(patternAsString, 1);
+		if (!pattern.isValid())
+		{
+			MessageHandler::logError("The pattern '%s' is malformed.", patternAsString.c_str());
+			return;
+		}
+		const auto queryStartTime = chrono::steady_clock::now();
+		ImageIndexQueryResult result;
+		auto index = obtainIndex();
+		if (nullptr == index)
+		{
+			ImageIndex::findAllByScanning(Utils::determineScanRanges(_hostImageAddress, _hostImageSize, false), pattern, result.locations);
+		}
+		else
+		{
+			index->findAll(pattern, result);
+		}
+		const double queryTimeInMs = chrono::duration<double, milli>(chrono::steady_clock::now() - queryStartTime).count();
+		const ImageIndexQueryMethod method = nullptr == index ? ImageIndexQueryMethod::ScanIndexNotBuilt 
+															  : (result.usedIndex ? ImageIndexQueryMethod::Index : ImageIndexQueryMethod::ScanTooFewConsecutiveBytes);
+		const char* howFound = nullptr == index ? "image scan, index isn't built yet" : (result.usedIndex ? "index" : "image scan, pattern has too few consecutive non-wildcard bytes");
+		vector<uint64_t> offsetsToReport;
+		for (size_t i = 0; i < result.locations.size() && i < IMAGE_INDEX_MAX_REPORTED_LOCATIONS; i++)
+		{
+			offsetsToReport.push_back(static_cast<uint64_t>(result.locations[i] - _hostImageAddress));
+		}
+		NamedPipeManager::instance().writeImageIndexQueryResult(result.locations.size(), queryTimeInMs, method, offsetsToReport);
+		MessageHandler::logLine("Pattern '%s': %zu location(s) found in %.3fms (%s).", patternAsString.c_str(), result.locations.size(), queryTimeInMs, howFound);
+		for (auto offset : offsetsToReport)
+		{
+			MessageHandler::logLine("    +0x%llX", static_cast<unsigned long long>(offset));
+		}
+		if (result.locations.size() > IMAGE_INDEX_MAX_REPORTED_LOCATIONS)
+		{
+			MessageHandler::logLine("    ... and %zu more.", result.locations.size() - IMAGE_INDEX_MAX_REPORTED_LOCATIONS);
+		}
+		if (nullptr == index)
+		{
+			buildIndexInBackground();
+		}
+	}
+
+
+	shared_ptr<const ImageIndex> ImageIndexManager::obtainIndex()
+	{
+		lock_guard<mutex> lock(_indexMutex);
+		return _index;
+	}
+
+
+	// Sends the state of the index and the memory it uses to the client, which shows it on its diagnostics page.
+	void ImageIndexManager::reportState(ImageIndexState state, const ImageIndex* index)
+	{
+		NamedPipeManager::instance().writeImageIndexState(state, nullptr == index ? 0 : index->memoryUsageInBytes(), nullptr == index ? 0 : index->numberOfIndexedBytes());
+	}
+}
@@ -0,0 +1,68 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include "stdafx.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "Defaults.h"
+#include "ImageIndex.h"
+
+namespace IGCS
+{
+	// Owns the optional ImageIndex over the executable sections of the host image, used for interactive pattern queries sent over the named
+	// pipe. The index is built on a background thread and replaced/discarded atomically: a query works on the index it obtained, so a
+	// discard while a query runs is harmless. Queries before the index is available are answered with a scan of the image, and start the build.
+	class ImageIndexManager
+	{
+	public:
+		ImageIndexManager();
+		~ImageIndexManager();
+
+		static ImageIndexManager& instance();
+
+		void initialize(LPBYTE hostImageAddress, DWORD hostImageSize);
+		void buildIndex();
+		void buildIndexInBackground();
+		void discardIndex();
+		void stop();
+		void queryPattern(const std::string& patternAsString);
+
+	private:
+		std::shared_ptr<const ImageIndex> obtainIndex();
+		void reportState(ImageIndexState state, const ImageIndex* index);
+
+		LPBYTE _hostImageAddress;
+		DWORD _hostImageSize;
+		std::mutex _indexMutex;
+		std::shared_ptr<const ImageIndex> _index;
+		bool _isBuilding;
+		std::thread _buildThread;
+	};
+}
@@ -329,7 +329,7 @@ namespace IGCS::Input
 				break;
 		}
 
-		if (!g_cameraEnabled)
+		if (!loadAcquire(g_controlBlock.cameraEnabled))
 		{
 			// let the game also handle the message
 			return false;
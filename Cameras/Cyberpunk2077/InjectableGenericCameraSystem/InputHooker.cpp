@@ -83,7 +83,7 @@ namespace IGCS::InputHooker
 		// first call the original function
 		DWORD toReturn = hookedXInputGetState(dwUserIndex, pState);
 		// check if the passed in pState is equal to our gamestate. If so, always allow.
-		if (g_cameraEnabled && pState != Globals::instance().gamePad().getState())
+		if (loadAcquire(g_controlBlock.cameraEnabled) && pState != Globals::instance().gamePad().getState())
 		{
 			// check if input is blocked. If so, zero the state, so the host will see no input data
 			if (Globals::instance().inputBlocked() && Globals::instance().controllerControlsCamera())
@@ -148,7 +148,7 @@ namespace IGCS::InputHooker
 		if (lpMsg != nullptr && Input::handleMessage(lpMsg))
 		{
 			// message was handled by our code. This means it's a message we want to block if input blocking is enabled or the overlay / menu is shown
-			if (g_cameraEnabled && Globals::instance().inputBlocked() && Globals::instance().keyboardMouseControlCamera())
+			if (loadAcquire(g_controlBlock.cameraEnabled) && Globals::instance().inputBlocked() && Globals::instance().keyboardMouseControlCamera())
 			{
 				lpMsg->message = WM_NULL;
 			}
@@ -28,98 +28,425 @@
 #include "stdafx.h"
 #include "InterceptorHelper.h"
 #include "GameConstants.h"
+#include "AOBPatterns.h"
 #include "GameImageHooker.h"
+#include <algorithm>
 #include <map>
 #include "MessageHandler.h"
 #include "CameraManipulator.h"
 #include "Globals.h"
+#include "NamedPipeManager.h"
+#include "InterceptorTelemetry.h"
 
 using namespace std;
 
 //--------------------------------------------------------------------------------------------------------------------------------
 // external asm functions
 extern "C" {
-	void pmStructAddressInterceptor();
-	void activeCamAddressInterceptor();
-	void activeCamWrite1Interceptor();
-	void resolutionStructAddressInterceptor();
-	void todStructAddressInterceptor();
-	void playHudWidgetReadInterceptor();
-	void pmHudWidgetReadInterceptor();
-	void fovPlayWriteInterceptor();
-	void timestopStructInterceptor();
 	void weatherStructInterceptor();
 }
 
 // external addresses used in asm.
 extern "C" {
-	LPBYTE _pmStructAddressInterceptionContinue = nullptr;
-	LPBYTE _activeCamAddressInterceptionContinue = nullptr;
-	LPBYTE _activeCamWrite1InterceptionContinue = nullptr;
-	LPBYTE _resolutionStructAddressInterceptionContinue = nullptr;
-	LPBYTE _todStructAddressInterceptionContinue = nullptr;
-	LPBYTE _playHudWidgetReadInterceptionContinue = nullptr;
-	LPBYTE _pmHudWidgetReadInterceptionContinue = nullptr;
-	LPBYTE _fovPlayWriteInterceptionContinue = nullptr;
-	LPBYTE _timestopStructInterceptionContinue = nullptr;
 	LPBYTE _weatherStructInterceptionContinue = nullptr;
+	uint64_t* _weatherStructHitCounter = nullptr;
 }
 
 
 namespace IGCS::GameSpecific::InterceptorHelper
 {
-	void initializeAOBBlocks(LPBYTE hostImageAddress, DWORD hostImageSize, map<string, AOBBlock*> &aobBlocks)
-	{
-		aobBlocks[ACTIVECAM_ADDRESS_INTERCEPT_KEY] = new AOBBlock(ACTIVECAM_ADDRESS_INTERCEPT_KEY, "0F 11 42 10 48 8B 03 | FF 90 58 02 00 00 F3 0F 11 46 20 48 8D 54 24 20 48 8B 03 48 8B CB", 1);
-		aobBlocks[ACTIVECAM_CAMERA_WRITE1_INTERCEPT_KEY] = new AOBBlock(ACTIVECAM_CAMERA_WRITE1_INTERCEPT_KEY, "F2 0F 11 83 E0 00 00 00 0F 28 44 24 30 89 8B E8 00 00 00 0F 11 83 F0 00 00 00", 2);	// 2 entries, we need the second one
-		aobBlocks[PMSTRUCT_ADDRESS_INTERCEPT_KEY] = new AOBBlock(PMSTRUCT_ADDRESS_INTERCEPT_KEY, "49 8B 4E 40 48 8D 95 90 00 00 00 41 88 9E FB 02 00 00", 1);
-		aobBlocks[COORD_FACTOR_ADDRESS_KEY] = new AOBBlock(COORD_FACTOR_ADDRESS_KEY, "F3 44 0F 10 1D | ?? ?? ?? ?? 48 85 C0 74 38", 1);
-		aobBlocks[RESOLUTION_STRUCT_ADDRESS_INTERCEPT_KEY] = new AOBBlock(RESOLUTION_STRUCT_ADDRESS_INTERCEPT_KEY, "8B 81 84 00 00 00 89 41 44 8B 81 88 00 00 00 89 41 40", 1);
-		aobBlocks[TOD_READ_INTERCEPT_KEY] = new AOBBlock(TOD_READ_INTERCEPT_KEY, "48 8B DA 48 8B 01 FF 90 F8 00 00 00 48 8B C3", 1);
-		aobBlocks[PLAY_WIDGETBUCKET_READ_INTERCEPT_KEY] = new AOBBlock(PLAY_WIDGETBUCKET_READ_INTERCEPT_KEY, "88 81 B1 00 00 00 48 89 BC 24 98 00 00 00 48 8B 7C 24 20", 1);
-		aobBlocks[PM_WIDGETBUCKET_READ_INTERCEPT_KEY] = new AOBBlock(PM_WIDGETBUCKET_READ_INTERCEPT_KEY, "74 0A 80 7A 40 00 74 04 B3 01 EB 02 32 DB 48 8B 49 40 0F B6 D3", 1);
-		aobBlocks[FOV_PLAY_WRITE_INTERCEPT_KEY] = new AOBBlock(FOV_PLAY_WRITE_INTERCEPT_KEY, "F3 0F 11 9F 5C 02 00 00 48 8B 8F B0 01 00 00", 1);
-		aobBlocks[TIMESTOP_STRUCT_INTERCEPT_KEY] = new AOBBlock(TIMESTOP_STRUCT_INTERCEPT_KEY, "44 8B 49 1C 48 85 D2 75 07 45 85 C9", 1);
-		aobBlocks[WEATHER_STRUCT_INTERCEPT_KEY] = new AOBBlock(WEATHER_STRUCT_INTERCEPT_KEY, "F3 0F 11 96 F0 00 00 00 F3 0F 5C C2 F3 0F 10 8D 3C 0A 00 00", 1);
-
-		map<string, AOBBlock*>::iterator it;
-		bool result = true;
-		for (it = aobBlocks.begin(); it != aobBlocks.end(); it++)
-		{
-			result &= it->second->scan(hostImageAddress, hostImageSize);
-		}
-		
+	// The interceptors whose stubs are generated when their hooks are set. The instructions overwritten by the hook are listed with each 
+	// interceptor, see Interceptor.asm for the surrounding code. The weather interceptor overrides values and is still written in asm.
+	static const InterceptorDescriptor activeCamAddressInterceptor =
+	{
+		// Cyberpunk2077.exe+FED759 - FF 90 58020000        - call qword ptr [rax+00000258]		<< INTERCEPT HERE >> RCX contains pointer to active camera.
+		// Cyberpunk2077.exe+FED75F - F3 0F11 46 20         - movss [rsi+20],xmm0
+		// Cyberpunk2077.exe+FED764 - 48 8D 54 24 20        - lea rdx,[rsp+20]
+		// Cyberpunk2077.exe+FED769 - 48 8B 03              - mov rax,[rbx]						<< CONTINUE HERE
+		.blockName = ACTIVECAM_ADDRESS_INTERCEPT_KEY,
+		.captureBefore = { &g_controlBlock.activeCamStructAddress, X64Register::Rcx },
+	};
+
+	static const InterceptorDescriptor postCameraStructInterceptors[] =
+	{
+		{
+			// Writes to many destinations, so the writes are only skipped if the destination is our camera struct. The movaps is always executed.
+			// Cyberpunk2077.exe+10B12BE - F2 0F11 83 E0000000   - movsd [rbx+000000E0],xmm0			<< INTERCEPT HERE << Write coords
+			// Cyberpunk2077.exe+10B12C6 - 0F28 44 24 30         - movaps xmm0,[rsp+30]
+			// Cyberpunk2077.exe+10B12CB - 89 8B E8000000        - mov [rbx+000000E8],ecx
+			// Cyberpunk2077.exe+10B12D1 - 0F11 83 F0000000      - movups [rbx+000000F0],xmm0			<< Write quaternion
+			// Cyberpunk2077.exe+10B12D8 - 80 BB B1000000 00     - cmp byte ptr [rbx+000000B1],00		<< CONTINUE HERE
+			.blockName = ACTIVECAM_CAMERA_WRITE1_INTERCEPT_KEY,
+			.continueOffset = 0x1A,
+			.instructionsSkippedWhileCameraEnabled = 0b1101,
+			.skipOnlyIfRegisterEquals = &g_controlBlock.activeCamStructAddress,
+			.skipConditionRegister = X64Register::Rbx,
+		},
+		{
+			// Cyberpunk2077.exe+25B6746 - 49 8B 4E 40           - mov rcx,[r14+40]					<< INTERCEPT HERE >> R14 contains the photomode struct.
+			// Cyberpunk2077.exe+25B674A - 48 8D 95 90000000     - lea rdx,[rbp+00000090]
+			// Cyberpunk2077.exe+25B6751 - 41 88 9E FB020000     - mov [r14+000002FB],bl
+			// Cyberpunk2077.exe+25B6758 - E8 6377FFFF           - call Cyberpunk2077.exe+25ADEC0		<< CONTINUE HERE
+			.blockName = PMSTRUCT_ADDRESS_INTERCEPT_KEY,
+			.captureBefore = { &g_controlBlock.pmStructAddress, X64Register::R14 },
+		},
+		{
+			// Cyberpunk2077.exe+16D4D53 - F3 0F11 9F 5C020000   - movss [rdi+0000025C],xmm3			<< INTERCEPT HERE << WRITE Gameplay fov.
+			// Cyberpunk2077.exe+16D4D5B - 48 8B 8F B0010000     - mov rcx,[rdi+000001B0]
+			// Cyberpunk2077.exe+16D4D62 - 0F2E 59 40            - ucomiss xmm3,[rcx+40]				<< CONTINUE HERE
+			.blockName = FOV_PLAY_WRITE_INTERCEPT_KEY,
+			.instructionsSkippedWhileCameraEnabled = 0b1,
+		},
+	};
+
+	static const InterceptorDescriptor nonCriticalInterceptors[] =
+	{
+		{
+			// Cyberpunk2077.exe+26C3E5D - 8B 81 84000000        - mov eax,[rcx+00000084]			<< INTERCEPT HERE >> RBX contains the resolution struct.
+			// Cyberpunk2077.exe+26C3E63 - 89 41 44              - mov [rcx+44],eax
+			// Cyberpunk2077.exe+26C3E66 - 8B 81 88000000        - mov eax,[rcx+00000088]
+			// Cyberpunk2077.exe+26C3E6C - 89 41 40              - mov [rcx+40],eax
+			// Cyberpunk2077.exe+26C3E6F - 8B 81 8C000000        - mov eax,[rcx+0000008C]			<< CONTINUE HERE
+			.blockName = RESOLUTION_STRUCT_ADDRESS_INTERCEPT_KEY,
+			.continueOffset = 0x12,
+			.captureBefore = { &g_controlBlock.resolutionStructAddress, X64Register::Rbx },
+		},
+		{
+			// Cyberpunk2077.exe+17461DD - 48 8B DA              - mov rbx,rdx						<< INTERCEPT HERE
+			// Cyberpunk2077.exe+17461E0 - 48 8B 01              - mov rax,[rcx]
+			// Cyberpunk2077.exe+17461E3 - FF 90 F8000000        - call qword ptr [rax+000000F8]	>> Call tod read, RCX contains the tod struct.
+			// Cyberpunk2077.exe+17461E9 - 48 8B C3              - mov rax,rbx
+			// Cyberpunk2077.exe+17461EC - 48 83 C4 20           - add rsp,20						<< CONTINUE HERE
+			.blockName = TOD_READ_INTERCEPT_KEY,
+			.captureBefore = { &g_controlBlock.todStructAddress, X64Register::Rcx },
+		},
+		{
+			// Cyberpunk2077.exe+867B97 - 88 81 B1000000        - mov [rcx+000000B1],al				<< INTERCEPT HERE
+			// Cyberpunk2077.exe+867B9D - 48 89 BC 24 98000000  - mov [rsp+00000098],rdi
+			// Cyberpunk2077.exe+867BA5 - 48 8B 7C 24 20        - mov rdi,[rsp+20]
+			// Cyberpunk2077.exe+867BAA - 48 83 7F 40 00        - cmp qword ptr [rdi+40],00			<< CONTINUE HERE << PLAY Bucket read.
+			.blockName = PLAY_WIDGETBUCKET_READ_INTERCEPT_KEY,
+			.continueOffset = (0x867BAA - 0x867B97),
+			.captureAfter = { &g_controlBlock.playHudWidgetAddress, X64Register::Rdi, true, 0x40 },
+		},
+		{
+			// The branches to the instructions within the hook are kept within the stub.
+			// Cyberpunk2077.exe+8BA914 - 74 0A                 - je Cyberpunk2077.exe+8BA920			<< INTERCEPT HERE
+			// Cyberpunk2077.exe+8BA916 - 80 7A 40 00           - cmp byte ptr [rdx+40],00
+			// Cyberpunk2077.exe+8BA91A - 74 04                 - je Cyberpunk2077.exe+8BA920
+			// Cyberpunk2077.exe+8BA91C - B3 01                 - mov bl,01
+			// Cyberpunk2077.exe+8BA91E - EB 02                 - jmp Cyberpunk2077.exe+8BA922
+			// Cyberpunk2077.exe+8BA920 - 32 DB                 - xor bl,bl
+			// Cyberpunk2077.exe+8BA922 - 48 8B 49 40           - mov rcx,[rcx+40]					<< PM Bucket read.
+			// Cyberpunk2077.exe+8BA926 - 0FB6 D3               - movzx edx,bl						<< CONTINUE HERE
+			.blockName = PM_WIDGETBUCKET_READ_INTERCEPT_KEY,
+			.continueOffset = (0x8BA926 - 0x8BA914),
+			.captureAfter = { &g_controlBlock.pmHudWidgetAddress, X64Register::Rcx },
+		},
+		{
+			// The ret is executed from the stub, the jne continues in the game's code.
+			// Cyberpunk2077.exe+AB73E0 - 44 8B 49 1C           - mov r9d,[rcx+1C]					<< INTERCEPT HERE << READ Timestop. 1=>paused, 0=>run
+			// Cyberpunk2077.exe+AB73E4 - 48 85 D2              - test rdx,rdx
+			// Cyberpunk2077.exe+AB73E7 - 75 07                 - jne Cyberpunk2077.exe+AB73F0
+			// Cyberpunk2077.exe+AB73E9 - 45 85 C9              - test r9d,r9d
+			// Cyberpunk2077.exe+AB73EC - 0F95 C0               - setne al
+			// Cyberpunk2077.exe+AB73EF - C3                    - ret 
+			// Cyberpunk2077.exe+AB73F0 - 45 33 C0              - xor r8d,r8d						<< CONTINUE HERE 
+			.blockName = TIMESTOP_STRUCT_INTERCEPT_KEY,
+			.continueOffset = (0xAB73F0 - 0xAB73E0),
+			.captureBefore = { &g_controlBlock.timestopStructAddress, X64Register::Rcx },
+		},
+	};
+
+
+	// An interceptor in a module other than the host image, with the feature which depends on it. Its hook is set when its module is loaded,
+	// see setModuleHooks.
+	struct ModuleInterceptor
+	{
+		InterceptorDescriptor interceptor;
+		FeatureType feature;
+	};
+
+	// Cyberpunk 2077 has no blocks outside the host image. Games with blocks in e.g. the Ansel SDK dll list their interceptors here, with the
+	// moduleName of their pattern definitions set.
+	static const vector<ModuleInterceptor> moduleInterceptors =
+	{
+	};
+
+
+	static bool isInModuleNotLoaded(AOBBlock* block, const vector<string>& modulesNotLoaded)
+	{
+		return !block->isInHostImage() && find(modulesNotLoaded.begin(), modulesNotLoaded.end(), block->moduleName()) != modulesNotLoaded.end();
+	}
+
+
+	// Creates the AOB blocks for all pattern definitions and resolves the critical ones, i.e. the ones needed for the camera itself. The 
+	// non-critical blocks are resolved later in the background with initializeNonCriticalAOBBlocks. The blocks in the modules which are
+	// loaded are resolved concurrently with the blocks in the host image. The modules which aren't loaded yet are returned in modulesNotLoaded,
+	// their blocks are resolved with initializeModuleAOBBlocks when the module is loaded. The identities of the host image and the loaded
+	// modules are returned in identityPerModule, for initializeNonCriticalAOBBlocks: they're determined before any hook is set, as the hooks
+	// change the code the identity is a hash of, and the AOB cache files would otherwise never match on the next run.
+	void initializeAOBBlocks(LPBYTE hostImageAddress, DWORD hostImageSize, map<string, AOBBlock*> &aobBlocks, const filesystem::path& aobCacheFilename,
+							 vector<string>& modulesNotLoaded, map<string, ModuleIdentity>& identityPerModule)
+	{
+		for (auto& definition : aobPatternDefinitions)
+		{
+			auto existingBlock = aobBlocks.find(definition.blockName);
+			if (existingBlock == aobBlocks.end())
+			{
+				AOBBlock* toAdd = new AOBBlock(definition.blockName, definition.pattern);
+				if (definition.kind == AOBBlockKind::NonCritical)
+				{
+					toAdd->markAsNonCritical();
+				}
+				if (nullptr != definition.moduleName)
+				{
+					toAdd->targetModule(definition.moduleName);
+				}
+				aobBlocks[definition.blockName] = toAdd;
+			}
+			else
+			{
+				existingBlock->second->addAlternative(definition.pattern);
+			}
+		}
+		modulesNotLoaded.clear();
+		identityPerModule.clear();
+		identityPerModule[string()] = AOBScanCache::determineModuleIdentity(hostImageAddress, hostImageSize, VirtualQueryMemorySource());
+		for (auto& moduleName : determineModulesOfBlocks(aobBlocks))
+		{
+			const MODULEINFO moduleInfo = Utils::getModuleInfoOfDll(moduleName);
+			if (nullptr == moduleInfo.lpBaseOfDll)
+			{
+				MessageHandler::logDebug("Module '%s' isn't loaded yet, its blocks are resolved when it's loaded.", moduleName.c_str());
+				modulesNotLoaded.push_back(moduleName);
+				continue;
+			}
+			identityPerModule[moduleName] = AOBScanCache::determineModuleIdentity(static_cast<const uint8_t*>(moduleInfo.lpBaseOfDll), moduleInfo.SizeOfImage, 
+																				  VirtualQueryMemorySource());
+		}
+		map<string, AOBBlock*> criticalBlocks;
+		for (auto& nameBlockPair : aobBlocks)
+		{
+			if (!nameBlockPair.second->isNonCritical() && !isInModuleNotLoaded(nameBlockPair.second, modulesNotLoaded))
+			{
+				criticalBlocks[nameBlockPair.first] = nameBlockPair.second;
+			}
+		}
+		// the features of the non-critical blocks aren't available till those blocks have been hooked.
+		for (int feature = 0; feature < static_cast<int>(FeatureType::Amount); feature++)
+		{
+			reportFeatureAvailability(static_cast<FeatureType>(feature), false);
+		}
+
+		// all blocks and their alternatives are resolved from the cache of a previous run or in a single sweep over the image. Blocks only scan
+		// the executable sections of the image, unless includeNonCodeSections() is called on them.
+		bool result = Utils::scanAOBBlocksInModules(hostImageAddress, hostImageSize, criticalBlocks, aobCacheFilename, identityPerModule);
+
 		if (result)
+		{
+			MessageHandler::logLine("All camera interception offsets found.");
+		}
+		else
+		{
+			MessageHandler::logError("One or more camera interception offsets weren't found: tools aren't compatible with this game's version.");
+		}
+	}
+
+
+	// Resolves the non-critical blocks created by initializeAOBBlocks. Called on a background thread, after the critical blocks have been
+	// resolved and hooked. Only the non-critical blocks are touched, except the ones in modulesNotLoaded. identityPerModule is the one
+	// returned by initializeAOBBlocks, so the cache files written by both phases are for the same, unhooked, module identities.
+	void initializeNonCriticalAOBBlocks(LPBYTE hostImageAddress, DWORD hostImageSize, map<string, AOBBlock*>& aobBlocks, const filesystem::path& aobCacheFilename,
+										const vector<string>& modulesNotLoaded, const map<string, ModuleIdentity>& identityPerModule)
+	{
+		map<string, AOBBlock*> nonCriticalBlocks;
+		for (auto& nameBlockPair : aobBlocks)
+		{
+			if (nameBlockPair.second->isNonCritical() && !isInModuleNotLoaded(nameBlockPair.second, modulesNotLoaded))
+			{
+				nonCriticalBlocks[nameBlockPair.first] = nameBlockPair.second;
+			}
+		}
+		if (nonCriticalBlocks.empty())
+		{
+			return;
+		}
+		Utils::scanAOBBlocksInModules(hostImageAddress, hostImageSize, nonCriticalBlocks, aobCacheFilename, identityPerModule);
+		int numberOfBlocksFound = 0;
+		for (auto& nameBlockPair : nonCriticalBlocks)
+		{
+			numberOfBlocksFound += nameBlockPair.second->found() ? 1 : 0;
+		}
+		if (numberOfBlocksFound == static_cast<int>(nonCriticalBlocks.size()))
 		{
 			MessageHandler::logLine("All interception offsets found.");
 		}
 		else
 		{
-			MessageHandler::logError("One or more interception offsets weren't found: tools aren't compatible with this game's version.");
+			MessageHandler::logError("%d of %d interception offsets for additional features weren't found: some features aren't available.",
+									 static_cast<int>(nonCriticalBlocks.size()) - numberOfBlocksFound, static_cast<int>(nonCriticalBlocks.size()));
 		}
 	}
 
 
+	// Resolves all blocks, critical or not, in the module specified, which was loaded after initializeAOBBlocks. Called on the thread of the
+	// module load watcher, the hooks in the host image aren't blocked by it.
+	void initializeModuleAOBBlocks(const string& moduleName, LPBYTE moduleImageAddress, DWORD moduleImageSize, map<string, AOBBlock*>& aobBlocks, 
+								   const filesystem::path& aobCacheFilename)
+	{
+		map<string, AOBBlock*> moduleBlocks;
+		for (auto& nameBlockPair : aobBlocks)
+		{
+			if (nameBlockPair.second->moduleName() == moduleName)
+			{
+				moduleBlocks[nameBlockPair.first] = nameBlockPair.second;
+			}
+		}
+		// the module was just loaded, so none of its blocks have been hooked yet.
+		const ModuleIdentity moduleIdentity = AOBScanCache::determineModuleIdentity(moduleImageAddress, moduleImageSize, VirtualQueryMemorySource());
+		WorkerPool workerPool(WorkerPool::defaultNumberOfWorkers());
+		if (Utils::scanAOBBlocksUsingCache(moduleImageAddress, moduleImageSize, moduleBlocks, Utils::determineModuleCacheFilename(aobCacheFilename, moduleName), 
+										   moduleIdentity, workerPool))
+		{
+			MessageHandler::logLine("All interception offsets in module '%s' found.", moduleName.c_str());
+		}
+		else
+		{
+			MessageHandler::logError("One or more interception offsets in module '%s' weren't found.", moduleName.c_str());
+		}
+	}
+
+
+	// Returns the names of the modules other than the host image which contain blocks.
+	vector<string> determineModulesOfBlocks(map<string, AOBBlock*>& aobBlocks)
+	{
+		vector<string> toReturn;
+		for (auto& nameBlockPair : aobBlocks)
+		{
+			const string& moduleName = nameBlockPair.second->moduleName();
+			if (!moduleName.empty() && find(toReturn.begin(), toReturn.end(), moduleName) == toReturn.end())
+			{
+				toReturn.push_back(moduleName);
+			}
+		}
+		return toReturn;
+	}
+
+
 	void setCameraStructInterceptorHook(map<string, AOBBlock*>& aobBlocks)
 	{
-		GameImageHooker::setHook(aobBlocks[ACTIVECAM_ADDRESS_INTERCEPT_KEY], 0x10, &_activeCamAddressInterceptionContinue, &activeCamAddressInterceptor);
+		GameImageHooker::setHook(aobBlocks[activeCamAddressInterceptor.blockName], activeCamAddressInterceptor);
 	}
 
 	
 	void setPostCameraStructHooks(map<string, AOBBlock*>& aobBlocks)
 	{
-		GameImageHooker::setHook(aobBlocks[ACTIVECAM_CAMERA_WRITE1_INTERCEPT_KEY], 0x1A, &_activeCamWrite1InterceptionContinue, &activeCamWrite1Interceptor);
-		GameImageHooker::setHook(aobBlocks[PMSTRUCT_ADDRESS_INTERCEPT_KEY], (0x25B6758-0x25B6746), &_pmStructAddressInterceptionContinue, &pmStructAddressInterceptor);
-		GameImageHooker::setHook(aobBlocks[RESOLUTION_STRUCT_ADDRESS_INTERCEPT_KEY], 0x12, &_resolutionStructAddressInterceptionContinue, &resolutionStructAddressInterceptor);
-		GameImageHooker::setHook(aobBlocks[TOD_READ_INTERCEPT_KEY], (0x17461EC-0x17461DD), &_todStructAddressInterceptionContinue, &todStructAddressInterceptor);
-		GameImageHooker::setHook(aobBlocks[PLAY_WIDGETBUCKET_READ_INTERCEPT_KEY], (0x867BAA - 0x867B97), &_playHudWidgetReadInterceptionContinue, &playHudWidgetReadInterceptor);
-		GameImageHooker::setHook(aobBlocks[PM_WIDGETBUCKET_READ_INTERCEPT_KEY], (0x8BA926 - 0x8BA914), &_pmHudWidgetReadInterceptionContinue, &pmHudWidgetReadInterceptor);
-		GameImageHooker::setHook(aobBlocks[FOV_PLAY_WRITE_INTERCEPT_KEY], (0x16D4D62 - 0x16D4D53), &_fovPlayWriteInterceptionContinue, &fovPlayWriteInterceptor);
-		GameImageHooker::setHook(aobBlocks[TIMESTOP_STRUCT_INTERCEPT_KEY], (0xAB73F0 - 0xAB73E0), &_timestopStructInterceptionContinue, &timestopStructInterceptor);
-		GameImageHooker::setHook(aobBlocks[WEATHER_STRUCT_INTERCEPT_KEY], (0x111A068 - 0x111A040), &_weatherStructInterceptionContinue, &weatherStructInterceptor);
-
-		// Grab the factor from static memory.
-		LPBYTE factorAddress = Utils::calculateAbsoluteAddress(aobBlocks[COORD_FACTOR_ADDRESS_KEY], 4);
-		CameraManipulator::setCoordMultiplierFactor(*reinterpret_cast<float*>(factorAddress));
+		GameImageHooker::beginTransaction();
+		for (auto& interceptor : postCameraStructInterceptors)
+		{
+			GameImageHooker::setHook(aobBlocks[interceptor.blockName], interceptor);
+		}
+		GameImageHooker::commitTransaction();
+
+		// Grab the factor from static memory. The block starts at the movss reading it.
+		LPBYTE factorAddress = Utils::calculateRipRelativeTarget(aobBlocks[COORD_FACTOR_ADDRESS_KEY]);
+		if (nullptr != factorAddress)
+		{
+			CameraManipulator::setCoordMultiplierFactor(*reinterpret_cast<float*>(factorAddress));
+		}
+	}
+
+
+	// Sets the hooks of the non-critical blocks which were found by initializeNonCriticalAOBBlocks and makes the features which depend on
+	// them available. Called on the background thread, the hooks don't depend on the camera struct. 
+	void setNonCriticalHooks(map<string, AOBBlock*>& aobBlocks)
+	{
+		// the hooks are set as a unit: if they can't be written, none is and the features aren't available. A hook which couldn't be set, e.g.
+		// because its block wasn't found or its stub couldn't be generated, isn't part of the unit, only its feature isn't available.
+		map<string, bool> isHookSet;
+		GameImageHooker::beginTransaction();
+		for (auto& interceptor : nonCriticalInterceptors)
+		{
+			isHookSet[interceptor.blockName] = GameImageHooker::setHook(aobBlocks[interceptor.blockName], interceptor);
+		}
+		// the generated interceptors count their hits themselves, the asm one needs its counter before it's hooked.
+		_weatherStructHitCounter = InterceptorTelemetry::instance().registerInterceptor(WEATHER_STRUCT_INTERCEPT_KEY);
+		isHookSet[WEATHER_STRUCT_INTERCEPT_KEY] = GameImageHooker::setHook(aobBlocks[WEATHER_STRUCT_INTERCEPT_KEY], (0x111A068 - 0x111A040), 
+																			&_weatherStructInterceptionContinue, &weatherStructInterceptor);
+		const bool hooksSet = GameImageHooker::commitTransaction();
+
+		reportFeatureAvailability(FeatureType::Hotsampling, hooksSet && isHookSet[RESOLUTION_STRUCT_ADDRESS_INTERCEPT_KEY]);
+		reportFeatureAvailability(FeatureType::TimeOfDay, hooksSet && isHookSet[TOD_READ_INTERCEPT_KEY]);
+		// the photomode HUD is only toggled if photomode is active, the HUD in play mode is always toggled.
+		reportFeatureAvailability(FeatureType::HudToggle, hooksSet && isHookSet[PLAY_WIDGETBUCKET_READ_INTERCEPT_KEY]);
+		reportFeatureAvailability(FeatureType::Timestop, hooksSet && isHookSet[TIMESTOP_STRUCT_INTERCEPT_KEY]);
+		reportFeatureAvailability(FeatureType::Weather, hooksSet && isHookSet[WEATHER_STRUCT_INTERCEPT_KEY]);
+	}
+
+
+	// Sets the hooks of the module interceptors in the module specified, after its blocks were resolved, and makes the features which depend 
+	// on them available. Called on the background thread for modules which were loaded at startup, and on the thread of the module load 
+	// watcher for modules loaded later, so the hooks in the host image aren't blocked by it.
+	void setModuleHooks(const string& moduleName, map<string, AOBBlock*>& aobBlocks)
+	{
+		vector<const ModuleInterceptor*> interceptorsInModule;
+		for (auto& moduleInterceptor : moduleInterceptors)
+		{
+			auto block = aobBlocks.find(moduleInterceptor.interceptor.blockName);
+			if (block != aobBlocks.end() && block->second->moduleName() == moduleName)
+			{
+				interceptorsInModule.push_back(&moduleInterceptor);
+			}
+		}
+		if (interceptorsInModule.empty())
+		{
+			return;
+		}
+		// as with the non-critical hooks, a feature is available if all hooks it depends on are set.
+		map<FeatureType, bool> isFeatureHooked;
+		GameImageHooker::beginTransaction();
+		for (auto moduleInterceptor : interceptorsInModule)
+		{
+			const bool isHookSet = GameImageHooker::setHook(aobBlocks[moduleInterceptor->interceptor.blockName], moduleInterceptor->interceptor);
+			auto existingFeature = isFeatureHooked.find(moduleInterceptor->feature);
+			isFeatureHooked[moduleInterceptor->feature] = isHookSet && (existingFeature == isFeatureHooked.end() || existingFeature->second);
+		}
+		const bool hooksSet = GameImageHooker::commitTransaction();
+		for (auto& featureHookedPair : isFeatureHooked)
+		{
+			reportFeatureAvailability(featureHookedPair.first, hooksSet && featureHookedPair.second);
+		}
+	}
+
+
+	// Forgets the hooks set in the module specified, which was unloaded, so the watchdog and the uninstall don't touch its memory anymore, and
+	// makes the features which depend on them unavailable. Its blocks are reset to not found, so they're resolved and hooked again when the 
+	// module is loaded again. Called on the thread of the module load watcher.
+	void handleModuleUnloaded(const string& moduleName, LPBYTE moduleImageAddress, DWORD moduleImageSize, map<string, AOBBlock*>& aobBlocks)
+	{
+		GameImageHooker::forgetPatchesInRange(moduleImageAddress, moduleImageSize);
+		for (auto& nameBlockPair : aobBlocks)
+		{
+			if (nameBlockPair.second->moduleName() == moduleName)
+			{
+				nameBlockPair.second->resetLocation();
+			}
+		}
+		for (auto& moduleInterceptor : moduleInterceptors)
+		{
+			auto block = aobBlocks.find(moduleInterceptor.interceptor.blockName);
+			if (block != aobBlocks.end() && block->second->moduleName() == moduleName)
+			{
+				reportFeatureAvailability(moduleInterceptor.feature, false);
+			}
+		}
+	}
+
+
+	void reportFeatureAvailability(FeatureType feature, bool isAvailable)
+	{
+		Globals::instance().featureAvailable(feature, isAvailable);
+		NamedPipeManager::instance().writeFeatureAvailability(feature, isAvailable);
 	}
 }
@@ -29,10 +29,21 @@
 #include "stdafx.h"
 #include <map>
 #include "Utils.h"
+#include "Defaults.h"
 
 namespace IGCS::GameSpecific::InterceptorHelper
 {
-	void initializeAOBBlocks(LPBYTE hostImageAddress, DWORD hostImageSize, std::map<std::string, AOBBlock*> &aobBlocks);
+	void initializeAOBBlocks(LPBYTE hostImageAddress, DWORD hostImageSize, std::map<std::string, AOBBlock*> &aobBlocks, const std::filesystem::path& aobCacheFilename,
+							 std::vector<std::string>& modulesNotLoaded, std::map<std::string, ModuleIdentity>& identityPerModule);
+	void initializeNonCriticalAOBBlocks(LPBYTE hostImageAddress, DWORD hostImageSize, std::map<std::string, AOBBlock*>& aobBlocks, const std::filesystem::path& aobCacheFilename,
+										const std::vector<std::string>& modulesNotLoaded, const std::map<std::string, ModuleIdentity>& identityPerModule);
+	void initializeModuleAOBBlocks(const std::string& moduleName, LPBYTE moduleImageAddress, DWORD moduleImageSize, std::map<std::string, AOBBlock*>& aobBlocks, 
+								   const std::filesystem::path& aobCacheFilename);
+	std::vector<std::string> determineModulesOfBlocks(std::map<std::string, AOBBlock*>& aobBlocks);
 	void setCameraStructInterceptorHook(std::map<std::string, AOBBlock*> &aobBlocks);
 	void setPostCameraStructHooks(std::map<std::string, AOBBlock*>& aobBlocks);
+	void setNonCriticalHooks(std::map<std::string, AOBBlock*>& aobBlocks);
+	void setModuleHooks(const std::string& moduleName, std::map<std::string, AOBBlock*>& aobBlocks);
+	void handleModuleUnloaded(const std::string& moduleName, LPBYTE moduleImageAddress, DWORD moduleImageSize, std::map<std::string, AOBBlock*>& aobBlocks);
+	void reportFeatureAvailability(FeatureType feature, bool isAvailable);
 }
@@ -0,0 +1,260 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "InterceptorStubBuilder.h"
+#include "X64InstructionDecoder.h"
+
+using namespace std;
+
+namespace IGCS::InterceptorStubBuilder
+{
+	// An instruction overwritten by a hook, which the stub has to execute instead.
+	struct DisplacedInstruction
+	{
+		const uint8_t* address;
+		X64Instruction decoded;
+	};
+
+	// Returns the first of rax, rcx and rdx which isn't one of the registers specified, to use as scratch register.
+	static X64Register pickScratchRegister(X64Register toAvoid1, X64Register toAvoid2)
+	{
+		for (X64Register candidate : { X64Register::Rax, X64Register::Rcx, X64Register::Rdx })
+		{
+			if (candidate != toAvoid1 && candidate != toAvoid2)
+			{
+				return candidate;
+			}
+		}
+		return X64Register::Rax;
+	}
+
+
+	static bool decodeDisplacedInstructions(const uint8_t* hookAddress, uint32_t continueOffset, vector<DisplacedInstruction>& instructions, string& errorDescription)
+	{
+		uint32_t offset = 0;
+		while (offset < continueOffset)
+		{
+			DisplacedInstruction instruction{ hookAddress + offset, {} };
+			// an instruction ending beyond continueOffset doesn't decode within the bytes available.
+			if (!X64InstructionDecoder::decode(instruction.address, continueOffset - offset, instruction.decoded))
+			{
+				errorDescription = "The instruction at offset " + to_string(offset) + " can't be decoded or doesn't end before the continue offset.";
+				return false;
+			}
+			instructions.push_back(instruction);
+			offset += instruction.decoded.length;
+		}
+		return true;
+	}
+
+
+	// Emits the code storing the value of capture in its destination. The scratch registers used are saved on the stack, which is fine as
+	// there's no red zone on x64 windows.
+	static bool emitCapture(X64Emitter& emitter, const InterceptorCapture& capture, string& errorDescription)
+	{
+		if (nullptr == capture.destination)
+		{
+			return true;
+		}
+		if (!capture.isDereferenced)
+		{
+			if (capture.source == X64Register::Rsp)
+			{
+				errorDescription = "rsp itself can't be captured, only values it points to.";
+				return false;
+			}
+			const X64Register addressRegister = pickScratchRegister(capture.source, capture.source);
+			emitter.push(addressRegister);
+			emitter.moveImmediate(addressRegister, reinterpret_cast<uintptr_t>(capture.destination));
+			emitter.store(addressRegister, 0, capture.source);
+			emitter.pop(addressRegister);
+			return true;
+		}
+		const X64Register valueRegister = pickScratchRegister(capture.source, capture.source);
+		const X64Register addressRegister = pickScratchRegister(capture.source, valueRegister);
+		emitter.push(valueRegister);
+		emitter.push(addressRegister);
+		// the two pushes moved rsp.
+		const int32_t displacement = capture.displacement + (capture.source == X64Register::Rsp ? 16 : 0);
+		emitter.load(valueRegister, capture.source, displacement);
+		emitter.moveImmediate(addressRegister, reinterpret_cast<uintptr_t>(capture.destination));
+		emitter.store(addressRegister, 0, valueRegister);
+		emitter.pop(addressRegister);
+		emitter.pop(valueRegister);
+		return true;
+	}
+
+
+	// Emits a copy of the displaced instructions, except the ones with their bit set in skipMask. Branches to a displaced instruction jump to 
+	// its copy, branches to the continue address jump to afterReplayLabel, so captures after the instructions are done on that path too.
+	static bool emitReplay(X64Emitter& emitter, const vector<DisplacedInstruction>& instructions, const uint8_t* hookAddress, uint32_t continueOffset, 
+						   uint32_t skipMask, int afterReplayLabel, string& errorDescription)
+	{
+		vector<int> instructionLabels;
+		for (size_t i = 0; i < instructions.size(); i++)
+		{
+			instructionLabels.push_back(emitter.createLabel());
+		}
+		for (size_t i = 0; i < instructions.size(); i++)
+		{
+			// a skipped instruction still gets its label bound, branches to it continue with the instruction after it.
+			emitter.bindLabel(instructionLabels[i]);
+			if ((skipMask & (1u << i)) != 0)
+			{
+				continue;
+			}
+			const DisplacedInstruction& instruction = instructions[i];
+			int branchTargetLabel = -1;
+			if (instruction.decoded.isRelativeBranch)
+			{
+				const uint8_t* target = X64InstructionDecoder::determineBranchTarget(instruction.address, instruction.decoded);
+				if (target == hookAddress + continueOffset)
+				{
+					branchTargetLabel = afterReplayLabel;
+				}
+				else if (target >= hookAddress && target < hookAddress + continueOffset)
+				{
+					for (size_t j = 0; j < instructions.size(); j++)
+					{
+						if (instructions[j].address == target)
+						{
+							branchTargetLabel = instructionLabels[j];
+						}
+					}
+					if (branchTargetLabel < 0)
+					{
+						errorDescription = "The branch at offset " + to_string(instruction.address - hookAddress) + " jumps into the middle of an overwritten instruction.";
+						return false;
+					}
+				}
+			}
+			if (!emitter.copyInstruction(instruction.address, instruction.decoded, branchTargetLabel))
+			{
+				errorDescription = "The instruction at offset " + to_string(instruction.address - hookAddress) + " can't be copied: " + emitter.errorDescription();
+				return false;
+			}
+		}
+		return true;
+	}
+
+
+	// Generates the code of the stub for the interceptor described by descriptor, for the hook at hookAddress which continues at continueOffset.
+	// The code is generated for stubAddress, where it has to be placed, and returned in stubCode. The stub looks like:
+	//		<save flags>, lock inc qword ptr [hitCounter], <restore flags>			(if a hit counter is specified)
+	//		<capture before>
+	//		pushfq, and if the camera is enabled (and the skip condition register equals the qword specified):
+	//			popfq, <displaced instructions except the skipped ones>, jmp afterReplay
+	//		replayAll: popfq, <displaced instructions>
+	//		afterReplay: <capture after>
+	//		jmp qword ptr [continue address]
+	// The flags are saved around the checks so the displaced instructions see the flags the game's code set. Returns false, with a description
+	// in errorDescription, if the overwritten instructions can't be relocated or the descriptor is invalid.
+	bool buildStub(const InterceptorDescriptor& descriptor, const uint8_t* hookAddress, uint32_t continueOffset, const uint8_t* cameraEnabledFlag,
+				   uint64_t* hitCounter, uintptr_t stubAddress, vector<uint8_t>& stubCode, string& errorDescription)
+	{
+		stubCode.clear();
+		errorDescription.clear();
+		vector<DisplacedInstruction> instructions;
+		if (!decodeDisplacedInstructions(hookAddress, continueOffset, instructions, errorDescription))
+		{
+			return false;
+		}
+		const uint32_t skipMask = descriptor.instructionsSkippedWhileCameraEnabled;
+		if (instructions.size() < 32 && (skipMask >> instructions.size()) != 0)
+		{
+			errorDescription = "Instructions to skip are specified which aren't overwritten by the hook.";
+			return false;
+		}
+		X64Emitter emitter(stubAddress);
+		if (nullptr != hitCounter)
+		{
+			// the increment changes the flags, which are saved with lahf/seto as that's cheaper than pushfq/popfq.
+			emitter.push(X64Register::Rax);
+			emitter.saveArithmeticFlagsInRax();
+			emitter.push(X64Register::Rcx);
+			emitter.moveImmediate(X64Register::Rcx, reinterpret_cast<uintptr_t>(hitCounter));
+			emitter.lockIncrement(X64Register::Rcx, 0);
+			emitter.pop(X64Register::Rcx);
+			emitter.restoreArithmeticFlagsFromRax();
+			emitter.pop(X64Register::Rax);
+		}
+		if (!emitCapture(emitter, descriptor.captureBefore, errorDescription))
+		{
+			return false;
+		}
+		const int afterReplayLabel = emitter.createLabel();
+		if (skipMask != 0)
+		{
+			if (nullptr == cameraEnabledFlag || descriptor.skipConditionRegister == X64Register::Rsp)
+			{
+				errorDescription = "Instructions can only be skipped with a camera enabled flag and a skip condition register other than rsp.";
+				return false;
+			}
+			const int replayAllLabel = emitter.createLabel();
+			const X64Register scratchRegister = pickScratchRegister(descriptor.skipConditionRegister, descriptor.skipConditionRegister);
+			emitter.pushFlags();
+			emitter.push(scratchRegister);
+			emitter.moveImmediate(scratchRegister, reinterpret_cast<uintptr_t>(cameraEnabledFlag));
+			emitter.compareByte(scratchRegister, 0, 1);
+			emitter.pop(scratchRegister);
+			emitter.jumpIf(X64Condition::NotEqual, replayAllLabel);
+			if (nullptr != descriptor.skipOnlyIfRegisterEquals)
+			{
+				emitter.push(scratchRegister);
+				emitter.moveImmediate(scratchRegister, reinterpret_cast<uintptr_t>(descriptor.skipOnlyIfRegisterEquals));
+				emitter.compare(descriptor.skipConditionRegister, scratchRegister, 0);
+				emitter.pop(scratchRegister);
+				emitter.jumpIf(X64Condition::NotEqual, replayAllLabel);
+			}
+			emitter.popFlags();
+			if (!emitReplay(emitter, instructions, hookAddress, continueOffset, skipMask, afterReplayLabel, errorDescription))
+			{
+				return false;
+			}
+			emitter.jump(afterReplayLabel);
+			emitter.bindLabel(replayAllLabel);
+			emitter.popFlags();
+		}
+		if (!emitReplay(emitter, instructions, hookAddress, continueOffset, 0, afterReplayLabel, errorDescription))
+		{
+			return false;
+		}
+		emitter.bindLabel(afterReplayLabel);
+		if (!emitCapture(emitter, descriptor.captureAfter, errorDescription))
+		{
+			return false;
+		}
+		emitter.jumpAbsolute(reinterpret_cast<uintptr_t>(hookAddress + continueOffset));
+		if (!emitter.finish())
+		{
+			errorDescription = emitter.errorDescription();
+			return false;
+		}
+		stubCode = emitter.code();
+		return true;
+	}
+}
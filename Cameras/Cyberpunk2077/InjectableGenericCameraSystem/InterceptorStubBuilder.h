@@ -0,0 +1,68 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include "X64Emitter.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace IGCS
+{
+	// A register, or the qword at [register + displacement], an interceptor stores in a field of the control block, e.g. g_controlBlock.pmStructAddress.
+	struct InterceptorCapture
+	{
+		void* destination = nullptr;			// the 8 byte field to store the value in. nullptr: nothing is captured.
+		X64Register source = X64Register::Rax;
+		bool isDereferenced = false;
+		int32_t displacement = 0;
+	};
+
+	// Describes what an interceptor does, so its stub can be generated at runtime instead of written in asm. An interceptor captures a value
+	// before and/or after it executes the instructions overwritten by its hook, and can skip some of those instructions while the camera is
+	// enabled, optionally only if a register equals the qword at an address, e.g. the address of the camera struct. Afterwards it continues in
+	// the game's code at continueOffset from the hook.
+	struct InterceptorDescriptor
+	{
+		const char* blockName = nullptr;
+		uint32_t continueOffset = 0;			// 0: continue after the whole instructions overwritten by the hook.
+		InterceptorCapture captureBefore;
+		InterceptorCapture captureAfter;
+		uint32_t instructionsSkippedWhileCameraEnabled = 0;		// bit n set: the n-th overwritten instruction isn't executed.
+		const void* skipOnlyIfRegisterEquals = nullptr;			// if set, instructions are only skipped if skipConditionRegister equals the qword here.
+		X64Register skipConditionRegister = X64Register::Rax;
+	};
+}
+
+// Generates the code of interceptor stubs from their descriptors. The overwritten instructions are copied into the stub with their rip relative
+// operands and branches relocated, branches to other overwritten instructions stay within the stub. Doesn't depend on windows headers, so 
+// the generated code can be checked outside the camera dll too.
+namespace IGCS::InterceptorStubBuilder
+{
+	bool buildStub(const InterceptorDescriptor& descriptor, const uint8_t* hookAddress, uint32_t continueOffset, const uint8_t* cameraEnabledFlag,
+				   uint64_t* hitCounter, uintptr_t stubAddress, std::vector<uint8_t>& stubCode, std::string& errorDescription);
+}
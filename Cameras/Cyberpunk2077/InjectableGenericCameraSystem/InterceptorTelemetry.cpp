@@ -0,0 +1,127 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+#include "InterceptorTelemetry.h"
+#include "Defaults.h"
+#include "MessageHandler.h"
+#include "NamedPipeManager.h"
+#include <algorithm>
+#include <atomic>
+
+using namespace std;
+
+namespace IGCS
+{
+	static InterceptorHitCounter _hitCounters[IGCS_MAX_INTERCEPTOR_HIT_COUNTERS];
+	// counts the hits of the interceptors registered once all counters are in use. Not reported.
+	static InterceptorHitCounter _overflowHitCounter;
+
+	InterceptorTelemetry::InterceptorTelemetry() : _intervalStartTick(0), _numberOfUpdatesInInterval(0), _updatesPerSecond(0.0)
+	{
+	}
+
+
+	InterceptorTelemetry::~InterceptorTelemetry()
+	{
+	}
+
+
+	InterceptorTelemetry& InterceptorTelemetry::instance()
+	{
+		static InterceptorTelemetry theInstance;
+		return theInstance;
+	}
+
+
+	// Returns the hit counter for the interceptor with the name specified, e.g. the name of its block, for the interceptor to increment. An 
+	// interceptor registered again, e.g. when its hook is set again, gets the same counter.
+	uint64_t* InterceptorTelemetry::registerInterceptor(const string& name)
+	{
+		lock_guard<mutex> lock(_mutex);
+		auto existingName = find(_names.begin(), _names.end(), name);
+		if (existingName != _names.end())
+		{
+			return &_hitCounters[existingName - _names.begin()].numberOfHits;
+		}
+		if (_names.size() >= IGCS_MAX_INTERCEPTOR_HIT_COUNTERS)
+		{
+			MessageHandler::logDebug("No hit counter left for interceptor %s, its hits aren't reported.", name.c_str());
+			return &_overflowHitCounter.numberOfHits;
+		}
+		_names.push_back(name);
+		_hitsAtIntervalStart.push_back(atomic_ref<uint64_t>(_hitCounters[_names.size() - 1].numberOfHits).load(memory_order_relaxed));
+		_hitRates.push_back({});
+		return &_hitCounters[_names.size() - 1].numberOfHits;
+	}
+
+
+	// Called by the main loop every camera update. Counts the update and, once per IGCS_INTERCEPTOR_TELEMETRY_INTERVAL ms, turns the hits of
+	// the interval into rates. Per update this is only an increment and a compare.
+	void InterceptorTelemetry::update(ULONGLONG currentTick)
+	{
+		if (0 == _intervalStartTick)
+		{
+			_intervalStartTick = currentTick;
+			return;
+		}
+		_numberOfUpdatesInInterval++;
+		const ULONGLONG intervalLength = currentTick - _intervalStartTick;
+		if (intervalLength < IGCS_INTERCEPTOR_TELEMETRY_INTERVAL)
+		{
+			return;
+		}
+		lock_guard<mutex> lock(_mutex);
+		const double intervalInSeconds = static_cast<double>(intervalLength) / 1000.0;
+		for (size_t i = 0; i < _names.size(); i++)
+		{
+			const uint64_t numberOfHits = atomic_ref<uint64_t>(_hitCounters[i].numberOfHits).load(memory_order_relaxed);
+			const double hitsInInterval = static_cast<double>(numberOfHits - _hitsAtIntervalStart[i]);
+			_hitRates[i] = { numberOfHits, hitsInInterval / intervalInSeconds, hitsInInterval / static_cast<double>(_numberOfUpdatesInInterval) };
+			_hitsAtIntervalStart[i] = numberOfHits;
+		}
+		_updatesPerSecond = static_cast<double>(_numberOfUpdatesInInterval) / intervalInSeconds;
+		_intervalStartTick = currentTick;
+		_numberOfUpdatesInInterval = 0;
+	}
+
+
+	// Sends the hits and hit rates of all interceptors, measured over the last interval, to the client, which shows them on its diagnostics page.
+	void InterceptorTelemetry::reportHitRates()
+	{
+		lock_guard<mutex> lock(_mutex);
+		if (_names.empty())
+		{
+			NamedPipeManager::instance().writeInterceptorHitRate(0, 0, "", {}, _updatesPerSecond);
+			return;
+		}
+		for (size_t i = 0; i < _names.size(); i++)
+		{
+			NamedPipeManager::instance().writeInterceptorHitRate((uint8_t)i, (uint8_t)_names.size(), _names[i], _hitRates[i], _updatesPerSecond);
+		}
+	}
+}
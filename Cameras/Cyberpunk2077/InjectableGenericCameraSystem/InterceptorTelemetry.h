@@ -0,0 +1,79 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include "stdafx.h"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace IGCS
+{
+	#define IGCS_MAX_INTERCEPTOR_HIT_COUNTERS		64
+
+	// The number of times an interceptor was hit. Incremented by the interceptor itself with a lock inc. Every counter has its own cache line,
+	// so interceptors hit on different threads don't contend for the same line.
+	struct alignas(64) InterceptorHitCounter
+	{
+		uint64_t numberOfHits;
+	};
+
+	// The hits of an interceptor and its hit rates over the last telemetry interval.
+	struct InterceptorHitRate
+	{
+		uint64_t numberOfHits = 0;			// since the interceptor was hooked.
+		double hitsPerSecond = 0.0;
+		double hitsPerUpdate = 0.0;			// per camera update, i.e. iteration of the main loop of the camera.
+	};
+
+	// Keeps a hit counter per interceptor and turns the counts into hits per second and hits per camera update, so interceptors which are hit
+	// a lot, and hooks which aren't hit at all anymore after a game patch, can be spotted. A camera update is an iteration of the main loop of
+	// the camera, which sleeps FRAME_SLEEP ms per iteration, so it's not a frame of the game. The rates are updated by the main loop every 
+	// IGCS_INTERCEPTOR_TELEMETRY_INTERVAL ms and reported over the named pipe.
+	class InterceptorTelemetry
+	{
+	public:
+		InterceptorTelemetry();
+		~InterceptorTelemetry();
+
+		static InterceptorTelemetry& instance();
+
+		uint64_t* registerInterceptor(const std::string& name);
+		void update(ULONGLONG currentTick);
+		void reportHitRates();
+
+	private:
+		std::mutex _mutex;
+		std::vector<std::string> _names;				// per counter in use.
+		std::vector<uint64_t> _hitsAtIntervalStart;		// per counter in use.
+		std::vector<InterceptorHitRate> _hitRates;		// per counter in use.
+		ULONGLONG _intervalStartTick;
+		uint64_t _numberOfUpdatesInInterval;
+		double _updatesPerSecond;
+	};
+}
@@ -36,27 +36,47 @@ using namespace IGCS;
 
 DWORD WINAPI MainThread(LPVOID lpParam);
 
+static HANDLE _mainThreadHandle = nullptr;
+
 BOOL APIENTRY DllMain(HMODULE hModule, DWORD  reason, LPVOID lpReserved)
 {
 	DWORD threadID;
-	HANDLE threadHandle;
 
 	DisableThreadLibraryCalls(hModule);
 
 	switch (reason)
 	{
 		case DLL_PROCESS_ATTACH:
-			threadHandle = CreateThread(nullptr, 0, MainThread, hModule, 0, &threadID);
-			SetThreadPriority(threadHandle, THREAD_PRIORITY_ABOVE_NORMAL);
+			_mainThreadHandle = CreateThread(nullptr, 0, MainThread, hModule, 0, &threadID);
+			SetThreadPriority(_mainThreadHandle, THREAD_PRIORITY_ABOVE_NORMAL);
 			break;
 		case DLL_PROCESS_DETACH:
-			Globals::instance().systemActive(false);
+			// nothing is done here: the loader lock is held, so our threads can't be waited for. To free the dll while the game keeps running, 
+			// UnloadCameraSystem has to be called first. When the process exits, nothing runs the game code anymore.
 			break;
 	}
 	return TRUE;
 }
 
 
+// Stops the camera system so the dll can be freed with FreeLibrary while the game keeps running, e.g. to inject a new build: stops the main
+// loop and waits till the main thread has stopped the other threads of the dll and restored the game's code, as our hooks jump into code 
+// which is unmapped when the dll is freed. Has the signature of a thread function, so an injector can run it with CreateRemoteThread. 
+// Must not be called from DllMain.
+extern "C" __declspec(dllexport) DWORD WINAPI UnloadCameraSystem(LPVOID lpParam)
+{
+	if (nullptr == _mainThreadHandle)
+	{
+		return 0;
+	}
+	Globals::instance().systemActive(false);
+	WaitForSingleObject(_mainThreadHandle, INFINITE);
+	CloseHandle(_mainThreadHandle);
+	_mainThreadHandle = nullptr;
+	return 0;
+}
+
+
 // lpParam gets the hModule value of the DllMain process
 DWORD WINAPI MainThread(LPVOID lpParam)
 {
@@ -0,0 +1,246 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "MemorySource.h"
+#include "PEImageInfo.h"
+#ifdef _WIN32
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#include <windows.h>
+#endif
+#ifdef __linux__
+	#include <cstdio>
+	#include <fstream>
+	#include <string>
+#endif
+
+using namespace std;
+
+namespace IGCS
+{
+#ifdef _WIN32
+	#define MEMORY_READABLE_PROTECTION		(PAGE_READONLY | PAGE_READWRITE | PAGE_WRITECOPY | PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY)
+	#define MEMORY_EXECUTABLE_PROTECTION	(PAGE_EXECUTE | PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY)
+	#define MEMORY_WRITABLE_PROTECTION		(PAGE_READWRITE | PAGE_WRITECOPY | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY)
+#endif
+
+	static bool rangesOverlap(const uint8_t* startA, size_t sizeA, const uint8_t* startB, size_t sizeB)
+	{
+		return startA < startB + sizeB && startB < startA + sizeA;
+	}
+
+
+	// Returns the ranges of the image to scan for patterns. Patterns of hooks target code, so by default these are the executable sections of
+	// the image, followed by the executable regions which aren't part of an executable section, e.g. code unpacked by a protector. If 
+	// includeNonCodeSections is true or no code is found, it's the whole image. Only the readable parts of these ranges are returned, so a 
+	// scan never touches guard or no-access pages. On a fully readable image the ranges are the executable sections, same as before regions
+	// were taken into account.
+	vector<AOBScanRange> MemorySource::determineScanRanges(const uint8_t* imageBase, size_t imageSize, bool includeNonCodeSections) const
+	{
+		vector<MemoryRegion> regions;
+		if (!enumerateRegions(imageBase, imageSize, regions))
+		{
+			// nothing known about the memory of the image, so it's treated as one readable range.
+			regions.clear();
+			regions.push_back({ imageBase, imageSize, true, true, false });
+		}
+		// adjacent readable regions are merged, so patterns which span two regions with a different protection are found.
+		vector<AOBScanRange> readableRanges;
+		for (auto& region : regions)
+		{
+			if (!region.isReadable || 0 == region.size)
+			{
+				continue;
+			}
+			if (!readableRanges.empty() && readableRanges.back().start + readableRanges.back().size == region.start)
+			{
+				readableRanges.back().size += region.size;
+				continue;
+			}
+			readableRanges.push_back({ region.start, region.size });
+		}
+
+		vector<AOBScanRange> wantedRanges;
+		if (!includeNonCodeSections)
+		{
+			// the headers can only be read if the image starts with a readable range.
+			const size_t readableHeaderSize = (!readableRanges.empty() && readableRanges.front().start == imageBase) ? readableRanges.front().size : 0;
+			PEImageInfo imageInfo;
+			if (imageInfo.parse(imageBase, readableHeaderSize))
+			{
+				for (auto& section : imageInfo.sections())
+				{
+					if (!section.isExecutable() || section.virtualAddress >= imageSize)
+					{
+						continue;
+					}
+					const size_t sectionSize = (section.virtualSize > imageSize - section.virtualAddress) ? imageSize - section.virtualAddress : section.virtualSize;
+					wantedRanges.push_back({ imageBase + section.virtualAddress, sectionSize });
+				}
+			}
+			const size_t numberOfSectionRanges = wantedRanges.size();
+			for (auto& region : regions)
+			{
+				if (!region.isExecutable)
+				{
+					continue;
+				}
+				bool isPartOfSection = false;
+				for (size_t i = 0; i < numberOfSectionRanges && !isPartOfSection; i++)
+				{
+					isPartOfSection = rangesOverlap(region.start, region.size, wantedRanges[i].start, wantedRanges[i].size);
+				}
+				if (!isPartOfSection)
+				{
+					wantedRanges.push_back({ region.start, region.size });
+				}
+			}
+		}
+		if (wantedRanges.empty())
+		{
+			wantedRanges.push_back({ imageBase, imageSize });
+		}
+
+		vector<AOBScanRange> toReturn;
+		for (auto& wantedRange : wantedRanges)
+		{
+			for (auto& readableRange : readableRanges)
+			{
+				if (!rangesOverlap(wantedRange.start, wantedRange.size, readableRange.start, readableRange.size))
+				{
+					continue;
+				}
+				const uint8_t* start = (wantedRange.start > readableRange.start) ? wantedRange.start : readableRange.start;
+				const uint8_t* wantedEnd = wantedRange.start + wantedRange.size;
+				const uint8_t* readableEnd = readableRange.start + readableRange.size;
+				const uint8_t* end = (wantedEnd < readableEnd) ? wantedEnd : readableEnd;
+				toReturn.push_back({ start, static_cast<size_t>(end - start) });
+			}
+		}
+		return toReturn;
+	}
+
+
+	// The whole image is readable. The executable sections are executable regions, everything else, like the headers, is a readable region.
+	bool ImageMemorySource::enumerateRegions(const uint8_t* start, size_t size, vector<MemoryRegion>& regions) const
+	{
+		regions.clear();
+		PEImageInfo imageInfo;
+		size_t offset = 0;
+		if (imageInfo.parse(start, size))
+		{
+			for (auto& section : imageInfo.sections())
+			{
+				if (!section.isExecutable() || section.virtualAddress < offset || section.virtualAddress >= size)
+				{
+					continue;
+				}
+				const size_t sectionSize = (section.virtualSize > size - section.virtualAddress) ? size - section.virtualAddress : section.virtualSize;
+				if (section.virtualAddress > offset)
+				{
+					regions.push_back({ start + offset, section.virtualAddress - offset, true, false, false });
+				}
+				regions.push_back({ start + section.virtualAddress, sectionSize, true, true, false });
+				offset = section.virtualAddress + sectionSize;
+			}
+		}
+		if (offset < size)
+		{
+			regions.push_back({ start + offset, size - offset, true, false, false });
+		}
+		return true;
+	}
+
+
+#ifdef _WIN32
+	// Walks the regions of the range with VirtualQuery. Only committed memory without PAGE_GUARD or PAGE_NOACCESS and with a readable protection
+	// is readable. If VirtualQuery fails halfway, the rest of the range is left out, so it's not scanned.
+	bool VirtualQueryMemorySource::enumerateRegions(const uint8_t* start, size_t size, vector<MemoryRegion>& regions) const
+	{
+		regions.clear();
+		const uint8_t* end = start + size;
+		const uint8_t* address = start;
+		while (address < end)
+		{
+			MEMORY_BASIC_INFORMATION memoryInfo;
+			if (0 == VirtualQuery(address, &memoryInfo, sizeof(memoryInfo)))
+			{
+				break;
+			}
+			const uint8_t* regionEnd = static_cast<const uint8_t*>(memoryInfo.BaseAddress) + memoryInfo.RegionSize;
+			if (regionEnd > end)
+			{
+				regionEnd = end;
+			}
+			const DWORD protection = memoryInfo.Protect;
+			const bool isAccessible = MEM_COMMIT == memoryInfo.State && 0 == (protection & (PAGE_GUARD | PAGE_NOACCESS));
+			regions.push_back({ address, static_cast<size_t>(regionEnd - address), isAccessible && 0 != (protection & MEMORY_READABLE_PROTECTION),
+								isAccessible && 0 != (protection & MEMORY_EXECUTABLE_PROTECTION), isAccessible && 0 != (protection & MEMORY_WRITABLE_PROTECTION) });
+			address = regionEnd;
+		}
+		return !regions.empty();
+	}
+#endif
+
+
+#ifdef __linux__
+	// Reads the mappings of the process from /proc/self/maps. Memory which isn't mapped isn't listed, so it's left out.
+	bool ProcMapsMemorySource::enumerateRegions(const uint8_t* start, size_t size, vector<MemoryRegion>& regions) const
+	{
+		regions.clear();
+		ifstream mapsFile("/proc/self/maps");
+		if (!mapsFile)
+		{
+			return false;
+		}
+		const uintptr_t rangeStart = reinterpret_cast<uintptr_t>(start);
+		const uintptr_t rangeEnd = rangeStart + size;
+		string line;
+		while (getline(mapsFile, line))
+		{
+			// e.g. 7f2c4a1d2000-7f2c4a1f4000 r-xp 00000000 08:01 1234 /usr/lib/libc.so.6
+			unsigned long long mappingStart = 0;
+			unsigned long long mappingEnd = 0;
+			char permissions[5] = {};
+			if (sscanf(line.c_str(), "%llx-%llx %4s", &mappingStart, &mappingEnd, permissions) != 3)
+			{
+				continue;
+			}
+			const uintptr_t regionStart = (mappingStart > rangeStart) ? static_cast<uintptr_t>(mappingStart) : rangeStart;
+			const uintptr_t regionEnd = (mappingEnd < rangeEnd) ? static_cast<uintptr_t>(mappingEnd) : rangeEnd;
+			if (regionStart >= regionEnd)
+			{
+				continue;
+			}
+			regions.push_back({ reinterpret_cast<const uint8_t*>(regionStart), regionEnd - regionStart, 'r' == permissions[0], 'x' == permissions[2],
+								'w' == permissions[1] });
+		}
+		return true;
+	}
+#endif
+}
@@ -0,0 +1,85 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "AOBScanEngine.h"
+
+namespace IGCS
+{
+	// A range of memory with the same protection.
+	struct MemoryRegion
+	{
+		const uint8_t* start;
+		size_t size;
+		bool isReadable;		// committed and readable, so it can be read without faulting. Guard pages and no-access pages aren't readable.
+		bool isExecutable;
+		bool isWritable;
+	};
+
+	// Provides the memory regions of an image, so the image can be scanned without touching memory which isn't readable, e.g. guard pages
+	// or the no-access pages of a packed or protected executable, and code in regions which aren't described by the sections of the image
+	// can be found. 
+	class MemorySource
+	{
+	public:
+		virtual ~MemorySource() {}
+
+		// Fills regions with the regions overlapping [start, start + size), clipped to that range and sorted on address. Memory which isn't
+		// mapped may be left out. Returns false if the regions can't be determined.
+		virtual bool enumerateRegions(const uint8_t* start, size_t size, std::vector<MemoryRegion>& regions) const = 0;
+
+		std::vector<AOBScanRange> determineScanRanges(const uint8_t* imageBase, size_t imageSize, bool includeNonCodeSections) const;
+	};
+
+	// An image which is fully readable, e.g. an executable loaded from a file by a tool. The regions are the headers and sections of the image.
+	class ImageMemorySource : public MemorySource
+	{
+	public:
+		bool enumerateRegions(const uint8_t* start, size_t size, std::vector<MemoryRegion>& regions) const override;
+	};
+
+#ifdef _WIN32
+	// The regions of memory in the current process, determined with VirtualQuery.
+	class VirtualQueryMemorySource : public MemorySource
+	{
+	public:
+		bool enumerateRegions(const uint8_t* start, size_t size, std::vector<MemoryRegion>& regions) const override;
+	};
+#endif
+
+#ifdef __linux__
+	// The regions of memory in the current process, read from /proc/self/maps. Used to test the region handling on Linux.
+	class ProcMapsMemorySource : public MemorySource
+	{
+	public:
+		bool enumerateRegions(const uint8_t* start, size_t size, std::vector<MemoryRegion>& regions) const override;
+	};
+#endif
+}
@@ -0,0 +1,265 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+#include "ModuleLoadWatcher.h"
+#include "Utils.h"
+#include "MessageHandler.h"
+#include <algorithm>
+#include <cctype>
+
+using namespace std;
+
+namespace IGCS
+{
+	// The dll notification api of the loader isn't in the sdk headers. See LdrRegisterDllNotification on MSDN. 
+	#define LDR_DLL_NOTIFICATION_REASON_LOADED		1
+	#define LDR_DLL_NOTIFICATION_REASON_UNLOADED	2
+
+	struct LdrUnicodeString
+	{
+		USHORT length;				// in bytes
+		USHORT maximumLength;
+		PWSTR buffer;
+	};
+
+	// Same layout for the loaded and the unloaded notification.
+	struct LdrDllNotificationData
+	{
+		ULONG flags;
+		const LdrUnicodeString* fullDllName;
+		const LdrUnicodeString* baseDllName;
+		void* dllBase;
+		ULONG sizeOfImage;
+	};
+
+	typedef void (CALLBACK* LdrDllNotificationFunction)(ULONG notificationReason, const void* notificationData, void* context);
+	typedef LONG (NTAPI* LdrRegisterDllNotificationFunction)(ULONG flags, LdrDllNotificationFunction notificationFunction, void* context, void** cookie);
+	typedef LONG (NTAPI* LdrUnregisterDllNotificationFunction)(void* cookie);
+
+
+	ModuleLoadWatcher::ModuleLoadWatcher() : _notificationCookie{ nullptr }, _stopping{ false }
+	{
+	}
+
+
+	ModuleLoadWatcher::~ModuleLoadWatcher()
+	{
+		stop();
+	}
+
+
+	// Registers for the dll notifications of the loader and starts the thread which calls loadedHandler for every watched module which is 
+	// loaded, and unloadedHandler for every watched module which was handled by loadedHandler and is unloaded. Returns false if the notifications aren't available, in which case modules loaded later aren't handled.
+	bool ModuleLoadWatcher::start(ModuleLoadedHandler loadedHandler, ModuleUnloadedHandler unloadedHandler)
+	{
+		if (_watcherThread.joinable())
+		{
+			return true;
+		}
+		_loadedHandler = loadedHandler;
+		_unloadedHandler = unloadedHandler;
+		_stopping = false;
+		HMODULE ntdllModule = GetModuleHandleA("ntdll.dll");
+		LdrRegisterDllNotificationFunction registerFunction = (nullptr == ntdllModule) ? nullptr 
+																					   : (LdrRegisterDllNotificationFunction)GetProcAddress(ntdllModule, "LdrRegisterDllNotification");
+		if (nullptr == registerFunction || 0 != registerFunction(0, &ModuleLoadWatcher::dllNotificationCallback, this, &_notificationCookie))
+		{
+			MessageHandler::logError("Can't register for dll load notifications, blocks in modules which are loaded later won't be resolved.");
+			_notificationCookie = nullptr;
+			return false;
+		}
+		_watcherThread = thread(&ModuleLoadWatcher::watcherLoop, this);
+		return true;
+	}
+
+
+	// Adds the modules specified to the modules to watch. Modules which are already loaded are queued right away, as the caller might have
+	// checked whether they were loaded before the watcher was started. Module names are compared case insensitive.
+	void ModuleLoadWatcher::watch(const vector<string>& moduleNames)
+	{
+		{
+			lock_guard<mutex> lock(_queueMutex);
+			for (auto& moduleName : moduleNames)
+			{
+				_watchedModuleNames[toLowerCase(moduleName)] = moduleName;
+			}
+		}
+		// GetModuleHandle takes the loader lock, so the queue lock can't be held here: the notification callback takes the queue lock while
+		// the loader holds the loader lock.
+		for (auto& moduleName : moduleNames)
+		{
+			MODULEINFO moduleInfo = Utils::getModuleInfoOfDll(moduleName);
+			if (nullptr != moduleInfo.lpBaseOfDll)
+			{
+				queueModule(toLowerCase(moduleName), (LPBYTE)moduleInfo.lpBaseOfDll, moduleInfo.SizeOfImage);
+			}
+		}
+	}
+
+
+	// Adds the modules specified, which are loaded and were handled by the caller, to the modules to watch. They're not queued for the loaded
+	// handler now, only for the unloaded handler when they're unloaded, and for the loaded handler again when they're loaded again.
+	void ModuleLoadWatcher::watchLoaded(const vector<string>& moduleNames)
+	{
+		lock_guard<mutex> lock(_queueMutex);
+		for (auto& moduleName : moduleNames)
+		{
+			_watchedModuleNames[toLowerCase(moduleName)] = moduleName;
+			_queuedModuleNames.insert(toLowerCase(moduleName));
+		}
+	}
+
+
+	// Unregisters the dll notifications and stops the watcher thread after the module it's handling, if any, has been handled. 
+	void ModuleLoadWatcher::stop()
+	{
+		if (nullptr != _notificationCookie)
+		{
+			HMODULE ntdllModule = GetModuleHandleA("ntdll.dll");
+			LdrUnregisterDllNotificationFunction unregisterFunction = (nullptr == ntdllModule) ? nullptr 
+																							   : (LdrUnregisterDllNotificationFunction)GetProcAddress(ntdllModule, "LdrUnregisterDllNotification");
+			if (nullptr != unregisterFunction)
+			{
+				unregisterFunction(_notificationCookie);
+			}
+			_notificationCookie = nullptr;
+		}
+		{
+			lock_guard<mutex> lock(_queueMutex);
+			_stopping = true;
+		}
+		_moduleQueued.notify_all();
+		if (_watcherThread.joinable())
+		{
+			_watcherThread.join();
+		}
+	}
+
+
+	void CALLBACK ModuleLoadWatcher::dllNotificationCallback(ULONG notificationReason, const void* notificationData, void* context)
+	{
+		static_cast<ModuleLoadWatcher*>(context)->handleDllNotification(notificationReason, notificationData);
+	}
+
+
+	string ModuleLoadWatcher::toLowerCase(const string& toConvert)
+	{
+		string toReturn = toConvert;
+		for (auto& character : toReturn)
+		{
+			character = static_cast<char>(tolower(static_cast<unsigned char>(character)));
+		}
+		return toReturn;
+	}
+
+
+	// Called by the loader with the loader lock held, so the module is only queued. A module which is unloaded before it was handled is 
+	// removed from the queue, otherwise it's queued for the unloaded handler. Either way it's handled again when it's loaded again.
+	void ModuleLoadWatcher::handleDllNotification(ULONG notificationReason, const void* notificationData)
+	{
+		const LdrDllNotificationData* data = static_cast<const LdrDllNotificationData*>(notificationData);
+		if (nullptr == data || nullptr == data->baseDllName || nullptr == data->baseDllName->buffer)
+		{
+			return;
+		}
+		// module names are ascii, so the name is narrowed per character.
+		string moduleName;
+		for (USHORT i = 0; i < data->baseDllName->length / sizeof(WCHAR); i++)
+		{
+			const WCHAR character = data->baseDllName->buffer[i];
+			moduleName += (character < 0x80) ? static_cast<char>(tolower(character)) : '?';
+		}
+		switch (notificationReason)
+		{
+		case LDR_DLL_NOTIFICATION_REASON_LOADED:
+			queueModule(moduleName, (LPBYTE)data->dllBase, data->sizeOfImage);
+			break;
+		case LDR_DLL_NOTIFICATION_REASON_UNLOADED:
+			{
+				lock_guard<mutex> lock(_queueMutex);
+				if (_queuedModuleNames.erase(moduleName) > 0)
+				{
+					const string& watchedModuleName = _watchedModuleNames[moduleName];
+					auto isUnloadedModule = [&](const QueuedModule& queuedModule) { return queuedModule.moduleName == watchedModuleName; };
+					const size_t numberOfQueuedModules = _moduleQueue.size();
+					_moduleQueue.erase(remove_if(_moduleQueue.begin(), _moduleQueue.end(), isUnloadedModule), _moduleQueue.end());
+					if (_moduleQueue.size() == numberOfQueuedModules && !_stopping)
+					{
+						// the module was handled or is being handled, so it might have been hooked.
+						_moduleQueue.push_back({ watchedModuleName, (LPBYTE)data->dllBase, data->sizeOfImage, true });
+					}
+				}
+			}
+			_moduleQueued.notify_one();
+			break;
+		}
+	}
+
+
+	// Queues the module specified for the handler if it's watched and wasn't queued since it was loaded. moduleName is in lower case.
+	void ModuleLoadWatcher::queueModule(const string& moduleName, LPBYTE imageAddress, DWORD imageSize)
+	{
+		{
+			lock_guard<mutex> lock(_queueMutex);
+			auto watchedModule = _watchedModuleNames.find(moduleName);
+			if (_stopping || watchedModule == _watchedModuleNames.end() || !_queuedModuleNames.insert(moduleName).second)
+			{
+				return;
+			}
+			_moduleQueue.push_back({ watchedModule->second, imageAddress, imageSize, false });
+		}
+		_moduleQueued.notify_one();
+	}
+
+
+	void ModuleLoadWatcher::watcherLoop()
+	{
+		while (true)
+		{
+			QueuedModule toHandle;
+			{
+				unique_lock<mutex> lock(_queueMutex);
+				_moduleQueued.wait(lock, [this] { return _stopping || !_moduleQueue.empty(); });
+				if (_stopping)
+				{
+					return;
+				}
+				toHandle = _moduleQueue.front();
+				_moduleQueue.pop_front();
+			}
+			if (toHandle.isUnloaded)
+			{
+				MessageHandler::logDebug("Module '%s' unloaded from %p, forgetting its hooks.", toHandle.moduleName.c_str(), (void*)toHandle.imageAddress);
+				_unloadedHandler(toHandle.moduleName, toHandle.imageAddress, toHandle.imageSize);
+				continue;
+			}
+			MessageHandler::logDebug("Module '%s' loaded at %p, resolving its blocks.", toHandle.moduleName.c_str(), (void*)toHandle.imageAddress);
+			_loadedHandler(toHandle.moduleName, toHandle.imageAddress, toHandle.imageSize);
+		}
+	}
+}
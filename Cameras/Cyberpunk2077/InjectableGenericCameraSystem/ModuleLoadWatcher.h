@@ -0,0 +1,87 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include "stdafx.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace IGCS
+{
+	// Watches for modules which are loaded into the process after the camera was started, using the dll notifications of the loader 
+	// (LdrRegisterDllNotification), so the AOB blocks in these modules can be resolved and hooked when the module appears, without blocking 
+	// the hooks in the host image. Notifications are received while the loader lock is held, so the handlers aren't called from the 
+	// notification: the module is queued and the handler is called on the watcher's own thread. A watched module which was handled and is
+	// unloaded again is queued for the unloaded handler, so the sites patched in it can be forgotten before its memory is reused.
+	class ModuleLoadWatcher
+	{
+	public:
+		typedef std::function<void(const std::string& moduleName, LPBYTE imageAddress, DWORD imageSize)> ModuleLoadedHandler;
+		typedef std::function<void(const std::string& moduleName, LPBYTE imageAddress, DWORD imageSize)> ModuleUnloadedHandler;
+
+		ModuleLoadWatcher();
+		~ModuleLoadWatcher();
+
+		bool start(ModuleLoadedHandler loadedHandler, ModuleUnloadedHandler unloadedHandler);
+		void watch(const std::vector<std::string>& moduleNames);
+		void watchLoaded(const std::vector<std::string>& moduleNames);
+		void stop();
+
+	private:
+		struct QueuedModule
+		{
+			std::string moduleName;
+			LPBYTE imageAddress;
+			DWORD imageSize;
+			bool isUnloaded;
+		};
+
+		static void CALLBACK dllNotificationCallback(ULONG notificationReason, const void* notificationData, void* context);
+		static std::string toLowerCase(const std::string& toConvert);
+		void handleDllNotification(ULONG notificationReason, const void* notificationData);
+		void queueModule(const std::string& moduleName, LPBYTE imageAddress, DWORD imageSize);
+		void watcherLoop();
+
+		std::mutex _queueMutex;
+		std::condition_variable _moduleQueued;
+		std::deque<QueuedModule> _moduleQueue;
+		std::map<std::string, std::string> _watchedModuleNames;		// the name in lower case and the name as specified to watch
+		std::set<std::string> _queuedModuleNames;		// lower case. Modules which were queued and not unloaded since, so they're handled once per load
+		ModuleLoadedHandler _loadedHandler;
+		ModuleUnloadedHandler _unloadedHandler;
+		std::thread _watcherThread;
+		void* _notificationCookie;
+		bool _stopping;
+	};
+}
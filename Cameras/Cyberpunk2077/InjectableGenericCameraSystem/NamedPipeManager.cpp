@@ -35,6 +35,10 @@
 #include "CameraManipulator.h"
 #include "Globals.h"
 #include "InputHooker.h"
+#include "ImageIndexManager.h"
+#include "CameraStructDiscovery.h"
+#include "ValueHuntManager.h"
+#include "InterceptorTelemetry.h"
 
 namespace IGCS
 {
@@ -46,7 +50,8 @@ namespace IGCS
 		return This->listenerThread();
 	}
 
-	NamedPipeManager::NamedPipeManager(): _clientToDllPipe(nullptr), _clientToDllPipeConnected(false), _dllToClientPipe(nullptr), _dllToClientPipeConnected(false)
+	NamedPipeManager::NamedPipeManager(): _clientToDllPipe(nullptr), _clientToDllPipeConnected(false), _dllToClientPipe(nullptr), _dllToClientPipeConnected(false),
+										   _listenerThreadHandle(nullptr), _isStopping(false)
 	{
 	}
 
@@ -76,12 +81,49 @@ namespace IGCS
 		}
 	}
 
+
+	// Closes the pipe to the client, so the client can be connected to again, e.g. by a new build of the dll injected after this one is unloaded.
+	void NamedPipeManager::disconnectDllToClient()
+	{
+		if (!_dllToClientPipeConnected)
+		{
+			return;
+		}
+		_dllToClientPipeConnected = false;
+		CloseHandle(_dllToClientPipe);
+		_dllToClientPipe = nullptr;
+	}
+
 	
 	void NamedPipeManager::startListening()
 	{
 		// create a thread to listen to the named pipe for messages and handle them.
 		DWORD threadID;
-		HANDLE threadHandle = CreateThread(nullptr, 0, staticListenerThread, (LPVOID)this, 0, &threadID);
+		_listenerThreadHandle = CreateThread(nullptr, 0, staticListenerThread, (LPVOID)this, 0, &threadID);
+	}
+
+
+	// Stops the listener thread and closes the pipe from the client. Called when the dll is unloaded. The listener is blocked in a connect or
+	// read most of the time, which is cancelled till the thread has seen it has to stop: it can be between two calls when one is cancelled.
+	void NamedPipeManager::stopListening()
+	{
+		if (nullptr == _listenerThreadHandle)
+		{
+			return;
+		}
+		_isStopping = true;
+		while (WAIT_TIMEOUT == WaitForSingleObject(_listenerThreadHandle, 10))
+		{
+			CancelSynchronousIo(_listenerThreadHandle);
+		}
+		CloseHandle(_listenerThreadHandle);
+		_listenerThreadHandle = nullptr;
+		if (_clientToDllPipeConnected)
+		{
+			_clientToDllPipeConnected = false;
+			CloseHandle(_clientToDllPipe);
+			_clientToDllPipe = INVALID_HANDLE_VALUE;
+		}
 	}
 
 
@@ -136,6 +178,88 @@ namespace IGCS
 	}
 
 
+	// Sends a 3 byte message: 'FeatureAvailability', the feature and 1 if it's available or 0 if it's not, so the client can enable/disable its controls.
+	void NamedPipeManager::writeFeatureAvailability(FeatureType feature, bool isAvailable)
+	{
+		if (!_dllToClientPipeConnected)
+		{
+			return;
+		}
+		uint8_t payload[3];
+		payload[0] = uint8_t(MessageType::FeatureAvailability);
+		payload[1] = uint8_t(feature);
+		payload[2] = isAvailable ? (uint8_t)1 : (uint8_t)0;
+		DWORD numberOfBytesWritten;
+		WriteFile(_dllToClientPipe, payload, sizeof(payload), &numberOfBytesWritten, nullptr);
+	}
+
+	// Sends the hits and hit rates of a single interceptor: 'InterceptorHitRate', the index of the interceptor, the number of interceptors, the number
+	// of hits (uint64), the hits per second, the hits per camera update and the camera updates per second (doubles) and the name of the interceptor as ascii text.
+	// The client collects the messages till the last interceptor has arrived. A number of interceptors of 0 means no interceptor has been hooked.
+	void NamedPipeManager::writeInterceptorHitRate(uint8_t index, uint8_t numberOfInterceptors, const std::string& name, const InterceptorHitRate& hitRate, 
+												   double updatesPerSecond)
+	{
+		if (!_dllToClientPipeConnected)
+		{
+			return;
+		}
+		uint8_t payload[IGCS_MAX_MESSAGE_SIZE];
+		payload[0] = uint8_t(MessageType::InterceptorHitRate);
+		payload[1] = index;
+		payload[2] = numberOfInterceptors;
+		memcpy(&payload[3], &hitRate.numberOfHits, sizeof(uint64_t));
+		memcpy(&payload[11], &hitRate.hitsPerSecond, sizeof(double));
+		memcpy(&payload[19], &hitRate.hitsPerUpdate, sizeof(double));
+		memcpy(&payload[27], &updatesPerSecond, sizeof(double));
+		const size_t nameLength = min(name.length(), (size_t)(IGCS_MAX_MESSAGE_SIZE - 35));
+		memcpy(&payload[35], name.c_str(), nameLength);
+		DWORD numberOfBytesWritten;
+		WriteFile(_dllToClientPipe, payload, (DWORD)(35 + nameLength), &numberOfBytesWritten, nullptr);
+	}
+
+
+	// Sends an 18 byte message: 'ImageIndexState', the state of the image index, the memory it uses in bytes (uint64) and the number of bytes of 
+	// code it covers (uint64). Both are 0 if the index isn't built.
+	void NamedPipeManager::writeImageIndexState(ImageIndexState state, uint64_t memoryUsageInBytes, uint64_t numberOfIndexedBytes)
+	{
+		if (!_dllToClientPipeConnected)
+		{
+			return;
+		}
+		uint8_t payload[18];
+		payload[0] = uint8_t(MessageType::ImageIndexState);
+		payload[1] = uint8_t(state);
+		memcpy(&payload[2], &memoryUsageInBytes, sizeof(uint64_t));
+		memcpy(&payload[10], &numberOfIndexedBytes, sizeof(uint64_t));
+		DWORD numberOfBytesWritten;
+		WriteFile(_dllToClientPipe, payload, sizeof(payload), &numberOfBytesWritten, nullptr);
+	}
+
+
+	// Sends the result of an image index query: 'ImageIndexQueryResult', the number of locations found (uint64), the query time in ms (double), 
+	// how the locations were found and the offsets of the locations to report from the image start (uint64 each). 
+	void NamedPipeManager::writeImageIndexQueryResult(uint64_t numberOfLocations, double queryTimeInMs, ImageIndexQueryMethod method, 
+													  const std::vector<uint64_t>& offsetsToReport)
+	{
+		if (!_dllToClientPipeConnected)
+		{
+			return;
+		}
+		uint8_t payload[IGCS_MAX_MESSAGE_SIZE];
+		payload[0] = uint8_t(MessageType::ImageIndexQueryResult);
+		memcpy(&payload[1], &numberOfLocations, sizeof(uint64_t));
+		memcpy(&payload[9], &queryTimeInMs, sizeof(double));
+		payload[17] = uint8_t(method);
+		const size_t numberOfOffsets = min(offsetsToReport.size(), (size_t)((IGCS_MAX_MESSAGE_SIZE - 18) / sizeof(uint64_t)));
+		if (numberOfOffsets > 0)
+		{
+			memcpy(&payload[18], offsetsToReport.data(), numberOfOffsets * sizeof(uint64_t));
+		}
+		DWORD numberOfBytesWritten;
+		WriteFile(_dllToClientPipe, payload, (DWORD)(18 + numberOfOffsets * sizeof(uint64_t)), &numberOfBytesWritten, nullptr);
+	}
+
+
 	DWORD NamedPipeManager::listenerThread()
 	{
 		// Set security ACLs as by default the connecting party has to be admin.
@@ -169,7 +293,7 @@ namespace IGCS
 			Console::WriteError("Couldn't create the Client -> DLL named pipe.");
 			return 1;
 		}
-		while (_clientToDllPipe != INVALID_HANDLE_VALUE)
+		while (!_isStopping)
 		{
 			auto connectResult = ConnectNamedPipe(_clientToDllPipe, nullptr);
 			if(connectResult!=0 || GetLastError()==ERROR_PIPE_CONNECTED)
@@ -223,6 +347,32 @@ namespace IGCS
 		case ActionMessageType::RehookXInput:
 			InputHooker::setXInputHook(true);
 			break;
+		case ActionMessageType::BuildImageIndex:
+			ImageIndexManager::instance().buildIndexInBackground();
+			break;
+		case ActionMessageType::QueryImageIndex:
+			// payload is the pattern as text, not zero terminated. payload starts at offset 2 in buffer.
+			ImageIndexManager::instance().queryPattern(std::string((char*)(buffer + 2), bytesRead - 2));
+			break;
+		case ActionMessageType::DiscardImageIndex:
+			ImageIndexManager::instance().discardIndex();
+			break;
+		case ActionMessageType::DiscoverCameraStruct:
+			CameraStructDiscovery::instance().startDiscovery();
+			break;
+		case ActionMessageType::StartValueHunt:
+			// payload is the value type and optional range as text, not zero terminated. payload starts at offset 2 in buffer.
+			ValueHuntManager::instance().startHunt(std::string((char*)(buffer + 2), bytesRead - 2));
+			break;
+		case ActionMessageType::NarrowValueHunt:
+			ValueHuntManager::instance().narrowHunt(std::string((char*)(buffer + 2), bytesRead - 2));
+			break;
+		case ActionMessageType::DiscardValueHunt:
+			ValueHuntManager::instance().discardHunt();
+			break;
+		case ActionMessageType::ReportInterceptorHits:
+			InterceptorTelemetry::instance().reportHitRates();
+			break;
 		case ActionMessageType::ResizeViewport:
 			// payload is 2x4 bytes which are width and height. payload starts at offset 2 in buffer.
 			int* intArrayInBuffer = (int*)(buffer + 2);
@@ -27,8 +27,11 @@
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma once
 #include "stdafx.h"
+#include <atomic>
 #include <string>
+#include <vector>
 #include "Defaults.h"
+#include "InterceptorTelemetry.h"
 
 namespace IGCS
 {
@@ -41,12 +44,18 @@ namespace IGCS
 		static NamedPipeManager& instance();
 
 		void connectDllToClient();
+		void disconnectDllToClient();
 		void startListening();
+		void stopListening();
 		void writeTextPayload(const std::string& messageText, MessageType typeOfMessage);
 		void writeMessage(const std::string& messageText);
 		void writeMessage(const std::string& messageText, bool isError);
 		void writeMessage(const std::string& messageText, bool isError, bool isDebug);
 		void writeNotification(const std::string& notificationText);
+		void writeFeatureAvailability(FeatureType feature, bool isAvailable);
+		void writeInterceptorHitRate(uint8_t index, uint8_t numberOfInterceptors, const std::string& name, const InterceptorHitRate& hitRate, double updatesPerSecond);
+		void writeImageIndexState(ImageIndexState state, uint64_t memoryUsageInBytes, uint64_t numberOfIndexedBytes);
+		void writeImageIndexQueryResult(uint64_t numberOfLocations, double queryTimeInMs, ImageIndexQueryMethod method, const std::vector<uint64_t>& offsetsToReport);
 		DWORD listenerThread();
 
 	private:
@@ -57,6 +66,8 @@ namespace IGCS
 		HANDLE _clientToDllPipe;
 		bool _dllToClientPipeConnected;
 		bool _clientToDllPipeConnected;
+		HANDLE _listenerThreadHandle;
+		std::atomic<bool> _isStopping;
 	};
 }
 
@@ -0,0 +1,105 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "PEImageInfo.h"
+#include <cstring>
+
+namespace IGCS
+{
+	// offsets in the PE headers. See the IMAGE_DOS_HEADER, IMAGE_NT_HEADERS and IMAGE_SECTION_HEADER structures in winnt.h
+	#define PE_DOS_SIGNATURE					0x5A4D		// MZ
+	#define PE_NT_SIGNATURE						0x00004550	// PE\0\0
+	#define PE_DOS_HEADER_NEW_HEADER_OFFSET		0x3C
+	#define PE_FILE_HEADER_OFFSET				4
+	#define PE_FILE_HEADER_SIZE					20
+	#define PE_SECTION_HEADER_SIZE				40
+	#define PE_SIZE_OF_IMAGE_OFFSET				56			// in the optional header, same offset for 32 and 64 bit images
+	#define PE_SIZE_OF_HEADERS_OFFSET			60			// in the optional header, same offset for 32 and 64 bit images
+
+	template<typename T>
+	static T readValue(const uint8_t* address)
+	{
+		T toReturn;
+		memcpy(&toReturn, address, sizeof(T));
+		return toReturn;
+	}
+
+
+	PEImageInfo::PEImageInfo() : _isValid{ false }, _timeDateStamp{ 0 }, _sizeOfImage{ 0 }, _sizeOfHeaders{ 0 }
+	{
+	}
+
+
+	PEImageInfo::~PEImageInfo()
+	{
+	}
+
+
+	// Parses the headers of the image. Returns false if the image isn't a valid PE image or the headers don't fit in imageSize.
+	bool PEImageInfo::parse(const uint8_t* imageBase, size_t imageSize)
+	{
+		_isValid = false;
+		_sections.clear();
+		if (nullptr == imageBase || imageSize < PE_DOS_HEADER_NEW_HEADER_OFFSET + sizeof(uint32_t) || readValue<uint16_t>(imageBase) != PE_DOS_SIGNATURE)
+		{
+			return false;
+		}
+		const size_t ntHeadersOffset = readValue<uint32_t>(imageBase + PE_DOS_HEADER_NEW_HEADER_OFFSET);
+		if (ntHeadersOffset + PE_FILE_HEADER_OFFSET + PE_FILE_HEADER_SIZE > imageSize || readValue<uint32_t>(imageBase + ntHeadersOffset) != PE_NT_SIGNATURE)
+		{
+			return false;
+		}
+		const uint8_t* fileHeader = imageBase + ntHeadersOffset + PE_FILE_HEADER_OFFSET;
+		const uint16_t numberOfSections = readValue<uint16_t>(fileHeader + 2);
+		_timeDateStamp = readValue<uint32_t>(fileHeader + 4);
+		const uint16_t sizeOfOptionalHeader = readValue<uint16_t>(fileHeader + 16);
+		const size_t optionalHeaderOffset = ntHeadersOffset + PE_FILE_HEADER_OFFSET + PE_FILE_HEADER_SIZE;
+		const size_t sectionTableOffset = optionalHeaderOffset + sizeOfOptionalHeader;
+		if (sizeOfOptionalHeader < PE_SIZE_OF_HEADERS_OFFSET + sizeof(uint32_t) ||
+			sectionTableOffset + static_cast<size_t>(numberOfSections) * PE_SECTION_HEADER_SIZE > imageSize)
+		{
+			return false;
+		}
+		_sizeOfImage = readValue<uint32_t>(imageBase + optionalHeaderOffset + PE_SIZE_OF_IMAGE_OFFSET);
+		_sizeOfHeaders = readValue<uint32_t>(imageBase + optionalHeaderOffset + PE_SIZE_OF_HEADERS_OFFSET);
+		for (int i = 0; i < numberOfSections; i++)
+		{
+			const uint8_t* sectionHeader = imageBase + sectionTableOffset + (static_cast<size_t>(i) * PE_SECTION_HEADER_SIZE);
+			PESection section;
+			// the name is 8 bytes and not zero terminated if it's 8 characters long.
+			section.name.assign(reinterpret_cast<const char*>(sectionHeader), strnlen(reinterpret_cast<const char*>(sectionHeader), 8));
+			section.virtualSize = readValue<uint32_t>(sectionHeader + 8);
+			section.virtualAddress = readValue<uint32_t>(sectionHeader + 12);
+			section.sizeOfRawData = readValue<uint32_t>(sectionHeader + 16);
+			section.pointerToRawData = readValue<uint32_t>(sectionHeader + 20);
+			section.characteristics = readValue<uint32_t>(sectionHeader + 36);
+			_sections.push_back(section);
+		}
+		_isValid = true;
+		return true;
+	}
+}
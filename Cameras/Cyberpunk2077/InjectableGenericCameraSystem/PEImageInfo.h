@@ -0,0 +1,77 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace IGCS
+{
+	// Section characteristics flags, same values as the IMAGE_SCN_* flags in winnt.h
+	#define PE_SECTION_CONTAINS_CODE		0x00000020
+	#define PE_SECTION_MEM_EXECUTE			0x20000000
+	#define PE_SECTION_MEM_READ				0x40000000
+	#define PE_SECTION_MEM_WRITE			0x80000000
+
+	struct PESection
+	{
+		std::string name;
+		uint32_t virtualAddress = 0;		// rva of the section
+		uint32_t virtualSize = 0;
+		uint32_t pointerToRawData = 0;		// offset of the section's data in the file
+		uint32_t sizeOfRawData = 0;
+		uint32_t characteristics = 0;
+
+		bool isExecutable() const { return (characteristics & (PE_SECTION_MEM_EXECUTE | PE_SECTION_CONTAINS_CODE)) != 0; }
+	};
+
+	// Reads the headers of a PE image which is mapped in memory (so with the sections at their rva) without using the windows api, so it
+	// can be used on images loaded in the process and on images mapped by a tool. The headers are at the same location in the file on disk,
+	// so it can also parse a file as-is, e.g. to map the sections of the file to their rva using the raw data locations.
+	class PEImageInfo
+	{
+	public:
+		PEImageInfo();
+		~PEImageInfo();
+
+		bool parse(const uint8_t* imageBase, size_t imageSize);
+		bool isValid() const { return _isValid; }
+		uint32_t timeDateStamp() const { return _timeDateStamp; }
+		uint32_t sizeOfImage() const { return _sizeOfImage; }
+		uint32_t sizeOfHeaders() const { return _sizeOfHeaders; }
+		const std::vector<PESection>& sections() const { return _sections; }
+
+	private:
+		bool _isValid;
+		uint32_t _timeDateStamp;
+		uint32_t _sizeOfImage;
+		uint32_t _sizeOfHeaders;
+		std::vector<PESection> _sections;
+	};
+}
@@ -0,0 +1,189 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace IGCS
+{
+	// The maximum number of bytes in a pattern. Longer patterns are malformed.
+	#define AOB_PATTERN_MAX_SIZE			64
+
+	// A single AOB pattern with its occurrence, parsed from a string like "aa bb ?? | cc". The pattern is parsed into fixed size arrays
+	// without allocations, and the parse is constexpr, so patterns specified as literals are compiled at compile time, see compileScanPattern.
+	// This class doesn't depend on windows headers so it can be used by the scan engine in tools outside the camera dll too.
+	class ScanPattern
+	{
+	public:
+		constexpr ScanPattern() = default;
+
+		// Parses a string in the form of "aa bb ??" where '??' is a byte which has to be skipped in the comparison, and 'aa' and 'bb' are
+		// hexadecimal bytes which have to have that value at that position. If a '|' is specified in the pattern, the position of the byte
+		// following it is the start offset returned by the aob scanner, instead of the position of the first byte of the pattern. If the
+		// pattern is malformed, the pattern is left empty and isValid() will return false.
+		constexpr ScanPattern(std::string_view bytePatternAsString, int occurrence) : _occurrence{ occurrence }
+		{
+			_patternHash = calculatePatternHash(bytePatternAsString, occurrence);
+			size_t index = 0;
+			while (index < bytePatternAsString.size())
+			{
+				const char current = bytePatternAsString[index];
+				if (current == ' ')
+				{
+					index++;
+					continue;
+				}
+				if (current == '|')
+				{
+					index++;
+					_customOffset = _patternSize;
+					continue;
+				}
+				if (_patternSize >= AOB_PATTERN_MAX_SIZE)
+				{
+					markAsMalformed();
+					return;
+				}
+				if (current == '?')
+				{
+					_bytePattern[_patternSize] = 0;
+					_patternMask[_patternSize] = 0;
+					_patternSize++;
+					index += (index + 1 < bytePatternAsString.size() && bytePatternAsString[index + 1] == '?') ? 2 : 1;
+					continue;
+				}
+				const int highNibble = hexCharToNibble(current);
+				const int lowNibble = (highNibble < 0 || index + 1 >= bytePatternAsString.size()) ? -1 : hexCharToNibble(bytePatternAsString[index + 1]);
+				if (lowNibble < 0)
+				{
+					markAsMalformed();
+					return;
+				}
+				_bytePattern[_patternSize] = static_cast<uint8_t>((highNibble << 4) + lowNibble);
+				_patternMask[_patternSize] = 0xFF;
+				_patternSize++;
+				index += 2;
+			}
+		}
+
+		constexpr int occurrence() const { return _occurrence; }
+		constexpr const uint8_t* bytePattern() const { return _bytePattern.data(); }
+		constexpr const uint8_t* patternMask() const { return _patternMask.data(); }		// 0xFF for bytes to compare, 0x00 for wildcards
+		constexpr int customOffset() const { return _customOffset; }
+		constexpr int patternSize() const { return _patternSize; }
+		constexpr bool isValid() const { return _patternSize > 0; }
+		// FNV-1a hash of the pattern as specified plus its occurrence, to recognize a pattern without keeping its text around.
+		constexpr uint64_t patternHash() const { return _patternHash; }
+
+		// Returns true if the bytes at location match this pattern. location has to point to at least patternSize() readable bytes.
+		constexpr bool matchesAt(const uint8_t* location) const
+		{
+			for (int i = 0; i < _patternSize; i++)
+			{
+				if ((location[i] & _patternMask[i]) != _bytePattern[i])
+				{
+					return false;
+				}
+			}
+			return _patternSize > 0;
+		}
+
+	private:
+		static constexpr int hexCharToNibble(char c)
+		{
+			if (c >= '0' && c <= '9')
+			{
+				return c - '0';
+			}
+			if (c >= 'a' && c <= 'f')
+			{
+				return c - 'a' + 10;
+			}
+			if (c >= 'A' && c <= 'F')
+			{
+				return c - 'A' + 10;
+			}
+			return -1;
+		}
+
+		static constexpr uint64_t calculatePatternHash(std::string_view bytePatternAsString, int occurrence)
+		{
+			uint64_t hash = 0xCBF29CE484222325ULL;
+			for (char c : bytePatternAsString)
+			{
+				hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001B3ULL;
+			}
+			hash = (hash ^ static_cast<uint8_t>('#')) * 0x100000001B3ULL;
+			// the occurrence in decimal
+			char digits[12] = {};
+			int numberOfDigits = 0;
+			unsigned int value = occurrence < 0 ? static_cast<unsigned int>(-occurrence) : static_cast<unsigned int>(occurrence);
+			do
+			{
+				digits[numberOfDigits++] = static_cast<char>('0' + (value % 10));
+				value /= 10;
+			} while (value > 0);
+			if (occurrence < 0)
+			{
+				hash = (hash ^ static_cast<uint8_t>('-')) * 0x100000001B3ULL;
+			}
+			while (numberOfDigits > 0)
+			{
+				hash = (hash ^ static_cast<uint8_t>(digits[--numberOfDigits])) * 0x100000001B3ULL;
+			}
+			return hash;
+		}
+
+		constexpr void markAsMalformed()
+		{
+			_patternSize = 0;
+			_customOffset = 0;
+		}
+
+		std::array<uint8_t, AOB_PATTERN_MAX_SIZE> _bytePattern{};		// wildcard positions are 0x00
+		std::array<uint8_t, AOB_PATTERN_MAX_SIZE> _patternMask{};
+		int _patternSize = 0;
+		int _customOffset = 0;
+		int _occurrence = 0;
+		uint64_t _patternHash = 0;
+	};
+
+
+	// Compiles the pattern specified at compile time. A malformed pattern makes the throw below part of the constant evaluation, which
+	// makes it a compile error.
+	consteval ScanPattern compileScanPattern(std::string_view bytePatternAsString, int occurrence)
+	{
+		const ScanPattern toReturn(bytePatternAsString, occurrence);
+		if (!toReturn.isValid())
+		{
+			throw "Malformed AOB pattern";
+		}
+		return toReturn;
+	}
+}
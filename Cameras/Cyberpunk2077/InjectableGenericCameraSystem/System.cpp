@@ -37,12 +37,26 @@
 #include "input.h"
 #include "MinHook.h"
 #include "NamedPipeManager.h"
+#include "ImageIndexManager.h"
+#include "ValueHuntManager.h"
+#include "CameraStructDiscovery.h"
 #include "MessageHandler.h"
+#include "GameImageHooker.h"
+#include "InterceptorTelemetry.h"
+#include <algorithm>
 
 namespace IGCS
 {
 	using namespace IGCS::GameSpecific;
 
+	// Workaround for having a method as the actual thread func. See: https://stackoverflow.com/a/1372989
+	static DWORD WINAPI staticNonCriticalBlocksThread(LPVOID lpParam)
+	{
+		auto This = (System*)lpParam;
+		return This->nonCriticalBlocksThread();
+	}
+
+
 	System::System()
 	{
 	}
@@ -61,10 +75,12 @@ namespace IGCS
 		filesystem::path hostExeFilenameAndPath = Utils::obtainHostExeAndPath();
 		_hostExeFilename = hostExeFilenameAndPath.stem();
 		_hostExePath = hostExeFilenameAndPath.parent_path();
+		ImageIndexManager::instance().initialize(_hostImageAddress, _hostImageSize);
 		Globals::instance().gamePad().setInvertLStickY(CONTROLLER_Y_INVERT);
 		Globals::instance().gamePad().setInvertRStickY(CONTROLLER_Y_INVERT);
-		initialize();		// will block till camera is found
+		initialize();		// will block till camera is found or the system is stopped
 		mainLoop();
+		shutdown();
 	}
 
 
@@ -84,6 +100,14 @@ namespace IGCS
 	{
 		handleUserInput();
 		CameraManipulator::updateCameraDataInGameData(_camera);
+		const ULONGLONG currentTick = GetTickCount64();
+		InterceptorTelemetry::instance().update(currentTick);
+		// the hooks are verified at a low frequency, per frame this is only a tick count compare.
+		if (currentTick - _lastHookVerificationTick >= IGCS_HOOK_WATCHDOG_INTERVAL)
+		{
+			_lastHookVerificationTick = currentTick;
+			GameImageHooker::verifyHooks();
+		}
 	}
 
 
@@ -141,7 +165,7 @@ namespace IGCS
 		
 		if (Input::isActionActivated(ActionType::CameraEnable))
 		{
-			if (g_cameraEnabled)
+			if (loadAcquire(g_controlBlock.cameraEnabled))
 			{
 				// it's going to be disabled, make sure things are alright when we give it back to the host
 				onCameraDisabled();
@@ -151,16 +175,16 @@ namespace IGCS
 				// it's going to be enabled, so cache the original values before we enable it so we can restore it afterwards
 				onCameraEnabled();
 			}
-			g_cameraEnabled = g_cameraEnabled == 0 ? (uint8_t)1 : (uint8_t)0;
+			storeRelease(g_controlBlock.cameraEnabled, loadAcquire(g_controlBlock.cameraEnabled) == 0 ? (uint8_t)1 : (uint8_t)0);
 			displayCameraState();
 			_applyHammerPrevention = true;
 		}
 
-		if (Input::isActionActivated(ActionType::TimeOfDayEarlier, true))
+		if (Input::isActionActivated(ActionType::TimeOfDayEarlier, true) && checkFeatureAvailable(FeatureType::TimeOfDay))
 		{
 			CameraManipulator::changeTimeOfDayUsingAmount(-DEFAULT_TOD_CHANGE * (Utils::altPressed() ? 0.1f : 1.0f));
 		}
-		if (Input::isActionActivated(ActionType::TimeOfDayLater, true))
+		if (Input::isActionActivated(ActionType::TimeOfDayLater, true) && checkFeatureAvailable(FeatureType::TimeOfDay))
 		{
 			CameraManipulator::changeTimeOfDayUsingAmount(DEFAULT_TOD_CHANGE * (Utils::altPressed() ? 0.1f : 1.0f));
 		}
@@ -176,22 +200,22 @@ namespace IGCS
 		{
 			CameraManipulator::changeFoV(Globals::instance().settings().fovChangeSpeed);
 		}
-		if (Input::isActionActivated(ActionType::Timestop))
+		if (Input::isActionActivated(ActionType::Timestop) && checkFeatureAvailable(FeatureType::Timestop))
 		{
 			toggleGamePause();
 			_applyHammerPrevention = true;
 		}
-		if (Input::isActionActivated(ActionType::SkipFrames))
+		if (Input::isActionActivated(ActionType::SkipFrames) && checkFeatureAvailable(FeatureType::Timestop))
 		{
 			CameraManipulator::stepGameInPause();
 			_applyHammerPrevention = true;
 		}
-		if (Input::isActionActivated(ActionType::HudToggle))
+		if (Input::isActionActivated(ActionType::HudToggle) && checkFeatureAvailable(FeatureType::HudToggle))
 		{
 			toggleHud();
 			_applyHammerPrevention = true;
 		}
-		if (!g_cameraEnabled)
+		if (!loadAcquire(g_controlBlock.cameraEnabled))
 		{
 			// camera is disabled. We simply disable all input to the camera movement, by returning now.
 			return;
@@ -427,9 +451,17 @@ namespace IGCS
 		InputHooker::setInputHooks();
 		Input::registerRawInput();
 
-		GameSpecific::InterceptorHelper::initializeAOBBlocks(_hostImageAddress, _hostImageSize, _aobBlocks);
+		GameSpecific::InterceptorHelper::initializeAOBBlocks(_hostImageAddress, _hostImageSize, _aobBlocks, _hostExePath / IGCS_AOB_CACHE_FILENAME, 
+														 _modulesNotLoadedAtStart, _moduleIdentityAtStart);
 		GameSpecific::InterceptorHelper::setCameraStructInterceptorHook(_aobBlocks);
-		waitForCameraStructAddresses();		// blocks till camera is found.
+		// the blocks for the other features are resolved and hooked in the background, so the camera can be used in the meantime.
+		DWORD threadID;
+		_nonCriticalBlocksThreadHandle = CreateThread(nullptr, 0, staticNonCriticalBlocksThread, (LPVOID)this, 0, &threadID);
+		waitForCameraStructAddresses();		// blocks till camera is found or the system is stopped.
+		if (!Globals::instance().systemActive())
+		{
+			return;
+		}
 		GameSpecific::InterceptorHelper::setPostCameraStructHooks(_aobBlocks);
 
 		// camera struct found, init our own camera object now and hook into game code which uses camera.
@@ -442,12 +474,103 @@ namespace IGCS
 	}
 
 
-	// Waits for the interceptor to pick up the camera struct address. Should only return if address is found 
+	// Stops the other threads of the dll and restores the game's code, after the main loop has ended because the dll is about to be unloaded. 
+	// The named pipe listener is stopped first, so no new background work is started by the client while the rest is stopped.
+	void System::shutdown()
+	{
+		MessageHandler::logLine("Stopping the camera system...");
+		NamedPipeManager::instance().stopListening();
+		if (nullptr != _nonCriticalBlocksThreadHandle)
+		{
+			// resolving the blocks can't be interrupted, so this waits till the scans are done.
+			WaitForSingleObject(_nonCriticalBlocksThreadHandle, INFINITE);
+			CloseHandle(_nonCriticalBlocksThreadHandle);
+			_nonCriticalBlocksThreadHandle = nullptr;
+		}
+		_moduleLoadWatcher.stop();
+		ImageIndexManager::instance().stop();
+		ValueHuntManager::instance().stop();
+		CameraStructDiscovery::instance().stop();
+		MH_Uninitialize();
+		GameImageHooker::uninstallAllHooks();
+		Sleep(IGCS_UNLOAD_GRACE_PERIOD);
+		GameImageHooker::releaseStubArenas();
+		MessageHandler::logLine("Camera system stopped, the dll can be unloaded.");
+		NamedPipeManager::instance().disconnectDllToClient();
+	}
+
+
+	// Resolves and hooks the non-critical blocks. Runs on its own thread, started by initialize.
+	DWORD System::nonCriticalBlocksThread()
+	{
+		GameSpecific::InterceptorHelper::initializeNonCriticalAOBBlocks(_hostImageAddress, _hostImageSize, _aobBlocks, _hostExePath / IGCS_AOB_CACHE_FILENAME, 
+																		_modulesNotLoadedAtStart, _moduleIdentityAtStart);
+		GameSpecific::InterceptorHelper::setNonCriticalHooks(_aobBlocks);
+		const vector<string> modulesOfBlocks = GameSpecific::InterceptorHelper::determineModulesOfBlocks(_aobBlocks);
+		vector<string> modulesLoadedAtStart;
+		for (auto& moduleName : modulesOfBlocks)
+		{
+			if (find(_modulesNotLoadedAtStart.begin(), _modulesNotLoadedAtStart.end(), moduleName) == _modulesNotLoadedAtStart.end())
+			{
+				modulesLoadedAtStart.push_back(moduleName);
+			}
+		}
+		if (!modulesOfBlocks.empty())
+		{
+			// the blocks in modules loaded later on are resolved and hooked on the watcher's thread when the loader reports the module. The
+			// hooks in a module which is unloaded are forgotten there too, as its memory is gone. The modules loaded at start are watched
+			// before they're hooked, so an unload while they're hooked is seen.
+			_moduleLoadWatcher.start([this](const string& moduleName, LPBYTE moduleImageAddress, DWORD moduleImageSize)
+									 {
+										 GameSpecific::InterceptorHelper::initializeModuleAOBBlocks(moduleName, moduleImageAddress, moduleImageSize, _aobBlocks, 
+																									_hostExePath / IGCS_AOB_CACHE_FILENAME);
+										 GameSpecific::InterceptorHelper::setModuleHooks(moduleName, _aobBlocks);
+									 },
+									 [this](const string& moduleName, LPBYTE moduleImageAddress, DWORD moduleImageSize)
+									 {
+										 GameSpecific::InterceptorHelper::handleModuleUnloaded(moduleName, moduleImageAddress, moduleImageSize, _aobBlocks);
+									 });
+			_moduleLoadWatcher.watchLoaded(modulesLoadedAtStart);
+		}
+		for (auto& moduleName : modulesLoadedAtStart)
+		{
+			GameSpecific::InterceptorHelper::setModuleHooks(moduleName, _aobBlocks);
+		}
+		if (!_modulesNotLoadedAtStart.empty())
+		{
+			_moduleLoadWatcher.watch(_modulesNotLoadedAtStart);
+		}
+		if (IGCS_BUILD_IMAGE_INDEX_AT_STARTUP)
+		{
+			ImageIndexManager::instance().buildIndex();
+		}
+		return 0;
+	}
+
+
+	// Returns true if the feature specified is available. If not, e.g. because its hooks haven't been set yet, the user is notified. 
+	bool System::checkFeatureAvailable(FeatureType feature)
+	{
+		if (Globals::instance().isFeatureAvailable(feature))
+		{
+			return true;
+		}
+		MessageHandler::addNotification("This feature isn't available (yet).");
+		_applyHammerPrevention = true;
+		return false;
+	}
+
+
+	// Waits for the interceptor to pick up the camera struct address. Should only return if address is found or the system is stopped.
 	void System::waitForCameraStructAddresses()
 	{
 		MessageHandler::logLine("Waiting for camera struct interception...");
 		while(!GameSpecific::CameraManipulator::isCameraFound())
 		{
+			if (!Globals::instance().systemActive())
+			{
+				return;
+			}
 			handleUserInput();
 			Sleep(100);
 		}
@@ -489,7 +612,7 @@ namespace IGCS
 
 	void System::displayCameraState()
 	{
-		MessageHandler::addNotification(g_cameraEnabled ? "Camera enabled" : "Camera disabled");
+		MessageHandler::addNotification(loadAcquire(g_controlBlock.cameraEnabled) ? "Camera enabled" : "Camera disabled");
 	}
 	
 
@@ -32,6 +32,8 @@
 #include "Gamepad.h"
 #include <map>
 #include "AOBBlock.h"
+#include "Defaults.h"
+#include "ModuleLoadWatcher.h"
 
 namespace IGCS
 {
@@ -41,10 +43,12 @@ namespace IGCS
 		System();
 		~System();
 		void start(LPBYTE hostBaseAddress, DWORD hostImageSize);
+		DWORD nonCriticalBlocksThread();
 
 	private:
 		void mainLoop();
 		void initialize();
+		void shutdown();
 		void updateFrame();
 		bool checkIfGameHasFocus();
 		void onCameraDisabled();
@@ -56,6 +60,7 @@ namespace IGCS
 		void handleMouseCameraMovement(float multiplier);
 		void handleGamePadMovement(float multiplierBase);
 		void waitForCameraStructAddresses();
+		bool checkFeatureAvailable(FeatureType feature);
 		void toggleInputBlockState(bool newValue);
 		void toggleHud();
 		void toggleGamePause(bool displayNotification = true);
@@ -69,6 +74,11 @@ namespace IGCS
 		bool _applyHammerPrevention = false;	// set to true by a keyboard action and which triggers a sleep before keyboard handling is performed.
 		std::filesystem::path _hostExePath;
 		std::filesystem::path _hostExeFilename;
+		std::vector<std::string> _modulesNotLoadedAtStart;		// modules with blocks which weren't loaded when the critical blocks were resolved.
+		std::map<std::string, ModuleIdentity> _moduleIdentityAtStart;		// per module with blocks, the host image under the empty name. Determined before any hook was set.
+		ModuleLoadWatcher _moduleLoadWatcher;
+		HANDLE _nonCriticalBlocksThreadHandle = nullptr;
+		ULONGLONG _lastHookVerificationTick = 0;
 	};
 }
 
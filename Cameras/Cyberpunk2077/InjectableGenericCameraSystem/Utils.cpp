@@ -29,9 +29,17 @@
 #include "Utils.h"
 #include "GameConstants.h"
 #include "AOBBlock.h"
+#include "AOBScanEngine.h"
+#include "AOBApproximateScanner.h"
+#include "X64InstructionDecoder.h"
+#include "WorkerPool.h"
+#include "AOBScanCache.h"
+#include "MemorySource.h"
+#include "Defaults.h"
 #include <comdef.h>
 #include <codecvt>
 #include <filesystem>
+#include <thread>
 #include "MessageHandler.h"
 
 using namespace std;
@@ -98,55 +106,46 @@ namespace IGCS::Utils
 	}
 
 
+	// The pseudo handle of GetCurrentProcess has all access rights and doesn't have to be closed, so no handle is opened to query our own process.
 	MODULEINFO getModuleInfoOfContainingProcess()
 	{
-		HANDLE processHandle = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, GetCurrentProcessId());
 		HMODULE processModule = nullptr;
-		if (nullptr != processHandle)
+		DWORD cbNeeded;
+		if (!EnumProcessModulesEx(GetCurrentProcess(), &processModule, sizeof(processModule), &cbNeeded, LIST_MODULES_32BIT | LIST_MODULES_64BIT))
 		{
-			DWORD cbNeeded;
-			if (!EnumProcessModulesEx(processHandle, &processModule, sizeof(processModule), &cbNeeded, LIST_MODULES_32BIT | LIST_MODULES_64BIT))
-			{
-				processModule = nullptr;
-			}
+			processModule = nullptr;
 		}
 		MODULEINFO toReturn;
-		if (nullptr == processModule)
+		if (nullptr == processModule || !GetModuleInformation(GetCurrentProcess(), processModule, &toReturn, sizeof(MODULEINFO)))
 		{
 			toReturn.lpBaseOfDll = nullptr;
 		}
-		else
-		{
-			if (!GetModuleInformation(processHandle, processModule, &toReturn, sizeof(MODULEINFO)))
-			{
-				toReturn.lpBaseOfDll = nullptr;
-			}
-		}
-		if (processHandle != nullptr)
-		{
-			CloseHandle(processHandle);
-		}
 		return toReturn;
 	}
 
 
 	MODULEINFO getModuleInfoOfDll(LPCWSTR libraryName)
 	{
-		HANDLE processHandle = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, GetCurrentProcessId());
 		HMODULE dllModule = GetModuleHandle(libraryName);
 		MODULEINFO toReturn;
-		if (nullptr == dllModule)
+		if (nullptr == dllModule || !GetModuleInformation(GetCurrentProcess(), dllModule, &toReturn, sizeof(MODULEINFO)))
 		{
 			toReturn.lpBaseOfDll = nullptr;
 		}
-		else
+		return toReturn;
+	}
+
+
+	// Same as getModuleInfoOfDll(LPCWSTR), for module names as used in the AOB pattern definitions. Returns a MODULEINFO with lpBaseOfDll
+	// set to nullptr if the module isn't loaded.
+	MODULEINFO getModuleInfoOfDll(const string& moduleName)
+	{
+		MODULEINFO toReturn;
+		HMODULE dllModule = GetModuleHandleA(moduleName.c_str());
+		if (nullptr == dllModule || !GetModuleInformation(GetCurrentProcess(), dllModule, &toReturn, sizeof(MODULEINFO)))
 		{
-			if (!GetModuleInformation(processHandle, dllModule, &toReturn, sizeof(MODULEINFO)))
-			{
-				toReturn.lpBaseOfDll = nullptr;
-			}
+			toReturn.lpBaseOfDll = nullptr;
 		}
-		CloseHandle(processHandle);
 		return toReturn;
 	}
 
@@ -161,86 +160,316 @@ namespace IGCS::Utils
 	}
 
 
-	uint8_t CharToByte(char c)
+	// Returns the ranges of the image to scan for patterns. Patterns of hooks target code, so by default these are the executable sections
+	// of the image. If includeNonCodeSections is true or the PE headers of the image can't be read, it's the whole image. The regions of the
+	// image are determined with VirtualQuery, so pages which can't be read, e.g. guard pages or the no-access pages of a protected executable,
+	// are left out and code in executable regions outside the sections is included. See MemorySource::determineScanRanges.
+	vector<AOBScanRange> determineScanRanges(LPBYTE imageAddress, DWORD imageSize, bool includeNonCodeSections)
 	{
-		uint8_t b;
-		sscanf_s(&c, "%hhx", &b);
-		return b;
+		return VirtualQueryMemorySource().determineScanRanges(imageAddress, imageSize, includeNonCodeSections);
 	}
 
 
-	bool DataCompare(LPBYTE image, LPBYTE bytePattern, char* patternMask)
+	// Returns the regions of the process which can contain the data of the game, e.g. the camera struct: committed memory which is readable and
+	// writable but not executable, so the heap, the stacks and the data sections of the modules. Our own dll is left out.
+	vector<AOBScanRange> determineGameDataRanges()
 	{
-		for (; *patternMask; ++patternMask, ++image, ++bytePattern)
+		HMODULE ownModule = nullptr;
+		MODULEINFO ownModuleInfo = {};
+		if (GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, reinterpret_cast<LPCTSTR>(&determineGameDataRanges), &ownModule))
+		{
+			GetModuleInformation(GetCurrentProcess(), ownModule, &ownModuleInfo, sizeof(ownModuleInfo));
+		}
+		const uint8_t* ownImageStart = static_cast<const uint8_t*>(ownModuleInfo.lpBaseOfDll);
+		const uint8_t* ownImageEnd = ownImageStart + ownModuleInfo.SizeOfImage;
+		SYSTEM_INFO systemInfo;
+		GetSystemInfo(&systemInfo);
+		const uint8_t* minimumAddress = static_cast<const uint8_t*>(systemInfo.lpMinimumApplicationAddress);
+		const uint8_t* maximumAddress = static_cast<const uint8_t*>(systemInfo.lpMaximumApplicationAddress);
+		vector<MemoryRegion> regions;
+		VirtualQueryMemorySource().enumerateRegions(minimumAddress, maximumAddress - minimumAddress, regions);
+		vector<AOBScanRange> toReturn;
+		for (auto& region : regions)
 		{
-			if (*patternMask == 'x' && *image != *bytePattern)
+			if (!region.isReadable || !region.isWritable || region.isExecutable || (region.start < ownImageEnd && ownImageStart < region.start + region.size))
 			{
-				return false;
+				continue;
 			}
+			toReturn.push_back({ region.start, region.size });
 		}
-		return (*patternMask) == 0;
+		return toReturn;
 	}
 
 
-	LPBYTE findAOBPattern(LPBYTE imageAddress, DWORD imageSize, AOBBlock* const toScanFor)
+	// Scans the image for locations close to the patterns of the blocks specified, which weren't found, using the AOBApproximateScanner. All
+	// patterns are scanned for in parallel chunks on the worker pool specified. The candidates found are reported by the blocks, so a game 
+	// update which changed a byte or two at a hook site can be fixed quickly. Returns true if all blocks were resolved afterwards, which is
+	// only possible if IGCS_AOB_APPROXIMATE_AUTO_ACCEPT is true.
+	static bool scanAOBBlocksApproximately(LPBYTE imageAddress, DWORD imageSize, const vector<AOBBlock*>& blocksNotFound, WorkerPool& workerPool)
 	{
-		uint8_t firstByte = *(toScanFor->bytePattern());
-		__int64 length = (__int64)imageAddress + imageSize - toScanFor->patternSize();
+		AOBApproximateScanner codeSectionsScanner(IGCS_AOB_APPROXIMATE_MAX_MISMATCHES, IGCS_AOB_APPROXIMATE_MAX_CANDIDATES);
+		AOBApproximateScanner wholeImageScanner(IGCS_AOB_APPROXIMATE_MAX_MISMATCHES, IGCS_AOB_APPROXIMATE_MAX_CANDIDATES);
+		map<AOBBlock*, vector<int>> patternIdsPerBlock;
+		for (AOBBlock* block : blocksNotFound)
+		{
+			AOBApproximateScanner& scanner = block->scansNonCodeSections() ? wholeImageScanner : codeSectionsScanner;
+			vector<int>& patternIds = patternIdsPerBlock[block];
+			for (auto& scanPattern : block->scanPatterns())
+			{
+				patternIds.push_back(scanner.addPattern(scanPattern));
+			}
+		}
+		if (codeSectionsScanner.numberOfPatterns() > 0)
+		{
+			codeSectionsScanner.scan(determineScanRanges(imageAddress, imageSize, false), workerPool);
+		}
+		if (wholeImageScanner.numberOfPatterns() > 0)
+		{
+			wholeImageScanner.scan(determineScanRanges(imageAddress, imageSize, true), workerPool);
+		}
+
+		bool toReturn = true;
+		for (auto& blockPatternIdsPair : patternIdsPerBlock)
+		{
+			AOBBlock* block = blockPatternIdsPair.first;
+			const AOBApproximateScanner& scanner = block->scansNonCodeSections() ? wholeImageScanner : codeSectionsScanner;
+			vector<vector<ApproximateMatch>> candidatesPerScanPattern;
+			for (int patternId : blockPatternIdsPair.second)
+			{
+				candidatesPerScanPattern.push_back(scanner.candidatesOfPattern(patternId));
+			}
+			toReturn &= block->processApproximateScanResults(candidatesPerScanPattern, IGCS_AOB_APPROXIMATE_AUTO_ACCEPT);
+		}
+		return toReturn;
+	}
 
-		LPBYTE toReturn = nullptr;
-		LPBYTE startOfScan = imageAddress;
-		for (int occurrence = 0; occurrence < toScanFor->occurrence(); occurrence++)
+
+	// Scans the image for all patterns and alternatives of all blocks specified in a single sweep, using the AOBScanEngine, and resolves
+	// each block with the results. The sweep is done in parallel chunks on a worker pool. Blocks which weren't found are then scanned for
+	// approximately, see scanAOBBlocksApproximately. Returns true if all blocks were resolved (non-critical blocks always count as resolved).
+	// The pool can be shared by concurrent scans of other modules, see scanAOBBlocksInModules.
+	bool scanAOBBlocks(LPBYTE imageAddress, DWORD imageSize, map<string, AOBBlock*>& aobBlocks, WorkerPool& workerPool)
+	{
+		// one engine for the blocks which only scan the code sections and one for the blocks which scan the whole image.
+		AOBScanEngine codeSectionsEngine;
+		AOBScanEngine wholeImageEngine;
+		map<AOBBlock*, vector<int>> patternIdsPerBlock;
+		for (auto& nameBlockPair : aobBlocks)
 		{
-			// reset the pointer found, as we're not interested in this occurrence, we need a following occurrence.
-			toReturn = nullptr;
-			for (__int64 i = (__int64)startOfScan; i < length; i += 4)
+			AOBBlock* block = nameBlockPair.second;
+			AOBScanEngine& engine = block->scansNonCodeSections() ? wholeImageEngine : codeSectionsEngine;
+			vector<int>& patternIds = patternIdsPerBlock[block];
+			for (auto& scanPattern : block->scanPatterns())
 			{
-				unsigned x = *(unsigned*)(i);
+				patternIds.push_back(engine.addPattern(scanPattern));
+			}
+		}
+		if (codeSectionsEngine.numberOfPatterns() > 0)
+		{
+			codeSectionsEngine.scan(determineScanRanges(imageAddress, imageSize, false), workerPool);
+		}
+		if (wholeImageEngine.numberOfPatterns() > 0)
+		{
+			wholeImageEngine.scan(determineScanRanges(imageAddress, imageSize, true), workerPool);
+		}
 
-				if ((x & 0xFF) == firstByte)
-				{
-					if (DataCompare(reinterpret_cast<uint8_t*>(i), toScanFor->bytePattern(), toScanFor->patternMask()))
-					{
-						toReturn = reinterpret_cast<uint8_t*>(i);
-						break;
-					}
-				}
-				if ((x & 0xFF00) >> 8 == firstByte)
-				{
-					if (DataCompare(reinterpret_cast<uint8_t*>(i + 1), toScanFor->bytePattern(), toScanFor->patternMask()))
-					{
-						toReturn = reinterpret_cast<uint8_t*>(i + 1);
-						break;
-					}
-				}
-				if ((x & 0xFF0000) >> 16 == firstByte)
-				{
-					if (DataCompare(reinterpret_cast<uint8_t*>(i + 2), toScanFor->bytePattern(), toScanFor->patternMask()))
-					{
-						toReturn = reinterpret_cast<uint8_t*>(i + 2);
-						break;
-					}
-				}
-				if ((x & 0xFF000000) >> 24 == firstByte)
-				{
-					if (DataCompare(reinterpret_cast<uint8_t*>(i + 3), toScanFor->bytePattern(), toScanFor->patternMask()))
-					{
-						toReturn = reinterpret_cast<uint8_t*>(i + 3);
-						break;
-					}
-				}
+		bool toReturn = true;
+		vector<AOBBlock*> blocksNotFound;
+		for (auto& blockPatternIdsPair : patternIdsPerBlock)
+		{
+			AOBBlock* block = blockPatternIdsPair.first;
+			const AOBScanEngine& engine = block->scansNonCodeSections() ? wholeImageEngine : codeSectionsEngine;
+			vector<LPBYTE> locationPerScanPattern;
+			vector<int> numberOfMatchesPerScanPattern;
+			for (int patternId : blockPatternIdsPair.second)
+			{
+				locationPerScanPattern.push_back(const_cast<LPBYTE>(engine.locationOfPattern(patternId)));
+				numberOfMatchesPerScanPattern.push_back(engine.numberOfMatches(patternId));
+			}
+			if (!block->processScanResults(locationPerScanPattern, numberOfMatchesPerScanPattern))
+			{
+				toReturn = false;
+			}
+			if (!block->found())
+			{
+				blocksNotFound.push_back(block);
+			}
+		}
+		if (blocksNotFound.empty())
+		{
+			return toReturn;
+		}
+		// all blocks are resolved if the blocks which weren't found are resolved approximately. 
+		const bool allBlocksNotFoundResolved = scanAOBBlocksApproximately(imageAddress, imageSize, blocksNotFound, workerPool);
+		return toReturn || allBlocksNotFoundResolved;
+	}
+
+
+	// Returns the identity of the module specified from identityPerModule. A module which isn't in there, which shouldn't happen, is hashed now.
+	static ModuleIdentity determineIdentityOfModule(const map<string, ModuleIdentity>& identityPerModule, const string& moduleName, LPBYTE imageAddress, 
+													DWORD imageSize)
+	{
+		auto identity = identityPerModule.find(moduleName);
+		if (identity != identityPerModule.end())
+		{
+			return identity->second;
+		}
+		MessageHandler::logDebug("No identity determined for module '%s' before it was hooked, the AOB cache might not match.", moduleName.c_str());
+		return AOBScanCache::determineModuleIdentity(imageAddress, imageSize, VirtualQueryMemorySource());
+	}
+
+
+	// Same as scanAOBBlocks, but first tries to resolve the blocks with the locations in the cache file specified. The cache is only used if it
+	// was created for the same build of the module in memory, and every cached location is verified against its pattern before it's used. 
+	// Blocks which can't be resolved from the cache are scanned for, after which the cache file is updated with the locations found.
+	// moduleIdentity has to be determined before any hook is set in the module, as the hooks change the code it's a hash of.
+	bool scanAOBBlocksUsingCache(LPBYTE imageAddress, DWORD imageSize, map<string, AOBBlock*>& aobBlocks, const filesystem::path& cacheFilename,
+								 const ModuleIdentity& moduleIdentity, WorkerPool& workerPool)
+	{
+		AOBScanCache cache;
+		if (!cache.load(cacheFilename, moduleIdentity))
+		{
+			MessageHandler::logDebug("No valid AOB cache for this build of the game, scanning the image.");
+		}
+		bool toReturn = true;
+		map<string, AOBBlock*> blocksToScan;
+		for (auto& nameBlockPair : aobBlocks)
+		{
+			AOBBlock* block = nameBlockPair.second;
+			const CachedBlockLocation* cachedLocation = cache.findValidBlockLocation(nameBlockPair.first, block->scanPatterns(), imageAddress, imageSize);
+			if (nullptr == cachedLocation)
+			{
+				blocksToScan[nameBlockPair.first] = block;
+				continue;
+			}
+			vector<LPBYTE> locationPerScanPattern(block->scanPatterns().size(), nullptr);
+			locationPerScanPattern[cachedLocation->patternIndex] = imageAddress + cachedLocation->rva;
+			// the cache is only used for the same build of the game, so the number of matches is the same as when the cache was written.
+			toReturn &= block->processScanResults(locationPerScanPattern, vector<int>());
+		}
+		MessageHandler::logDebug("%d of %d AOB blocks resolved from the cache.", static_cast<int>(aobBlocks.size() - blocksToScan.size()), static_cast<int>(aobBlocks.size()));
+		if (blocksToScan.empty())
+		{
+			return toReturn;
+		}
+		toReturn &= scanAOBBlocks(imageAddress, imageSize, blocksToScan, workerPool);
+
+		bool cacheChanged = false;
+		for (auto& nameBlockPair : blocksToScan)
+		{
+			AOBBlock* block = nameBlockPair.second;
+			if (!block->found() || block->foundApproximately())
+			{
+				// approximate locations don't match their pattern, so they'd never pass the verification when loaded from the cache.
+				continue;
+			}
+			CachedBlockLocation location;
+			location.patternIndex = block->patternIndexThatMatched();
+			location.patternHash = block->scanPatterns()[location.patternIndex].patternHash();
+			location.rva = static_cast<uint32_t>(block->locationInImage() - imageAddress);
+			location.customOffset = block->customOffset();
+			cache.setBlockLocation(nameBlockPair.first, location);
+			cacheChanged = true;
+		}
+		if (cacheChanged && !cache.save(cacheFilename))
+		{
+			MessageHandler::logDebug("Couldn't write the AOB cache file '%s'.", cacheFilename.string().c_str());
+		}
+		return toReturn;
+	}
+
+
+	// Resolves the blocks specified in the modules they're in, see AOBBlock::moduleName. The blocks of every module are resolved with 
+	// scanAOBBlocksUsingCache, each module with its own cache file. If the blocks are in more than one module, the modules are scanned
+	// concurrently, each on its own thread. All module scans chunk their image on one shared worker pool with a worker per core, so the
+	// number of threads scanning doesn't grow with the number of modules. Blocks in modules which aren't loaded aren't found. Returns true 
+	// if all blocks were resolved.
+	// identityPerModule contains the identity of every module, the host image under the empty name, determined before any hook was set.
+	bool scanAOBBlocksInModules(LPBYTE hostImageAddress, DWORD hostImageSize, map<string, AOBBlock*>& aobBlocks, const filesystem::path& cacheFilename,
+								const map<string, ModuleIdentity>& identityPerModule)
+	{
+		map<string, map<string, AOBBlock*>> blocksPerModule;
+		for (auto& nameBlockPair : aobBlocks)
+		{
+			blocksPerModule[nameBlockPair.second->moduleName()][nameBlockPair.first] = nameBlockPair.second;
+		}
+		WorkerPool workerPool(WorkerPool::defaultNumberOfWorkers());
+		if (blocksPerModule.size() == 1 && blocksPerModule.begin()->first.empty())
+		{
+			// only blocks in the host image.
+			return scanAOBBlocksUsingCache(hostImageAddress, hostImageSize, aobBlocks, cacheFilename, determineIdentityOfModule(identityPerModule, string(), 
+										   hostImageAddress, hostImageSize), workerPool);
+		}
+
+		bool toReturn = true;
+		vector<pair<MODULEINFO, map<string, AOBBlock*>*>> modulesToScan;
+		vector<ModuleIdentity> identityPerModuleToScan;
+		for (auto& moduleBlocksPair : blocksPerModule)
+		{
+			MODULEINFO moduleInfo;
+			if (moduleBlocksPair.first.empty())
+			{
+				moduleInfo.lpBaseOfDll = hostImageAddress;
+				moduleInfo.SizeOfImage = hostImageSize;
+			}
+			else
+			{
+				moduleInfo = getModuleInfoOfDll(moduleBlocksPair.first);
 			}
-			if (nullptr == toReturn)
+			if (nullptr == moduleInfo.lpBaseOfDll)
 			{
-				// not found, give up
-				return toReturn;
+				MessageHandler::logError("Module '%s' isn't loaded, its %d block(s) weren't scanned for.", moduleBlocksPair.first.c_str(), 
+										 static_cast<int>(moduleBlocksPair.second.size()));
+				for (auto& nameBlockPair : moduleBlocksPair.second)
+				{
+					toReturn &= nameBlockPair.second->isNonCritical();
+				}
+				continue;
 			}
-			startOfScan = toReturn + 1;	// otherwise we'll match ourselves. 
+			modulesToScan.push_back({ moduleInfo, &moduleBlocksPair.second });
+			identityPerModuleToScan.push_back(determineIdentityOfModule(identityPerModule, moduleBlocksPair.first, static_cast<LPBYTE>(moduleInfo.lpBaseOfDll), 
+																		moduleInfo.SizeOfImage));
+		}
+		// a thread per module, which only verifies the cache and processes the results. The scanning itself is done in chunks on the shared pool. 
+		// The module scans can't be jobs on that pool, as a job which waits for the chunk jobs it enqueued would block a worker the chunks need.
+		vector<char> resultPerModule(modulesToScan.size(), 0);
+		vector<thread> moduleThreads;
+		for (size_t i = 0; i < modulesToScan.size(); i++)
+		{
+			moduleThreads.emplace_back([&, i] 
+				{
+					const string& moduleName = modulesToScan[i].second->begin()->second->moduleName();
+					resultPerModule[i] = scanAOBBlocksUsingCache(static_cast<LPBYTE>(modulesToScan[i].first.lpBaseOfDll), modulesToScan[i].first.SizeOfImage,
+																 *modulesToScan[i].second, determineModuleCacheFilename(cacheFilename, moduleName), identityPerModuleToScan[i], 
+																 workerPool) ? 1 : 0;
+				});
+		}
+		for (auto& moduleThread : moduleThreads)
+		{
+			moduleThread.join();
+		}
+		for (char moduleResult : resultPerModule)
+		{
+			toReturn &= (moduleResult != 0);
 		}
 		return toReturn;
 	}
 
 
+	// Returns the name of the cache file for the blocks in the module specified. The host image uses the cache file specified, other modules
+	// use a file next to it with the module name added, e.g. IGCS_aobcache.AnselSDK64.dll.txt, as a cache file is for one module only.
+	filesystem::path determineModuleCacheFilename(const filesystem::path& cacheFilename, const string& moduleName)
+	{
+		if (moduleName.empty())
+		{
+			return cacheFilename;
+		}
+		filesystem::path toReturn = cacheFilename;
+		toReturn.replace_filename(cacheFilename.stem().string() + "." + moduleName + cacheFilename.extension().string());
+		return toReturn;
+	}
+
+
 	// locationData is the AOB block with the address of the rip relative value to read for the calculation.
 	// nextOpCodeOffset is used to calculate the address of the next instruction as that's the address the rip relative value is relative off. In general
 	// this is 4 (the size of the int32 for the rip relative value), but sometimes the rip relative value is inside an instruction following one or more bytes before the 
@@ -254,6 +483,23 @@ namespace IGCS::Utils
 		return  ripRelativeValueAddress + nextOpCodeOffset + *((__int32*)ripRelativeValueAddress);
 	}
 
+
+	// Calculates the absolute address the rip relative operand of the instruction at the start of the block refers to. Unlike calculateAbsoluteAddress
+	// the location of the rip relative value and the offset of the next instruction are determined by decoding the instruction. 
+	// Returns nullptr if the instruction can't be decoded or has no rip relative operand.
+	LPBYTE calculateRipRelativeTarget(AOBBlock* locationData)
+	{
+		assert(locationData != nullptr);
+		LPBYTE instructionAddress = locationData->locationInImage();
+		X64Instruction decoded;
+		if (!X64InstructionDecoder::decode(instructionAddress, X64_MAX_INSTRUCTION_LENGTH, decoded) || !decoded.isRipRelative)
+		{
+			MessageHandler::logError("The instruction at address %p of block %s doesn't have a rip relative operand", (void*)instructionAddress, locationData->blockName().c_str());
+			return nullptr;
+		}
+		return const_cast<LPBYTE>(X64InstructionDecoder::determineRipRelativeTarget(instructionAddress, decoded));
+	}
+
 	
 	string formatString(const char* fmt, ...)
 	{
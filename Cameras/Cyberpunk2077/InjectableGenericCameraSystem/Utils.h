@@ -28,6 +28,11 @@
 #pragma once
 #include "stdafx.h"
 #include <filesystem>
+#include <map>
+#include "ScanPattern.h"
+#include "AOBScanEngine.h"
+#include "AOBScanCache.h"
+#include "WorkerPool.h"
 
 namespace IGCS
 {
@@ -59,9 +64,17 @@ namespace IGCS::Utils
 	HWND findMainWindow(unsigned long process_id);
 	MODULEINFO getModuleInfoOfContainingProcess();
 	MODULEINFO getModuleInfoOfDll(LPCWSTR libraryName);
-	LPBYTE findAOBPattern(LPBYTE imageAddress, DWORD imageSize, AOBBlock* const toScanFor);
-	uint8_t CharToByte(char c);
+	MODULEINFO getModuleInfoOfDll(const std::string& moduleName);
+	std::vector<AOBScanRange> determineScanRanges(LPBYTE imageAddress, DWORD imageSize, bool includeNonCodeSections);
+	std::vector<AOBScanRange> determineGameDataRanges();
+	bool scanAOBBlocks(LPBYTE imageAddress, DWORD imageSize, std::map<std::string, AOBBlock*>& aobBlocks, WorkerPool& workerPool);
+	bool scanAOBBlocksUsingCache(LPBYTE imageAddress, DWORD imageSize, std::map<std::string, AOBBlock*>& aobBlocks, const std::filesystem::path& cacheFilename,
+								 const ModuleIdentity& moduleIdentity, WorkerPool& workerPool);
+	bool scanAOBBlocksInModules(LPBYTE hostImageAddress, DWORD hostImageSize, std::map<std::string, AOBBlock*>& aobBlocks, const std::filesystem::path& cacheFilename,
+								const std::map<std::string, ModuleIdentity>& identityPerModule);
+	std::filesystem::path determineModuleCacheFilename(const std::filesystem::path& cacheFilename, const std::string& moduleName);
 	LPBYTE calculateAbsoluteAddress(AOBBlock* locationData, int nextOpCodeOffset);
+	LPBYTE calculateRipRelativeTarget(AOBBlock* locationData);
 	std::string formatString(const char* fmt, ...);
 	std::string formatStringVa(const char* fmt, va_list args);
 	bool stringStartsWith(const char *a, const char *b);
@@ -0,0 +1,481 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "ValueHunt.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+	// SSE2 is part of x64, so no cpu check is needed.
+	#define IGCS_VALUE_HUNT_SIMD_SUPPORTED
+	#include <emmintrin.h>
+	// the flush to zero and denormals are zero bits of the MXCSR register.
+	#define VALUE_HUNT_FLUSH_DENORMALS_MASK		0x8040
+#endif
+
+using namespace std;
+
+namespace IGCS
+{
+	// slabs are big enough to never come from the heap of the game, but from their own region.
+	#define VALUE_HUNT_PAGES_PER_SLAB		4096
+	#define VALUE_HUNT_PAGES_PER_JOB		64
+
+	static const uint8_t zeroPage[VALUE_HUNT_PAGE_SIZE] = {};
+
+	HuntPageStore::HuntPageStore()
+	{
+	}
+
+
+	HuntPageStore::~HuntPageStore()
+	{
+	}
+
+
+	uint8_t* HuntPageStore::allocatePage()
+	{
+		lock_guard<mutex> lock(_storeMutex);
+		if (_freePages.empty())
+		{
+			// not value initialized, a page is always overwritten completely.
+			_slabs.push_back(unique_ptr<uint8_t[]>(new uint8_t[VALUE_HUNT_PAGES_PER_SLAB * VALUE_HUNT_PAGE_SIZE]));
+			uint8_t* slab = _slabs.back().get();
+			for (int i = VALUE_HUNT_PAGES_PER_SLAB - 1; i >= 0; i--)
+			{
+				_freePages.push_back(slab + static_cast<size_t>(i) * VALUE_HUNT_PAGE_SIZE);
+			}
+		}
+		uint8_t* toReturn = _freePages.back();
+		_freePages.pop_back();
+		return toReturn;
+	}
+
+
+	void HuntPageStore::releasePage(uint8_t* page)
+	{
+		if (nullptr == page)
+		{
+			return;
+		}
+		lock_guard<mutex> lock(_storeMutex);
+		_freePages.push_back(page);
+	}
+
+
+	void HuntPageStore::releaseAll()
+	{
+		lock_guard<mutex> lock(_storeMutex);
+		_freePages.clear();
+		_freePages.shrink_to_fit();
+		_slabs.clear();
+	}
+
+
+	size_t HuntPageStore::numberOfPagesInUse() const
+	{
+		lock_guard<mutex> lock(_storeMutex);
+		return _slabs.size() * VALUE_HUNT_PAGES_PER_SLAB - _freePages.size();
+	}
+
+
+	size_t HuntPageStore::memoryUsageInBytes() const
+	{
+		lock_guard<mutex> lock(_storeMutex);
+		return _slabs.size() * VALUE_HUNT_PAGES_PER_SLAB * VALUE_HUNT_PAGE_SIZE + _freePages.capacity() * sizeof(uint8_t*);
+	}
+
+
+#ifndef IGCS_VALUE_HUNT_SIMD_SUPPORTED
+	// Returns for the 32 values of candidate word wordIndex which of them match the comparison, one bit per value.
+	static uint32_t compareValuesScalar(const uint8_t* previous, const uint8_t* current, int wordIndex, HuntValueType valueType, HuntComparison comparison, 
+										uint32_t rawValue, float epsilon)
+	{
+		uint32_t toReturn = 0;
+		for (int i = 0; i < 32; i++)
+		{
+			const size_t offset = (static_cast<size_t>(wordIndex) * 32 + i) * sizeof(uint32_t);
+			uint32_t previousBits;
+			uint32_t currentBits;
+			memcpy(&previousBits, previous + offset, sizeof(uint32_t));
+			memcpy(&currentBits, current + offset, sizeof(uint32_t));
+			bool isMatch = false;
+			if (HuntValueType::Float == valueType)
+			{
+				const float previousValue = bit_cast<float>(previousBits);
+				const float currentValue = bit_cast<float>(currentBits);
+				switch (comparison)
+				{
+				case HuntComparison::Changed:
+					isMatch = previousBits != currentBits;
+					break;
+				case HuntComparison::Unchanged:
+					isMatch = previousBits == currentBits || fabsf(currentValue - previousValue) <= epsilon;
+					break;
+				case HuntComparison::Increased:
+					isMatch = currentValue > previousValue;
+					break;
+				case HuntComparison::Decreased:
+					isMatch = currentValue < previousValue;
+					break;
+				case HuntComparison::EqualTo:
+					isMatch = fabsf(currentValue - bit_cast<float>(rawValue)) <= epsilon;
+					break;
+				}
+			}
+			else
+			{
+				const int32_t previousValue = static_cast<int32_t>(previousBits);
+				const int32_t currentValue = static_cast<int32_t>(currentBits);
+				switch (comparison)
+				{
+				case HuntComparison::Changed:
+					isMatch = previousValue != currentValue;
+					break;
+				case HuntComparison::Unchanged:
+					isMatch = previousValue == currentValue;
+					break;
+				case HuntComparison::Increased:
+					isMatch = currentValue > previousValue;
+					break;
+				case HuntComparison::Decreased:
+					isMatch = currentValue < previousValue;
+					break;
+				case HuntComparison::EqualTo:
+					isMatch = currentBits == rawValue;
+					break;
+				}
+			}
+			toReturn |= isMatch ? (1u << i) : 0u;
+		}
+		return toReturn;
+	}
+#else
+	// Returns for the 32 values of candidate word wordIndex which of them match the comparison, one bit per value. 4 values at a time.
+	static uint32_t compareValuesSimd(const uint8_t* previous, const uint8_t* current, int wordIndex, HuntValueType valueType, HuntComparison comparison,
+									  uint32_t rawValue, float epsilon)
+	{
+		const __m128i givenValue = _mm_set1_epi32(static_cast<int>(rawValue));
+		const __m128 epsilonValues = _mm_set1_ps(epsilon);
+		const __m128 absoluteMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+		const __m128i allOnes = _mm_set1_epi32(-1);
+		uint32_t toReturn = 0;
+		for (int group = 0; group < 8; group++)
+		{
+			const size_t offset = (static_cast<size_t>(wordIndex) * 32 + group * 4) * sizeof(uint32_t);
+			const __m128i previousValues = _mm_loadu_si128(reinterpret_cast<const __m128i*>(previous + offset));
+			const __m128i currentValues = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current + offset));
+			const __m128i isBitwiseEqual = _mm_cmpeq_epi32(previousValues, currentValues);
+			__m128 isMatch;
+			if (HuntValueType::Float == valueType)
+			{
+				const __m128 previousFloats = _mm_castsi128_ps(previousValues);
+				const __m128 currentFloats = _mm_castsi128_ps(currentValues);
+				switch (comparison)
+				{
+				case HuntComparison::Changed:
+					isMatch = _mm_castsi128_ps(_mm_xor_si128(isBitwiseEqual, allOnes));
+					break;
+				case HuntComparison::Unchanged:
+					isMatch = _mm_or_ps(_mm_castsi128_ps(isBitwiseEqual), _mm_cmple_ps(_mm_and_ps(_mm_sub_ps(currentFloats, previousFloats), absoluteMask), epsilonValues));
+					break;
+				case HuntComparison::Increased:
+					isMatch = _mm_cmpgt_ps(currentFloats, previousFloats);
+					break;
+				case HuntComparison::Decreased:
+					isMatch = _mm_cmplt_ps(currentFloats, previousFloats);
+					break;
+				default:
+					isMatch = _mm_cmple_ps(_mm_and_ps(_mm_sub_ps(currentFloats, _mm_castsi128_ps(givenValue)), absoluteMask), epsilonValues);
+					break;
+				}
+			}
+			else
+			{
+				switch (comparison)
+				{
+				case HuntComparison::Changed:
+					isMatch = _mm_castsi128_ps(_mm_xor_si128(isBitwiseEqual, allOnes));
+					break;
+				case HuntComparison::Unchanged:
+					isMatch = _mm_castsi128_ps(isBitwiseEqual);
+					break;
+				case HuntComparison::Increased:
+					isMatch = _mm_castsi128_ps(_mm_cmpgt_epi32(currentValues, previousValues));
+					break;
+				case HuntComparison::Decreased:
+					isMatch = _mm_castsi128_ps(_mm_cmplt_epi32(currentValues, previousValues));
+					break;
+				default:
+					isMatch = _mm_castsi128_ps(_mm_cmpeq_epi32(currentValues, givenValue));
+					break;
+				}
+			}
+			toReturn |= static_cast<uint32_t>(_mm_movemask_ps(isMatch)) << (group * 4);
+		}
+		return toReturn;
+	}
+#endif
+
+
+	ValueHunt::ValueHunt(HuntMemoryReader memoryReader, int numberOfWorkers) : _memoryReader(memoryReader), _workerPool(numberOfWorkers), 
+																				_valueType(HuntValueType::Float), _numberOfCandidates(0), _numberOfCleanPages(0)
+	{
+	}
+
+
+	ValueHunt::~ValueHunt()
+	{
+	}
+
+
+	// Takes the first snapshot of the whole pages in the ranges specified. Every 4-byte aligned value in them is a candidate.
+	void ValueHunt::start(const vector<AOBScanRange>& ranges, HuntValueType valueType)
+	{
+		clear();
+		_valueType = valueType;
+		for (auto& range : ranges)
+		{
+			const uintptr_t rangeStart = reinterpret_cast<uintptr_t>(range.start);
+			uintptr_t pageAddress = (rangeStart + VALUE_HUNT_PAGE_SIZE - 1) & ~static_cast<uintptr_t>(VALUE_HUNT_PAGE_SIZE - 1);
+			for (; pageAddress + VALUE_HUNT_PAGE_SIZE <= rangeStart + range.size; pageAddress += VALUE_HUNT_PAGE_SIZE)
+			{
+				HuntPage page;
+				page.address = pageAddress;
+				page.data = nullptr;
+				memset(page.candidateBits, 0xFF, sizeof(page.candidateBits));
+				_pages.push_back(page);
+			}
+		}
+		for (size_t firstPageIndex = 0; firstPageIndex < _pages.size(); firstPageIndex += VALUE_HUNT_PAGES_PER_JOB)
+		{
+			_workerPool.enqueue([this, firstPageIndex] 
+				{
+					capturePages(firstPageIndex, min(static_cast<size_t>(VALUE_HUNT_PAGES_PER_JOB), _pages.size() - firstPageIndex), true, HuntComparison::Changed, 0, 0.0f);
+				});
+		}
+		_workerPool.waitUntilIdle();
+		removePagesWithoutCandidates();
+	}
+
+
+	// Takes a new snapshot of the pages with candidates and keeps the candidates which match the comparison. value and epsilon are converted to
+	// the value type of the hunt. epsilon is only used for floats.
+	void ValueHunt::narrow(HuntComparison comparison, double value, double epsilon)
+	{
+		const uint32_t rawValue = HuntValueType::Float == _valueType ? bit_cast<uint32_t>(static_cast<float>(value)) : static_cast<uint32_t>(static_cast<int32_t>(llround(value)));
+		const float epsilonAsFloat = static_cast<float>(fabs(epsilon));
+		_numberOfCleanPages = 0;
+		for (size_t firstPageIndex = 0; firstPageIndex < _pages.size(); firstPageIndex += VALUE_HUNT_PAGES_PER_JOB)
+		{
+			_workerPool.enqueue([this, firstPageIndex, comparison, rawValue, epsilonAsFloat]
+				{
+					capturePages(firstPageIndex, min(static_cast<size_t>(VALUE_HUNT_PAGES_PER_JOB), _pages.size() - firstPageIndex), false, comparison, rawValue, epsilonAsFloat);
+				});
+		}
+		_workerPool.waitUntilIdle();
+		removePagesWithoutCandidates();
+	}
+
+
+	// Fills candidates with at most maxNumberOfCandidates candidates, in address order.
+	void ValueHunt::collectCandidates(vector<HuntCandidate>& candidates, size_t maxNumberOfCandidates) const
+	{
+		candidates.clear();
+		for (auto& page : _pages)
+		{
+			for (int wordIndex = 0; wordIndex < VALUE_HUNT_CANDIDATE_WORDS_PER_PAGE; wordIndex++)
+			{
+				uint32_t bits = page.candidateBits[wordIndex];
+				while (0 != bits)
+				{
+					if (candidates.size() >= maxNumberOfCandidates)
+					{
+						return;
+					}
+					const size_t offset = (static_cast<size_t>(wordIndex) * 32 + countr_zero(bits)) * sizeof(uint32_t);
+					bits &= bits - 1;
+					uint32_t rawValue = 0;
+					if (nullptr != page.data)
+					{
+						memcpy(&rawValue, page.data + offset, sizeof(rawValue));
+					}
+					candidates.push_back({ page.address + offset, rawValue });
+				}
+			}
+		}
+	}
+
+
+	size_t ValueHunt::memoryUsageInBytes() const
+	{
+		return _pageStore.memoryUsageInBytes() + _pages.capacity() * sizeof(HuntPage);
+	}
+
+
+	void ValueHunt::clear()
+	{
+		_pages.clear();
+		_pages.shrink_to_fit();
+		_pageStore.releaseAll();
+		_numberOfCandidates = 0;
+		_numberOfCleanPages = 0;
+	}
+
+
+	// Captures the pages [firstPageIndex, firstPageIndex + numberOfPages) and, if it's not the first snapshot, keeps the candidates which match
+	// the comparison with the previous snapshot of the page. The new snapshot replaces the previous one. A page which can't be read anymore 
+	// loses its candidates.
+	void ValueHunt::capturePages(size_t firstPageIndex, size_t numberOfPages, bool isFirstSnapshot, HuntComparison comparison, uint32_t rawValue, float epsilon)
+	{
+#ifdef IGCS_VALUE_HUNT_SIMD_SUPPORTED
+		// memory which isn't floats is often denormals when read as floats. Arithmetic with denormals is very slow, so they're flushed to zero.
+		// That doesn't change the outcome for the values hunted for.
+		const unsigned int controlStatusToRestore = _mm_getcsr();
+		_mm_setcsr(controlStatusToRestore | VALUE_HUNT_FLUSH_DENORMALS_MASK);
+#endif
+		uint8_t current[VALUE_HUNT_PAGE_SIZE];
+		size_t numberOfCleanPages = 0;
+		for (size_t pageIndex = firstPageIndex; pageIndex < firstPageIndex + numberOfPages; pageIndex++)
+		{
+			HuntPage& page = _pages[pageIndex];
+			if (!_memoryReader(page.address, current, VALUE_HUNT_PAGE_SIZE))
+			{
+				memset(page.candidateBits, 0, sizeof(page.candidateBits));
+				_pageStore.releasePage(page.data);
+				page.data = nullptr;
+				continue;
+			}
+			const uint8_t* previous = nullptr == page.data ? zeroPage : page.data;
+			const bool isClean = !isFirstSnapshot && 0 == memcmp(previous, current, VALUE_HUNT_PAGE_SIZE);
+			numberOfCleanPages += isClean ? 1 : 0;
+			bool hasCandidates = false;
+			for (int wordIndex = 0; wordIndex < VALUE_HUNT_CANDIDATE_WORDS_PER_PAGE; wordIndex++)
+			{
+				uint32_t& candidateWord = page.candidateBits[wordIndex];
+				if (0 == candidateWord || isFirstSnapshot)
+				{
+					hasCandidates |= 0 != candidateWord;
+					continue;
+				}
+				if (isClean && HuntComparison::EqualTo != comparison)
+				{
+					// no value changed, so nothing has to be compared.
+					candidateWord = HuntComparison::Unchanged == comparison ? candidateWord : 0;
+				}
+				else
+				{
+#ifdef IGCS_VALUE_HUNT_SIMD_SUPPORTED
+					candidateWord &= compareValuesSimd(previous, current, wordIndex, _valueType, comparison, rawValue, epsilon);
+#else
+					candidateWord &= compareValuesScalar(previous, current, wordIndex, _valueType, comparison, rawValue, epsilon);
+#endif
+				}
+				hasCandidates |= 0 != candidateWord;
+			}
+			if (isClean)
+			{
+				continue;
+			}
+			if (!hasCandidates || 0 == memcmp(current, zeroPage, VALUE_HUNT_PAGE_SIZE))
+			{
+				// all zeros isn't stored, it's the zero page.
+				_pageStore.releasePage(page.data);
+				page.data = nullptr;
+				continue;
+			}
+			if (nullptr == page.data)
+			{
+				page.data = _pageStore.allocatePage();
+			}
+			memcpy(page.data, current, VALUE_HUNT_PAGE_SIZE);
+		}
+		_numberOfCleanPages += numberOfCleanPages;
+#ifdef IGCS_VALUE_HUNT_SIMD_SUPPORTED
+		_mm_setcsr(controlStatusToRestore);
+#endif
+	}
+
+
+	void ValueHunt::removePagesWithoutCandidates()
+	{
+		size_t numberOfCandidates = 0;
+		auto pageToKeep = _pages.begin();
+		for (auto& page : _pages)
+		{
+			size_t numberOfCandidatesInPage = 0;
+			for (uint32_t candidateWord : page.candidateBits)
+			{
+				numberOfCandidatesInPage += popcount(candidateWord);
+			}
+			if (0 == numberOfCandidatesInPage)
+			{
+				_pageStore.releasePage(page.data);
+				continue;
+			}
+			numberOfCandidates += numberOfCandidatesInPage;
+			*pageToKeep++ = page;
+		}
+		_pages.erase(pageToKeep, _pages.end());
+		_numberOfCandidates = numberOfCandidates;
+		compactPageStore();
+	}
+
+
+	// Narrowing frees most of the pages of the first snapshot, but the slabs stay allocated while a single page in them is in use. If most of
+	// the store is free, the pages in use are moved to new slabs, so the memory of the old ones is released.
+	void ValueHunt::compactPageStore()
+	{
+		const size_t numberOfPagesInUse = _pageStore.numberOfPagesInUse();
+		if (numberOfPagesInUse * 4 > _pageStore.memoryUsageInBytes() / VALUE_HUNT_PAGE_SIZE)
+		{
+			return;
+		}
+		vector<uint8_t> pagesInUse(numberOfPagesInUse * VALUE_HUNT_PAGE_SIZE);
+		size_t pageInUseIndex = 0;
+		for (auto& page : _pages)
+		{
+			if (nullptr != page.data)
+			{
+				memcpy(pagesInUse.data() + pageInUseIndex++ * VALUE_HUNT_PAGE_SIZE, page.data, VALUE_HUNT_PAGE_SIZE);
+			}
+		}
+		_pageStore.releaseAll();
+		pageInUseIndex = 0;
+		for (auto& page : _pages)
+		{
+			if (nullptr != page.data)
+			{
+				page.data = _pageStore.allocatePage();
+				memcpy(page.data, pagesInUse.data() + pageInUseIndex++ * VALUE_HUNT_PAGE_SIZE, VALUE_HUNT_PAGE_SIZE);
+			}
+		}
+		_pages.shrink_to_fit();
+	}
+}
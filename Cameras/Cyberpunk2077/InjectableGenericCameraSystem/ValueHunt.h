@@ -0,0 +1,133 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "AOBScanEngine.h"
+#include "WorkerPool.h"
+
+namespace IGCS
+{
+	#define VALUE_HUNT_PAGE_SIZE				4096
+	#define VALUE_HUNT_VALUES_PER_PAGE			(VALUE_HUNT_PAGE_SIZE / 4)
+	#define VALUE_HUNT_CANDIDATE_WORDS_PER_PAGE	(VALUE_HUNT_VALUES_PER_PAGE / 32)
+
+	enum class HuntValueType : uint8_t
+	{
+		Float = 0,
+		Int32 = 1,
+	};
+
+	// How the value of a candidate has to relate to its value in the previous snapshot, or, with EqualTo, to a given value. 
+	enum class HuntComparison : uint8_t
+	{
+		Changed = 0,
+		Unchanged = 1,		// for floats: the difference with the previous value is at most epsilon
+		Increased = 2,
+		Decreased = 3,
+		EqualTo = 4,		// for floats: the difference with the given value is at most epsilon
+	};
+
+	struct HuntCandidate
+	{
+		uintptr_t address;
+		uint32_t rawValue;		// the bits of the value in the last snapshot
+	};
+
+	// Reads size bytes at address into buffer. Returns false if the memory can't be read, e.g. because it has been freed.
+	typedef std::function<bool(uintptr_t address, uint8_t* buffer, size_t size)> HuntMemoryReader;
+
+	// Fixed size blocks of memory for the pages of a snapshot. The pages are allocated from large slabs, which aren't allocated from the heap
+	// the game uses but are separate regions, so the snapshot doesn't end up in the memory it captures.
+	class HuntPageStore
+	{
+	public:
+		HuntPageStore();
+		~HuntPageStore();
+
+		uint8_t* allocatePage();
+		void releasePage(uint8_t* page);
+		void releaseAll();
+		size_t memoryUsageInBytes() const;
+		size_t numberOfPagesInUse() const;
+
+	private:
+		mutable std::mutex _storeMutex;
+		std::vector<std::unique_ptr<uint8_t[]>> _slabs;
+		std::vector<uint8_t*> _freePages;
+	};
+
+	// Value hunting like in Cheat Engine, to find e.g. the offset of the fov or the time of day in a struct: the first snapshot of the memory 
+	// makes every 4-byte aligned value a candidate, and every next snapshot narrows the candidates down with a comparison against the previous
+	// snapshot or a given value. Snapshots are page granular and only the pages which still have candidates are captured again. A page is
+	// stored once: pages which are all zeros aren't stored at all and a page which is the same as in the previous snapshot (a clean page) 
+	// isn't compared value by value unless the comparison needs it. The comparisons are done with SSE2, 4 values at a time, on a bitmap of 
+	// candidates per page, in parallel over the pages. Doesn't depend on windows headers so it can be used by tools outside the camera dll too.
+	class ValueHunt
+	{
+	public:
+		ValueHunt(HuntMemoryReader memoryReader, int numberOfWorkers);
+		~ValueHunt();
+
+		void start(const std::vector<AOBScanRange>& ranges, HuntValueType valueType);
+		void narrow(HuntComparison comparison, double value, double epsilon);
+		void collectCandidates(std::vector<HuntCandidate>& candidates, size_t maxNumberOfCandidates) const;
+		size_t numberOfCandidates() const { return _numberOfCandidates; }
+		size_t numberOfPages() const { return _pages.size(); }
+		size_t numberOfCleanPages() const { return _numberOfCleanPages; }
+		size_t memoryUsageInBytes() const;
+		HuntValueType valueType() const { return _valueType; }
+
+	private:
+		// A page with candidates. data is nullptr if the page is all zeros.
+		struct HuntPage
+		{
+			uintptr_t address;
+			uint8_t* data;
+			uint32_t candidateBits[VALUE_HUNT_CANDIDATE_WORDS_PER_PAGE];
+		};
+
+		void clear();
+		void capturePages(size_t firstPageIndex, size_t numberOfPages, bool isFirstSnapshot, HuntComparison comparison, uint32_t rawValue, float epsilon);
+		void removePagesWithoutCandidates();
+		void compactPageStore();
+
+		HuntMemoryReader _memoryReader;
+		WorkerPool _workerPool;
+		HuntPageStore _pageStore;
+		std::vector<HuntPage> _pages;
+		HuntValueType _valueType;
+		size_t _numberOfCandidates;
+		std::atomic<size_t> _numberOfCleanPages;
+	};
+}
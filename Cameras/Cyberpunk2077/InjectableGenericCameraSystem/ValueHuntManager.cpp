@@ -0,0 +1,240 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+#include "ValueHuntManager.h"
+#include "MessageHandler.h"
+#include "Utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+
+using namespace std;
+
+namespace IGCS
+{
+	#define VALUE_HUNT_MAX_REPORTED_CANDIDATES		32
+
+	ValueHuntManager::ValueHuntManager() : _isBusy(false)
+	{
+	}
+
+
+	ValueHuntManager::~ValueHuntManager()
+	{
+		if (_huntThread.joinable())
+		{
+			_huntThread.join();
+		}
+	}
+
+
+	ValueHuntManager& ValueHuntManager::instance()
+	{
+		static ValueHuntManager theInstance;
+		return theInstance;
+	}
+
+
+	// Starts a new hunt. arguments is the value type, 'float' or 'int', optionally followed by the start and end address, in hex, of the memory
+	// to hunt in, e.g. "float 7FF600000000 7FF700000000". Without addresses, all memory which can contain game data is used.
+	void ValueHuntManager::startHunt(const string& arguments)
+	{
+		istringstream argumentStream(arguments);
+		string valueTypeName;
+		argumentStream >> valueTypeName;
+		if (valueTypeName != "float" && valueTypeName != "int")
+		{
+			MessageHandler::logError("Unknown value type '%s' for a value hunt, use 'float' or 'int'.", valueTypeName.c_str());
+			return;
+		}
+		const HuntValueType valueType = valueTypeName == "float" ? HuntValueType::Float : HuntValueType::Int32;
+		unsigned long long startAddress = 0;
+		unsigned long long endAddress = ~0ULL;
+		string startAddressText;
+		string endAddressText;
+		if (argumentStream >> startAddressText >> endAddressText)
+		{
+			startAddress = strtoull(startAddressText.c_str(), nullptr, 16);
+			endAddress = strtoull(endAddressText.c_str(), nullptr, 16);
+		}
+		runInBackground([this, valueType, startAddress, endAddress]
+			{
+				vector<AOBScanRange> ranges;
+				size_t sizeOfRanges = 0;
+				for (auto& range : Utils::determineGameDataRanges())
+				{
+					const uint8_t* rangeStart = max(range.start, reinterpret_cast<const uint8_t*>(startAddress));
+					const uint8_t* rangeEnd = min(range.start + range.size, reinterpret_cast<const uint8_t*>(endAddress));
+					if (rangeStart < rangeEnd)
+					{
+						ranges.push_back({ rangeStart, static_cast<size_t>(rangeEnd - rangeStart) });
+						sizeOfRanges += rangeEnd - rangeStart;
+					}
+				}
+				if (nullptr == _hunt)
+				{
+					_hunt = make_unique<ValueHunt>([](uintptr_t address, uint8_t* buffer, size_t size)
+						{
+							// the game can free memory while it's read, so it's not read directly.
+							SIZE_T numberOfBytesRead = 0;
+							return ReadProcessMemory(GetCurrentProcess(), reinterpret_cast<LPCVOID>(address), buffer, size, &numberOfBytesRead) && numberOfBytesRead == size;
+						}, WorkerPool::defaultNumberOfWorkers());
+				}
+				const auto startTime = chrono::steady_clock::now();
+				_hunt->start(ranges, valueType);
+				const double timeInMs = chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+				MessageHandler::logLine("Value hunt started over %.1f MB of memory in %.0fms: %zu candidates in %zu pages, using %.1f MB of memory.", sizeOfRanges / (1024.0 * 1024.0),
+										timeInMs, _hunt->numberOfCandidates(), _hunt->numberOfPages(), _hunt->memoryUsageInBytes() / (1024.0 * 1024.0));
+			});
+	}
+
+
+	// Narrows the hunt down with the comparison in arguments: 'changed', 'unchanged' [epsilon], 'increased', 'decreased' or 'equal' value 
+	// [epsilon]. The epsilon is only used for floats and is 0 by default.
+	void ValueHuntManager::narrowHunt(const string& arguments)
+	{
+		istringstream argumentStream(arguments);
+		string comparisonName;
+		argumentStream >> comparisonName;
+		double value = 0.0;
+		double epsilon = 0.0;
+		HuntComparison comparison;
+		if (comparisonName == "changed")
+		{
+			comparison = HuntComparison::Changed;
+		}
+		else if (comparisonName == "unchanged")
+		{
+			comparison = HuntComparison::Unchanged;
+			argumentStream >> epsilon;
+		}
+		else if (comparisonName == "increased")
+		{
+			comparison = HuntComparison::Increased;
+		}
+		else if (comparisonName == "decreased")
+		{
+			comparison = HuntComparison::Decreased;
+		}
+		else if (comparisonName == "equal" && (argumentStream >> value))
+		{
+			comparison = HuntComparison::EqualTo;
+			argumentStream >> epsilon;
+		}
+		else
+		{
+			MessageHandler::logError("Unknown value hunt comparison '%s', use changed, unchanged [epsilon], increased, decreased or equal value [epsilon].", arguments.c_str());
+			return;
+		}
+		runInBackground([this, comparison, value, epsilon, arguments]
+			{
+				if (nullptr == _hunt || 0 == _hunt->numberOfPages())
+				{
+					MessageHandler::logLine("There's no value hunt with candidates left, start a new one first.");
+					return;
+				}
+				const size_t numberOfPagesBefore = _hunt->numberOfPages();
+				const auto narrowStartTime = chrono::steady_clock::now();
+				_hunt->narrow(comparison, value, epsilon);
+				const double timeInMs = chrono::duration<double, milli>(chrono::steady_clock::now() - narrowStartTime).count();
+				MessageHandler::logLine("Value hunt '%s' in %.0fms: %zu candidates left in %zu pages (%zu of %zu pages were unchanged), using %.1f MB of memory.", arguments.c_str(), timeInMs,
+										_hunt->numberOfCandidates(), _hunt->numberOfPages(), _hunt->numberOfCleanPages(), numberOfPagesBefore, _hunt->memoryUsageInBytes() / (1024.0 * 1024.0));
+				reportCandidates();
+			});
+	}
+
+
+	void ValueHuntManager::discardHunt()
+	{
+		runInBackground([this]
+			{
+				if (nullptr == _hunt)
+				{
+					MessageHandler::logLine("There's no value hunt to discard.");
+					return;
+				}
+				const double memoryUsageInMB = _hunt->memoryUsageInBytes() / (1024.0 * 1024.0);
+				_hunt.reset();
+				MessageHandler::logLine("Value hunt discarded, %.1f MB of memory released.", memoryUsageInMB);
+			});
+	}
+
+
+	// Waits for the work running on the hunt thread and discards the hunt, which stops the workers of its pool. Called when the dll is 
+	// unloaded, after the named pipe listener has been stopped, so no new work is started.
+	void ValueHuntManager::stop()
+	{
+		if (_huntThread.joinable())
+		{
+			_huntThread.join();
+		}
+		_hunt.reset();
+	}
+
+
+	// Runs the work specified on the hunt thread, unless the previous work is still running.
+	void ValueHuntManager::runInBackground(function<void()> work)
+	{
+		if (_isBusy.exchange(true))
+		{
+			MessageHandler::logLine("The value hunt is still busy, try again when it's done.");
+			return;
+		}
+		if (_huntThread.joinable())
+		{
+			// previous work is done, as _isBusy was false.
+			_huntThread.join();
+		}
+		_huntThread = thread([this, work] { work(); _isBusy = false; });
+	}
+
+
+	void ValueHuntManager::reportCandidates()
+	{
+		vector<HuntCandidate> candidates;
+		_hunt->collectCandidates(candidates, VALUE_HUNT_MAX_REPORTED_CANDIDATES);
+		for (auto& candidate : candidates)
+		{
+			if (HuntValueType::Float == _hunt->valueType())
+			{
+				float value;
+				memcpy(&value, &candidate.rawValue, sizeof(value));
+				MessageHandler::logLine("    0x%llX: %f", static_cast<unsigned long long>(candidate.address), value);
+			}
+			else
+			{
+				MessageHandler::logLine("    0x%llX: %d", static_cast<unsigned long long>(candidate.address), static_cast<int32_t>(candidate.rawValue));
+			}
+		}
+		if (_hunt->numberOfCandidates() > candidates.size())
+		{
+			MessageHandler::logLine("    ... and %zu more.", _hunt->numberOfCandidates() - candidates.size());
+		}
+	}
+}
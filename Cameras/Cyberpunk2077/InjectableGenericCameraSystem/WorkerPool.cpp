@@ -0,0 +1,115 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "WorkerPool.h"
+
+namespace IGCS
+{
+	// Creates a pool with the number of workers specified. If numberOfWorkers is 0 or less, defaultNumberOfWorkers() workers are created.
+	WorkerPool::WorkerPool(int numberOfWorkers) : _numberOfBusyWorkers{ 0 }, _stopping{ false }
+	{
+		if (numberOfWorkers <= 0)
+		{
+			numberOfWorkers = defaultNumberOfWorkers();
+		}
+		for (int i = 0; i < numberOfWorkers; i++)
+		{
+			_workers.emplace_back(&WorkerPool::workerLoop, this);
+		}
+	}
+
+
+	// Runs the jobs still queued and stops the workers.
+	WorkerPool::~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_jobsMutex);
+			_stopping = true;
+		}
+		_jobAvailable.notify_all();
+		for (auto& worker : _workers)
+		{
+			worker.join();
+		}
+	}
+
+
+	void WorkerPool::enqueue(std::function<void()> job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_jobsMutex);
+			_jobs.push_back(std::move(job));
+		}
+		_jobAvailable.notify_one();
+	}
+
+
+	// Blocks till all jobs enqueued have been executed.
+	void WorkerPool::waitUntilIdle()
+	{
+		std::unique_lock<std::mutex> lock(_jobsMutex);
+		_allJobsDone.wait(lock, [this] { return _jobs.empty() && 0 == _numberOfBusyWorkers; });
+	}
+
+
+	// One worker per hardware thread.
+	int WorkerPool::defaultNumberOfWorkers()
+	{
+		const unsigned int numberOfHardwareThreads = std::thread::hardware_concurrency();
+		return numberOfHardwareThreads > 0 ? static_cast<int>(numberOfHardwareThreads) : 1;
+	}
+
+
+	void WorkerPool::workerLoop()
+	{
+		while (true)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(_jobsMutex);
+				_jobAvailable.wait(lock, [this] { return _stopping || !_jobs.empty(); });
+				if (_jobs.empty())
+				{
+					// stopping and nothing left to do
+					return;
+				}
+				job = std::move(_jobs.front());
+				_jobs.pop_front();
+				_numberOfBusyWorkers++;
+			}
+			job();
+			{
+				std::lock_guard<std::mutex> lock(_jobsMutex);
+				_numberOfBusyWorkers--;
+				if (_jobs.empty() && 0 == _numberOfBusyWorkers)
+				{
+					_allJobsDone.notify_all();
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,373 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "X64Emitter.h"
+#include <cstring>
+
+using namespace std;
+
+namespace IGCS
+{
+	#define REX_W		0x08
+	#define REX_R		0x04
+	#define REX_B		0x01
+
+	static uint8_t registerCode(X64Register value)
+	{
+		return static_cast<uint8_t>(value);
+	}
+
+
+	static bool fitsInInt32(int64_t value)
+	{
+		return value >= INT32_MIN && value <= INT32_MAX;
+	}
+
+
+	X64Emitter::X64Emitter(uintptr_t baseAddress) : _baseAddress(baseAddress)
+	{
+	}
+
+
+	int X64Emitter::createLabel()
+	{
+		_labelOffsets.push_back(-1);
+		return static_cast<int>(_labelOffsets.size()) - 1;
+	}
+
+
+	// Binds the label specified to the current position in the code.
+	void X64Emitter::bindLabel(int label)
+	{
+		_labelOffsets[label] = static_cast<int64_t>(_code.size());
+	}
+
+
+	// push r64
+	void X64Emitter::push(X64Register source)
+	{
+		if (registerCode(source) >= 8)
+		{
+			emitByte(0x40 | REX_B);
+		}
+		emitByte(0x50 | (registerCode(source) & 7));
+	}
+
+
+	// pop r64. Doesn't change the flags.
+	void X64Emitter::pop(X64Register destination)
+	{
+		if (registerCode(destination) >= 8)
+		{
+			emitByte(0x40 | REX_B);
+		}
+		emitByte(0x58 | (registerCode(destination) & 7));
+	}
+
+
+	// pushfq
+	void X64Emitter::pushFlags()
+	{
+		emitByte(0x9C);
+	}
+
+
+	// popfq
+	void X64Emitter::popFlags()
+	{
+		emitByte(0x9D);
+	}
+
+
+	// lahf, seto al: saves the arithmetic flags in ah and al, which is much cheaper than pushfq/popfq. Overwrites ax.
+	void X64Emitter::saveArithmeticFlagsInRax()
+	{
+		const uint8_t saveBytes[] = { 0x9F, 0x0F, 0x90, 0xC0 };
+		emitBytes(saveBytes, sizeof(saveBytes));
+	}
+
+
+	// add al, 7Fh, sahf: restores the flags saved by saveArithmeticFlagsInRax. The add overflows only if al is 1, i.e. if the overflow flag
+	// was set, and sahf then restores the other flags from ah.
+	void X64Emitter::restoreArithmeticFlagsFromRax()
+	{
+		const uint8_t restoreBytes[] = { 0x04, 0x7F, 0x9E };
+		emitBytes(restoreBytes, sizeof(restoreBytes));
+	}
+
+
+	// mov r64, imm64
+	void X64Emitter::moveImmediate(X64Register destination, uint64_t value)
+	{
+		emitByte(0x40 | REX_W | (registerCode(destination) >= 8 ? REX_B : 0));
+		emitByte(0xB8 | (registerCode(destination) & 7));
+		for (int i = 0; i < 8; i++)
+		{
+			emitByte(static_cast<uint8_t>(value >> (i * 8)));
+		}
+	}
+
+
+	// mov r64, qword ptr [base + displacement]
+	void X64Emitter::load(X64Register destination, X64Register base, int32_t displacement)
+	{
+		emitMemoryOperand(REX_W, 0x8B, registerCode(destination), base, displacement);
+	}
+
+
+	// mov qword ptr [base + displacement], r64
+	void X64Emitter::store(X64Register base, int32_t displacement, X64Register source)
+	{
+		emitMemoryOperand(REX_W, 0x89, registerCode(source), base, displacement);
+	}
+
+
+	// cmp r64, qword ptr [base + displacement]
+	void X64Emitter::compare(X64Register left, X64Register base, int32_t displacement)
+	{
+		emitMemoryOperand(REX_W, 0x3B, registerCode(left), base, displacement);
+	}
+
+
+	// cmp byte ptr [base + displacement], imm8
+	void X64Emitter::compareByte(X64Register base, int32_t displacement, uint8_t value)
+	{
+		emitMemoryOperand(0, 0x80, 7, base, displacement);
+		emitByte(value);
+	}
+
+
+	// lock inc qword ptr [base + displacement]
+	void X64Emitter::lockIncrement(X64Register base, int32_t displacement)
+	{
+		emitByte(0xF0);
+		emitMemoryOperand(REX_W, 0xFF, 0, base, displacement);
+	}
+
+
+	// jmp rel32 to the label specified.
+	void X64Emitter::jump(int label)
+	{
+		emitByte(0xE9);
+		emitRelativeToLabel(label);
+	}
+
+
+	// jcc rel32 to the label specified.
+	void X64Emitter::jumpIf(X64Condition condition, int label)
+	{
+		emitByte(0x0F);
+		emitByte(0x80 | static_cast<uint8_t>(condition));
+		emitRelativeToLabel(label);
+	}
+
+
+	// jmp qword ptr [rip+0] followed by the 8 byte target, so the target can be anywhere in the address space.
+	void X64Emitter::jumpAbsolute(uintptr_t target)
+	{
+		const uint8_t jumpBytes[] = { 0xFF, 0x25, 0x00, 0x00, 0x00, 0x00 };
+		emitBytes(jumpBytes, sizeof(jumpBytes));
+		for (int i = 0; i < 8; i++)
+		{
+			emitByte(static_cast<uint8_t>(static_cast<uint64_t>(target) >> (i * 8)));
+		}
+	}
+
+
+	void X64Emitter::emitBytes(const uint8_t* bytes, size_t length)
+	{
+		_code.insert(_code.end(), bytes, bytes + length);
+	}
+
+
+	// Copies the instruction at instructionAddress, decoded in decoded, to the code. Its rip relative operand is relocated so it still refers to
+	// the same address. Relative branches are re-encoded with a 32 bit offset, so short branches can be copied too; if branchTargetLabel is 
+	// specified, the branch jumps to that label instead of its original target, e.g. for branches to other instructions which are copied.
+	// Returns false if the instruction can't be relocated, e.g. if its target is more than 2GB away from the code.
+	bool X64Emitter::copyInstruction(const uint8_t* instructionAddress, const X64Instruction& decoded, int branchTargetLabel)
+	{
+		if (decoded.length <= 0)
+		{
+			return fail("The instruction couldn't be decoded.");
+		}
+		if (decoded.isRelativeBranch)
+		{
+			// the prefixes of a branch are only hints and are dropped, except an operand size prefix which would make the offset 16 bit.
+			const int opcodeStart = decoded.immediateOffset - (decoded.opcodeMap == 1 ? 2 : 1);
+			if (nullptr != memchr(instructionAddress, 0x66, opcodeStart))
+			{
+				return fail("Branches with a 16 bit offset can't be relocated.");
+			}
+			if (decoded.opcodeMap == 0 && (decoded.opcode == 0xE8 || decoded.opcode == 0xE9 || decoded.opcode == 0xEB))
+			{
+				// call rel32 stays a call, jmp rel8 becomes a jmp rel32.
+				emitByte(decoded.opcode == 0xE8 ? 0xE8 : 0xE9);
+			}
+			else if ((decoded.opcodeMap == 0 && (decoded.opcode & 0xF0) == 0x70) || (decoded.opcodeMap == 1 && (decoded.opcode & 0xF0) == 0x80))
+			{
+				emitByte(0x0F);
+				emitByte(0x80 | (decoded.opcode & 0x0F));
+			}
+			else
+			{
+				// loop, loopcc and jrcxz only exist with an 8 bit offset.
+				return fail("Loop and jrcxz instructions can't be relocated.");
+			}
+			if (branchTargetLabel >= 0)
+			{
+				emitRelativeToLabel(branchTargetLabel);
+				return true;
+			}
+			return emitRelativeToAddress(reinterpret_cast<uintptr_t>(X64InstructionDecoder::determineBranchTarget(instructionAddress, decoded)));
+		}
+		if (decoded.isRipRelative)
+		{
+			// the instruction keeps its length, so the displacement is relative to the end of the copy.
+			const uintptr_t target = reinterpret_cast<uintptr_t>(X64InstructionDecoder::determineRipRelativeTarget(instructionAddress, decoded));
+			const int64_t displacement = static_cast<int64_t>(target - (currentAddress() + decoded.length));
+			if (!fitsInInt32(displacement))
+			{
+				return fail("The rip relative operand of the instruction is more than 2GB away from the code.");
+			}
+			const size_t start = _code.size();
+			emitBytes(instructionAddress, decoded.length);
+			const int32_t displacement32 = static_cast<int32_t>(displacement);
+			memcpy(_code.data() + start + decoded.displacementOffset, &displacement32, sizeof(displacement32));
+			return true;
+		}
+		emitBytes(instructionAddress, decoded.length);
+		return true;
+	}
+
+
+	// Resolves the jumps to labels. Returns false if a label isn't bound or if something emitted before failed.
+	bool X64Emitter::finish()
+	{
+		if (!_errorDescription.empty())
+		{
+			return false;
+		}
+		for (auto& fixup : _labelFixups)
+		{
+			const int64_t labelOffset = _labelOffsets[fixup.label];
+			if (labelOffset < 0)
+			{
+				return fail("A jump refers to a label which isn't bound.");
+			}
+			const int32_t offset = static_cast<int32_t>(labelOffset - static_cast<int64_t>(fixup.offsetInCode + sizeof(int32_t)));
+			memcpy(_code.data() + fixup.offsetInCode, &offset, sizeof(offset));
+		}
+		_labelFixups.clear();
+		return true;
+	}
+
+
+	void X64Emitter::emitByte(uint8_t value)
+	{
+		_code.push_back(value);
+	}
+
+
+	void X64Emitter::emitInt32(int32_t value)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			emitByte(static_cast<uint8_t>(static_cast<uint32_t>(value) >> (i * 8)));
+		}
+	}
+
+
+	// Emits [REX] opcode ModRM [SIB] [disp8/disp32] for a [base + displacement] operand. regField is the register or the opcode extension in the 
+	// reg field of the ModRM byte. rsp and r12 as base need a SIB byte, rbp and r13 as base always need a displacement.
+	void X64Emitter::emitMemoryOperand(uint8_t rexW, uint8_t opcode, uint8_t regField, X64Register base, int32_t displacement)
+	{
+		const uint8_t rex = rexW | (regField >= 8 ? REX_R : 0) | (registerCode(base) >= 8 ? REX_B : 0);
+		if (rex != 0)
+		{
+			emitByte(0x40 | rex);
+		}
+		emitByte(opcode);
+		const uint8_t baseLowBits = registerCode(base) & 7;
+		uint8_t mod;
+		if (displacement == 0 && baseLowBits != 5)
+		{
+			mod = 0;
+		}
+		else if (displacement >= INT8_MIN && displacement <= INT8_MAX)
+		{
+			mod = 1;
+		}
+		else
+		{
+			mod = 2;
+		}
+		emitByte(static_cast<uint8_t>((mod << 6) | ((regField & 7) << 3) | baseLowBits));
+		if (baseLowBits == 4)
+		{
+			// SIB: no index, base in the base field.
+			emitByte(0x24);
+		}
+		if (mod == 1)
+		{
+			emitByte(static_cast<uint8_t>(static_cast<int8_t>(displacement)));
+		}
+		else if (mod == 2)
+		{
+			emitInt32(displacement);
+		}
+	}
+
+
+	void X64Emitter::emitRelativeToLabel(int label)
+	{
+		_labelFixups.push_back({ _code.size(), label });
+		emitInt32(0);
+	}
+
+
+	// Emits the 32 bit offset of target relative to the end of the offset.
+	bool X64Emitter::emitRelativeToAddress(uintptr_t target)
+	{
+		const int64_t offset = static_cast<int64_t>(target - (currentAddress() + sizeof(int32_t)));
+		if (!fitsInInt32(offset))
+		{
+			return fail("The branch target is more than 2GB away from the code.");
+		}
+		emitInt32(static_cast<int32_t>(offset));
+		return true;
+	}
+
+
+	bool X64Emitter::fail(const string& errorDescription)
+	{
+		if (_errorDescription.empty())
+		{
+			_errorDescription = errorDescription;
+		}
+		return false;
+	}
+}
@@ -0,0 +1,106 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include "X64InstructionDecoder.h"
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace IGCS
+{
+	// The general purpose registers, in encoding order.
+	enum class X64Register : uint8_t
+	{
+		Rax, Rcx, Rdx, Rbx, Rsp, Rbp, Rsi, Rdi,
+		R8, R9, R10, R11, R12, R13, R14, R15,
+	};
+
+	// The condition codes of jcc, in encoding order.
+	enum class X64Condition : uint8_t
+	{
+		Overflow, NotOverflow, Below, AboveOrEqual, Equal, NotEqual, BelowOrEqual, Above,
+		Sign, NotSign, Parity, NotParity, Less, GreaterOrEqual, LessOrEqual, Greater,
+	};
+
+	// Emits x64 machine code into a buffer which will be placed at baseAddress. The address has to be known up front so instructions copied from
+	// elsewhere can have their rip relative operands and branches relocated. Only the handful of instructions needed for interceptor stubs can
+	// be emitted. Jumps to labels are always emitted with a 32 bit offset and resolved by finish. Doesn't depend on windows headers, so the 
+	// encodings can be checked outside the camera dll too.
+	class X64Emitter
+	{
+	public:
+		explicit X64Emitter(uintptr_t baseAddress);
+
+		int createLabel();
+		void bindLabel(int label);
+		void push(X64Register source);
+		void pop(X64Register destination);
+		void pushFlags();
+		void popFlags();
+		void saveArithmeticFlagsInRax();
+		void restoreArithmeticFlagsFromRax();
+		void moveImmediate(X64Register destination, uint64_t value);
+		void load(X64Register destination, X64Register base, int32_t displacement);
+		void store(X64Register base, int32_t displacement, X64Register source);
+		void compare(X64Register left, X64Register base, int32_t displacement);
+		void compareByte(X64Register base, int32_t displacement, uint8_t value);
+		void lockIncrement(X64Register base, int32_t displacement);
+		void jump(int label);
+		void jumpIf(X64Condition condition, int label);
+		void jumpAbsolute(uintptr_t target);
+		void emitBytes(const uint8_t* bytes, size_t length);
+		bool copyInstruction(const uint8_t* instructionAddress, const X64Instruction& decoded, int branchTargetLabel = -1);
+		bool finish();
+
+		uintptr_t currentAddress() const { return _baseAddress + _code.size(); }
+		const std::vector<uint8_t>& code() const { return _code; }
+		const std::string& errorDescription() const { return _errorDescription; }
+
+	private:
+		// A 32 bit offset in the code which has to be set to the offset of a label relative to the end of the offset.
+		struct LabelFixup
+		{
+			size_t offsetInCode;
+			int label;
+		};
+
+		void emitByte(uint8_t value);
+		void emitInt32(int32_t value);
+		void emitMemoryOperand(uint8_t rexW, uint8_t opcode, uint8_t regField, X64Register base, int32_t displacement);
+		void emitRelativeToLabel(int label);
+		bool emitRelativeToAddress(uintptr_t target);
+		bool fail(const std::string& errorDescription);
+
+		uintptr_t _baseAddress;
+		std::vector<uint8_t> _code;
+		std::vector<int64_t> _labelOffsets;		// -1 for labels which aren't bound yet.
+		std::vector<LabelFixup> _labelFixups;
+		std::string _errorDescription;
+	};
+}
@@ -0,0 +1,419 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "X64InstructionDecoder.h"
+#include <cstring>
+
+namespace IGCS::X64InstructionDecoder
+{
+	// Flags per opcode in the opcode tables.
+	#define OP_NONE			0x00
+	#define OP_MODRM		0x01	// has a ModRM byte
+	#define OP_IMM8			0x02	// has an 8-bit immediate
+	#define OP_IMM16		0x04	// has a 16-bit immediate
+	#define OP_IMMZ			0x08	// has a 16-bit immediate with a 66 prefix, otherwise a 32-bit immediate
+	#define OP_RELATIVE		0x10	// the immediate is a branch offset relative to the next instruction
+	#define OP_INVALID		0x20	// invalid in 64-bit mode
+	#define OP_PREFIX		0x40	// legacy or REX prefix
+	#define OP_SPECIAL		0x80	// length depends on more than the opcode, handled in decode
+
+	#define OP_M			OP_MODRM
+	#define OP_MB			(OP_MODRM | OP_IMM8)
+	#define OP_MZ			(OP_MODRM | OP_IMMZ)
+	#define OP_B			OP_IMM8
+	#define OP_Z			OP_IMMZ
+	#define OP_BR			(OP_IMM8 | OP_RELATIVE)
+	#define OP_ZR			(OP_IMMZ | OP_RELATIVE)
+	#define OP_X			OP_INVALID
+	#define OP_P			OP_PREFIX
+	#define OP_S			OP_SPECIAL
+	#define OP_0			OP_NONE
+
+	// One byte opcodes.
+	static const uint8_t oneByteOpcodeFlags[256] =
+	{
+		//	x0		x1		x2		x3		x4		x5		x6		x7		x8		x9		xA		xB		xC		xD		xE		xF
+			OP_M,	OP_M,	OP_M,	OP_M,	OP_B,	OP_Z,	OP_X,	OP_X,	OP_M,	OP_M,	OP_M,	OP_M,	OP_B,	OP_Z,	OP_X,	OP_S,	// 0x
+			OP_M,	OP_M,	OP_M,	OP_M,	OP_B,	OP_Z,	OP_X,	OP_X,	OP_M,	OP_M,	OP_M,	OP_M,	OP_B,	OP_Z,	OP_X,	OP_X,	// 1x
+			OP_M,	OP_M,	OP_M,	OP_M,	OP_B,	OP_Z,	OP_P,	OP_X,	OP_M,	OP_M,	OP_M,	OP_M,	OP_B,	OP_Z,	OP_P,	OP_X,	// 2x
+			OP_M,	OP_M,	OP_M,	OP_M,	OP_B,	OP_Z,	OP_P,	OP_X,	OP_M,	OP_M,	OP_M,	OP_M,	OP_B,	OP_Z,	OP_P,	OP_X,	// 3x
+			OP_P,	OP_P,	OP_P,	OP_P,	OP_P,	OP_P,	OP_P,	OP_P,	OP_P,	OP_P,	OP_P,	OP_P,	OP_P,	OP_P,	OP_P,	OP_P,	// 4x
+			OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	// 5x
+			OP_X,	OP_X,	OP_S,	OP_M,	OP_P,	OP_P,	OP_P,	OP_P,	OP_Z,	OP_MZ,	OP_B,	OP_MB,	OP_0,	OP_0,	OP_0,	OP_0,	// 6x
+			OP_BR,	OP_BR,	OP_BR,	OP_BR,	OP_BR,	OP_BR,	OP_BR,	OP_BR,	OP_BR,	OP_BR,	OP_BR,	OP_BR,	OP_BR,	OP_BR,	OP_BR,	OP_BR,	// 7x
+			OP_MB,	OP_MZ,	OP_X,	OP_MB,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	// 8x
+			OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	OP_X,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	// 9x
+			OP_S,	OP_S,	OP_S,	OP_S,	OP_0,	OP_0,	OP_0,	OP_0,	OP_B,	OP_Z,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	// Ax
+			OP_B,	OP_B,	OP_B,	OP_B,	OP_B,	OP_B,	OP_B,	OP_B,	OP_S,	OP_S,	OP_S,	OP_S,	OP_S,	OP_S,	OP_S,	OP_S,	// Bx
+			OP_MB,	OP_MB,	OP_IMM16,OP_0,	OP_S,	OP_S,	OP_MB,	OP_MZ,	OP_IMM16 | OP_IMM8, OP_0, OP_IMM16, OP_0, OP_0, OP_B,	OP_X,	OP_0,	// Cx
+			OP_M,	OP_M,	OP_M,	OP_M,	OP_X,	OP_X,	OP_X,	OP_0,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	// Dx
+			OP_BR,	OP_BR,	OP_BR,	OP_BR,	OP_B,	OP_B,	OP_B,	OP_B,	OP_ZR,	OP_ZR,	OP_X,	OP_BR,	OP_0,	OP_0,	OP_0,	OP_0,	// Ex
+			OP_P,	OP_0,	OP_P,	OP_P,	OP_0,	OP_0,	OP_S,	OP_S,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	OP_M,	OP_M,	// Fx
+	};
+
+	// Two byte opcodes, 0F xx. Also used for VEX/EVEX instructions in map 1.
+	static const uint8_t twoByteOpcodeFlags[256] =
+	{
+		//	x0		x1		x2		x3		x4		x5		x6		x7		x8		x9		xA		xB		xC		xD		xE		xF
+			OP_M,	OP_M,	OP_M,	OP_M,	OP_X,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	OP_X,	OP_0,	OP_X,	OP_M,	OP_0,	OP_MB,	// 0x
+			OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	// 1x
+			OP_M,	OP_M,	OP_M,	OP_M,	OP_X,	OP_X,	OP_X,	OP_X,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	// 2x
+			OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	OP_X,	OP_0,	OP_S,	OP_X,	OP_S,	OP_X,	OP_X,	OP_X,	OP_X,	OP_X,	// 3x
+			OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	// 4x
+			OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	// 5x
+			OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	// 6x
+			OP_MB,	OP_MB,	OP_MB,	OP_MB,	OP_M,	OP_M,	OP_M,	OP_0,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	// 7x
+			OP_ZR,	OP_ZR,	OP_ZR,	OP_ZR,	OP_ZR,	OP_ZR,	OP_ZR,	OP_ZR,	OP_ZR,	OP_ZR,	OP_ZR,	OP_ZR,	OP_ZR,	OP_ZR,	OP_ZR,	OP_ZR,	// 8x
+			OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	// 9x
+			OP_0,	OP_0,	OP_0,	OP_M,	OP_MB,	OP_M,	OP_X,	OP_X,	OP_0,	OP_0,	OP_0,	OP_M,	OP_MB,	OP_M,	OP_M,	OP_M,	// Ax
+			OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_MB,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	// Bx
+			OP_M,	OP_M,	OP_MB,	OP_M,	OP_MB,	OP_MB,	OP_MB,	OP_M,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	OP_0,	// Cx
+			OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	// Dx
+			OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	// Ex
+			OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	OP_M,	// Fx
+	};
+
+
+	static bool isLegacyPrefix(uint8_t value)
+	{
+		switch (value)
+		{
+			case 0x26: case 0x2E: case 0x36: case 0x3E: case 0x64: case 0x65:	// segment overrides
+			case 0x66: case 0x67:												// operand size, address size
+			case 0xF0: case 0xF2: case 0xF3:									// lock, repne, rep
+				return true;
+			default:
+				return false;
+		}
+	}
+
+
+	// Decodes the instruction at code. availableBytes is the number of readable bytes at code, the decoder never reads past them.
+	// Returns false if the instruction is invalid in 64-bit mode or doesn't fit in availableBytes, in which case decoded.length is 0.
+	bool decode(const uint8_t* code, size_t availableBytes, X64Instruction& decoded)
+	{
+		decoded = X64Instruction();
+		const int maxLength = availableBytes < X64_MAX_INSTRUCTION_LENGTH ? static_cast<int>(availableBytes) : X64_MAX_INSTRUCTION_LENGTH;
+		int offset = 0;
+		bool hasOperandSizePrefix = false;
+		bool hasAddressSizePrefix = false;
+		bool hasRexW = false;
+		// prefixes. A REX prefix is only used if it's the last prefix before the opcode.
+		while (offset < maxLength)
+		{
+			const uint8_t current = code[offset];
+			if (isLegacyPrefix(current))
+			{
+				hasOperandSizePrefix |= (current == 0x66);
+				hasAddressSizePrefix |= (current == 0x67);
+				hasRexW = false;
+				offset++;
+				continue;
+			}
+			if (current >= 0x40 && current <= 0x4F)
+			{
+				hasRexW = (current & 0x08) != 0;
+				offset++;
+				continue;
+			}
+			break;
+		}
+		if (offset >= maxLength)
+		{
+			return false;
+		}
+
+		// opcode. 
+		uint8_t flags = OP_NONE;
+		const uint8_t firstOpcodeByte = code[offset];
+		bool isVexOrEvex = false;
+		if (firstOpcodeByte == 0x0F)
+		{
+			if (offset + 1 >= maxLength)
+			{
+				return false;
+			}
+			const uint8_t secondOpcodeByte = code[offset + 1];
+			if (secondOpcodeByte == 0x38 || secondOpcodeByte == 0x3A)
+			{
+				if (offset + 2 >= maxLength)
+				{
+					return false;
+				}
+				decoded.opcodeMap = (secondOpcodeByte == 0x38) ? 2 : 3;
+				decoded.opcode = code[offset + 2];
+				offset += 3;
+			}
+			else
+			{
+				decoded.opcodeMap = 1;
+				decoded.opcode = secondOpcodeByte;
+				offset += 2;
+			}
+		}
+		else if (firstOpcodeByte == 0xC4 || firstOpcodeByte == 0xC5 || firstOpcodeByte == 0x62)
+		{
+			// in 64-bit mode these are always the VEX (C4: 3 bytes, C5: 2 bytes) and EVEX (62: 4 bytes) prefixes. The map is in the prefix.
+			const int prefixLength = (firstOpcodeByte == 0xC5) ? 2 : (firstOpcodeByte == 0xC4) ? 3 : 4;
+			if (offset + prefixLength >= maxLength)
+			{
+				return false;
+			}
+			decoded.opcodeMap = (firstOpcodeByte == 0xC5) ? 1 : (firstOpcodeByte == 0xC4) ? (code[offset + 1] & 0x1F) : (code[offset + 1] & 0x07);
+			decoded.opcode = code[offset + prefixLength];
+			offset += prefixLength + 1;
+			isVexOrEvex = true;
+		}
+		else
+		{
+			decoded.opcodeMap = 0;
+			decoded.opcode = firstOpcodeByte;
+			offset++;
+		}
+
+		switch (decoded.opcodeMap)
+		{
+			case 0:
+				// map 0 is reserved in the VEX and EVEX prefixes, it's not the one byte opcode map.
+				flags = isVexOrEvex ? OP_INVALID : oneByteOpcodeFlags[decoded.opcode];
+				break;
+			case 1:
+				flags = twoByteOpcodeFlags[decoded.opcode];
+				if (isVexOrEvex && (flags & (OP_INVALID | OP_SPECIAL | OP_RELATIVE)) == 0 && decoded.opcode != 0x77)
+				{
+					// all VEX/EVEX instructions in map 1 have a ModRM byte, except vzeroupper/vzeroall.
+					flags |= OP_MODRM;
+				}
+				break;
+			case 2:
+				flags = OP_MODRM;
+				break;
+			case 3:
+				flags = OP_MODRM | OP_IMM8;
+				break;
+			case 5:
+			case 6:
+				// EVEX maps of the FP16 instructions.
+				flags = isVexOrEvex ? OP_MODRM : OP_INVALID;
+				break;
+			default:
+				flags = OP_INVALID;
+				break;
+		}
+		if ((flags & (OP_INVALID | OP_PREFIX)) != 0 || (isVexOrEvex && (flags & (OP_SPECIAL | OP_RELATIVE)) != 0))
+		{
+			return false;
+		}
+
+		int immediateSize = 0;
+		int displacementSize = 0;
+		if ((flags & OP_SPECIAL) != 0)
+		{
+			switch (decoded.opcode)
+			{
+				case 0xA0: case 0xA1: case 0xA2: case 0xA3:
+					// mov with an absolute address (moffs) instead of a ModRM byte.
+					displacementSize = hasAddressSizePrefix ? 4 : 8;
+					break;
+				case 0xB8: case 0xB9: case 0xBA: case 0xBB: case 0xBC: case 0xBD: case 0xBE: case 0xBF:
+					// mov reg, imm. With REX.W the immediate is 64-bit.
+					immediateSize = hasRexW ? 8 : hasOperandSizePrefix ? 2 : 4;
+					break;
+				case 0xF6:
+				case 0xF7:
+					// group 3. Only test (reg field 0 and 1) has an immediate.
+					flags |= OP_MODRM;
+					if (offset >= maxLength)
+					{
+						return false;
+					}
+					if (((code[offset] >> 3) & 0x07) < 2)
+					{
+						immediateSize = (decoded.opcode == 0xF6) ? 1 : (hasOperandSizePrefix && !hasRexW) ? 2 : 4;
+					}
+					break;
+				default:
+					return false;
+			}
+		}
+		else
+		{
+			if ((flags & OP_IMM8) != 0)
+			{
+				immediateSize += 1;
+			}
+			if ((flags & OP_IMM16) != 0)
+			{
+				immediateSize += 2;
+			}
+			if ((flags & OP_IMMZ) != 0)
+			{
+				// relative branches always have a 32-bit offset in 64-bit mode, and REX.W overrides the 66 prefix.
+				immediateSize += ((flags & OP_RELATIVE) == 0 && hasOperandSizePrefix && !hasRexW) ? 2 : 4;
+			}
+		}
+
+		if ((flags & OP_MODRM) != 0)
+		{
+			if (offset >= maxLength)
+			{
+				return false;
+			}
+			decoded.hasModRM = true;
+			decoded.modRM = code[offset];
+			offset++;
+			const int mod = decoded.modRM >> 6;
+			const int rm = decoded.modRM & 0x07;
+			if (mod != 3)
+			{
+				if (rm == 4)
+				{
+					// SIB byte follows. A base of 5 without displacement means there's no base but a disp32.
+					if (offset >= maxLength)
+					{
+						return false;
+					}
+					const int sibBase = code[offset] & 0x07;
+					offset++;
+					if (mod == 0 && sibBase == 5)
+					{
+						displacementSize = 4;
+					}
+				}
+				else if (mod == 0 && rm == 5)
+				{
+					displacementSize = 4;
+					decoded.isRipRelative = true;
+				}
+				if (mod == 1)
+				{
+					displacementSize = 1;
+				}
+				else if (mod == 2)
+				{
+					displacementSize = 4;
+				}
+			}
+		}
+		if (displacementSize > 0)
+		{
+			decoded.displacementOffset = offset;
+			decoded.displacementSize = displacementSize;
+			offset += displacementSize;
+		}
+		if (immediateSize > 0)
+		{
+			decoded.immediateOffset = offset;
+			decoded.immediateSize = immediateSize;
+			decoded.isRelativeBranch = (flags & OP_RELATIVE) != 0;
+			offset += immediateSize;
+		}
+		if (offset > maxLength)
+		{
+			decoded = X64Instruction();
+			return false;
+		}
+		decoded.length = offset;
+		return true;
+	}
+
+
+	// Returns the length of the smallest run of whole instructions starting at code which is at least minimumLength bytes long, e.g. the
+	// bytes a hook of minimumLength bytes overwrites. Returns -1 if an instruction in the run couldn't be decoded.
+	int determineInstructionSpan(const uint8_t* code, size_t availableBytes, int minimumLength)
+	{
+		int span = 0;
+		while (span < minimumLength)
+		{
+			X64Instruction decoded;
+			if (static_cast<size_t>(span) >= availableBytes || !decode(code + span, availableBytes - span, decoded))
+			{
+				return -1;
+			}
+			span += decoded.length;
+		}
+		return span;
+	}
+
+
+	// Returns true if offset is the start of an instruction when decoding from code onwards.
+	bool isInstructionBoundary(const uint8_t* code, size_t availableBytes, int offset)
+	{
+		return determineInstructionSpan(code, availableBytes, offset) == offset;
+	}
+
+
+	// Returns the address the rip relative memory operand of the instruction at instructionAddress refers to. rip is the address of the next
+	// instruction, so immediates after the displacement are taken into account. Returns nullptr if the instruction has no such operand.
+	const uint8_t* determineRipRelativeTarget(const uint8_t* instructionAddress, const X64Instruction& decoded)
+	{
+		if (!decoded.isRipRelative || decoded.displacementSize != 4)
+		{
+			return nullptr;
+		}
+		int32_t displacement;
+		memcpy(&displacement, instructionAddress + decoded.displacementOffset, sizeof(displacement));
+		return instructionAddress + decoded.length + displacement;
+	}
+
+
+	// Returns the target of the relative jmp, jcc, call or loop at instructionAddress. Returns nullptr if the instruction isn't a relative branch.
+	const uint8_t* determineBranchTarget(const uint8_t* instructionAddress, const X64Instruction& decoded)
+	{
+		if (!decoded.isRelativeBranch)
+		{
+			return nullptr;
+		}
+		int32_t offset;
+		if (decoded.immediateSize == 1)
+		{
+			offset = static_cast<int8_t>(instructionAddress[decoded.immediateOffset]);
+		}
+		else
+		{
+			memcpy(&offset, instructionAddress + decoded.immediateOffset, sizeof(offset));
+		}
+		return instructionAddress + decoded.length + offset;
+	}
+
+
+	// Returns true if the instruction is a call: the relative call (E8) or the indirect near or far call (FF /2, FF /3). Code that replays
+	// such an instruction pushes a return address into itself.
+	bool isCall(const X64Instruction& decoded)
+	{
+		if (decoded.length == 0 || decoded.opcodeMap != 0)
+		{
+			return false;
+		}
+		if (decoded.opcode == 0xE8)
+		{
+			return true;
+		}
+		const uint8_t reg = (decoded.modRM >> 3) & 7;
+		return decoded.opcode == 0xFF && decoded.hasModRM && (reg == 2 || reg == 3);
+	}
+}
@@ -0,0 +1,65 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+namespace IGCS
+{
+	// The maximum length of an x64 instruction, prefixes included.
+	#define X64_MAX_INSTRUCTION_LENGTH		15
+
+	// The layout of a decoded x64 instruction: its length and where its displacement and immediate are.
+	struct X64Instruction
+	{
+		int length = 0;					// 0 if the instruction couldn't be decoded.
+		uint8_t opcodeMap = 0;			// 0: one byte opcodes, 1: 0F xx, 2: 0F 38 xx, 3: 0F 3A xx. Maps of VEX/EVEX instructions are the same.
+		uint8_t opcode = 0;				// the opcode byte within the map.
+		bool hasModRM = false;
+		uint8_t modRM = 0;
+		bool isRipRelative = false;		// true if the memory operand is [rip + disp32].
+		int displacementOffset = 0;		// offset of the displacement in the instruction, 0 if there's no displacement.
+		int displacementSize = 0;
+		int immediateOffset = 0;		// offset of the immediate in the instruction, 0 if there's no immediate.
+		int immediateSize = 0;
+		bool isRelativeBranch = false;	// true if the immediate is a branch offset relative to the next instruction (jmp, jcc, call, loop).
+	};
+}
+
+// Table driven length decoder for x64 code. It decodes the prefixes (legacy, REX, VEX and EVEX), opcode, ModRM, SIB, displacement and 
+// immediate of an instruction, but not what the instruction does. That's enough to determine whole instruction spans for hooks and
+// to resolve rip relative operands. Doesn't depend on windows headers, so it can be used by tools outside the camera dll too.
+namespace IGCS::X64InstructionDecoder
+{
+	bool decode(const uint8_t* code, size_t availableBytes, X64Instruction& decoded);
+	int determineInstructionSpan(const uint8_t* code, size_t availableBytes, int minimumLength);
+	bool isInstructionBoundary(const uint8_t* code, size_t availableBytes, int offset);
+	const uint8_t* determineRipRelativeTarget(const uint8_t* instructionAddress, const X64Instruction& decoded);
+	const uint8_t* determineBranchTarget(const uint8_t* instructionAddress, const X64Instruction& decoded);
+	bool isCall(const X64Instruction& decoded);
+}
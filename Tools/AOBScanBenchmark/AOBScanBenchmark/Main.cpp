@@ -0,0 +1,716 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Benchmark and regression harness for the AOB pattern search kernels used by the camera dlls. Runs on Windows and Linux, see the ReadMe.md
+// for how to build it.
+//
+// Usage: AOBScanBenchmark [--size <MB>] [--iterations <count>] [--seed <value>] [--workers <count>] [--pattern-set <name|all>] 
+//                         [--distribution <code|uniform|padding>] [--corpus] [image dump files]
+//
+// Without image dump files a synthetic image of the specified size is generated per pattern set, with the byte distribution specified and
+// the patterns of the set planted in it at known locations. Image dump files are read as-is, e.g. a dump of the game's image made with a 
+// memory dumper. With --corpus, every pattern set is run against synthetic images of every byte distribution and a couple of seeds, which is
+// meant as a regression test of the kernels and the engine. Afterwards the verification of the hook watchdog of the camera is timed.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include "ScanPattern.h"
+#include "AOBPatternSearch.h"
+#include "AOBScanEngine.h"
+#include "WorkerPool.h"
+#include "HookWatchdog.h"
+#include "AOBPatterns.h"
+
+using namespace std;
+using namespace IGCS;
+using namespace IGCS::GameSpecific;
+
+#define DEFAULT_SYNTHETIC_IMAGE_SIZE_MB		64
+#define DEFAULT_NUMBER_OF_ITERATIONS		5
+#define NUMBER_OF_CORPUS_SEEDS				3
+#define NUMBER_OF_WATCHDOG_SITES			10		// about the number of hooks the Cyberpunk 2077 camera sets.
+#define WATCHDOG_SITE_LENGTH				14		// the jmp qword ptr [0] and the address of a hook on x64.
+#define WATCHDOG_VERIFICATIONS_PER_RUN		100000
+
+#define EXIT_CODE_RESULTS_MATCH				0
+#define EXIT_CODE_RESULTS_DIFFER			1
+#define EXIT_CODE_USAGE_ERROR				2
+
+// The byte distributions of the synthetic images. 
+enum class ByteDistribution
+{
+	Code,			// x64 code like: half of the bytes are common opcode/modrm/zero bytes, the rest is uniformly distributed.
+	Uniform,		// all bytes uniformly distributed, so every anchor byte is as rare as any other.
+	Padding,		// mostly 00 and CC bytes, like padding and zero initialized data, with uniformly distributed bytes in between.
+};
+
+struct BenchmarkPattern
+{
+	string blockName;
+	ScanPattern pattern;
+};
+
+struct PatternSet
+{
+	string name;
+	vector<BenchmarkPattern> patterns;
+};
+
+// The patterns of the Greedfall camera. That camera creates its blocks at runtime from these strings in its InterceptorHelper.cpp, so they 
+// can't be included here and are copied as-is.
+struct PatternStringDefinition
+{
+	const char* blockName;
+	const char* patternAsString;
+	int occurrence;
+};
+
+static const PatternStringDefinition greedfallPatternDefinitions[] =
+{
+	{ "AOB_CAMERA_ADDRESS_INTERCEPT", "C3 | 66 0F 7F 83 B0 00 00 00 66 0F 7F 8B C0 00 00 00 66 0F 7F 93 D0 00 00 00 66 0F 7F 9B E0 00 00 00", 1 },
+	{ "AOB_CAMERA_WRITE1_INTERCEPT", "0F 28 5A 30 | 66 0F 7F 81 B0 00 00 00 66 0F 7F 89 C0 00 00 00 66 0F 7F 91 D0 00 00 00 66 0F 7F 99 E0 00 00 00", 1 },
+	{ "AOB_CAMERA_WRITE2_INTERCEPT", "0F 29 B7 B0 00 00 00 0F C6 87 C0 00 00 00 FA 41 0F 28 73 F0 0F C6 E0 C4", 1 },
+	{ "AOB_CAMERA_WRITE32_INTERCEPT", "66 0F 7F 80 B0 00 00 00 66 0F 7F 88 C0 00 00 00 66 0F 7F 90 D0 00 00 00 66 0F 7F 98 E0 00 00 00 48 8B 49 10", 1 },
+	{ "AOB_FOV_WRITE_INTERCEPT", "48 81 C1 E0 01 00 00 F3 0F 10 41 10 0F 2E C1 7A 02 74 0A | F3 0F 11 49 10", 1 },
+	{ "AOB_GAMESPEED_READ_INTERCEPT", "F3 0F 10 47 24 F3 0F 59 47 20 F3 0F 59 C1 F3 0F 5D", 1 },
+	{ "AOB_FOG_WRITE_INTERCEPT", "66 0F 7F 83 60 01 00 00 C6 83 A3 02 00 00 01", 1 },
+	{ "AOB_TOD_WRITE_INTERCEPT", "44 0F 28 54 24 50 44 0F 28 44 24 70 F3 0F 11 43 2C", 1 },
+};
+
+// The results of one kernel or engine for all patterns of a set. 
+struct BenchmarkResult
+{
+	vector<const uint8_t*> locations;
+	vector<int> numberOfMatches;				// only filled by the engine, the kernels stop at the occurrence of a pattern.
+	vector<double> bestTimePerPatternInMs;		// only filled for the kernels, the engine scans for all patterns at once.
+	double bestTimeInMs = 0.0;
+};
+
+
+static vector<PatternSet> createPatternSets()
+{
+	vector<PatternSet> toReturn;
+	PatternSet cyberpunkPatternSet{ "Cyberpunk2077", {} };
+	for (auto& definition : aobPatternDefinitions)
+	{
+		cyberpunkPatternSet.patterns.push_back({ definition.blockName, definition.pattern });
+	}
+	toReturn.push_back(cyberpunkPatternSet);
+	PatternSet greedfallPatternSet{ "Greedfall", {} };
+	for (auto& definition : greedfallPatternDefinitions)
+	{
+		greedfallPatternSet.patterns.push_back({ definition.blockName, ScanPattern(definition.patternAsString, definition.occurrence) });
+	}
+	toReturn.push_back(greedfallPatternSet);
+	return toReturn;
+}
+
+
+static const char* distributionName(ByteDistribution distribution)
+{
+	switch (distribution)
+	{
+	case ByteDistribution::Code:
+		return "code";
+	case ByteDistribution::Uniform:
+		return "uniform";
+	case ByteDistribution::Padding:
+		return "padding";
+	}
+	return "unknown";
+}
+
+
+// The search as it was done before the kernels: compare the first byte of the pattern, 4 bytes per iteration. Kept as the baseline and
+// used as the reference all other results are compared with.
+static const uint8_t* findPatternLegacy(const uint8_t* start, const uint8_t* end, const ScanPattern& pattern)
+{
+	const uint8_t firstByte = *(pattern.bytePattern());
+	if (end - start < pattern.patternSize() + 4)
+	{
+		for (const uint8_t* candidate = start; candidate + pattern.patternSize() <= end; candidate++)
+		{
+			if (pattern.matchesAt(candidate))
+			{
+				return candidate;
+			}
+		}
+		return nullptr;
+	}
+	const uint8_t* last = end - pattern.patternSize();
+	for (const uint8_t* i = start; i < last; i += 4)
+	{
+		uint32_t x;
+		memcpy(&x, i, sizeof(x));
+		for (int j = 0; j < 4; j++)
+		{
+			if (((x >> (j * 8)) & 0xFF) == firstByte && i + j <= last && pattern.matchesAt(i + j))
+			{
+				return i + j;
+			}
+		}
+	}
+	return nullptr;
+}
+
+
+// Generates an image with the byte distribution specified and plants each pattern in it 'occurrence' times, with random bytes at the 
+// wildcard positions. The planted copies are placed in disjoint slots of the image, so they never overlap each other. The offsets of the
+// copies of each pattern are stored, in ascending order, in plantedOffsetsPerPattern, so the reference results can be checked against them.
+static vector<uint8_t> createSyntheticImage(size_t imageSize, uint32_t seed, ByteDistribution distribution, const PatternSet& patternSet,
+											vector<vector<size_t>>& plantedOffsetsPerPattern)
+{
+	static const uint8_t commonBytes[] = { 0x00, 0x48, 0x8B, 0x89, 0x0F, 0xFF, 0xCC, 0x24, 0x4C, 0x8D, 0x44, 0xE8, 0xC3, 0x01, 0x10, 0x20 };
+	mt19937 generator(seed);
+	vector<uint8_t> image(imageSize);
+	for (size_t i = 0; i < imageSize; i++)
+	{
+		const uint32_t value = generator();
+		switch (distribution)
+		{
+		case ByteDistribution::Code:
+			image[i] = (value & 0x100) ? commonBytes[value & 0xF] : static_cast<uint8_t>(value);
+			break;
+		case ByteDistribution::Uniform:
+			image[i] = static_cast<uint8_t>(value);
+			break;
+		case ByteDistribution::Padding:
+			// 3 out of 4 bytes are padding.
+			image[i] = (value & 0x300) ? ((value & 0x400) ? 0xCC : 0x00) : static_cast<uint8_t>(value);
+			break;
+		}
+	}
+
+	size_t numberOfCopies = 0;
+	for (auto& benchmarkPattern : patternSet.patterns)
+	{
+		numberOfCopies += benchmarkPattern.pattern.occurrence();
+	}
+	plantedOffsetsPerPattern.assign(patternSet.patterns.size(), vector<size_t>());
+	const size_t slotSize = (numberOfCopies > 0) ? imageSize / numberOfCopies : 0;
+	if (slotSize < AOB_PATTERN_MAX_SIZE)
+	{
+		// too small to plant the patterns without overlap.
+		return image;
+	}
+	vector<size_t> slots(numberOfCopies);
+	for (size_t i = 0; i < numberOfCopies; i++)
+	{
+		slots[i] = i;
+	}
+	shuffle(slots.begin(), slots.end(), generator);
+	size_t copyIndex = 0;
+	for (size_t patternIndex = 0; patternIndex < patternSet.patterns.size(); patternIndex++)
+	{
+		const ScanPattern& pattern = patternSet.patterns[patternIndex].pattern;
+		for (int occurrence = 0; occurrence < pattern.occurrence(); occurrence++)
+		{
+			const size_t location = slots[copyIndex++] * slotSize + (generator() % (slotSize - pattern.patternSize() + 1));
+			for (int i = 0; i < pattern.patternSize(); i++)
+			{
+				if (pattern.patternMask()[i] == 0xFF)
+				{
+					image[location + i] = pattern.bytePattern()[i];
+				}
+			}
+			plantedOffsetsPerPattern[patternIndex].push_back(location);
+		}
+		sort(plantedOffsetsPerPattern[patternIndex].begin(), plantedOffsetsPerPattern[patternIndex].end());
+	}
+	return image;
+}
+
+
+static bool readImageDump(const string& filename, vector<uint8_t>& image)
+{
+	ifstream file(filename, ios::binary | ios::ate);
+	if (!file)
+	{
+		return false;
+	}
+	const streamoff fileSize = file.tellg();
+	file.seekg(0);
+	image.resize(static_cast<size_t>(fileSize));
+	return static_cast<bool>(file.read(reinterpret_cast<char*>(image.data()), fileSize));
+}
+
+
+// Returns the location of the occurrence-th match of the pattern, like Utils::findAOBPattern does.
+template<typename FindFunc>
+static const uint8_t* findOccurrence(const uint8_t* start, const uint8_t* end, int occurrence, FindFunc&& findFunc)
+{
+	const uint8_t* toReturn = nullptr;
+	const uint8_t* startOfScan = start;
+	for (int i = 0; i < occurrence; i++)
+	{
+		toReturn = findFunc(startOfScan, end);
+		if (nullptr == toReturn)
+		{
+			return nullptr;
+		}
+		startOfScan = toReturn + 1;
+	}
+	return toReturn;
+}
+
+
+// Counts all matches of the pattern in the image with the legacy search. Not timed, it's the reference for the match counts of the engine.
+static int countMatchesLegacy(const vector<uint8_t>& image, const ScanPattern& pattern)
+{
+	int toReturn = 0;
+	const uint8_t* end = image.data() + image.size();
+	const uint8_t* location = findPatternLegacy(image.data(), end, pattern);
+	while (nullptr != location)
+	{
+		toReturn++;
+		location = findPatternLegacy(location + 1, end, pattern);
+	}
+	return toReturn;
+}
+
+
+// Runs all patterns with the find function specified, 'iterations' times, and reports the best time. The best time per pattern is kept
+// as well, which is the latency of resolving that block with the kernel. Returns the locations of the last iteration.
+template<typename FindFunc>
+static BenchmarkResult runBenchmark(const char* name, const vector<uint8_t>& image, const PatternSet& patternSet, int iterations, FindFunc&& findFunc)
+{
+	const size_t numberOfPatterns = patternSet.patterns.size();
+	BenchmarkResult toReturn;
+	toReturn.locations.resize(numberOfPatterns);
+	toReturn.bestTimePerPatternInMs.resize(numberOfPatterns);
+	for (int iteration = 0; iteration < iterations; iteration++)
+	{
+		double timeInMs = 0.0;
+		for (size_t i = 0; i < numberOfPatterns; i++)
+		{
+			const auto startTime = chrono::steady_clock::now();
+			toReturn.locations[i] = findOccurrence(image.data(), image.data() + image.size(), patternSet.patterns[i].pattern.occurrence(),
+												   [&](const uint8_t* start, const uint8_t* end) { return findFunc(start, end, i); });
+			const double patternTimeInMs = chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+			if (0 == iteration || patternTimeInMs < toReturn.bestTimePerPatternInMs[i])
+			{
+				toReturn.bestTimePerPatternInMs[i] = patternTimeInMs;
+			}
+			timeInMs += patternTimeInMs;
+		}
+		if (0 == iteration || timeInMs < toReturn.bestTimeInMs)
+		{
+			toReturn.bestTimeInMs = timeInMs;
+		}
+	}
+	// every pattern scans (part of) the image, so report the throughput as the amount of bytes per pattern per second.
+	const double megabytesScanned = (static_cast<double>(image.size()) * numberOfPatterns) / (1024.0 * 1024.0);
+	printf("  %-10s %10.2f ms  %10.1f MB/s\n", name, toReturn.bestTimeInMs, megabytesScanned / (toReturn.bestTimeInMs / 1000.0));
+	return toReturn;
+}
+
+
+// Runs all patterns with the AOBScanEngine using the scan method specified, chunked on the worker pool specified if it's not null. Reports the
+// best time of 'iterations' runs and returns the results of the last iteration. The automatic method is what the camera uses.
+static BenchmarkResult runEngineBenchmark(const char* name, const vector<uint8_t>& image, const PatternSet& patternSet, int iterations, WorkerPool* workerPool,
+										  AOBScanEngine::ScanMethod scanMethod)
+{
+	AOBScanEngine engine;
+	engine.setScanMethod(scanMethod);
+	for (auto& benchmarkPattern : patternSet.patterns)
+	{
+		engine.addPattern(benchmarkPattern.pattern);
+	}
+	engine.compile();
+	BenchmarkResult toReturn;
+	for (int iteration = 0; iteration < iterations; iteration++)
+	{
+		const auto startTime = chrono::steady_clock::now();
+		if (nullptr == workerPool)
+		{
+			engine.scan(image.data(), image.size());
+		}
+		else
+		{
+			engine.scan(image.data(), image.size(), *workerPool);
+		}
+		const double timeInMs = chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+		if (0 == iteration || timeInMs < toReturn.bestTimeInMs)
+		{
+			toReturn.bestTimeInMs = timeInMs;
+		}
+	}
+	// all patterns are resolved by a single call, so the throughput is the image size per second.
+	printf("  %-10s %10.2f ms  %10.1f MB/s (image, %s)\n", name, toReturn.bestTimeInMs, (static_cast<double>(image.size()) / (1024.0 * 1024.0)) / (toReturn.bestTimeInMs / 1000.0),
+		   engine.usesSearchKernels() ? "search kernels" : "automaton");
+	for (int patternId = 0; patternId < engine.numberOfPatterns(); patternId++)
+	{
+		toReturn.locations.push_back(engine.locationOfPattern(patternId));
+		toReturn.numberOfMatches.push_back(engine.numberOfMatches(patternId));
+	}
+	return toReturn;
+}
+
+
+// Compares the locations and, if the result has them, the match counts with the reference. Reports every difference.
+static bool reportMismatches(const char* name, const PatternSet& patternSet, const BenchmarkResult& result, const BenchmarkResult& reference)
+{
+	bool resultsMatch = true;
+	for (size_t i = 0; i < result.locations.size(); i++)
+	{
+		if (result.locations[i] != reference.locations[i])
+		{
+			printf("  MISMATCH: %s, pattern %s\n", name, patternSet.patterns[i].blockName.c_str());
+			resultsMatch = false;
+		}
+		if (i < result.numberOfMatches.size() && result.numberOfMatches[i] != reference.numberOfMatches[i])
+		{
+			printf("  MISMATCH: %s, pattern %s matches %d times, expected %d\n", name, patternSet.patterns[i].blockName.c_str(), result.numberOfMatches[i],
+				   reference.numberOfMatches[i]);
+			resultsMatch = false;
+		}
+	}
+	return resultsMatch;
+}
+
+
+// Checks the reference results against the locations the patterns were planted at. The occurrence-th copy of a pattern has to be found,
+// unless the random bytes of the image contain the pattern as well, which is reported as the reference then differs from what was planted.
+static bool reportReferenceMismatches(const vector<uint8_t>& image, const PatternSet& patternSet, const BenchmarkResult& reference,
+									  const vector<vector<size_t>>& plantedOffsetsPerPattern)
+{
+	bool resultsMatch = true;
+	for (size_t i = 0; i < plantedOffsetsPerPattern.size(); i++)
+	{
+		const vector<size_t>& plantedOffsets = plantedOffsetsPerPattern[i];
+		const int occurrence = patternSet.patterns[i].pattern.occurrence();
+		if (plantedOffsets.size() < static_cast<size_t>(occurrence))
+		{
+			continue;
+		}
+		const uint8_t* expectedLocation = image.data() + plantedOffsets[occurrence - 1];
+		if (reference.locations[i] != expectedLocation || reference.numberOfMatches[i] != static_cast<int>(plantedOffsets.size()))
+		{
+			printf("  MISMATCH: reference, pattern %s planted %zu time(s), occurrence %d at offset 0x%zX, but found %d time(s)\n", 
+				   patternSet.patterns[i].blockName.c_str(), plantedOffsets.size(), occurrence, plantedOffsets[occurrence - 1], reference.numberOfMatches[i]);
+			resultsMatch = false;
+		}
+	}
+	return resultsMatch;
+}
+
+
+// Reports per block where the reference found it, how many times it matched and the latency of resolving it with every kernel. 
+static void reportPerBlockResults(const vector<uint8_t>& image, const PatternSet& patternSet, const vector<string>& kernelNames, 
+								  const vector<BenchmarkResult>& kernelResults)
+{
+	printf("  %-40s %12s %8s", "Block", "Offset", "Matches");
+	for (auto& kernelName : kernelNames)
+	{
+		printf(" %10s", kernelName.c_str());
+	}
+	printf("  (latency in us)\n");
+	const BenchmarkResult& reference = kernelResults[0];
+	for (size_t i = 0; i < patternSet.patterns.size(); i++)
+	{
+		if (nullptr == reference.locations[i])
+		{
+			printf("  %-40s %12s %8d", patternSet.patterns[i].blockName.c_str(), "not found", reference.numberOfMatches[i]);
+		}
+		else
+		{
+			printf("  %-40s   0x%08zX %8d", patternSet.patterns[i].blockName.c_str(), static_cast<size_t>(reference.locations[i] - image.data()), 
+				   reference.numberOfMatches[i]);
+		}
+		for (auto& result : kernelResults)
+		{
+			printf(" %10.1f", result.bestTimePerPatternInMs[i] * 1000.0);
+		}
+		printf("\n");
+	}
+}
+
+
+// Benchmarks all kernels and the engine with the pattern set specified and compares their results with the reference, the legacy search.
+// If plantedOffsetsPerPattern isn't empty, the reference itself is checked against the locations the patterns were planted at. Returns
+// true if all results match.
+static bool benchmarkImage(const string& imageName, const vector<uint8_t>& image, const PatternSet& patternSet, const vector<vector<size_t>>& plantedOffsetsPerPattern,
+						   int iterations, WorkerPool& workerPool, bool reportPerBlock)
+{
+	printf("Image '%s', %zu bytes, %s patterns (%zu), best of %d iterations\n", imageName.c_str(), image.size(), patternSet.name.c_str(), 
+		   patternSet.patterns.size(), iterations);
+	ByteFrequencyTable frequencies;
+	frequencies.buildFromImage(image.data(), image.size());
+	vector<AOBPatternSearch::PreparedPattern> preparedPatterns;
+	for (auto& benchmarkPattern : patternSet.patterns)
+	{
+		preparedPatterns.push_back(AOBPatternSearch::preparePattern(benchmarkPattern.pattern, frequencies));
+	}
+
+	vector<string> kernelNames;
+	vector<BenchmarkResult> kernelResults;
+	kernelNames.push_back("Legacy");
+	kernelResults.push_back(runBenchmark("Legacy", image, patternSet, iterations,
+										 [&](const uint8_t* start, const uint8_t* end, size_t index) { return findPatternLegacy(start, end, patternSet.patterns[index].pattern); }));
+	BenchmarkResult& reference = kernelResults[0];
+	for (auto& benchmarkPattern : patternSet.patterns)
+	{
+		reference.numberOfMatches.push_back(countMatchesLegacy(image, benchmarkPattern.pattern));
+	}
+	bool resultsMatch = plantedOffsetsPerPattern.empty() || reportReferenceMismatches(image, patternSet, reference, plantedOffsetsPerPattern);
+	for (auto kernel : { AOBPatternSearch::SearchKernel::Scalar, AOBPatternSearch::SearchKernel::SSE2, AOBPatternSearch::SearchKernel::AVX2 })
+	{
+		if (!AOBPatternSearch::isKernelSupported(kernel))
+		{
+			printf("  %-10s not supported on this cpu\n", AOBPatternSearch::kernelName(kernel));
+			continue;
+		}
+		kernelNames.push_back(AOBPatternSearch::kernelName(kernel));
+		kernelResults.push_back(runBenchmark(AOBPatternSearch::kernelName(kernel), image, patternSet, iterations,
+											 [&](const uint8_t* start, const uint8_t* end, size_t index) { return AOBPatternSearch::findPattern(start, end, preparedPatterns[index], kernel); }));
+		resultsMatch &= reportMismatches(AOBPatternSearch::kernelName(kernel), patternSet, kernelResults.back(), kernelResults[0]);
+	}
+	resultsMatch &= reportMismatches("Engine", patternSet, runEngineBenchmark("Engine", image, patternSet, iterations, nullptr, AOBScanEngine::ScanMethod::Automatic), 
+									 kernelResults[0]);
+	char engineMTName[32];
+	snprintf(engineMTName, sizeof(engineMTName), "Engine %dT", workerPool.numberOfWorkers());
+	resultsMatch &= reportMismatches(engineMTName, patternSet, runEngineBenchmark(engineMTName, image, patternSet, iterations, &workerPool, AOBScanEngine::ScanMethod::Automatic), 
+									 kernelResults[0]);
+	// the other method of the engine, so both are compared with the reference whatever the number of patterns.
+	const AOBScanEngine::ScanMethod otherScanMethod = (patternSet.patterns.size() <= AOB_SEARCH_KERNEL_MAX_PATTERNS) ? AOBScanEngine::ScanMethod::Automaton 
+																													 : AOBScanEngine::ScanMethod::SearchKernels;
+	resultsMatch &= reportMismatches("Engine alt", patternSet, runEngineBenchmark("Engine alt", image, patternSet, iterations, nullptr, otherScanMethod), kernelResults[0]);
+	if (reportPerBlock)
+	{
+		reportPerBlockResults(image, patternSet, kernelNames, kernelResults);
+	}
+	return resultsMatch;
+}
+
+
+// Times the verification of the hook watchdog of the camera over sites like the camera's hooks, and checks a change of a site is reported for
+// that site. The camera verifies its sites once per watchdog interval, so this is the cost of a verification, not of a frame.
+static bool benchmarkHookWatchdog(int iterations)
+{
+	vector<uint8_t> code(NUMBER_OF_WATCHDOG_SITES * 0x100, 0xCC);
+	vector<CodePatch> sites;
+	for (size_t siteIndex = 0; siteIndex < NUMBER_OF_WATCHDOG_SITES; siteIndex++)
+	{
+		CodePatch site;
+		site.address = code.data() + siteIndex * 0x100 + 0x80;
+		site.patchedBytes = { 0xFF, 0x25, 0x00, 0x00, 0x00, 0x00 };
+		for (size_t i = site.patchedBytes.size(); i < WATCHDOG_SITE_LENGTH; i++)
+		{
+			site.patchedBytes.push_back(static_cast<uint8_t>(siteIndex * 8 + i));
+		}
+		memcpy(site.address, site.patchedBytes.data(), site.patchedBytes.size());
+		sites.push_back(site);
+	}
+	HookWatchdog watchdog;
+	watchdog.watch(sites);
+	double bestTimeInNs = 0.0;
+	bool resultsMatch = true;
+	for (int iteration = 0; iteration < iterations; iteration++)
+	{
+		int numberOfIntactVerifications = 0;
+		const auto startTime = chrono::steady_clock::now();
+		for (int i = 0; i < WATCHDOG_VERIFICATIONS_PER_RUN; i++)
+		{
+			numberOfIntactVerifications += watchdog.verify() ? 1 : 0;
+		}
+		const double timeInNs = chrono::duration<double, nano>(chrono::steady_clock::now() - startTime).count() / WATCHDOG_VERIFICATIONS_PER_RUN;
+		if (0 == iteration || timeInNs < bestTimeInNs)
+		{
+			bestTimeInNs = timeInNs;
+		}
+		resultsMatch &= numberOfIntactVerifications == WATCHDOG_VERIFICATIONS_PER_RUN;
+	}
+	// a change of the last byte of the address in a site has to be noticed.
+	sites[NUMBER_OF_WATCHDOG_SITES / 2].address[WATCHDOG_SITE_LENGTH - 1] ^= 0x01;
+	const vector<size_t> tamperedSites = watchdog.determineTamperedSites();
+	resultsMatch &= !watchdog.verify() && tamperedSites.size() == 1 && tamperedSites[0] == NUMBER_OF_WATCHDOG_SITES / 2;
+	printf("Hook watchdog, %zu sites of %d bytes (%zu lanes), best of %d iterations\n", watchdog.numberOfSites(), WATCHDOG_SITE_LENGTH, 
+		   watchdog.numberOfLanes(), iterations);
+	printf("  %-10s %10.1f ns  %10.2f ns per site\n", "Verify", bestTimeInNs, bestTimeInNs / watchdog.numberOfSites());
+	if (!resultsMatch)
+	{
+		printf("  Verify doesn't report the sites changed\n");
+	}
+	return resultsMatch;
+}
+
+
+static void displayUsage()
+{
+	printf("Usage: AOBScanBenchmark [--size <MB>] [--iterations <count>] [--seed <value>] [--workers <count>] [--pattern-set <name|all>]\n");
+	printf("                        [--distribution <code|uniform|padding>] [--corpus] [image dump files]\n");
+}
+
+
+int main(int argc, char* argv[])
+{
+	size_t syntheticImageSizeInMB = DEFAULT_SYNTHETIC_IMAGE_SIZE_MB;
+	int iterations = DEFAULT_NUMBER_OF_ITERATIONS;
+	uint32_t seed = 42;
+	int numberOfWorkers = WorkerPool::defaultNumberOfWorkers();
+	string patternSetName = "all";
+	ByteDistribution distribution = ByteDistribution::Code;
+	bool runCorpus = false;
+	vector<string> imageDumpFilenames;
+	for (int i = 1; i < argc; i++)
+	{
+		const string argument = argv[i];
+		if (argument == "--size" && i + 1 < argc)
+		{
+			syntheticImageSizeInMB = strtoul(argv[++i], nullptr, 10);
+		}
+		else if (argument == "--iterations" && i + 1 < argc)
+		{
+			iterations = atoi(argv[++i]);
+		}
+		else if (argument == "--seed" && i + 1 < argc)
+		{
+			seed = strtoul(argv[++i], nullptr, 10);
+		}
+		else if (argument == "--workers" && i + 1 < argc)
+		{
+			numberOfWorkers = atoi(argv[++i]);
+		}
+		else if (argument == "--pattern-set" && i + 1 < argc)
+		{
+			patternSetName = argv[++i];
+		}
+		else if (argument == "--distribution" && i + 1 < argc)
+		{
+			const string distributionAsString = argv[++i];
+			if (distributionAsString == distributionName(ByteDistribution::Code))
+			{
+				distribution = ByteDistribution::Code;
+			}
+			else if (distributionAsString == distributionName(ByteDistribution::Uniform))
+			{
+				distribution = ByteDistribution::Uniform;
+			}
+			else if (distributionAsString == distributionName(ByteDistribution::Padding))
+			{
+				distribution = ByteDistribution::Padding;
+			}
+			else
+			{
+				printf("Unknown byte distribution '%s'\n", distributionAsString.c_str());
+				return EXIT_CODE_USAGE_ERROR;
+			}
+		}
+		else if (argument == "--corpus")
+		{
+			runCorpus = true;
+		}
+		else if (argument.rfind("--", 0) == 0)
+		{
+			displayUsage();
+			return EXIT_CODE_USAGE_ERROR;
+		}
+		else
+		{
+			imageDumpFilenames.push_back(argument);
+		}
+	}
+	if (syntheticImageSizeInMB == 0 || iterations <= 0)
+	{
+		printf("Size and iterations have to be larger than 0\n");
+		return EXIT_CODE_USAGE_ERROR;
+	}
+
+	vector<PatternSet> patternSets;
+	for (auto& patternSet : createPatternSets())
+	{
+		if (patternSetName == "all" || patternSetName == patternSet.name)
+		{
+			patternSets.push_back(patternSet);
+		}
+	}
+	if (patternSets.empty())
+	{
+		printf("Unknown pattern set '%s'\n", patternSetName.c_str());
+		return EXIT_CODE_USAGE_ERROR;
+	}
+
+	WorkerPool workerPool(numberOfWorkers);
+	bool resultsMatch = true;
+	if (runCorpus)
+	{
+		// every pattern set against every distribution with a couple of seeds. Only the differences and a summary are reported per image.
+		int numberOfImages = 0;
+		int numberOfImagesWithDifferences = 0;
+		for (auto& patternSet : patternSets)
+		{
+			for (auto corpusDistribution : { ByteDistribution::Code, ByteDistribution::Uniform, ByteDistribution::Padding })
+			{
+				for (uint32_t seedIndex = 0; seedIndex < NUMBER_OF_CORPUS_SEEDS; seedIndex++)
+				{
+					vector<vector<size_t>> plantedOffsetsPerPattern;
+					const vector<uint8_t> image = createSyntheticImage(syntheticImageSizeInMB * 1024 * 1024, seed + seedIndex, corpusDistribution, patternSet, 
+																	   plantedOffsetsPerPattern);
+					char imageName[64];
+					snprintf(imageName, sizeof(imageName), "%s, seed %u", distributionName(corpusDistribution), seed + seedIndex);
+					const bool imageResultsMatch = benchmarkImage(imageName, image, patternSet, plantedOffsetsPerPattern, iterations, workerPool, false);
+					numberOfImages++;
+					numberOfImagesWithDifferences += imageResultsMatch ? 0 : 1;
+					resultsMatch &= imageResultsMatch;
+				}
+			}
+		}
+		printf("Corpus: %d image(s), %d image(s) with differences\n", numberOfImages, numberOfImagesWithDifferences);
+	}
+	else if (imageDumpFilenames.empty())
+	{
+		for (auto& patternSet : patternSets)
+		{
+			vector<vector<size_t>> plantedOffsetsPerPattern;
+			const vector<uint8_t> image = createSyntheticImage(syntheticImageSizeInMB * 1024 * 1024, seed, distribution, patternSet, plantedOffsetsPerPattern);
+			resultsMatch &= benchmarkImage(string("synthetic, ") + distributionName(distribution), image, patternSet, plantedOffsetsPerPattern, iterations, 
+										   workerPool, true);
+		}
+	}
+	for (auto& filename : imageDumpFilenames)
+	{
+		vector<uint8_t> image;
+		if (!readImageDump(filename, image))
+		{
+			printf("Can't read image dump '%s'\n", filename.c_str());
+			return EXIT_CODE_USAGE_ERROR;
+		}
+		for (auto& patternSet : patternSets)
+		{
+			resultsMatch &= benchmarkImage(filename, image, patternSet, vector<vector<size_t>>(), iterations, workerPool, true);
+		}
+	}
+	resultsMatch &= benchmarkHookWatchdog(iterations);
+	return resultsMatch ? EXIT_CODE_RESULTS_MATCH : EXIT_CODE_RESULTS_DIFFER;
+}
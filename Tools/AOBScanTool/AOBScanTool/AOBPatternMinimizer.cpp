@@ -0,0 +1,326 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "AOBPatternMinimizer.h"
+#include <cstdio>
+#include "ScanPattern.h"
+#include "X64InstructionDecoder.h"
+
+namespace IGCS
+{
+	// the number of bytes before the first possible start of a pattern from which the code is decoded too, so the decoding is in step
+	// with the real instructions at that start, instead of starting in the middle of the instruction which is there.
+	#define AOB_MINIMIZER_SYNCHRONIZATION_BYTES		64
+
+	AOBPatternMinimizer::AOBPatternMinimizer(const uint8_t* imageBase, size_t imageSize, const std::vector<AOBScanRange>& rangesToScan)
+						: _imageBase{ imageBase }, _imageSize{ imageSize }, _rangesToScan{ rangesToScan }
+	{
+	}
+
+
+	AOBPatternMinimizer::~AOBPatternMinimizer()
+	{
+	}
+
+
+	// Finds the shortest pattern for the hook location specified. See the other overload.
+	MinimizedPattern AOBPatternMinimizer::minimize(uint32_t hookRva, int maxBytesBeforeHook, int maxPatternSize, WorkerPool& workerPool)
+	{
+		return minimize(std::vector<uint32_t>{ hookRva }, maxBytesBeforeHook, maxPatternSize, workerPool)[0];
+	}
+
+
+	// Finds per hook location specified the shortest pattern which starts at most maxBytesBeforeHook bytes before the hook and is at most maxPatternSize
+	// bytes long. The candidates of all hooks are scanned for in one sweep, chunked on the worker pool specified. Returns a result per hook, in the 
+	// order of hookRvas.
+	std::vector<MinimizedPattern> AOBPatternMinimizer::minimize(const std::vector<uint32_t>& hookRvas, int maxBytesBeforeHook, int maxPatternSize, WorkerPool& workerPool)
+	{
+		maxPatternSize = (maxPatternSize > AOB_PATTERN_MAX_SIZE) ? AOB_PATTERN_MAX_SIZE : maxPatternSize;
+		std::vector<MinimizedPattern> toReturn(hookRvas.size());
+		std::vector<CandidateWindow> candidates;
+		for (size_t i = 0; i < hookRvas.size(); i++)
+		{
+			toReturn[i].hookRva = hookRvas[i];
+			createCandidateWindows(i, hookRvas[i], maxBytesBeforeHook, maxPatternSize, candidates);
+		}
+		if (candidates.empty())
+		{
+			return toReturn;
+		}
+		AOBScanEngine engine;
+		for (auto& candidate : candidates)
+		{
+			engine.addPattern(ScanPattern(candidate.patternAsString, 1));
+		}
+		engine.compile();
+		engine.scan(_rangesToScan, workerPool);
+
+		// per hook the best candidate so far. A unique candidate beats a non-unique one, then the one with the fewest matches, then the shortest, 
+		// then the one which starts at the hook (so no '|' is needed), then the one with the fewest wildcards.
+		std::vector<int> bestCandidatePerHook(hookRvas.size(), -1);
+		for (int candidateIndex = 0; candidateIndex < static_cast<int>(candidates.size()); candidateIndex++)
+		{
+			const CandidateWindow& candidate = candidates[candidateIndex];
+			MinimizedPattern& result = toReturn[candidate.hookIndex];
+			result.numberOfCandidatesEvaluated++;
+			const int numberOfMatches = engine.numberOfMatches(candidateIndex);
+			int occurrence = 0;
+			for (int matchIndex = 0; matchIndex < engine.numberOfRecordedMatches(candidateIndex); matchIndex++)
+			{
+				if (engine.matchLocation(candidateIndex, matchIndex) == _imageBase + candidate.startRva)
+				{
+					occurrence = matchIndex + 1;
+					break;
+				}
+			}
+			if (0 == occurrence)
+			{
+				// the hook location is past the recorded matches, so the occurrence can't be determined.
+				continue;
+			}
+			const int bestIndex = bestCandidatePerHook[candidate.hookIndex];
+			if (bestIndex >= 0)
+			{
+				const CandidateWindow& best = candidates[bestIndex];
+				const int bestNumberOfMatches = engine.numberOfMatches(bestIndex);
+				if (numberOfMatches != bestNumberOfMatches)
+				{
+					if (numberOfMatches > bestNumberOfMatches)
+					{
+						continue;
+					}
+				}
+				else if (candidate.size != best.size)
+				{
+					if (candidate.size > best.size)
+					{
+						continue;
+					}
+				}
+				else if ((candidate.customOffset == 0) != (best.customOffset == 0))
+				{
+					if (candidate.customOffset != 0)
+					{
+						continue;
+					}
+				}
+				else if (candidate.numberOfWildcards >= best.numberOfWildcards)
+				{
+					continue;
+				}
+			}
+			bestCandidatePerHook[candidate.hookIndex] = candidateIndex;
+			result.found = true;
+			result.patternAsString = candidate.patternAsString;
+			result.patternSize = candidate.size;
+			result.customOffset = candidate.customOffset;
+			result.occurrence = occurrence;
+			result.numberOfMatches = numberOfMatches;
+		}
+		return toReturn;
+	}
+
+
+	const AOBScanRange* AOBPatternMinimizer::findContainingRange(uint32_t rva) const
+	{
+		const uint8_t* location = _imageBase + rva;
+		for (auto& range : _rangesToScan)
+		{
+			if (location >= range.start && location < range.start + range.size)
+			{
+				return &range;
+			}
+		}
+		return nullptr;
+	}
+
+
+	// Decodes the code around the hook. startsBeforeHook receives the instruction starts before the hook and the hook itself, startsFromHook
+	// the ends of the instructions from the hook onwards. The instructions before the hook can't be decoded backwards, so they're decoded from
+	// the first location from which the decoding ends up exactly at the hook, starting AOB_MINIMIZER_SYNCHRONIZATION_BYTES before the first
+	// location at most maxBytesBeforeHook bytes before the hook. Starting at that location itself would decode the bytes of the instruction
+	// which starts before it as an instruction, e.g. the last bytes of a displacement, which then aren't wildcarded. wildcardMask receives
+	// per byte from maskStartRva whether the byte has to be wildcarded. Returns false if the instruction at the hook can't be decoded.
+	bool AOBPatternMinimizer::determineInstructionStarts(const AOBScanRange& range, uint32_t hookRva, int maxBytesBeforeHook, int maxPatternSize,
+														 std::vector<uint32_t>& startsBeforeHook, std::vector<uint32_t>& startsFromHook,
+														 std::vector<uint8_t>& wildcardMask, uint32_t& maskStartRva) const
+	{
+		const uint32_t rangeStartRva = static_cast<uint32_t>(range.start - _imageBase);
+		const uint32_t rangeEndRva = static_cast<uint32_t>(rangeStartRva + range.size);
+		const uint32_t leftLimitRva = (hookRva - rangeStartRva > static_cast<uint32_t>(maxBytesBeforeHook)) ? hookRva - maxBytesBeforeHook : rangeStartRva;
+		const uint32_t rightLimitRva = (rangeEndRva - hookRva > static_cast<uint32_t>(maxPatternSize)) ? hookRva + maxPatternSize : rangeEndRva;
+		const uint32_t decodeStartRva = (leftLimitRva - rangeStartRva > AOB_MINIMIZER_SYNCHRONIZATION_BYTES) ? leftLimitRva - AOB_MINIMIZER_SYNCHRONIZATION_BYTES
+																											 : rangeStartRva;
+
+		std::vector<X64Instruction> instructions;
+		std::vector<uint32_t> instructionRvas;
+		for (uint32_t candidateStartRva = decodeStartRva; candidateStartRva <= hookRva; candidateStartRva++)
+		{
+			instructions.clear();
+			instructionRvas.clear();
+			uint32_t currentRva = candidateStartRva;
+			while (currentRva < hookRva)
+			{
+				X64Instruction decoded;
+				if (!X64InstructionDecoder::decode(_imageBase + currentRva, hookRva - currentRva, decoded))
+				{
+					break;
+				}
+				if (currentRva >= leftLimitRva)
+				{
+					instructions.push_back(decoded);
+					instructionRvas.push_back(currentRva);
+				}
+				currentRva += decoded.length;
+			}
+			if (currentRva == hookRva)
+			{
+				break;
+			}
+		}
+		maskStartRva = instructionRvas.empty() ? hookRva : instructionRvas.front();
+		startsBeforeHook = instructionRvas;
+		startsBeforeHook.push_back(hookRva);
+
+		startsFromHook.clear();
+		uint32_t currentRva = hookRva;
+		while (currentRva < rightLimitRva)
+		{
+			X64Instruction decoded;
+			if (!X64InstructionDecoder::decode(_imageBase + currentRva, rangeEndRva - currentRva, decoded) || currentRva + decoded.length > rightLimitRva)
+			{
+				break;
+			}
+			instructions.push_back(decoded);
+			instructionRvas.push_back(currentRva);
+			currentRva += decoded.length;
+			startsFromHook.push_back(currentRva);
+		}
+		if (startsFromHook.empty())
+		{
+			return false;
+		}
+
+		wildcardMask.assign(currentRva - maskStartRva, 0);
+		for (size_t i = 0; i < instructions.size(); i++)
+		{
+			const X64Instruction& instruction = instructions[i];
+			const uint32_t offsetInMask = instructionRvas[i] - maskStartRva;
+			if (instruction.isRipRelative)
+			{
+				for (int j = 0; j < instruction.displacementSize; j++)
+				{
+					wildcardMask[offsetInMask + instruction.displacementOffset + j] = 1;
+				}
+			}
+			if (instruction.isRelativeBranch && instruction.immediateSize == 4)
+			{
+				for (int j = 0; j < instruction.immediateSize; j++)
+				{
+					wildcardMask[offsetInMask + instruction.immediateOffset + j] = 1;
+				}
+			}
+		}
+		return true;
+	}
+
+
+	// Adds all windows of whole instructions around the hook to candidates: every start before the hook combined with every end after it, as
+	// long as the window isn't larger than maxPatternSize.
+	void AOBPatternMinimizer::createCandidateWindows(size_t hookIndex, uint32_t hookRva, int maxBytesBeforeHook, int maxPatternSize,
+													 std::vector<CandidateWindow>& candidates) const
+	{
+		if (hookRva >= _imageSize)
+		{
+			return;
+		}
+		const AOBScanRange* range = findContainingRange(hookRva);
+		if (nullptr == range)
+		{
+			return;
+		}
+		std::vector<uint32_t> startsBeforeHook;
+		std::vector<uint32_t> startsFromHook;
+		std::vector<uint8_t> wildcardMask;
+		uint32_t maskStartRva = 0;
+		if (!determineInstructionStarts(*range, hookRva, maxBytesBeforeHook, maxPatternSize, startsBeforeHook, startsFromHook, wildcardMask, maskStartRva))
+		{
+			return;
+		}
+		for (uint32_t startRva : startsBeforeHook)
+		{
+			for (uint32_t endRva : startsFromHook)
+			{
+				const int size = static_cast<int>(endRva - startRva);
+				if (size > maxPatternSize)
+				{
+					break;
+				}
+				CandidateWindow candidate;
+				candidate.hookIndex = hookIndex;
+				candidate.startRva = startRva;
+				candidate.size = size;
+				candidate.customOffset = static_cast<int>(hookRva - startRva);
+				candidate.patternAsString = createPatternString(startRva, size, candidate.customOffset, wildcardMask, maskStartRva, candidate.numberOfWildcards);
+				if (candidate.numberOfWildcards < size)
+				{
+					candidates.push_back(candidate);
+				}
+			}
+		}
+	}
+
+
+	// Creates the pattern string of the window specified, in the format used in AOBPatterns.h.
+	std::string AOBPatternMinimizer::createPatternString(uint32_t startRva, int size, int customOffset, const std::vector<uint8_t>& wildcardMask,
+														 uint32_t maskStartRva, int& numberOfWildcards) const
+	{
+		std::string toReturn;
+		numberOfWildcards = 0;
+		for (int i = 0; i < size; i++)
+		{
+			if (i > 0)
+			{
+				toReturn += ' ';
+			}
+			if (i == customOffset && customOffset > 0)
+			{
+				toReturn += "| ";
+			}
+			if (wildcardMask[startRva + i - maskStartRva] != 0)
+			{
+				toReturn += "??";
+				numberOfWildcards++;
+				continue;
+			}
+			char byteAsString[3];
+			snprintf(byteAsString, sizeof(byteAsString), "%02X", _imageBase[startRva + i]);
+			toReturn += byteAsString;
+		}
+		return toReturn;
+	}
+}
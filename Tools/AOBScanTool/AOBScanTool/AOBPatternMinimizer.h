@@ -0,0 +1,91 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "AOBScanEngine.h"
+#include "WorkerPool.h"
+
+namespace IGCS
+{
+	// The pattern found for a hook location.
+	struct MinimizedPattern
+	{
+		uint32_t hookRva = 0;
+		bool found = false;					// false if no pattern could be created, e.g. the hook isn't in a scanned range or the code can't be decoded
+		std::string patternAsString;		// in the format of the AOBPatterns.h, e.g. "48 8B ?? ?? ?? ?? | FF 90"
+		int patternSize = 0;
+		int customOffset = 0;				// offset of the hook in the pattern, the position of the '|'
+		int occurrence = 0;					// the occurrence of the hook location among the matches of the pattern. 1 if the pattern is unique.
+		int numberOfMatches = 0;			// the number of matches of the pattern in the scanned ranges
+		int numberOfCandidatesEvaluated = 0;
+
+		bool isUnique() const { return found && numberOfMatches == 1; }
+	};
+
+	// Finds the shortest AOB pattern which matches only the hook location specified, in an image mapped at its rva (e.g. a MappedExecutable).
+	// The code around the hook is decoded with the X64InstructionDecoder, and candidate windows of whole instructions are grown left and right
+	// of the hook. Rip relative displacements and rel32 branch offsets are wildcarded, as these change with every build of the game. All candidate
+	// windows of all hooks are scanned for in a single sweep of the AOBScanEngine, after which per hook the shortest candidate which matches once
+	// is picked. If no candidate is unique, the shortest candidate with the fewest matches is picked, with the occurrence of the hook location.
+	class AOBPatternMinimizer
+	{
+	public:
+		AOBPatternMinimizer(const uint8_t* imageBase, size_t imageSize, const std::vector<AOBScanRange>& rangesToScan);
+		~AOBPatternMinimizer();
+
+		MinimizedPattern minimize(uint32_t hookRva, int maxBytesBeforeHook, int maxPatternSize, WorkerPool& workerPool);
+		std::vector<MinimizedPattern> minimize(const std::vector<uint32_t>& hookRvas, int maxBytesBeforeHook, int maxPatternSize, WorkerPool& workerPool);
+
+	private:
+		// A window of bytes around a hook, with the bytes to wildcard.
+		struct CandidateWindow
+		{
+			size_t hookIndex;
+			uint32_t startRva;
+			int size;
+			int customOffset;
+			int numberOfWildcards;
+			std::string patternAsString;
+		};
+
+		const AOBScanRange* findContainingRange(uint32_t rva) const;
+		bool determineInstructionStarts(const AOBScanRange& range, uint32_t hookRva, int maxBytesBeforeHook, int maxPatternSize,
+										std::vector<uint32_t>& startsBeforeHook, std::vector<uint32_t>& startsFromHook, std::vector<uint8_t>& wildcardMask,
+										uint32_t& maskStartRva) const;
+		void createCandidateWindows(size_t hookIndex, uint32_t hookRva, int maxBytesBeforeHook, int maxPatternSize, std::vector<CandidateWindow>& candidates) const;
+		std::string createPatternString(uint32_t startRva, int size, int customOffset, const std::vector<uint8_t>& wildcardMask, uint32_t maskStartRva,
+										int& numberOfWildcards) const;
+
+		const uint8_t* _imageBase;
+		size_t _imageSize;
+		std::vector<AOBScanRange> _rangesToScan;
+	};
+}
@@ -0,0 +1,613 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "HookSiteMigrator.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <unordered_set>
+#include "ScanPattern.h"
+#include "X64InstructionDecoder.h"
+
+namespace IGCS
+{
+	// The number of normalized instructions in a seed.
+	#define MIGRATION_SEED_LENGTH				4
+	// The context of a site: the instructions in the bytes before the anchor and the number of instructions from the anchor onwards.
+	#define MIGRATION_BYTES_BEFORE_ANCHOR		48
+	#define MIGRATION_INSTRUCTIONS_FROM_ANCHOR	16
+	// The number of bytes decoded before a chunk to get in sync with the instruction stream.
+	#define MIGRATION_CHUNK_WARMUP_SIZE			64
+	#define MIGRATION_MINIMUM_CHUNK_SIZE		(1024 * 1024)
+	#define MIGRATION_CHUNKS_PER_WORKER			4
+	// Seeds with more hits than this in the new build are too common to be of use, e.g. the prologue of small functions. Per site the seeds
+	// with the fewest hits are always used though, so every site gets candidates.
+	#define MIGRATION_MAX_HITS_PER_SEED			1024
+	#define MIGRATION_SEED_FILTER_SIZE			(64 * 1024)
+	// The size of the jmp written by GameImageHooker::setHook on x64.
+	#define MIGRATION_HOOK_SIZE					14
+	// Sites without a pattern get a pattern of whole instructions of at least this many bytes.
+	#define MIGRATION_DEFAULT_PATTERN_SIZE		16
+
+	static uint64_t hashBytes(const uint8_t* bytes, int length)
+	{
+		uint64_t hash = 0xCBF29CE484222325ULL;
+		for (int i = 0; i < length; i++)
+		{
+			hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+		}
+		return hash;
+	}
+
+
+	// Returns per byte of the decoded instruction whether it's a displacement or branch offset which changes between builds.
+	static void determineMaskedBytes(const X64Instruction& decoded, bool isMasked[X64_MAX_INSTRUCTION_LENGTH])
+	{
+		memset(isMasked, 0, X64_MAX_INSTRUCTION_LENGTH);
+		// rip relative displacements and absolute addresses (mov with moffs, which has a displacement but no ModRM).
+		if (decoded.isRipRelative || (decoded.displacementSize == 8))
+		{
+			memset(isMasked + decoded.displacementOffset, 1, decoded.displacementSize);
+		}
+		if (decoded.isRelativeBranch)
+		{
+			memset(isMasked + decoded.immediateOffset, 1, decoded.immediateSize);
+		}
+	}
+
+
+	HookSiteMigrator::HookSiteMigrator(const uint8_t* oldImageBase, size_t oldImageSize, const uint8_t* newImageBase, size_t newImageSize,
+									   const std::vector<AOBScanRange>& newRangesToScan)
+					: _oldImageBase{ oldImageBase }, _oldImageSize{ oldImageSize }, _newImageBase{ newImageBase }, _newImageSize{ newImageSize },
+					  _newRangesToScan{ newRangesToScan }
+	{
+	}
+
+
+	HookSiteMigrator::~HookSiteMigrator()
+	{
+	}
+
+
+	// Finds the sites specified in the new build. Returns a result per site, in the order of sites.
+	std::vector<MigrationResult> HookSiteMigrator::migrate(const std::vector<MigrationSite>& sites, WorkerPool& workerPool)
+	{
+		std::vector<MigrationResult> toReturn(sites.size());
+		_siteContexts.assign(sites.size(), SiteContext());
+		_seeds.clear();
+		for (int siteIndex = 0; siteIndex < static_cast<int>(sites.size()); siteIndex++)
+		{
+			SiteContext& context = _siteContexts[siteIndex];
+			if (!createSiteContext(sites[siteIndex], context))
+			{
+				continue;
+			}
+			toReturn[siteIndex].maxScore = static_cast<int>(context.instructions.size());
+			for (int startIndex = 0; startIndex + MIGRATION_SEED_LENGTH <= static_cast<int>(context.instructions.size()); startIndex++)
+			{
+				uint64_t seedHash = 0;
+				for (int i = startIndex; i < startIndex + MIGRATION_SEED_LENGTH; i++)
+				{
+					seedHash = (seedHash * 0x100000001B3ULL) ^ context.instructions[i].normalizedHash;
+				}
+				_seeds.push_back({ seedHash, { siteIndex, startIndex } });
+			}
+		}
+		std::sort(_seeds.begin(), _seeds.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+		_seedFilter.assign(MIGRATION_SEED_FILTER_SIZE, false);
+		for (auto& hashSeedPair : _seeds)
+		{
+			_seedFilter[hashSeedPair.first % MIGRATION_SEED_FILTER_SIZE] = true;
+		}
+
+		// split the ranges of the new build in chunks which are scanned for seed hits in parallel. Every chunk has its own hits.
+		size_t totalSize = 0;
+		for (auto& range : _newRangesToScan)
+		{
+			totalSize += range.size;
+		}
+		size_t chunkSize = totalSize / (static_cast<size_t>(workerPool.numberOfWorkers()) * MIGRATION_CHUNKS_PER_WORKER);
+		chunkSize = chunkSize < MIGRATION_MINIMUM_CHUNK_SIZE ? MIGRATION_MINIMUM_CHUNK_SIZE : chunkSize;
+		std::vector<std::pair<const AOBScanRange*, size_t>> chunks;		// range and offset of the chunk in the range
+		for (auto& range : _newRangesToScan)
+		{
+			for (size_t offset = 0; offset < range.size; offset += chunkSize)
+			{
+				chunks.push_back({ &range, offset });
+			}
+		}
+		std::vector<std::vector<SeedHit>> hitsPerChunk(chunks.size());
+		if (!_seeds.empty())
+		{
+			for (size_t i = 0; i < chunks.size(); i++)
+			{
+				workerPool.enqueue([this, &chunks, &hitsPerChunk, i, chunkSize]
+					{
+						const AOBScanRange& range = *chunks[i].first;
+						const uint8_t* ownedStart = range.start + chunks[i].second;
+						const uint8_t* ownedEnd = (range.size - chunks[i].second > chunkSize) ? ownedStart + chunkSize : range.start + range.size;
+						scanRangeForSeeds(range, ownedStart, ownedEnd, hitsPerChunk[i]);
+					});
+			}
+			workerPool.waitUntilIdle();
+		}
+
+		// drop the hits of seeds which are too common, then extend the remaining hits in parallel. The hits are split over the jobs in chunk
+		// order, every job has its own candidates.
+		std::vector<uint32_t> numberOfHitsPerSeed(_seeds.size(), 0);
+		for (auto& chunkHits : hitsPerChunk)
+		{
+			for (auto& hit : chunkHits)
+			{
+				numberOfHitsPerSeed[hit.seedIndex]++;
+			}
+		}
+		std::vector<uint32_t> fewestHitsPerSite(sites.size(), UINT32_MAX);
+		for (size_t seedIndex = 0; seedIndex < _seeds.size(); seedIndex++)
+		{
+			uint32_t& fewestHits = fewestHitsPerSite[_seeds[seedIndex].second.siteIndex];
+			fewestHits = std::min(fewestHits, numberOfHitsPerSeed[seedIndex]);
+		}
+		std::vector<SeedHit> hitsToExtend;
+		for (auto& chunkHits : hitsPerChunk)
+		{
+			for (auto& hit : chunkHits)
+			{
+				const uint32_t numberOfHits = numberOfHitsPerSeed[hit.seedIndex];
+				if (numberOfHits <= MIGRATION_MAX_HITS_PER_SEED || numberOfHits == fewestHitsPerSite[_seeds[hit.seedIndex].second.siteIndex])
+				{
+					hitsToExtend.push_back(hit);
+				}
+			}
+			chunkHits.clear();
+			chunkHits.shrink_to_fit();
+		}
+		const size_t numberOfJobs = std::max<size_t>(1, std::min<size_t>(chunks.size(), hitsToExtend.size()));
+		std::vector<std::vector<Candidate>> candidatesPerJob(numberOfJobs);
+		for (size_t jobIndex = 0; jobIndex < numberOfJobs; jobIndex++)
+		{
+			workerPool.enqueue([this, &hitsToExtend, &candidatesPerJob, jobIndex, numberOfJobs]
+				{
+					const size_t startIndex = (hitsToExtend.size() * jobIndex) / numberOfJobs;
+					const size_t endIndex = (hitsToExtend.size() * (jobIndex + 1)) / numberOfJobs;
+					std::unordered_set<uint64_t> alignmentsExtended;
+					for (size_t i = startIndex; i < endIndex; i++)
+					{
+						// seeds of the same site which imply the same alignment give the same result, so extend only the first.
+						const Seed& seed = _seeds[hitsToExtend[i].seedIndex].second;
+						const SiteContext& context = _siteContexts[seed.siteIndex];
+						const uint32_t impliedAnchorRva = hitsToExtend[i].newSeedRva + 
+														  (context.instructions[context.anchorIndex].rva - context.instructions[seed.startIndex].rva);
+						if (alignmentsExtended.insert((static_cast<uint64_t>(seed.siteIndex) << 32) | impliedAnchorRva).second)
+						{
+							extendSeedHit(seed, hitsToExtend[i].newSeedRva, candidatesPerJob[jobIndex]);
+						}
+					}
+				});
+		}
+		workerPool.waitUntilIdle();
+
+		// per site the location with the highest score wins. Locations are keyed on the rva so the result doesn't depend on the chunking.
+		std::vector<std::map<uint32_t, std::pair<int, int>>> scoresPerSite(sites.size());
+		for (auto& jobCandidates : candidatesPerJob)
+		{
+			for (auto& candidate : jobCandidates)
+			{
+				auto& scores = scoresPerSite[candidate.siteIndex][candidate.newAnchorRva];
+				scores = std::max(scores, std::make_pair(candidate.score, candidate.exactScore));
+			}
+		}
+		for (size_t siteIndex = 0; siteIndex < sites.size(); siteIndex++)
+		{
+			MigrationResult& result = toReturn[siteIndex];
+			std::pair<int, int> bestScores = { 0, 0 };
+			for (auto& anchorScoresPair : scoresPerSite[siteIndex])
+			{
+				if (anchorScoresPair.second > bestScores)
+				{
+					bestScores = anchorScoresPair.second;
+					result.newAnchorRva = anchorScoresPair.first;
+					result.isAmbiguous = false;
+				}
+				else if (anchorScoresPair.second == bestScores)
+				{
+					result.isAmbiguous = true;
+				}
+			}
+			if (bestScores.first == 0)
+			{
+				continue;
+			}
+			result.found = true;
+			result.score = bestScores.first;
+			createPattern(sites[siteIndex], result);
+			determineContinueOffset(sites[siteIndex], result);
+		}
+
+		// check how often the new patterns match in the new build, all in one sweep.
+		AOBScanEngine engine;
+		std::vector<int> patternIdPerSite(sites.size(), -1);
+		for (size_t siteIndex = 0; siteIndex < sites.size(); siteIndex++)
+		{
+			if (!toReturn[siteIndex].patternAsString.empty())
+			{
+				patternIdPerSite[siteIndex] = engine.addPattern(ScanPattern(toReturn[siteIndex].patternAsString, 1));
+			}
+		}
+		if (engine.numberOfPatterns() == 0)
+		{
+			return toReturn;
+		}
+		engine.compile();
+		engine.scan(_newRangesToScan, workerPool);
+		for (size_t siteIndex = 0; siteIndex < sites.size(); siteIndex++)
+		{
+			const int patternId = patternIdPerSite[siteIndex];
+			if (patternId < 0)
+			{
+				continue;
+			}
+			MigrationResult& result = toReturn[siteIndex];
+			result.numberOfMatches = engine.numberOfMatches(patternId);
+			for (int matchIndex = 0; matchIndex < engine.numberOfRecordedMatches(patternId); matchIndex++)
+			{
+				if (engine.matchLocation(patternId, matchIndex) == _newImageBase + result.newAnchorRva)
+				{
+					result.occurrence = matchIndex + 1;
+					break;
+				}
+			}
+		}
+		return toReturn;
+	}
+
+
+	// Decodes the instruction at rva and hashes its bytes, once with the displacements and branch offsets masked and once as-is.
+	bool HookSiteMigrator::decodeNormalized(const uint8_t* imageBase, uint32_t rva, size_t availableBytes, NormalizedInstruction& decoded)
+	{
+		X64Instruction instruction;
+		if (!X64InstructionDecoder::decode(imageBase + rva, availableBytes, instruction))
+		{
+			return false;
+		}
+		bool isMasked[X64_MAX_INSTRUCTION_LENGTH];
+		determineMaskedBytes(instruction, isMasked);
+		uint8_t normalizedBytes[X64_MAX_INSTRUCTION_LENGTH];
+		for (int i = 0; i < instruction.length; i++)
+		{
+			normalizedBytes[i] = isMasked[i] ? 0 : imageBase[rva + i];
+		}
+		decoded.rva = rva;
+		decoded.length = instruction.length;
+		decoded.normalizedHash = hashBytes(normalizedBytes, instruction.length);
+		decoded.exactHash = hashBytes(imageBase + rva, instruction.length);
+		decoded.isPadding = (instruction.opcodeMap == 0 && (instruction.opcode == 0xCC || instruction.opcode == 0x90)) ||
+							(instruction.opcodeMap == 1 && instruction.opcode == 0x1F);
+		return true;
+	}
+
+
+	// Decodes the instructions before rva, padding excluded. Code can't be decoded backwards, so they're decoded from the first location at or after
+	// lowestRva from which the decoding ends up exactly at rva. 
+	void HookSiteMigrator::decodeInstructionsBefore(const uint8_t* imageBase, uint32_t rva, uint32_t lowestRva, std::vector<NormalizedInstruction>& instructions) const
+	{
+		instructions.clear();
+		if (lowestRva >= rva)
+		{
+			return;
+		}
+		// determine from right to left per start location whether decoding from there ends up at rva, so every location is decoded only once.
+		const uint32_t numberOfLocations = rva - lowestRva;
+		std::vector<uint8_t> endsUpAtRva(numberOfLocations, 0);
+		std::vector<uint8_t> lengthAtLocation(numberOfLocations, 0);
+		for (uint32_t i = numberOfLocations; i > 0; i--)
+		{
+			const uint32_t location = i - 1;
+			X64Instruction decoded;
+			if (!X64InstructionDecoder::decode(imageBase + lowestRva + location, numberOfLocations - location, decoded))
+			{
+				continue;
+			}
+			const uint32_t next = location + decoded.length;
+			lengthAtLocation[location] = static_cast<uint8_t>(decoded.length);
+			endsUpAtRva[location] = (next == numberOfLocations) || endsUpAtRva[next];
+		}
+		uint32_t location = 0;
+		while (location < numberOfLocations && !endsUpAtRva[location])
+		{
+			location++;
+		}
+		while (location < numberOfLocations)
+		{
+			NormalizedInstruction normalized;
+			decodeNormalized(imageBase, lowestRva + location, numberOfLocations - location, normalized);
+			if (!normalized.isPadding)
+			{
+				instructions.push_back(normalized);
+			}
+			location += lengthAtLocation[location];
+		}
+	}
+
+
+	// Decodes at most maxNumberOfInstructions instructions from rva onwards, until an instruction can't be decoded. If skipPadding is true, padding 
+	// instructions are skipped and not counted.
+	void HookSiteMigrator::decodeInstructionsFrom(const uint8_t* imageBase, size_t imageSize, uint32_t rva, int maxNumberOfInstructions, bool skipPadding,
+												  std::vector<NormalizedInstruction>& instructions) const
+	{
+		instructions.clear();
+		uint32_t currentRva = rva;
+		NormalizedInstruction decoded;
+		while (static_cast<int>(instructions.size()) < maxNumberOfInstructions && currentRva < imageSize &&
+			   decodeNormalized(imageBase, currentRva, imageSize - currentRva, decoded))
+		{
+			if (!skipPadding || !decoded.isPadding)
+			{
+				instructions.push_back(decoded);
+			}
+			currentRva += decoded.length;
+		}
+	}
+
+
+	bool HookSiteMigrator::createSiteContext(const MigrationSite& site, SiteContext& context) const
+	{
+		if (site.oldAnchorRva >= _oldImageSize)
+		{
+			return false;
+		}
+		const uint32_t lowestRva = (site.oldAnchorRva > MIGRATION_BYTES_BEFORE_ANCHOR) ? site.oldAnchorRva - MIGRATION_BYTES_BEFORE_ANCHOR : 0;
+		decodeInstructionsBefore(_oldImageBase, site.oldAnchorRva, lowestRva, context.instructions);
+		context.anchorIndex = static_cast<int>(context.instructions.size());
+		std::vector<NormalizedInstruction> instructionsFromAnchor;
+		decodeInstructionsFrom(_oldImageBase, _oldImageSize, site.oldAnchorRva, MIGRATION_INSTRUCTIONS_FROM_ANCHOR, true, instructionsFromAnchor);
+		if (instructionsFromAnchor.empty())
+		{
+			context.instructions.clear();
+			context.anchorIndex = -1;
+			return false;
+		}
+		context.instructions.insert(context.instructions.end(), instructionsFromAnchor.begin(), instructionsFromAnchor.end());
+		return true;
+	}
+
+
+	// Decodes the instructions in the range from ownedStart and looks up every run of MIGRATION_SEED_LENGTH instructions in the seeds. The chunk
+	// owns the runs which start in [ownedStart, ownedEnd), decoding starts a bit before ownedStart to get in sync with the instruction stream.
+	void HookSiteMigrator::scanRangeForSeeds(const AOBScanRange& range, const uint8_t* ownedStart, const uint8_t* ownedEnd, std::vector<SeedHit>& hits) const
+	{
+		const uint32_t rangeStartRva = static_cast<uint32_t>(range.start - _newImageBase);
+		const uint32_t rangeEndRva = static_cast<uint32_t>(rangeStartRva + range.size);
+		const uint32_t ownedStartRva = static_cast<uint32_t>(ownedStart - _newImageBase);
+		const uint32_t ownedEndRva = static_cast<uint32_t>(ownedEnd - _newImageBase);
+		uint32_t currentRva = (ownedStartRva - rangeStartRva > MIGRATION_CHUNK_WARMUP_SIZE) ? ownedStartRva - MIGRATION_CHUNK_WARMUP_SIZE : rangeStartRva;
+		// the last MIGRATION_SEED_LENGTH instructions decoded, as a ring buffer
+		NormalizedInstruction window[MIGRATION_SEED_LENGTH];
+		int numberOfInstructionsInWindow = 0;
+		while (currentRva < rangeEndRva)
+		{
+			NormalizedInstruction& decoded = window[numberOfInstructionsInWindow % MIGRATION_SEED_LENGTH];
+			if (!decodeNormalized(_newImageBase, currentRva, rangeEndRva - currentRva, decoded))
+			{
+				// data or padding which isn't code. Skip a byte and start over.
+				currentRva++;
+				numberOfInstructionsInWindow = 0;
+				continue;
+			}
+			currentRva += decoded.length;
+			if (decoded.isPadding)
+			{
+				// padding differs between builds, it's left out of the seeds and the alignments.
+				continue;
+			}
+			numberOfInstructionsInWindow++;
+			if (numberOfInstructionsInWindow < MIGRATION_SEED_LENGTH)
+			{
+				continue;
+			}
+			const int oldestIndex = numberOfInstructionsInWindow % MIGRATION_SEED_LENGTH;
+			const uint32_t seedRva = window[oldestIndex].rva;
+			if (seedRva >= ownedEndRva)
+			{
+				break;
+			}
+			if (seedRva < ownedStartRva)
+			{
+				continue;
+			}
+			uint64_t seedHash = 0;
+			for (int i = 0; i < MIGRATION_SEED_LENGTH; i++)
+			{
+				seedHash = (seedHash * 0x100000001B3ULL) ^ window[(oldestIndex + i) % MIGRATION_SEED_LENGTH].normalizedHash;
+			}
+			if (!_seedFilter[seedHash % MIGRATION_SEED_FILTER_SIZE])
+			{
+				continue;
+			}
+			auto seedsWithHash = std::equal_range(_seeds.begin(), _seeds.end(), std::make_pair(seedHash, Seed()), 
+												  [](const auto& a, const auto& b) { return a.first < b.first; });
+			for (auto it = seedsWithHash.first; it != seedsWithHash.second; ++it)
+			{
+				hits.push_back({ static_cast<uint32_t>(it - _seeds.begin()), seedRva });
+			}
+		}
+	}
+
+
+	// Aligns the instructions of the seed's site with the instructions around newSeedRva, without gaps, and adds the location of the anchor 
+	// in the new build with the number of matching instructions as a candidate.
+	void HookSiteMigrator::extendSeedHit(const Seed& seed, uint32_t newSeedRva, std::vector<Candidate>& candidates) const
+	{
+		const SiteContext& context = _siteContexts[seed.siteIndex];
+		const int numberOfInstructions = static_cast<int>(context.instructions.size());
+		std::vector<NormalizedInstruction> instructionsBefore;
+		if (seed.startIndex > 0)
+		{
+			const uint32_t bytesBefore = context.instructions[seed.startIndex].rva - context.instructions[0].rva + MIGRATION_BYTES_BEFORE_ANCHOR;
+			decodeInstructionsBefore(_newImageBase, newSeedRva, newSeedRva > bytesBefore ? newSeedRva - bytesBefore : 0, instructionsBefore);
+		}
+		std::vector<NormalizedInstruction> instructionsFrom;
+		decodeInstructionsFrom(_newImageBase, _newImageSize, newSeedRva, numberOfInstructions - seed.startIndex, true, instructionsFrom);
+
+		Candidate candidate = { seed.siteIndex, 0, 0, 0 };
+		bool anchorAligned = false;
+		for (int i = 0; i < numberOfInstructions; i++)
+		{
+			const NormalizedInstruction* newInstruction = nullptr;
+			if (i >= seed.startIndex)
+			{
+				const size_t indexFrom = static_cast<size_t>(i - seed.startIndex);
+				newInstruction = (indexFrom < instructionsFrom.size()) ? &instructionsFrom[indexFrom] : nullptr;
+			}
+			else
+			{
+				const size_t distance = static_cast<size_t>(seed.startIndex - i);
+				newInstruction = (distance <= instructionsBefore.size()) ? &instructionsBefore[instructionsBefore.size() - distance] : nullptr;
+			}
+			if (nullptr == newInstruction)
+			{
+				continue;
+			}
+			if (i == context.anchorIndex)
+			{
+				candidate.newAnchorRva = newInstruction->rva;
+				anchorAligned = true;
+			}
+			candidate.score += (newInstruction->normalizedHash == context.instructions[i].normalizedHash) ? 1 : 0;
+			candidate.exactScore += (newInstruction->exactHash == context.instructions[i].exactHash) ? 1 : 0;
+		}
+		if (anchorAligned)
+		{
+			candidates.push_back(candidate);
+		}
+	}
+
+
+	// Creates the pattern of the site in the new build from the instructions from the new anchor which correspond with the instructions the
+	// old pattern covered, with the displacements and branch offsets wildcarded. The hook is at the same offset in the same instruction as in 
+	// the old build.
+	void HookSiteMigrator::createPattern(const MigrationSite& site, MigrationResult& result) const
+	{
+		const int patternSize = site.patternSize > 0 ? site.patternSize : MIGRATION_DEFAULT_PATTERN_SIZE;
+		std::vector<NormalizedInstruction> oldInstructions;
+		decodeInstructionsFrom(_oldImageBase, _oldImageSize, site.oldAnchorRva, MIGRATION_INSTRUCTIONS_FROM_ANCHOR, false, oldInstructions);
+		std::vector<NormalizedInstruction> newInstructions;
+		decodeInstructionsFrom(_newImageBase, _newImageSize, result.newAnchorRva, MIGRATION_INSTRUCTIONS_FROM_ANCHOR, false, newInstructions);
+		int oldOffset = 0;
+		int newOffset = 0;
+		int newCustomOffset = -1;
+		std::string pattern;
+		for (size_t i = 0; i < newInstructions.size() && i < oldInstructions.size() && oldOffset < patternSize; i++)
+		{
+			const NormalizedInstruction& oldInstruction = oldInstructions[i];
+			const NormalizedInstruction& newInstruction = newInstructions[i];
+			if (site.customOffset >= oldOffset && site.customOffset < oldOffset + oldInstruction.length)
+			{
+				const int offsetInInstruction = site.customOffset - oldOffset;
+				newCustomOffset = newOffset + (offsetInInstruction < newInstruction.length ? offsetInInstruction : 0);
+			}
+			X64Instruction decoded;
+			X64InstructionDecoder::decode(_newImageBase + newInstruction.rva, _newImageSize - newInstruction.rva, decoded);
+			bool isMasked[X64_MAX_INSTRUCTION_LENGTH];
+			determineMaskedBytes(decoded, isMasked);
+			for (int j = 0; j < newInstruction.length; j++)
+			{
+				if (newOffset + j > AOB_PATTERN_MAX_SIZE - 1)
+				{
+					break;
+				}
+				if (!pattern.empty())
+				{
+					pattern += ' ';
+				}
+				if (newOffset + j == newCustomOffset && newCustomOffset > 0)
+				{
+					pattern += "| ";
+				}
+				char byteAsString[3];
+				snprintf(byteAsString, sizeof(byteAsString), "%02X", _newImageBase[newInstruction.rva + j]);
+				pattern += isMasked[j] ? "??" : byteAsString;
+			}
+			oldOffset += oldInstruction.length;
+			newOffset += newInstruction.length;
+		}
+		if (newCustomOffset < 0)
+		{
+			// the hook is past the instructions decoded, keep its distance to the anchor.
+			newCustomOffset = site.customOffset;
+		}
+		result.patternAsString = pattern;
+		result.newHookRva = result.newAnchorRva + newCustomOffset;
+	}
+
+
+	// Maps the old continue offset of the hook to the new build by the number of instructions it spans. If there's no old continue offset, the
+	// smallest span of whole instructions the jmp of a hook fits in is used.
+	void HookSiteMigrator::determineContinueOffset(const MigrationSite& site, MigrationResult& result) const
+	{
+		if (result.newHookRva >= _newImageSize)
+		{
+			return;
+		}
+		if (site.oldContinueOffset <= 0)
+		{
+			const int span = X64InstructionDecoder::determineInstructionSpan(_newImageBase + result.newHookRva, _newImageSize - result.newHookRva, MIGRATION_HOOK_SIZE);
+			result.newContinueOffset = span > 0 ? span : 0;
+			return;
+		}
+		const uint32_t oldHookRva = site.oldAnchorRva + site.customOffset;
+		int numberOfInstructions = 0;
+		uint32_t oldRva = oldHookRva;
+		while (oldRva < oldHookRva + site.oldContinueOffset)
+		{
+			X64Instruction decoded;
+			if (!X64InstructionDecoder::decode(_oldImageBase + oldRva, _oldImageSize - oldRva, decoded))
+			{
+				return;
+			}
+			oldRva += decoded.length;
+			numberOfInstructions++;
+		}
+		if (oldRva != oldHookRva + site.oldContinueOffset)
+		{
+			// the old continue offset isn't at an instruction boundary, so it can't be mapped.
+			return;
+		}
+		uint32_t newRva = result.newHookRva;
+		for (int i = 0; i < numberOfInstructions; i++)
+		{
+			X64Instruction decoded;
+			if (!X64InstructionDecoder::decode(_newImageBase + newRva, _newImageSize - newRva, decoded))
+			{
+				return;
+			}
+			newRva += decoded.length;
+		}
+		result.newContinueOffset = static_cast<int>(newRva - result.newHookRva);
+	}
+}
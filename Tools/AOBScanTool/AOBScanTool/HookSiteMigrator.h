@@ -0,0 +1,140 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "AOBScanEngine.h"
+#include "WorkerPool.h"
+
+namespace IGCS
+{
+	// A hook site in the old build of the game.
+	struct MigrationSite
+	{
+		std::string name;
+		uint32_t oldAnchorRva = 0;			// rva of the first instruction of the site, e.g. the start of the match of the block's pattern
+		int customOffset = 0;				// offset of the hook from the anchor, e.g. the position of the '|' in the block's pattern
+		int patternSize = 0;				// size of the block's pattern. 0 if the site doesn't have a pattern
+		int oldContinueOffset = 0;			// the continue offset of the hook in the old build. 0 if not known
+	};
+
+	// Where a hook site ended up in the new build of the game.
+	struct MigrationResult
+	{
+		bool found = false;
+		uint32_t newAnchorRva = 0;
+		uint32_t newHookRva = 0;
+		int score = 0;						// the number of instructions around the site which are the same in both builds, displacements ignored
+		int maxScore = 0;					// the number of instructions around the site in the old build
+		bool isAmbiguous = false;			// true if another location in the new build has the same score
+		std::string patternAsString;		// pattern of the site in the new build, in the format used in AOBPatterns.h
+		int occurrence = 0;
+		int numberOfMatches = 0;
+		int newContinueOffset = 0;			// the old continue offset mapped to the new build, or the smallest span of whole instructions a hook fits in
+	};
+
+	// Finds the hook sites of an old build of a game in a new build. The instructions around every old site are decoded and normalized: 
+	// rip relative displacements and branch offsets are masked, as these change with every build, and padding (int3, nop) between functions
+	// is left out. Every run of MIGRATION_SEED_LENGTH normalized instructions around a site is a seed. The code of the new build is decoded in
+	// parallel chunks on a worker pool and looked up in the seeds. Hits of seeds which are too common are dropped, the others are extended in
+	// parallel into an ungapped alignment of the site's instructions. Per site the location with the most matching instructions wins. Then a 
+	// pattern for the new location is created from the instructions the old pattern covered, and its uniqueness is checked with the AOBScanEngine.
+	class HookSiteMigrator
+	{
+	public:
+		HookSiteMigrator(const uint8_t* oldImageBase, size_t oldImageSize, const uint8_t* newImageBase, size_t newImageSize,
+						 const std::vector<AOBScanRange>& newRangesToScan);
+		~HookSiteMigrator();
+
+		std::vector<MigrationResult> migrate(const std::vector<MigrationSite>& sites, WorkerPool& workerPool);
+
+	private:
+		// A decoded instruction with a hash of its bytes with the displacements masked and a hash of all its bytes.
+		struct NormalizedInstruction
+		{
+			uint32_t rva;
+			int length;
+			uint64_t normalizedHash;
+			uint64_t exactHash;
+			bool isPadding;					// int3 or nop, which are everywhere between functions so they're useless in a seed
+		};
+
+		// The normalized instructions around an old site, padding excluded.
+		struct SiteContext
+		{
+			std::vector<NormalizedInstruction> instructions;
+			int anchorIndex = -1;				// index of the instruction at the anchor
+		};
+
+		// A location in the new build a site aligns with.
+		struct Candidate
+		{
+			int siteIndex;
+			uint32_t newAnchorRva;
+			int score;
+			int exactScore;
+		};
+
+		// A seed: a run of instructions of a site, starting at instruction index 'startIndex' of the site's context.
+		struct Seed
+		{
+			int siteIndex;
+			int startIndex;
+		};
+
+		// A location in the new build where a seed was found.
+		struct SeedHit
+		{
+			uint32_t seedIndex;				// index in _seeds
+			uint32_t newSeedRva;
+		};
+
+		static bool decodeNormalized(const uint8_t* imageBase, uint32_t rva, size_t availableBytes, NormalizedInstruction& decoded);
+		void decodeInstructionsBefore(const uint8_t* imageBase, uint32_t rva, uint32_t lowestRva, std::vector<NormalizedInstruction>& instructions) const;
+		void decodeInstructionsFrom(const uint8_t* imageBase, size_t imageSize, uint32_t rva, int maxNumberOfInstructions, bool skipPadding,
+									std::vector<NormalizedInstruction>& instructions) const;
+		bool createSiteContext(const MigrationSite& site, SiteContext& context) const;
+		void scanRangeForSeeds(const AOBScanRange& range, const uint8_t* ownedStart, const uint8_t* ownedEnd, std::vector<SeedHit>& hits) const;
+		void extendSeedHit(const Seed& seed, uint32_t newSeedRva, std::vector<Candidate>& candidates) const;
+		void createPattern(const MigrationSite& site, MigrationResult& result) const;
+		void determineContinueOffset(const MigrationSite& site, MigrationResult& result) const;
+
+		const uint8_t* _oldImageBase;
+		size_t _oldImageSize;
+		const uint8_t* _newImageBase;
+		size_t _newImageSize;
+		std::vector<AOBScanRange> _newRangesToScan;
+		std::vector<SiteContext> _siteContexts;
+		// the seeds of all sites, sorted on hash, for a binary search per instruction of the new build.
+		std::vector<std::pair<uint64_t, Seed>> _seeds;
+		// per hash modulo its size whether there's a seed with that hash, to skip the binary search for most instructions.
+		std::vector<bool> _seedFilter;
+	};
+}
@@ -0,0 +1,773 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Offline AOB scanner for the pattern sets of the camera dlls. Runs on Windows and Linux, see the ReadMe.md for how to build it.
+//
+// Usage: AOBScanTool scan [--camera <name>] [--workers <count>] [--all-sections] <executables>
+//        AOBScanTool minimize [--camera <name>] [--workers <count>] [--all-sections] [--max-before <bytes>] [--max-size <bytes>] <executable> [rvas]
+//        AOBScanTool migrate [--camera <name>] [--workers <count>] [--all-sections] <old executable> <new executable> [rva[:continue offset]]
+//        AOBScanTool xrefs [--workers <count>] [--all-sections] [--kind <kind>] [--max-references <count>] [--patterns] <executable> <rva[-rva]>
+//
+// scan: maps every executable specified with its sections at their rva and scans it for the AOB blocks of the camera specified, with the same
+// scan engine as the camera dll. Per block the resolved rva, the number of matches and whether the block is ambiguous are reported, so
+// it can be checked whether the patterns of a camera still work with a new build of the game without starting the game.
+// minimize: creates the shortest pattern which matches only once per hook rva specified. Without rvas, the patterns of the camera's blocks
+// found in the executable are minimized.
+// migrate: finds the hook sites at the rvas specified in the old build of a game in the new build and creates patterns for the new build. Without
+// rvas, the sites of the camera's blocks found in the old build are migrated.
+// xrefs: decodes all code of the executable and reports the instructions which reference the rvas or rva ranges specified, e.g. to find the
+// code which reads a global. Optionally creates a unique pattern for every referencing instruction.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "ScanPattern.h"
+#include "AOBScanEngine.h"
+#include "WorkerPool.h"
+#include "MemorySource.h"
+#include "AOBPatterns.h"
+#include "MappedExecutable.h"
+#include "AOBPatternMinimizer.h"
+#include "HookSiteMigrator.h"
+#include "XrefIndex.h"
+
+using namespace std;
+using namespace IGCS;
+using namespace IGCS::GameSpecific;
+
+#define EXIT_CODE_ALL_BLOCKS_FOUND		0
+#define EXIT_CODE_NOT_ALL_BLOCKS_FOUND		1
+#define EXIT_CODE_USAGE_ERROR			2
+
+#define DEFAULT_MAX_BYTES_BEFORE_HOOK	32
+#define DEFAULT_MAX_REFERENCES_REPORTED	64
+
+// The pattern set of a camera. Only cameras which define their patterns in an AOBPatterns.h can be scanned for.
+struct CameraPatternSet
+{
+	const char* cameraName;
+	const AOBPatternDefinition* definitions;
+	size_t numberOfDefinitions;
+};
+
+static const CameraPatternSet cameraPatternSets[] =
+{
+	{ "Cyberpunk2077", aobPatternDefinitions, size(aobPatternDefinitions) },
+};
+
+// The result of a block in an executable. A block has one or more alternative patterns, the first alternative found resolves the block, 
+// like AOBBlock::processScanResults does.
+struct BlockScanResult
+{
+	string blockName;
+	int alternativeIndex = -1;			// index of the alternative which resolved the block, -1 if the block wasn't found
+	int occurrence = 0;
+	int numberOfMatches = 0;
+	uint32_t rva = 0;					// rva of the location of the block, so the start of the match plus the custom offset of the pattern
+	int customOffset = 0;
+	int patternSize = 0;
+
+	bool found() const { return alternativeIndex >= 0; }
+	bool isAmbiguous() const { return numberOfMatches > occurrence; }
+};
+
+struct ExecutableScanResult
+{
+	string filename;
+	string errorMessage;				// empty if the executable was loaded
+	size_t imageSize = 0;
+	uint32_t timeDateStamp = 0;
+	int numberOfRangesScanned = 0;
+	double loadTimeInMs = 0.0;
+	double scanTimeInMs = 0.0;
+	vector<BlockScanResult> blockResults;
+};
+
+
+static void displayUsage()
+{
+	printf("Usage: AOBScanTool scan [--camera <name>] [--workers <count>] [--all-sections] <executables>\n");
+	printf("       AOBScanTool minimize [--camera <name>] [--workers <count>] [--all-sections] [--max-before <bytes>] [--max-size <bytes>] <executable> [rvas]\n");
+	printf("       AOBScanTool migrate [--camera <name>] [--workers <count>] [--all-sections] <old executable> <new executable> [rva[:continue offset]]\n");
+	printf("       AOBScanTool xrefs [--workers <count>] [--all-sections] [--kind <kind>] [--max-references <count>] [--patterns] <executable> <rva[-rva]>\n");
+	printf("Cameras:");
+	for (auto& patternSet : cameraPatternSets)
+	{
+		printf(" %s", patternSet.cameraName);
+	}
+	printf("\n");
+}
+
+
+static const CameraPatternSet* findCameraPatternSet(const string& cameraName)
+{
+	for (auto& candidate : cameraPatternSets)
+	{
+		if (cameraName == candidate.cameraName)
+		{
+			return &candidate;
+		}
+	}
+	printf("Unknown camera '%s'\n", cameraName.c_str());
+	return nullptr;
+}
+
+
+// Same as Utils::determineScanRanges in the camera dll: the executable sections of the image, or the whole image if includeNonCodeSections is true
+// or the image has no executable sections. The image is loaded from a file, so it's fully readable.
+static vector<AOBScanRange> determineScanRanges(const MappedExecutable& executable, bool includeNonCodeSections)
+{
+	return ImageMemorySource().determineScanRanges(executable.imageBase(), executable.imageSize(), includeNonCodeSections);
+}
+
+
+// Scans the executable specified for all patterns of the pattern set specified in a single sweep. If workerPool isn't null the sweep is 
+// chunked on the pool, otherwise it runs on the calling thread.
+static void scanImage(const MappedExecutable& executable, const CameraPatternSet& patternSet, bool includeNonCodeSections, WorkerPool* workerPool,
+					  ExecutableScanResult& toReturn)
+{
+	toReturn.imageSize = executable.imageSize();
+	toReturn.timeDateStamp = executable.imageInfo().timeDateStamp();
+
+	const auto scanStartTime = chrono::steady_clock::now();
+	AOBScanEngine engine;
+	for (size_t i = 0; i < patternSet.numberOfDefinitions; i++)
+	{
+		engine.addPattern(patternSet.definitions[i].pattern);
+	}
+	engine.compile();
+	const vector<AOBScanRange> ranges = determineScanRanges(executable, includeNonCodeSections);
+	toReturn.numberOfRangesScanned = static_cast<int>(ranges.size());
+	if (nullptr == workerPool)
+	{
+		engine.scan(ranges);
+	}
+	else
+	{
+		engine.scan(ranges, *workerPool);
+	}
+	toReturn.scanTimeInMs = chrono::duration<double, milli>(chrono::steady_clock::now() - scanStartTime).count();
+
+	// definitions with the same block name are alternatives of that block, in the order they're specified.
+	for (size_t patternId = 0; patternId < patternSet.numberOfDefinitions; patternId++)
+	{
+		const AOBPatternDefinition& definition = patternSet.definitions[patternId];
+		if (nullptr != definition.moduleName)
+		{
+			// block lives in another module than the executable, e.g. a dll shipped with the game.
+			continue;
+		}
+		BlockScanResult* blockResult = nullptr;
+		for (auto& existingResult : toReturn.blockResults)
+		{
+			if (existingResult.blockName == definition.blockName)
+			{
+				blockResult = &existingResult;
+				break;
+			}
+		}
+		int alternativeIndex = 0;
+		if (nullptr == blockResult)
+		{
+			toReturn.blockResults.push_back(BlockScanResult());
+			blockResult = &toReturn.blockResults.back();
+			blockResult->blockName = definition.blockName;
+		}
+		else
+		{
+			if (blockResult->found())
+			{
+				continue;
+			}
+			alternativeIndex = blockResult->alternativeIndex < 0 ? 1 : blockResult->alternativeIndex + 1;
+		}
+		const int id = static_cast<int>(patternId);
+		blockResult->occurrence = definition.pattern.occurrence();
+		blockResult->numberOfMatches = engine.numberOfMatches(id);
+		const uint8_t* location = engine.locationOfPattern(id);
+		if (nullptr != location)
+		{
+			blockResult->alternativeIndex = alternativeIndex;
+			blockResult->customOffset = definition.pattern.customOffset();
+			blockResult->patternSize = definition.pattern.patternSize();
+			blockResult->rva = static_cast<uint32_t>((location - executable.imageBase()) + definition.pattern.customOffset());
+		}
+	}
+}
+
+
+// Loads the executable specified and scans it, see scanImage.
+static ExecutableScanResult scanExecutable(const string& filename, const CameraPatternSet& patternSet, bool includeNonCodeSections, WorkerPool* workerPool)
+{
+	ExecutableScanResult toReturn;
+	toReturn.filename = filename;
+	const auto loadStartTime = chrono::steady_clock::now();
+	MappedExecutable executable;
+	if (!executable.load(filename, toReturn.errorMessage))
+	{
+		return toReturn;
+	}
+	toReturn.loadTimeInMs = chrono::duration<double, milli>(chrono::steady_clock::now() - loadStartTime).count();
+	scanImage(executable, patternSet, includeNonCodeSections, workerPool, toReturn);
+	return toReturn;
+}
+
+
+// Prints the results of the executable specified. Returns the number of blocks which weren't found.
+static int reportExecutableScanResult(const ExecutableScanResult& result)
+{
+	if (!result.errorMessage.empty())
+	{
+		printf("%s: %s\n", result.filename.c_str(), result.errorMessage.c_str());
+		return 0;
+	}
+	printf("%s: %zu bytes, timestamp 0x%08X, %d ranges, loaded in %.2f ms, scanned in %.2f ms\n", result.filename.c_str(), result.imageSize,
+		   result.timeDateStamp, result.numberOfRangesScanned, result.loadTimeInMs, result.scanTimeInMs);
+	int numberOfBlocksNotFound = 0;
+	for (auto& blockResult : result.blockResults)
+	{
+		if (!blockResult.found())
+		{
+			printf("  %-40s NOT FOUND  %d match(es), occurrence %d\n", blockResult.blockName.c_str(), blockResult.numberOfMatches, blockResult.occurrence);
+			numberOfBlocksNotFound++;
+			continue;
+		}
+		printf("  %-40s rva 0x%08X (+0x%X)  %d match(es), occurrence %d", blockResult.blockName.c_str(), blockResult.rva, blockResult.customOffset,
+			   blockResult.numberOfMatches, blockResult.occurrence);
+		if (blockResult.alternativeIndex > 0)
+		{
+			printf(", alternative %d", blockResult.alternativeIndex);
+		}
+		printf(blockResult.isAmbiguous() ? "  AMBIGUOUS\n" : "\n");
+	}
+	return numberOfBlocksNotFound;
+}
+
+
+static int scanCommand(int argc, char* argv[])
+{
+	const CameraPatternSet* patternSet = &cameraPatternSets[0];
+	int numberOfWorkers = WorkerPool::defaultNumberOfWorkers();
+	bool includeNonCodeSections = false;
+	vector<string> filenames;
+	for (int i = 0; i < argc; i++)
+	{
+		const string argument = argv[i];
+		if (argument == "--camera" && i + 1 < argc)
+		{
+			patternSet = findCameraPatternSet(argv[++i]);
+			if (nullptr == patternSet)
+			{
+				displayUsage();
+				return EXIT_CODE_USAGE_ERROR;
+			}
+		}
+		else if (argument == "--workers" && i + 1 < argc)
+		{
+			numberOfWorkers = atoi(argv[++i]);
+		}
+		else if (argument == "--all-sections")
+		{
+			includeNonCodeSections = true;
+		}
+		else if (argument.rfind("--", 0) == 0)
+		{
+			displayUsage();
+			return EXIT_CODE_USAGE_ERROR;
+		}
+		else
+		{
+			filenames.push_back(argument);
+		}
+	}
+	if (filenames.empty() || numberOfWorkers <= 0)
+	{
+		displayUsage();
+		return EXIT_CODE_USAGE_ERROR;
+	}
+
+	const auto startTime = chrono::steady_clock::now();
+	WorkerPool workerPool(numberOfWorkers);
+	vector<ExecutableScanResult> results(filenames.size());
+	if (filenames.size() == 1)
+	{
+		// a single executable is scanned in chunks on all workers.
+		results[0] = scanExecutable(filenames[0], *patternSet, includeNonCodeSections, &workerPool);
+	}
+	else
+	{
+		// multiple executables are scanned in parallel, one per worker. Each job writes only its own result.
+		for (size_t i = 0; i < filenames.size(); i++)
+		{
+			workerPool.enqueue([&, i] { results[i] = scanExecutable(filenames[i], *patternSet, includeNonCodeSections, nullptr); });
+		}
+		workerPool.waitUntilIdle();
+	}
+	const double totalTimeInMs = chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+
+	int numberOfBlocksNotFound = 0;
+	int numberOfExecutablesNotLoaded = 0;
+	for (auto& result : results)
+	{
+		numberOfBlocksNotFound += reportExecutableScanResult(result);
+		numberOfExecutablesNotLoaded += result.errorMessage.empty() ? 0 : 1;
+	}
+	printf("Scanned %zu executable(s) for the %s patterns in %.2f ms, %d block(s) not found, %d executable(s) couldn't be loaded\n", filenames.size(),
+		   patternSet->cameraName, totalTimeInMs, numberOfBlocksNotFound, numberOfExecutablesNotLoaded);
+	return (numberOfBlocksNotFound == 0 && numberOfExecutablesNotLoaded == 0) ? EXIT_CODE_ALL_BLOCKS_FOUND : EXIT_CODE_NOT_ALL_BLOCKS_FOUND;
+}
+
+
+static int minimizeCommand(int argc, char* argv[])
+{
+	const CameraPatternSet* patternSet = &cameraPatternSets[0];
+	int numberOfWorkers = WorkerPool::defaultNumberOfWorkers();
+	bool includeNonCodeSections = false;
+	int maxBytesBeforeHook = DEFAULT_MAX_BYTES_BEFORE_HOOK;
+	int maxPatternSize = AOB_PATTERN_MAX_SIZE;
+	string filename;
+	vector<uint32_t> hookRvas;
+	for (int i = 0; i < argc; i++)
+	{
+		const string argument = argv[i];
+		if (argument == "--camera" && i + 1 < argc)
+		{
+			patternSet = findCameraPatternSet(argv[++i]);
+			if (nullptr == patternSet)
+			{
+				displayUsage();
+				return EXIT_CODE_USAGE_ERROR;
+			}
+		}
+		else if (argument == "--workers" && i + 1 < argc)
+		{
+			numberOfWorkers = atoi(argv[++i]);
+		}
+		else if (argument == "--all-sections")
+		{
+			includeNonCodeSections = true;
+		}
+		else if (argument == "--max-before" && i + 1 < argc)
+		{
+			maxBytesBeforeHook = atoi(argv[++i]);
+		}
+		else if (argument == "--max-size" && i + 1 < argc)
+		{
+			maxPatternSize = atoi(argv[++i]);
+		}
+		else if (argument.rfind("--", 0) == 0)
+		{
+			displayUsage();
+			return EXIT_CODE_USAGE_ERROR;
+		}
+		else if (filename.empty())
+		{
+			filename = argument;
+		}
+		else
+		{
+			// rvas are hexadecimal, with or without 0x.
+			hookRvas.push_back(static_cast<uint32_t>(strtoul(argv[i], nullptr, 16)));
+		}
+	}
+	if (filename.empty() || numberOfWorkers <= 0 || maxBytesBeforeHook < 0 || maxPatternSize <= 0)
+	{
+		displayUsage();
+		return EXIT_CODE_USAGE_ERROR;
+	}
+
+	MappedExecutable executable;
+	string errorMessage;
+	if (!executable.load(filename, errorMessage))
+	{
+		printf("%s: %s\n", filename.c_str(), errorMessage.c_str());
+		return EXIT_CODE_NOT_ALL_BLOCKS_FOUND;
+	}
+	WorkerPool workerPool(numberOfWorkers);
+	vector<string> hookNames;
+	if (hookRvas.empty())
+	{
+		// minimize the patterns of the blocks of the camera found in the executable.
+		ExecutableScanResult scanResult;
+		scanImage(executable, *patternSet, includeNonCodeSections, &workerPool, scanResult);
+		for (auto& blockResult : scanResult.blockResults)
+		{
+			if (!blockResult.found())
+			{
+				printf("Block %s not found, skipped\n", blockResult.blockName.c_str());
+				continue;
+			}
+			hookRvas.push_back(blockResult.rva);
+			hookNames.push_back(blockResult.blockName);
+		}
+	}
+	else
+	{
+		for (uint32_t hookRva : hookRvas)
+		{
+			char hookName[16];
+			snprintf(hookName, sizeof(hookName), "0x%08X", hookRva);
+			hookNames.push_back(hookName);
+		}
+	}
+
+	const auto startTime = chrono::steady_clock::now();
+	AOBPatternMinimizer minimizer(executable.imageBase(), executable.imageSize(), determineScanRanges(executable, includeNonCodeSections));
+	const vector<MinimizedPattern> results = minimizer.minimize(hookRvas, maxBytesBeforeHook, maxPatternSize, workerPool);
+	const double timeInMs = chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+
+	int numberOfCandidatesEvaluated = 0;
+	int numberOfHooksNotUnique = 0;
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const MinimizedPattern& result = results[i];
+		numberOfCandidatesEvaluated += result.numberOfCandidatesEvaluated;
+		if (!result.found)
+		{
+			printf("  %-40s rva 0x%08X  no pattern, the code at the rva can't be decoded or isn't in a scanned section\n", hookNames[i].c_str(), result.hookRva);
+			numberOfHooksNotUnique++;
+			continue;
+		}
+		printf("  %-40s rva 0x%08X  \"%s\", %d  (%d bytes, %d match(es)%s)\n", hookNames[i].c_str(), result.hookRva, result.patternAsString.c_str(),
+			   result.occurrence, result.patternSize, result.numberOfMatches, result.isUnique() ? "" : ", NOT UNIQUE");
+		numberOfHooksNotUnique += result.isUnique() ? 0 : 1;
+	}
+	printf("Minimized %zu pattern(s), %d candidate(s) evaluated in %.2f ms, %d pattern(s) not unique\n", results.size(), numberOfCandidatesEvaluated,
+		   timeInMs, numberOfHooksNotUnique);
+	return numberOfHooksNotUnique == 0 ? EXIT_CODE_ALL_BLOCKS_FOUND : EXIT_CODE_NOT_ALL_BLOCKS_FOUND;
+}
+
+
+static int migrateCommand(int argc, char* argv[])
+{
+	const CameraPatternSet* patternSet = &cameraPatternSets[0];
+	int numberOfWorkers = WorkerPool::defaultNumberOfWorkers();
+	bool includeNonCodeSections = false;
+	vector<string> filenames;
+	vector<MigrationSite> sites;
+	for (int i = 0; i < argc; i++)
+	{
+		const string argument = argv[i];
+		if (argument == "--camera" && i + 1 < argc)
+		{
+			patternSet = findCameraPatternSet(argv[++i]);
+			if (nullptr == patternSet)
+			{
+				displayUsage();
+				return EXIT_CODE_USAGE_ERROR;
+			}
+		}
+		else if (argument == "--workers" && i + 1 < argc)
+		{
+			numberOfWorkers = atoi(argv[++i]);
+		}
+		else if (argument == "--all-sections")
+		{
+			includeNonCodeSections = true;
+		}
+		else if (argument.rfind("--", 0) == 0)
+		{
+			displayUsage();
+			return EXIT_CODE_USAGE_ERROR;
+		}
+		else if (filenames.size() < 2)
+		{
+			filenames.push_back(argument);
+		}
+		else
+		{
+			// rva[:continue offset], both hexadecimal, with or without 0x.
+			MigrationSite site;
+			char* end = nullptr;
+			site.oldAnchorRva = static_cast<uint32_t>(strtoul(argv[i], &end, 16));
+			if (nullptr != end && *end == ':')
+			{
+				site.oldContinueOffset = static_cast<int>(strtoul(end + 1, nullptr, 16));
+			}
+			char siteName[16];
+			snprintf(siteName, sizeof(siteName), "0x%08X", site.oldAnchorRva);
+			site.name = siteName;
+			sites.push_back(site);
+		}
+	}
+	if (filenames.size() < 2 || numberOfWorkers <= 0)
+	{
+		displayUsage();
+		return EXIT_CODE_USAGE_ERROR;
+	}
+
+	MappedExecutable oldExecutable;
+	MappedExecutable newExecutable;
+	string errorMessage;
+	if (!oldExecutable.load(filenames[0], errorMessage) || !newExecutable.load(filenames[1], errorMessage))
+	{
+		printf("%s\n", errorMessage.c_str());
+		return EXIT_CODE_NOT_ALL_BLOCKS_FOUND;
+	}
+	WorkerPool workerPool(numberOfWorkers);
+	if (sites.empty())
+	{
+		// migrate the sites of the blocks of the camera found in the old build.
+		ExecutableScanResult scanResult;
+		scanImage(oldExecutable, *patternSet, includeNonCodeSections, &workerPool, scanResult);
+		for (auto& blockResult : scanResult.blockResults)
+		{
+			if (!blockResult.found())
+			{
+				printf("Block %s not found in the old build, skipped\n", blockResult.blockName.c_str());
+				continue;
+			}
+			MigrationSite site;
+			site.name = blockResult.blockName;
+			site.oldAnchorRva = blockResult.rva - blockResult.customOffset;
+			site.customOffset = blockResult.customOffset;
+			site.patternSize = blockResult.patternSize;
+			sites.push_back(site);
+		}
+	}
+
+	const auto startTime = chrono::steady_clock::now();
+	HookSiteMigrator migrator(oldExecutable.imageBase(), oldExecutable.imageSize(), newExecutable.imageBase(), newExecutable.imageSize(),
+							  determineScanRanges(newExecutable, includeNonCodeSections));
+	const vector<MigrationResult> results = migrator.migrate(sites, workerPool);
+
+	// the pattern mapped from the old build might not be unique anymore in the new build. For these sites a unique pattern is searched as well.
+	vector<uint32_t> hookRvasToMinimize;
+	for (auto& result : results)
+	{
+		if (result.found && !result.isAmbiguous && result.numberOfMatches != 1)
+		{
+			hookRvasToMinimize.push_back(result.newHookRva);
+		}
+	}
+	vector<MinimizedPattern> minimizedPatterns;
+	if (!hookRvasToMinimize.empty())
+	{
+		AOBPatternMinimizer minimizer(newExecutable.imageBase(), newExecutable.imageSize(), determineScanRanges(newExecutable, includeNonCodeSections));
+		minimizedPatterns = minimizer.minimize(hookRvasToMinimize, DEFAULT_MAX_BYTES_BEFORE_HOOK, AOB_PATTERN_MAX_SIZE, workerPool);
+	}
+	const double timeInMs = chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+
+	int numberOfSitesNotMigrated = 0;
+	size_t minimizedPatternIndex = 0;
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const MigrationResult& result = results[i];
+		const MigrationSite& site = sites[i];
+		if (!result.found)
+		{
+			printf("  %-40s rva 0x%08X  NOT FOUND\n", site.name.c_str(), site.oldAnchorRva + site.customOffset);
+			numberOfSitesNotMigrated++;
+			continue;
+		}
+		char continueOffsetAsString[16] = "?";
+		if (result.newContinueOffset > 0)
+		{
+			snprintf(continueOffsetAsString, sizeof(continueOffsetAsString), "0x%X", result.newContinueOffset);
+		}
+		printf("  %-40s rva 0x%08X -> 0x%08X  score %d/%d%s  \"%s\", %d  (%d match(es))  continue offset %s\n", site.name.c_str(),
+			   site.oldAnchorRva + site.customOffset, result.newHookRva, result.score, result.maxScore, result.isAmbiguous ? " AMBIGUOUS" : "",
+			   result.patternAsString.c_str(), result.occurrence, result.numberOfMatches, continueOffsetAsString);
+		numberOfSitesNotMigrated += (result.isAmbiguous || result.occurrence == 0) ? 1 : 0;
+		if (result.isAmbiguous || result.numberOfMatches == 1)
+		{
+			continue;
+		}
+		const MinimizedPattern& minimizedPattern = minimizedPatterns[minimizedPatternIndex++];
+		if (minimizedPattern.found && minimizedPattern.isUnique())
+		{
+			printf("  %-40s unique alternative \"%s\", 1  (custom offset %d)\n", "", minimizedPattern.patternAsString.c_str(), 
+				   minimizedPattern.customOffset);
+		}
+	}
+	printf("Migrated %zu site(s) in %.2f ms, %d site(s) not found or ambiguous\n", results.size(), timeInMs, numberOfSitesNotMigrated);
+	return numberOfSitesNotMigrated == 0 ? EXIT_CODE_ALL_BLOCKS_FOUND : EXIT_CODE_NOT_ALL_BLOCKS_FOUND;
+}
+
+
+static int xrefsCommand(int argc, char* argv[])
+{
+	int numberOfWorkers = WorkerPool::defaultNumberOfWorkers();
+	bool includeNonCodeSections = false;
+	bool createPatterns = false;
+	int maxReferencesReported = DEFAULT_MAX_REFERENCES_REPORTED;
+	string kindToReport;
+	string filename;
+	vector<pair<uint32_t, uint32_t>> targetRanges;			// first and last rva
+	for (int i = 0; i < argc; i++)
+	{
+		const string argument = argv[i];
+		if (argument == "--workers" && i + 1 < argc)
+		{
+			numberOfWorkers = atoi(argv[++i]);
+		}
+		else if (argument == "--all-sections")
+		{
+			includeNonCodeSections = true;
+		}
+		else if (argument == "--kind" && i + 1 < argc)
+		{
+			kindToReport = argv[++i];
+		}
+		else if (argument == "--max-references" && i + 1 < argc)
+		{
+			maxReferencesReported = atoi(argv[++i]);
+		}
+		else if (argument == "--patterns")
+		{
+			createPatterns = true;
+		}
+		else if (argument.rfind("--", 0) == 0)
+		{
+			displayUsage();
+			return EXIT_CODE_USAGE_ERROR;
+		}
+		else if (filename.empty())
+		{
+			filename = argument;
+		}
+		else
+		{
+			// rva or rva-rva, hexadecimal, with or without 0x. The range includes the last rva.
+			char* end = nullptr;
+			const uint32_t firstRva = static_cast<uint32_t>(strtoul(argv[i], &end, 16));
+			const uint32_t lastRva = (nullptr != end && *end == '-') ? static_cast<uint32_t>(strtoul(end + 1, nullptr, 16)) : firstRva;
+			targetRanges.push_back({ firstRva, lastRva < firstRva ? firstRva : lastRva });
+		}
+	}
+	if (filename.empty() || targetRanges.empty() || numberOfWorkers <= 0 || maxReferencesReported < 0)
+	{
+		displayUsage();
+		return EXIT_CODE_USAGE_ERROR;
+	}
+
+	MappedExecutable executable;
+	string errorMessage;
+	if (!executable.load(filename, errorMessage))
+	{
+		printf("%s: %s\n", filename.c_str(), errorMessage.c_str());
+		return EXIT_CODE_NOT_ALL_BLOCKS_FOUND;
+	}
+	WorkerPool workerPool(numberOfWorkers);
+	const vector<AOBScanRange> rangesToDecode = determineScanRanges(executable, includeNonCodeSections);
+	const auto buildStartTime = chrono::steady_clock::now();
+	XrefIndex xrefIndex(executable.imageBase(), executable.imageSize());
+	xrefIndex.build(rangesToDecode, workerPool);
+	const double buildTimeInMs = chrono::duration<double, milli>(chrono::steady_clock::now() - buildStartTime).count();
+	printf("%s: %zu instructions decoded, %zu references in %.2f ms (%.1f MB)\n", filename.c_str(), xrefIndex.numberOfInstructionsDecoded(),
+		   xrefIndex.numberOfXrefs(), buildTimeInMs, xrefIndex.memoryUsageInBytes() / (1024.0 * 1024.0));
+
+	int numberOfTargetsWithoutReferences = 0;
+	AOBPatternMinimizer minimizer(executable.imageBase(), executable.imageSize(), rangesToDecode);
+	for (auto& targetRange : targetRanges)
+	{
+		const auto queryStartTime = chrono::steady_clock::now();
+		vector<Xref> references = xrefIndex.findReferencesTo(targetRange.first, targetRange.second);
+		if (!kindToReport.empty())
+		{
+			references.erase(remove_if(references.begin(), references.end(), [&](const Xref& xref) { return kindToReport != XrefIndex::kindName(xref.kind); }),
+							 references.end());
+		}
+		const double queryTimeInMs = chrono::duration<double, milli>(chrono::steady_clock::now() - queryStartTime).count();
+		if (targetRange.first == targetRange.second)
+		{
+			printf("0x%08X: %zu reference(s), found in %.3f ms\n", targetRange.first, references.size(), queryTimeInMs);
+		}
+		else
+		{
+			printf("0x%08X-0x%08X: %zu reference(s), found in %.3f ms\n", targetRange.first, targetRange.second, references.size(), queryTimeInMs);
+		}
+		numberOfTargetsWithoutReferences += references.empty() ? 1 : 0;
+		if (references.size() > static_cast<size_t>(maxReferencesReported))
+		{
+			references.resize(maxReferencesReported);
+		}
+		vector<MinimizedPattern> patterns;
+		if (createPatterns && !references.empty())
+		{
+			vector<uint32_t> sourceRvas;
+			for (auto& reference : references)
+			{
+				sourceRvas.push_back(reference.sourceRva);
+			}
+			patterns = minimizer.minimize(sourceRvas, DEFAULT_MAX_BYTES_BEFORE_HOOK, AOB_PATTERN_MAX_SIZE, workerPool);
+		}
+		for (size_t i = 0; i < references.size(); i++)
+		{
+			const Xref& reference = references[i];
+			printf("  0x%08X  %-5s -> 0x%08X", reference.sourceRva, XrefIndex::kindName(reference.kind), reference.targetRva);
+			if (patterns.empty())
+			{
+				printf("\n");
+				continue;
+			}
+			const MinimizedPattern& pattern = patterns[i];
+			if (!pattern.found)
+			{
+				printf("  no pattern\n");
+				continue;
+			}
+			// the target is the address after the instruction plus the displacement (or branch offset) at the operand offset.
+			printf("  \"%s\", %d  (%d match(es), operand at +%d, instruction length %d)\n", pattern.patternAsString.c_str(), pattern.occurrence,
+				   pattern.numberOfMatches, reference.operandOffset, reference.instructionLength);
+		}
+	}
+	return numberOfTargetsWithoutReferences == 0 ? EXIT_CODE_ALL_BLOCKS_FOUND : EXIT_CODE_NOT_ALL_BLOCKS_FOUND;
+}
+
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		displayUsage();
+		return EXIT_CODE_USAGE_ERROR;
+	}
+	const string command = argv[1];
+	if (command == "scan")
+	{
+		return scanCommand(argc - 2, argv + 2);
+	}
+	if (command == "minimize")
+	{
+		return minimizeCommand(argc - 2, argv + 2);
+	}
+	if (command == "migrate")
+	{
+		return migrateCommand(argc - 2, argv + 2);
+	}
+	if (command == "xrefs")
+	{
+		return xrefsCommand(argc - 2, argv + 2);
+	}
+	displayUsage();
+	return EXIT_CODE_USAGE_ERROR;
+}
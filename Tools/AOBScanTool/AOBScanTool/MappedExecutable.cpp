@@ -0,0 +1,203 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "MappedExecutable.h"
+#include <cstring>
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace IGCS
+{
+	// Read-only memory mapping of a whole file, unmapped when it goes out of scope.
+	class FileMapping
+	{
+	public:
+		FileMapping() : _contents{ nullptr }, _size{ 0 }
+#ifdef _WIN32
+			, _fileHandle{ INVALID_HANDLE_VALUE }, _mappingHandle{ nullptr }
+#else
+			, _fileDescriptor{ -1 }
+#endif
+		{
+		}
+
+
+		~FileMapping()
+		{
+#ifdef _WIN32
+			if (nullptr != _contents)
+			{
+				UnmapViewOfFile(_contents);
+			}
+			if (nullptr != _mappingHandle)
+			{
+				CloseHandle(_mappingHandle);
+			}
+			if (INVALID_HANDLE_VALUE != _fileHandle)
+			{
+				CloseHandle(_fileHandle);
+			}
+#else
+			if (nullptr != _contents)
+			{
+				munmap(const_cast<uint8_t*>(_contents), _size);
+			}
+			if (_fileDescriptor >= 0)
+			{
+				close(_fileDescriptor);
+			}
+#endif
+		}
+
+
+		bool map(const std::string& filename)
+		{
+#ifdef _WIN32
+			_fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (INVALID_HANDLE_VALUE == _fileHandle)
+			{
+				return false;
+			}
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(_fileHandle, &fileSize) || fileSize.QuadPart == 0)
+			{
+				return false;
+			}
+			_size = static_cast<size_t>(fileSize.QuadPart);
+			_mappingHandle = CreateFileMappingA(_fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (nullptr == _mappingHandle)
+			{
+				return false;
+			}
+			_contents = static_cast<const uint8_t*>(MapViewOfFile(_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+			_fileDescriptor = open(filename.c_str(), O_RDONLY);
+			if (_fileDescriptor < 0)
+			{
+				return false;
+			}
+			struct stat fileStatus;
+			if (fstat(_fileDescriptor, &fileStatus) != 0 || fileStatus.st_size == 0)
+			{
+				return false;
+			}
+			_size = static_cast<size_t>(fileStatus.st_size);
+			void* mapping = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fileDescriptor, 0);
+			_contents = (MAP_FAILED == mapping) ? nullptr : static_cast<const uint8_t*>(mapping);
+#endif
+			return nullptr != _contents;
+		}
+
+		const uint8_t* contents() const { return _contents; }
+		size_t size() const { return _size; }
+
+	private:
+		const uint8_t* _contents;
+		size_t _size;
+#ifdef _WIN32
+		HANDLE _fileHandle;
+		HANDLE _mappingHandle;
+#else
+		int _fileDescriptor;
+#endif
+	};
+
+
+	MappedExecutable::MappedExecutable()
+	{
+	}
+
+
+	MappedExecutable::~MappedExecutable()
+	{
+	}
+
+
+	// Maps the file specified and copies its headers and sections to their rva. Returns false with the reason in errorMessage if the file can't be
+	// read or isn't a PE executable.
+	bool MappedExecutable::load(const std::string& filename, std::string& errorMessage)
+	{
+		_filename = filename;
+		_image.clear();
+		FileMapping fileMapping;
+		if (!fileMapping.map(filename))
+		{
+			errorMessage = "can't open or map the file";
+			return false;
+		}
+		return mapSections(fileMapping.contents(), fileMapping.size(), errorMessage);
+	}
+
+
+	bool MappedExecutable::mapSections(const uint8_t* fileContents, size_t fileSize, std::string& errorMessage)
+	{
+		// the headers are at the same location in the file as in the image, so the file can be parsed as-is for the section table.
+		PEImageInfo fileInfo;
+		if (!fileInfo.parse(fileContents, fileSize) || fileInfo.sizeOfImage() == 0)
+		{
+			errorMessage = "not a PE executable";
+			return false;
+		}
+		_image.assign(fileInfo.sizeOfImage(), 0);
+		size_t sizeOfHeaders = fileInfo.sizeOfHeaders();
+		sizeOfHeaders = sizeOfHeaders < fileSize ? sizeOfHeaders : fileSize;
+		sizeOfHeaders = sizeOfHeaders < _image.size() ? sizeOfHeaders : _image.size();
+		memcpy(_image.data(), fileContents, sizeOfHeaders);
+		for (auto& section : fileInfo.sections())
+		{
+			if (section.virtualAddress >= _image.size() || section.pointerToRawData >= fileSize)
+			{
+				// uninitialized data (e.g. .bss) or a section outside the image, which stays zeroed.
+				continue;
+			}
+			// the raw data is padded to the file alignment, so the part past the virtual size isn't part of the image.
+			size_t sizeToCopy = section.sizeOfRawData;
+			if (section.virtualSize > 0 && section.virtualSize < sizeToCopy)
+			{
+				sizeToCopy = section.virtualSize;
+			}
+			sizeToCopy = (sizeToCopy < fileSize - section.pointerToRawData) ? sizeToCopy : fileSize - section.pointerToRawData;
+			sizeToCopy = (sizeToCopy < _image.size() - section.virtualAddress) ? sizeToCopy : _image.size() - section.virtualAddress;
+			memcpy(_image.data() + section.virtualAddress, fileContents + section.pointerToRawData, sizeToCopy);
+		}
+		// parse the headers again in the image, so the sections are reported at their rva in the image like in the camera dll.
+		if (!_imageInfo.parse(_image.data(), _image.size()))
+		{
+			errorMessage = "the headers don't fit in the image";
+			_image.clear();
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,59 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "PEImageInfo.h"
+
+namespace IGCS
+{
+	// A PE executable read from disk with its sections at their rva, like the windows loader maps them, so offsets in the image are rvas and
+	// scan results match the locations found by the camera dll in the running game. The file is memory mapped while the sections are copied, 
+	// nothing is relocated or imported. Doesn't depend on windows headers outside the .cpp file, builds on Windows and Linux.
+	class MappedExecutable
+	{
+	public:
+		MappedExecutable();
+		~MappedExecutable();
+
+		bool load(const std::string& filename, std::string& errorMessage);
+		const uint8_t* imageBase() const { return _image.data(); }
+		size_t imageSize() const { return _image.size(); }
+		const PEImageInfo& imageInfo() const { return _imageInfo; }
+		const std::string& filename() const { return _filename; }
+
+	private:
+		bool mapSections(const uint8_t* fileContents, size_t fileSize, std::string& errorMessage);
+
+		std::string _filename;
+		std::vector<uint8_t> _image;
+		PEImageInfo _imageInfo;
+	};
+}
@@ -0,0 +1,318 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "XrefIndex.h"
+#include <algorithm>
+#include <iterator>
+#include "X64InstructionDecoder.h"
+
+namespace IGCS
+{
+	// The number of bytes decoded before a chunk to get in sync with the instruction stream.
+	#define XREF_CHUNK_WARMUP_SIZE			64
+	#define XREF_MINIMUM_CHUNK_SIZE			(1024 * 1024)
+	#define XREF_CHUNKS_PER_WORKER			4
+
+	static bool isOrderedBefore(const Xref& a, const Xref& b)
+	{
+		return a.targetRva < b.targetRva || (a.targetRva == b.targetRva && a.sourceRva < b.sourceRva);
+	}
+
+
+	static uint8_t regFieldOf(const X64Instruction& decoded)
+	{
+		return (decoded.modRM >> 3) & 0x7;
+	}
+
+
+	// Determines what the instruction specified does with its rip relative memory operand.
+	static XrefKind determineMemoryOperandKind(const X64Instruction& decoded)
+	{
+		const uint8_t opcode = decoded.opcode;
+		switch (decoded.opcodeMap)
+		{
+		case 0:
+			if (opcode == 0x8D)
+			{
+				return XrefKind::Address;
+			}
+			if (opcode == 0xFF)
+			{
+				switch (regFieldOf(decoded))
+				{
+				case 0:		// inc
+				case 1:		// dec
+					return XrefKind::Write;
+				case 2:		// call
+				case 3:
+					return XrefKind::Call;
+				case 4:		// jmp
+				case 5:
+					return XrefKind::Jump;
+				default:
+					return XrefKind::Read;
+				}
+			}
+			// add, or, adc, sbb, and, sub, xor with the memory operand as destination. cmp (0x38/0x39) only reads.
+			if (opcode < 0x38 && (opcode & 0x7) <= 1)
+			{
+				return XrefKind::Write;
+			}
+			switch (opcode)
+			{
+			case 0x86:		// xchg
+			case 0x87:
+			case 0x88:		// mov
+			case 0x89:
+			case 0x8F:		// pop
+			case 0xC0:		// shifts and rotates
+			case 0xC1:
+			case 0xC6:		// mov imm
+			case 0xC7:
+			case 0xD0:
+			case 0xD1:
+			case 0xD2:
+			case 0xD3:
+				return XrefKind::Write;
+			case 0x80:		// group 1, /7 is cmp
+			case 0x81:
+			case 0x83:
+				return regFieldOf(decoded) == 7 ? XrefKind::Read : XrefKind::Write;
+			case 0xF6:		// group 3, /2 is not, /3 is neg
+			case 0xF7:
+				return (regFieldOf(decoded) == 2 || regFieldOf(decoded) == 3) ? XrefKind::Write : XrefKind::Read;
+			case 0xFE:		// inc/dec
+				return regFieldOf(decoded) <= 1 ? XrefKind::Write : XrefKind::Read;
+			default:
+				return XrefKind::Read;
+			}
+		case 1:
+			if (opcode >= 0x90 && opcode <= 0x9F)
+			{
+				// setcc
+				return XrefKind::Write;
+			}
+			switch (opcode)
+			{
+			case 0x11:		// (v)movups/movss/movsd store
+			case 0x13:		// (v)movlps
+			case 0x17:		// (v)movhps
+			case 0x29:		// (v)movaps
+			case 0x2B:		// (v)movntps
+			case 0x7F:		// (v)movdqa/movdqu
+			case 0xAB:		// bts
+			case 0xB0:		// cmpxchg
+			case 0xB1:
+			case 0xB3:		// btr
+			case 0xBB:		// btc
+			case 0xC0:		// xadd
+			case 0xC1:
+			case 0xC3:		// movnti
+			case 0xD6:		// movq
+			case 0xE7:		// (v)movntdq
+				return XrefKind::Write;
+			case 0xBA:		// group 8, /5, /6 and /7 are bts, btr and btc
+				return regFieldOf(decoded) >= 5 ? XrefKind::Write : XrefKind::Read;
+			default:
+				return XrefKind::Read;
+			}
+		case 3:
+			switch (opcode)
+			{
+			case 0x14:		// pextrb/w/d/q, extractps
+			case 0x15:
+			case 0x16:
+			case 0x17:
+			case 0x19:		// vextractf128
+			case 0x1D:		// vcvtps2ph
+			case 0x39:		// vextracti128
+				return XrefKind::Write;
+			default:
+				return XrefKind::Read;
+			}
+		default:
+			return XrefKind::Read;
+		}
+	}
+
+
+	XrefIndex::XrefIndex(const uint8_t* imageBase, size_t imageSize) : _imageBase(imageBase), _imageSize(imageSize), _numberOfInstructionsDecoded(0)
+	{
+	}
+
+
+	XrefIndex::~XrefIndex()
+	= default;
+
+
+	void XrefIndex::build(const std::vector<AOBScanRange>& rangesToDecode, WorkerPool& workerPool)
+	{
+		_xrefs.clear();
+		_numberOfInstructionsDecoded = 0;
+		size_t totalSize = 0;
+		for (auto& range : rangesToDecode)
+		{
+			totalSize += range.size;
+		}
+		size_t chunkSize = totalSize / (static_cast<size_t>(workerPool.numberOfWorkers()) * XREF_CHUNKS_PER_WORKER);
+		chunkSize = chunkSize < XREF_MINIMUM_CHUNK_SIZE ? XREF_MINIMUM_CHUNK_SIZE : chunkSize;
+		std::vector<std::pair<const AOBScanRange*, size_t>> chunks;		// range and offset of the chunk in the range
+		for (auto& range : rangesToDecode)
+		{
+			for (size_t offset = 0; offset < range.size; offset += chunkSize)
+			{
+				chunks.push_back({ &range, offset });
+			}
+		}
+		if (chunks.empty())
+		{
+			return;
+		}
+		// every chunk is decoded and sorted by one job, into its own table.
+		std::vector<std::vector<Xref>> xrefsPerChunk(chunks.size());
+		std::vector<size_t> numberOfInstructionsPerChunk(chunks.size(), 0);
+		for (size_t i = 0; i < chunks.size(); i++)
+		{
+			workerPool.enqueue([this, &chunks, &xrefsPerChunk, &numberOfInstructionsPerChunk, i, chunkSize]
+				{
+					const AOBScanRange& range = *chunks[i].first;
+					const uint8_t* ownedStart = range.start + chunks[i].second;
+					const uint8_t* ownedEnd = (range.size - chunks[i].second > chunkSize) ? ownedStart + chunkSize : range.start + range.size;
+					decodeChunk(range, ownedStart, ownedEnd, xrefsPerChunk[i], numberOfInstructionsPerChunk[i]);
+					std::sort(xrefsPerChunk[i].begin(), xrefsPerChunk[i].end(), isOrderedBefore);
+				});
+		}
+		workerPool.waitUntilIdle();
+		for (size_t numberOfInstructions : numberOfInstructionsPerChunk)
+		{
+			_numberOfInstructionsDecoded += numberOfInstructions;
+		}
+
+		// merge the sorted tables pairwise, every round halves the number of tables and merges its pairs in parallel.
+		for (size_t distance = 1; distance < xrefsPerChunk.size(); distance *= 2)
+		{
+			for (size_t i = 0; i + distance < xrefsPerChunk.size(); i += distance * 2)
+			{
+				workerPool.enqueue([&xrefsPerChunk, i, distance]
+					{
+						std::vector<Xref>& first = xrefsPerChunk[i];
+						std::vector<Xref>& second = xrefsPerChunk[i + distance];
+						std::vector<Xref> merged;
+						merged.reserve(first.size() + second.size());
+						std::merge(first.begin(), first.end(), second.begin(), second.end(), std::back_inserter(merged), isOrderedBefore);
+						first.swap(merged);
+						std::vector<Xref>().swap(second);
+					});
+			}
+			workerPool.waitUntilIdle();
+		}
+		_xrefs.swap(xrefsPerChunk[0]);
+	}
+
+
+	// Returns all references to an address in the range [firstTargetRva, lastTargetRva], sorted on target, then source.
+	std::vector<Xref> XrefIndex::findReferencesTo(uint32_t firstTargetRva, uint32_t lastTargetRva) const
+	{
+		std::vector<Xref> toReturn;
+		auto current = std::lower_bound(_xrefs.begin(), _xrefs.end(), firstTargetRva, [](const Xref& xref, uint32_t rva) { return xref.targetRva < rva; });
+		for (; current != _xrefs.end() && current->targetRva <= lastTargetRva; ++current)
+		{
+			toReturn.push_back(*current);
+		}
+		return toReturn;
+	}
+
+
+	const char* XrefIndex::kindName(XrefKind kind)
+	{
+		switch (kind)
+		{
+		case XrefKind::Read:
+			return "read";
+		case XrefKind::Write:
+			return "write";
+		case XrefKind::Address:
+			return "lea";
+		case XrefKind::Call:
+			return "call";
+		case XrefKind::Jump:
+			return "jump";
+		default:
+			return "?";
+		}
+	}
+
+
+	// Decodes the instructions which start in [ownedStart, ownedEnd) and stores their references to locations inside the image. Decoding starts
+	// XREF_CHUNK_WARMUP_SIZE bytes before the chunk, so the instruction stream is in sync at the start of the chunk, like the neighbouring
+	// chunk decoded it.
+	void XrefIndex::decodeChunk(const AOBScanRange& range, const uint8_t* ownedStart, const uint8_t* ownedEnd, std::vector<Xref>& xrefs, 
+								size_t& numberOfInstructions) const
+	{
+		const uint8_t* rangeEnd = range.start + range.size;
+		const uint8_t* current = (static_cast<size_t>(ownedStart - range.start) > XREF_CHUNK_WARMUP_SIZE) ? ownedStart - XREF_CHUNK_WARMUP_SIZE : range.start;
+		X64Instruction decoded;
+		while (current < ownedEnd)
+		{
+			if (!X64InstructionDecoder::decode(current, rangeEnd - current, decoded))
+			{
+				// data or padding which isn't code. Skip a byte and start over.
+				current++;
+				continue;
+			}
+			const uint8_t* instructionStart = current;
+			current += decoded.length;
+			if (instructionStart < ownedStart)
+			{
+				continue;
+			}
+			numberOfInstructions++;
+			const uint8_t* target = nullptr;
+			Xref xref;
+			if (decoded.isRipRelative)
+			{
+				target = X64InstructionDecoder::determineRipRelativeTarget(instructionStart, decoded);
+				xref.kind = determineMemoryOperandKind(decoded);
+				xref.operandOffset = static_cast<uint8_t>(decoded.displacementOffset);
+			}
+			else if (decoded.isRelativeBranch)
+			{
+				target = X64InstructionDecoder::determineBranchTarget(instructionStart, decoded);
+				xref.kind = (decoded.opcodeMap == 0 && decoded.opcode == 0xE8) ? XrefKind::Call : XrefKind::Jump;
+				xref.operandOffset = static_cast<uint8_t>(decoded.immediateOffset);
+			}
+			if (nullptr == target || target < _imageBase || target >= _imageBase + _imageSize)
+			{
+				continue;
+			}
+			xref.targetRva = static_cast<uint32_t>(target - _imageBase);
+			xref.sourceRva = static_cast<uint32_t>(instructionStart - _imageBase);
+			xref.instructionLength = static_cast<uint8_t>(decoded.length);
+			xrefs.push_back(xref);
+		}
+	}
+}
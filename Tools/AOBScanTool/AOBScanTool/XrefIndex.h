@@ -0,0 +1,84 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "AOBScanEngine.h"
+#include "WorkerPool.h"
+
+namespace IGCS
+{
+	// What an instruction does with the address it references. Determined from the opcode for the common instructions, so it's a best
+	// effort: a rip relative memory operand of an instruction which isn't recognized as a write is reported as a read.
+	enum class XrefKind : uint8_t
+	{
+		Read = 0,
+		Write = 1,
+		Address = 2,		// lea, the address itself is taken
+		Call = 3,
+		Jump = 4,
+	};
+
+	// An instruction referencing an address, either with a rip relative memory operand or as a relative branch.
+	struct Xref
+	{
+		uint32_t targetRva;
+		uint32_t sourceRva;					// rva of the referencing instruction
+		uint8_t instructionLength;
+		uint8_t operandOffset;				// offset of the displacement (or branch offset) in the instruction
+		XrefKind kind;
+	};
+
+	// Table of all references in the code of an image mapped at its rva (e.g. a MappedExecutable), sorted on target, so all the code which
+	// references an address or a range of addresses is found with a binary search. The code is decoded linearly with the X64InstructionDecoder, 
+	// in chunks on a worker pool. Every chunk is sorted on its worker, after which the chunks are merged pairwise in parallel.
+	class XrefIndex
+	{
+	public:
+		XrefIndex(const uint8_t* imageBase, size_t imageSize);
+		~XrefIndex();
+
+		void build(const std::vector<AOBScanRange>& rangesToDecode, WorkerPool& workerPool);
+		std::vector<Xref> findReferencesTo(uint32_t firstTargetRva, uint32_t lastTargetRva) const;
+		size_t numberOfXrefs() const { return _xrefs.size(); }
+		size_t numberOfInstructionsDecoded() const { return _numberOfInstructionsDecoded; }
+		size_t memoryUsageInBytes() const { return _xrefs.capacity() * sizeof(Xref); }
+
+		static const char* kindName(XrefKind kind);
+
+	private:
+		void decodeChunk(const AOBScanRange& range, const uint8_t* ownedStart, const uint8_t* ownedEnd, std::vector<Xref>& xrefs, 
+						 size_t& numberOfInstructions) const;
+
+		const uint8_t* _imageBase;
+		size_t _imageSize;
+		std::vector<Xref> _xrefs;			// sorted on target, then source
+		size_t _numberOfInstructionsDecoded;
+	};
+}
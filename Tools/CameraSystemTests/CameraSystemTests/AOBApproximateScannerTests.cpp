@@ -0,0 +1,311 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Tests of the AOBApproximateScanner: the candidates of every pattern have to be the ones a naive comparison of the pattern with every
+// location of the ranges finds, counting the non-wildcard bytes which differ, ranked the same way and capped at the number of mismatches the
+// pattern is allowed. Copies of the patterns with mismatches are planted on the chunk boundaries of the scan and over the ends of the ranges.
+// Also tests the rule with which a block is resolved to a candidate which differs 1 byte.
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "TestRunner.h"
+#include "AOBApproximateScanner.h"
+#include "ScanPattern.h"
+#include "WorkerPool.h"
+
+using namespace std;
+using namespace IGCS;
+
+#define APPROXIMATE_TEST_IMAGE_SIZE				(2 * 1024 * 1024)
+// the scanner's minimum chunk size, which is the chunk size used for an image this small on pools of up to 2 workers.
+#define APPROXIMATE_TEST_CHUNK_SIZE				(256 * 1024)
+#define APPROXIMATE_TEST_MAX_MISMATCHES			3
+#define APPROXIMATE_TEST_MAX_CANDIDATES			6
+
+struct ApproximateTestImage
+{
+	vector<uint8_t> bytes;
+	vector<AOBScanRange> ranges;
+	vector<ScanPattern> patterns;
+};
+
+
+static string createRandomPattern(mt19937& generator, int length, int wildcardPercentage)
+{
+	uniform_int_distribution<int> byteDistribution(0, 255);
+	uniform_int_distribution<int> percentageDistribution(0, 99);
+	string toReturn;
+	char byteAsString[4];
+	for (int i = 0; i < length; i++)
+	{
+		if (i > 0 && i < length - 1 && percentageDistribution(generator) < wildcardPercentage)
+		{
+			toReturn += "?? ";
+			continue;
+		}
+		snprintf(byteAsString, sizeof(byteAsString), "%02X ", byteDistribution(generator));
+		toReturn += byteAsString;
+	}
+	return toReturn;
+}
+
+
+static int numberOfSignificantBytes(const ScanPattern& pattern)
+{
+	return static_cast<int>(count(pattern.patternMask(), pattern.patternMask() + pattern.patternSize(), 0xFF));
+}
+
+
+// Copies the pattern to the location specified, with numberOfMismatches of its non-wildcard bytes changed. Bytes beyond the end of the image
+// aren't written.
+static void plantPattern(vector<uint8_t>& image, size_t location, const ScanPattern& pattern, int numberOfMismatches, mt19937& generator)
+{
+	vector<int> significantPositions;
+	for (int i = 0; i < pattern.patternSize(); i++)
+	{
+		if (pattern.patternMask()[i] == 0xFF)
+		{
+			significantPositions.push_back(i);
+		}
+	}
+	shuffle(significantPositions.begin(), significantPositions.end(), generator);
+	uniform_int_distribution<int> differenceDistribution(1, 255);
+	for (int i = 0; i < pattern.patternSize() && location + i < image.size(); i++)
+	{
+		if (pattern.patternMask()[i] == 0xFF)
+		{
+			image[location + i] = pattern.bytePattern()[i];
+		}
+	}
+	for (int i = 0; i < numberOfMismatches && i < static_cast<int>(significantPositions.size()); i++)
+	{
+		const size_t mismatchLocation = location + significantPositions[i];
+		if (mismatchLocation < image.size())
+		{
+			image[mismatchLocation] ^= static_cast<uint8_t>(differenceDistribution(generator));
+		}
+	}
+}
+
+
+static ApproximateTestImage createImage(mt19937& generator)
+{
+	ApproximateTestImage toReturn;
+	uniform_int_distribution<int> byteDistribution(0, 255);
+	toReturn.bytes.resize(APPROXIMATE_TEST_IMAGE_SIZE);
+	for (auto& imageByte : toReturn.bytes)
+	{
+		imageByte = static_cast<uint8_t>(byteDistribution(generator));
+	}
+	// two ranges with a hole between them, the second one doesn't start at a chunk boundary of the first.
+	toReturn.ranges = { { toReturn.bytes.data(), 900 * 1024 + 3 }, { toReturn.bytes.data() + 904 * 1024 + 1, APPROXIMATE_TEST_IMAGE_SIZE - 904 * 1024 - 1 } };
+
+	// patterns allowed 0 (5 and 3 significant bytes), 1 (11), 2 (12 and 13) and 3 mismatches, the longest one 64 bytes.
+	const char* fixedPatterns[] = { "0F 28 74 24 40", "48 ?? ?? 8B ?? 05", "C7 43 7C 00 00 80 3F 48 8D 4C 24", "48 8B 05 ?? ?? ?? ?? F3 0F 11 4F 3C 89 5D 7A 01",
+									"F3 0F 10 05 ?? ?? ?? ?? 0F 2F C1 76 ?? 48 8B 4C 24 30" };
+	for (auto patternAsString : fixedPatterns)
+	{
+		toReturn.patterns.emplace_back(patternAsString, 1);
+	}
+	toReturn.patterns.emplace_back(createRandomPattern(generator, 24, 10), 1);
+	toReturn.patterns.emplace_back(createRandomPattern(generator, 40, 20), 1);
+	toReturn.patterns.emplace_back(createRandomPattern(generator, 64, 15), 1);
+
+	uniform_int_distribution<size_t> locationDistribution(0, toReturn.bytes.size() - 64);
+	for (auto& pattern : toReturn.patterns)
+	{
+		const int maxNumberOfMismatches = min(APPROXIMATE_TEST_MAX_MISMATCHES, numberOfSignificantBytes(pattern) / AOB_APPROXIMATE_MIN_SIGNIFICANT_BYTES_PER_MISMATCH);
+		// copies with every number of mismatches up to one more than the pattern is allowed, more than the candidates kept.
+		for (int i = 0; i < 14; i++)
+		{
+			plantPattern(toReturn.bytes, locationDistribution(generator), pattern, i % (maxNumberOfMismatches + 2), generator);
+		}
+		// over the chunk boundaries, and over the start and end of each range.
+		for (auto& range : toReturn.ranges)
+		{
+			const size_t rangeStart = range.start - toReturn.bytes.data();
+			for (size_t boundary = rangeStart + APPROXIMATE_TEST_CHUNK_SIZE; boundary < rangeStart + range.size; boundary += APPROXIMATE_TEST_CHUNK_SIZE)
+			{
+				plantPattern(toReturn.bytes, boundary - pattern.patternSize() / 2, pattern, maxNumberOfMismatches > 0 ? 1 : 0, generator);
+			}
+			plantPattern(toReturn.bytes, rangeStart, pattern, 0, generator);
+			plantPattern(toReturn.bytes, rangeStart + range.size - pattern.patternSize() / 2, pattern, 0, generator);
+		}
+	}
+	return toReturn;
+}
+
+
+// The reference: the mismatches of the pattern at every location of the ranges, kept if there are at most maxNumberOfMismatches of them,
+// ranked on number of mismatches, then on location. numberOfCandidates is set to the number of candidates before only the best are kept.
+static vector<ApproximateMatch> findCandidates(const ApproximateTestImage& image, const ScanPattern& pattern, int maxNumberOfMismatches, int& numberOfCandidates)
+{
+	vector<ApproximateMatch> toReturn;
+	for (auto& range : image.ranges)
+	{
+		for (size_t offset = 0; maxNumberOfMismatches > 0 && offset + pattern.patternSize() <= range.size; offset++)
+		{
+			ApproximateMatch candidate{ range.start + offset, 0, 0 };
+			for (int i = 0; i < pattern.patternSize() && candidate.numberOfMismatches <= maxNumberOfMismatches; i++)
+			{
+				if ((candidate.location[i] & pattern.patternMask()[i]) != pattern.bytePattern()[i])
+				{
+					candidate.numberOfMismatches++;
+					candidate.mismatchMask |= (1ULL << i);
+				}
+			}
+			if (candidate.numberOfMismatches <= maxNumberOfMismatches)
+			{
+				toReturn.push_back(candidate);
+			}
+		}
+	}
+	numberOfCandidates = static_cast<int>(toReturn.size());
+	stable_sort(toReturn.begin(), toReturn.end(), [](const ApproximateMatch& a, const ApproximateMatch& b) { return a.numberOfMismatches < b.numberOfMismatches; });
+	if (toReturn.size() > APPROXIMATE_TEST_MAX_CANDIDATES)
+	{
+		toReturn.resize(APPROXIMATE_TEST_MAX_CANDIDATES);
+	}
+	return toReturn;
+}
+
+
+static bool areEqual(const vector<ApproximateMatch>& candidates, const vector<ApproximateMatch>& expectedCandidates)
+{
+	if (candidates.size() != expectedCandidates.size())
+	{
+		return false;
+	}
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		if (candidates[i].location != expectedCandidates[i].location || candidates[i].numberOfMismatches != expectedCandidates[i].numberOfMismatches ||
+			candidates[i].mismatchMask != expectedCandidates[i].mismatchMask)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+static void testCandidatesAgainstNaiveSearch()
+{
+	mt19937 generator(8);
+	const ApproximateTestImage image = createImage(generator);
+	for (int numberOfWorkers : { 1, 2 })
+	{
+		WorkerPool workerPool(numberOfWorkers);
+		AOBApproximateScanner scanner(APPROXIMATE_TEST_MAX_MISMATCHES, APPROXIMATE_TEST_MAX_CANDIDATES);
+		for (auto& pattern : image.patterns)
+		{
+			scanner.addPattern(pattern);
+		}
+		scanner.scan(image.ranges, workerPool);
+		for (int patternId = 0; patternId < scanner.numberOfPatterns(); patternId++)
+		{
+			const ScanPattern& pattern = image.patterns[patternId];
+			const int expectedMaxNumberOfMismatches = min(APPROXIMATE_TEST_MAX_MISMATCHES, numberOfSignificantBytes(pattern) / AOB_APPROXIMATE_MIN_SIGNIFICANT_BYTES_PER_MISMATCH);
+			int expectedNumberOfCandidates = 0;
+			const vector<ApproximateMatch> expectedCandidates = findCandidates(image, pattern, expectedMaxNumberOfMismatches, expectedNumberOfCandidates);
+			const vector<ApproximateMatch>& candidates = scanner.candidatesOfPattern(patternId);
+			TEST_CHECK(scanner.maxNumberOfMismatchesOfPattern(patternId) == expectedMaxNumberOfMismatches);
+			TEST_CHECK(scanner.numberOfCandidates(patternId) == expectedNumberOfCandidates);
+			if (!TEST_CHECK(areEqual(candidates, expectedCandidates)))
+			{
+				printf("  pattern %d with %d worker(s): %zu candidates, %zu expected.\n", patternId, numberOfWorkers, candidates.size(), expectedCandidates.size());
+			}
+			if (expectedMaxNumberOfMismatches > 0)
+			{
+				// every pattern has more planted copies than candidates are kept, so the ranking decides which ones are returned.
+				TEST_CHECK(expectedNumberOfCandidates > APPROXIMATE_TEST_MAX_CANDIDATES);
+			}
+		}
+	}
+	// the caps of the fixed patterns: 5 and 3 significant bytes aren't enough for a mismatch, 11 allow 1, 12 and 13 allow 2.
+	AOBApproximateScanner scanner(APPROXIMATE_TEST_MAX_MISMATCHES, APPROXIMATE_TEST_MAX_CANDIDATES);
+	for (auto& pattern : image.patterns)
+	{
+		scanner.addPattern(pattern);
+	}
+	TEST_CHECK(scanner.maxNumberOfMismatchesOfPattern(0) == 0);
+	TEST_CHECK(scanner.maxNumberOfMismatchesOfPattern(1) == 0);
+	TEST_CHECK(scanner.maxNumberOfMismatchesOfPattern(2) == 1);
+	TEST_CHECK(scanner.maxNumberOfMismatchesOfPattern(3) == 2);
+	TEST_CHECK(scanner.maxNumberOfMismatchesOfPattern(4) == 2);
+	TEST_CHECK(scanner.maxNumberOfMismatchesOfPattern(7) == APPROXIMATE_TEST_MAX_MISMATCHES);
+}
+
+
+// Scans a noise image with copies of a single pattern planted with the numbers of mismatches specified, and returns the candidate the
+// block would be resolved to, as an offset in the image, or -1 if it wouldn't be resolved.
+static long long acceptedCandidateOffset(const vector<int>& mismatchesPerCopy, vector<size_t>& plantedOffsets)
+{
+	mt19937 generator(6);
+	vector<uint8_t> image(512 * 1024);
+	uniform_int_distribution<int> byteDistribution(0, 255);
+	for (auto& imageByte : image)
+	{
+		imageByte = static_cast<uint8_t>(byteDistribution(generator));
+	}
+	const ScanPattern pattern("F3 0F 10 05 ?? ?? ?? ?? 0F 2F C1 76 ?? 48 8B 4C 24 30", 1);
+	plantedOffsets.clear();
+	for (size_t i = 0; i < mismatchesPerCopy.size(); i++)
+	{
+		plantedOffsets.push_back(1000 + i * 40000);
+		plantPattern(image, plantedOffsets.back(), pattern, mismatchesPerCopy[i], generator);
+	}
+	WorkerPool workerPool(2);
+	AOBApproximateScanner scanner(2, 5);
+	const int patternId = scanner.addPattern(pattern);
+	scanner.scan({ { image.data(), image.size() } }, workerPool);
+	const ApproximateMatch* candidateToAccept = AOBApproximateScanner::uniqueCandidateWithOneMismatch(scanner.candidatesOfPattern(patternId));
+	return nullptr == candidateToAccept ? -1 : static_cast<long long>(candidateToAccept->location - image.data());
+}
+
+
+static void testUniqueCandidateIsAccepted()
+{
+	vector<size_t> plantedOffsets;
+	// the only copy which differs 1 byte is accepted, also when there are copies which differ more.
+	TEST_CHECK(acceptedCandidateOffset({ 1 }, plantedOffsets) == static_cast<long long>(plantedOffsets[0]));
+	TEST_CHECK(acceptedCandidateOffset({ 2, 1, 2 }, plantedOffsets) == static_cast<long long>(plantedOffsets[1]));
+	// two copies which differ 1 byte are ambiguous, and copies which differ 2 bytes or none at all aren't accepted.
+	TEST_CHECK(acceptedCandidateOffset({ 1, 2, 1 }, plantedOffsets) == -1);
+	TEST_CHECK(acceptedCandidateOffset({ 2, 2 }, plantedOffsets) == -1);
+	TEST_CHECK(acceptedCandidateOffset({ 0 }, plantedOffsets) == -1);
+	TEST_CHECK(acceptedCandidateOffset({}, plantedOffsets) == -1);
+	TEST_CHECK(nullptr == AOBApproximateScanner::uniqueCandidateWithOneMismatch({}));
+}
+
+
+void runAOBApproximateScannerTests()
+{
+	testCandidatesAgainstNaiveSearch();
+	testUniqueCandidateIsAccepted();
+}
@@ -0,0 +1,356 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Tests of the AOBPatternMinimizer of the AOBScanTool: for hook sites in synthetic code, the pattern found has to match only at the hook site,
+// contain the hook, wildcard exactly the rip relative displacements and rel32 branch offsets, and no shorter window of whole instructions
+// around the hook may be unique. The reference enumerates every such window and counts its matches byte by byte. Sites in duplicated 
+// functions have no unique pattern: for these the pattern with the fewest matches has to be picked, with the occurrence of the site.
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "TestRunner.h"
+#include "AOBPatternMinimizer.h"
+#include "ScanPattern.h"
+#include "WorkerPool.h"
+
+using namespace std;
+using namespace IGCS;
+
+#define MINIMIZER_TEST_NUMBER_OF_FUNCTIONS		400
+#define MINIMIZER_TEST_NUMBER_OF_SITES			60
+#define MINIMIZER_TEST_CODE_START				0x1000
+#define MINIMIZER_TEST_MAX_BYTES_BEFORE_HOOK	32
+#define MINIMIZER_TEST_MAX_PATTERN_SIZE			48
+// instructions are at least 2 bytes, so the middle of a duplicated function is at least 60 bytes from its start and end.
+#define MINIMIZER_TEST_DUPLICATED_FUNCTION_LENGTH	60
+
+// Local to this file, HookSiteMigratorTests.cpp has a synthetic instruction of its own.
+namespace
+{
+	// An instruction of the synthetic code, with the offset of its rip relative displacement or branch offset.
+	struct SyntheticInstruction
+	{
+		vector<uint8_t> bytes;
+		int relocatedOffset = 0;			// offset of the rel32/disp32 the minimizer has to wildcard, 0 if none.
+	};
+
+	// The synthetic code: the image, which bytes are the start of an instruction and which bytes have to be wildcarded, and per function the 
+	// rvas of its instructions.
+	struct SyntheticCode
+	{
+		vector<uint8_t> image;
+		vector<uint8_t> isInstructionStart;
+		vector<uint8_t> isWildcard;
+		vector<vector<uint32_t>> instructionRvasPerFunction;
+	};
+
+	// The best a window of whole instructions around a hook can do: the fewest matches, then the smallest size.
+	struct ReferenceWindow
+	{
+		int numberOfMatches = 0;
+		int size = 0;
+	};
+}
+
+
+// Creates an instruction from a small set of common x64 forms with few registers, displacements and immediates, so short sequences of
+// instructions occur more than once, as they do in compiled code, and a hook site needs a pattern of several instructions.
+static SyntheticInstruction createRandomInstruction(mt19937& generator)
+{
+	static const uint8_t registers[] = { 0, 1, 3 };
+	static const uint8_t disp8s[] = { 0x08, 0x10, 0x20 };
+	uniform_int_distribution<int> byteDistribution(0, 255);
+	uniform_int_distribution<int> kindDistribution(0, 8);
+	const uint8_t reg = registers[byteDistribution(generator) % 3];
+	const uint8_t base = registers[byteDistribution(generator) % 3];
+	const uint8_t disp8 = disp8s[byteDistribution(generator) % 3];
+	SyntheticInstruction toReturn;
+	switch (kindDistribution(generator))
+	{
+		case 0:	// mov r64,[base+disp8]
+			toReturn.bytes = { 0x48, 0x8B, static_cast<uint8_t>(0x40 | (reg << 3) | base), disp8 };
+			break;
+		case 1:	// movss xmm,[rip+disp32]
+			toReturn.bytes = { 0xF3, 0x0F, 0x10, static_cast<uint8_t>(0x05 | (reg << 3)), 0, 0, 0, 0 };
+			toReturn.relocatedOffset = 4;
+			break;
+		case 2:	// call rel32
+			toReturn.bytes = { 0xE8, 0, 0, 0, 0 };
+			toReturn.relocatedOffset = 1;
+			break;
+		case 3:	// lea r64,[rip+disp32]
+			toReturn.bytes = { 0x48, 0x8D, static_cast<uint8_t>(0x05 | (reg << 3)), 0, 0, 0, 0 };
+			toReturn.relocatedOffset = 3;
+			break;
+		case 4:	// cmp r64,imm8
+			toReturn.bytes = { 0x48, 0x83, static_cast<uint8_t>(0xF8 | reg), disp8 };
+			break;
+		case 5:	// test r32,r32 / je rel32
+			toReturn.bytes = { 0x85, static_cast<uint8_t>(0xC0 | (reg << 3) | reg) };
+			break;
+		case 6:	// je rel32
+			toReturn.bytes = { 0x0F, 0x84, 0, 0, 0, 0 };
+			toReturn.relocatedOffset = 2;
+			break;
+		case 7:	// jmp rel8
+			toReturn.bytes = { 0xEB, static_cast<uint8_t>(disp8 + 2) };
+			break;
+		default:	// movss [base+disp8],xmm
+			toReturn.bytes = { 0xF3, 0x0F, 0x11, static_cast<uint8_t>(0x40 | (reg << 3) | base), disp8 };
+			break;
+	}
+	return toReturn;
+}
+
+
+// Lays out random functions 16 byte aligned with int3 padding in between, with random rel32/disp32 values. The functions in 
+// duplicatedFunctions are emitted a second time, at the end, with the same instructions but other rel32/disp32 values. These are long
+// enough for all windows around the instruction in their middle to be within them.
+static SyntheticCode createCode(mt19937& generator, const vector<int>& duplicatedFunctions)
+{
+	uniform_int_distribution<int> lengthDistribution(20, 50);
+	uniform_int_distribution<uint32_t> displacementDistribution;
+	vector<vector<SyntheticInstruction>> functions(MINIMIZER_TEST_NUMBER_OF_FUNCTIONS);
+	for (int functionIndex = 0; functionIndex < MINIMIZER_TEST_NUMBER_OF_FUNCTIONS; functionIndex++)
+	{
+		vector<SyntheticInstruction>& function = functions[functionIndex];
+		// push rbx; sub rsp,20 ... add rsp,20; pop rbx; ret
+		function.push_back({ { 0x53 }, 0 });
+		function.push_back({ { 0x48, 0x83, 0xEC, 0x20 }, 0 });
+		const bool isDuplicated = find(duplicatedFunctions.begin(), duplicatedFunctions.end(), functionIndex) != duplicatedFunctions.end();
+		const int numberOfInstructions = isDuplicated ? MINIMIZER_TEST_DUPLICATED_FUNCTION_LENGTH : lengthDistribution(generator);
+		for (int i = 0; i < numberOfInstructions; i++)
+		{
+			function.push_back(createRandomInstruction(generator));
+		}
+		function.push_back({ { 0x48, 0x83, 0xC4, 0x20 }, 0 });
+		function.push_back({ { 0x5B }, 0 });
+		function.push_back({ { 0xC3 }, 0 });
+	}
+	for (int functionIndex : duplicatedFunctions)
+	{
+		functions.push_back(functions[functionIndex]);
+	}
+
+	SyntheticCode toReturn;
+	toReturn.image.assign(MINIMIZER_TEST_CODE_START, 0);
+	toReturn.isWildcard.assign(MINIMIZER_TEST_CODE_START, 0);
+	toReturn.isInstructionStart.assign(MINIMIZER_TEST_CODE_START, 0);
+	for (auto& function : functions)
+	{
+		toReturn.instructionRvasPerFunction.emplace_back();
+		for (auto& instruction : function)
+		{
+			toReturn.instructionRvasPerFunction.back().push_back(static_cast<uint32_t>(toReturn.image.size()));
+			vector<uint8_t> bytes = instruction.bytes;
+			vector<uint8_t> isWildcard(bytes.size(), 0);
+			vector<uint8_t> isInstructionStart(bytes.size(), 0);
+			isInstructionStart[0] = 1;
+			if (instruction.relocatedOffset > 0)
+			{
+				const uint32_t displacement = displacementDistribution(generator);
+				memcpy(bytes.data() + instruction.relocatedOffset, &displacement, sizeof(displacement));
+				fill(isWildcard.begin() + instruction.relocatedOffset, isWildcard.begin() + instruction.relocatedOffset + 4, 1);
+			}
+			toReturn.image.insert(toReturn.image.end(), bytes.begin(), bytes.end());
+			toReturn.isWildcard.insert(toReturn.isWildcard.end(), isWildcard.begin(), isWildcard.end());
+			toReturn.isInstructionStart.insert(toReturn.isInstructionStart.end(), isInstructionStart.begin(), isInstructionStart.end());
+		}
+		while ((toReturn.image.size() % 16) != 0)
+		{
+			toReturn.image.push_back(0xCC);
+			toReturn.isWildcard.push_back(0);
+			toReturn.isInstructionStart.push_back(1);
+		}
+	}
+	toReturn.image.insert(toReturn.image.end(), 64, 0xCC);
+	toReturn.isWildcard.insert(toReturn.isWildcard.end(), 64, 0);
+	toReturn.isInstructionStart.insert(toReturn.isInstructionStart.end(), 64, 1);
+	return toReturn;
+}
+
+
+// The rvas at which the window specified, with the wildcards of the synthetic code, matches in the code.
+static vector<uint32_t> findMatches(const SyntheticCode& code, uint32_t windowRva, int windowSize)
+{
+	vector<uint32_t> toReturn;
+	for (size_t rva = MINIMIZER_TEST_CODE_START; rva + windowSize <= code.image.size(); rva++)
+	{
+		bool matches = true;
+		for (int i = 0; i < windowSize && matches; i++)
+		{
+			matches = (0 != code.isWildcard[windowRva + i]) || code.image[rva + i] == code.image[windowRva + i];
+		}
+		if (matches)
+		{
+			toReturn.push_back(static_cast<uint32_t>(rva));
+		}
+	}
+	return toReturn;
+}
+
+
+// Enumerates all windows of whole instructions around the hook within the limits of the minimizer, and returns the best of these.
+static ReferenceWindow determineBestWindow(const SyntheticCode& code, uint32_t hookRva)
+{
+	ReferenceWindow toReturn;
+	for (uint32_t startRva = hookRva - MINIMIZER_TEST_MAX_BYTES_BEFORE_HOOK; startRva <= hookRva; startRva++)
+	{
+		if (0 == code.isInstructionStart[startRva])
+		{
+			continue;
+		}
+		for (uint32_t endRva = hookRva + 1; endRva - startRva <= MINIMIZER_TEST_MAX_PATTERN_SIZE; endRva++)
+		{
+			if (0 == code.isInstructionStart[endRva])
+			{
+				continue;
+			}
+			const int size = static_cast<int>(endRva - startRva);
+			if (count(code.isWildcard.begin() + startRva, code.isWildcard.begin() + endRva, 0) == 0)
+			{
+				continue;
+			}
+			const int numberOfMatches = static_cast<int>(findMatches(code, startRva, size).size());
+			if (toReturn.size == 0 || numberOfMatches < toReturn.numberOfMatches || (numberOfMatches == toReturn.numberOfMatches && size < toReturn.size))
+			{
+				toReturn.numberOfMatches = numberOfMatches;
+				toReturn.size = size;
+			}
+		}
+	}
+	return toReturn;
+}
+
+
+// Checks the pattern found for the hook specified against the code and the best window of the reference.
+static bool checkPattern(const SyntheticCode& code, uint32_t hookRva, const MinimizedPattern& result, bool isUniqueExpected)
+{
+	bool passed = TEST_CHECK(result.found);
+	passed &= TEST_CHECK(result.hookRva == hookRva);
+	if (!passed)
+	{
+		return false;
+	}
+	const ScanPattern pattern(result.patternAsString, result.occurrence);
+	passed &= TEST_CHECK(pattern.isValid());
+	passed &= TEST_CHECK(pattern.patternSize() == result.patternSize && pattern.customOffset() == result.customOffset);
+	// the pattern contains the hook site and starts and ends at an instruction boundary within the limits.
+	const uint32_t patternRva = hookRva - result.customOffset;
+	passed &= TEST_CHECK(result.customOffset >= 0 && result.customOffset < result.patternSize);
+	passed &= TEST_CHECK(result.customOffset <= MINIMIZER_TEST_MAX_BYTES_BEFORE_HOOK && result.patternSize <= MINIMIZER_TEST_MAX_PATTERN_SIZE);
+	passed &= TEST_CHECK(0 != code.isInstructionStart[patternRva] && 0 != code.isInstructionStart[patternRva + result.patternSize]);
+	passed &= TEST_CHECK((result.customOffset > 0) == (result.patternAsString.find('|') != string::npos));
+	// exactly the rel32/disp32 bytes are wildcards.
+	bool wildcardsMatch = true;
+	for (int i = 0; i < pattern.patternSize(); i++)
+	{
+		wildcardsMatch &= ((pattern.patternMask()[i] == 0) == (code.isWildcard[patternRva + i] != 0));
+	}
+	passed &= TEST_CHECK(wildcardsMatch);
+	// the number of matches and the occurrence of the hook site among them.
+	vector<uint32_t> matchRvas;
+	for (size_t rva = MINIMIZER_TEST_CODE_START; rva + pattern.patternSize() <= code.image.size(); rva++)
+	{
+		if (pattern.matchesAt(code.image.data() + rva))
+		{
+			matchRvas.push_back(static_cast<uint32_t>(rva));
+		}
+	}
+	passed &= TEST_CHECK(result.numberOfMatches == static_cast<int>(matchRvas.size()));
+	passed &= TEST_CHECK(result.occurrence >= 1 && result.occurrence <= static_cast<int>(matchRvas.size()) && matchRvas[result.occurrence - 1] == patternRva);
+	passed &= TEST_CHECK(result.isUnique() == isUniqueExpected);
+	// no window has fewer matches, and no window with as few matches is shorter.
+	const ReferenceWindow bestWindow = determineBestWindow(code, hookRva);
+	passed &= TEST_CHECK(result.numberOfMatches == bestWindow.numberOfMatches);
+	passed &= TEST_CHECK(result.patternSize == bestWindow.size);
+	if (!passed)
+	{
+		printf("  hook rva %X: pattern \"%s\" (%d bytes, %d matches), best window %d bytes with %d matches\n", hookRva, result.patternAsString.c_str(),
+			   result.patternSize, result.numberOfMatches, bestWindow.size, bestWindow.numberOfMatches);
+	}
+	return passed;
+}
+
+
+void runAOBPatternMinimizerTests()
+{
+	mt19937 generator(12);
+	const vector<int> duplicatedFunctions = { 17, 250 };
+	const SyntheticCode code = createCode(generator, duplicatedFunctions);
+	const vector<AOBScanRange> rangesToScan = { { code.image.data() + MINIMIZER_TEST_CODE_START, code.image.size() - MINIMIZER_TEST_CODE_START } };
+	AOBPatternMinimizer minimizer(code.image.data(), code.image.size(), rangesToScan);
+	WorkerPool workerPool(4);
+
+	// sites at the start of a function and within a function, away from the duplicated functions.
+	vector<uint32_t> hookRvas;
+	uniform_int_distribution<int> functionDistribution(0, MINIMIZER_TEST_NUMBER_OF_FUNCTIONS - 1);
+	for (int i = 0; i < MINIMIZER_TEST_NUMBER_OF_SITES; i++)
+	{
+		int functionIndex = functionDistribution(generator);
+		if (find(duplicatedFunctions.begin(), duplicatedFunctions.end(), functionIndex) != duplicatedFunctions.end())
+		{
+			functionIndex++;
+		}
+		const vector<uint32_t>& instructionRvas = code.instructionRvasPerFunction[functionIndex];
+		hookRvas.push_back(instructionRvas[(i % 4 == 0) ? 0 : (i % instructionRvas.size())]);
+	}
+	// sites in the middle of the duplicated functions.
+	const size_t firstDuplicatedSite = hookRvas.size();
+	for (int functionIndex : duplicatedFunctions)
+	{
+		const vector<uint32_t>& instructionRvas = code.instructionRvasPerFunction[functionIndex];
+		hookRvas.push_back(instructionRvas[instructionRvas.size() / 2]);
+	}
+	const vector<MinimizedPattern> results = minimizer.minimize(hookRvas, MINIMIZER_TEST_MAX_BYTES_BEFORE_HOOK, MINIMIZER_TEST_MAX_PATTERN_SIZE, workerPool);
+	if (!TEST_CHECK(results.size() == hookRvas.size()))
+	{
+		return;
+	}
+	int numberOfFailedSites = 0;
+	for (size_t i = 0; i < hookRvas.size(); i++)
+	{
+		numberOfFailedSites += checkPattern(code, hookRvas[i], results[i], i < firstDuplicatedSite) ? 0 : 1;
+	}
+	TEST_CHECK(0 == numberOfFailedSites);
+	// a single hook gets the same pattern as in the batch, and so does a site in the copy of a duplicated function, with the second occurrence.
+	const MinimizedPattern singleResult = minimizer.minimize(hookRvas[1], MINIMIZER_TEST_MAX_BYTES_BEFORE_HOOK, MINIMIZER_TEST_MAX_PATTERN_SIZE, workerPool);
+	TEST_CHECK(singleResult.patternAsString == results[1].patternAsString && singleResult.occurrence == results[1].occurrence);
+	const vector<uint32_t>& copyRvas = code.instructionRvasPerFunction[MINIMIZER_TEST_NUMBER_OF_FUNCTIONS];
+	const MinimizedPattern copyResult = minimizer.minimize(copyRvas[copyRvas.size() / 2], MINIMIZER_TEST_MAX_BYTES_BEFORE_HOOK, MINIMIZER_TEST_MAX_PATTERN_SIZE, workerPool);
+	TEST_CHECK(checkPattern(code, copyRvas[copyRvas.size() / 2], copyResult, false));
+	TEST_CHECK(copyResult.occurrence == 2);
+
+	// a hook outside the scanned ranges or the image has no pattern, and the pattern size is capped at the maximum pattern size.
+	TEST_CHECK(!minimizer.minimize(0x10, MINIMIZER_TEST_MAX_BYTES_BEFORE_HOOK, MINIMIZER_TEST_MAX_PATTERN_SIZE, workerPool).found);
+	TEST_CHECK(!minimizer.minimize(static_cast<uint32_t>(code.image.size()), MINIMIZER_TEST_MAX_BYTES_BEFORE_HOOK, MINIMIZER_TEST_MAX_PATTERN_SIZE, workerPool).found);
+	const MinimizedPattern cappedResult = minimizer.minimize(copyRvas[copyRvas.size() / 2], MINIMIZER_TEST_MAX_BYTES_BEFORE_HOOK, 200, workerPool);
+	TEST_CHECK(cappedResult.found && cappedResult.patternSize <= AOB_PATTERN_MAX_SIZE);
+}
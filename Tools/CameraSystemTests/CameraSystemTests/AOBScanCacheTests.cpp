@@ -0,0 +1,439 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Tests of the AOBScanCache: a saved cache loads back as it was saved, but only for the module identity it was saved for, a cached location
+// is only valid for the pattern which matched there, and a truncated or corrupt cache file is rejected as a whole. The module identity
+// is determined from a synthetic PE image, which only hashes the code, so writes to the data section don't invalidate the cache. On Linux 
+// the identity is also determined of the image mapped in pages, with a no-access hole in its code, which mustn't be read.
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include "TestRunner.h"
+#include "AOBScanCache.h"
+#include "MemorySource.h"
+#include "ScanPattern.h"
+#ifdef __linux__
+	#include <sys/mman.h>
+#endif
+
+using namespace std;
+using namespace IGCS;
+
+#define CACHE_TEST_IMAGE_SIZE				0x4000
+#define CACHE_TEST_TEXT_RVA					0x1000
+#define CACHE_TEST_TEXT_SIZE				0x2000
+#define CACHE_TEST_DATA_RVA					0x3000
+#define CACHE_TEST_DATA_SIZE				0x1000
+#define CACHE_TEST_NT_HEADERS_OFFSET		0x80
+#define CACHE_TEST_OPTIONAL_HEADER_SIZE		0xF0
+#define CACHE_TEST_TIME_DATE_STAMP			0x5FD2A1C4
+#define CACHE_TEST_PAGE_SIZE				0x1000
+
+// The patterns of the test blocks and the rva in the .text section each pattern is planted at.
+static const char* cameraAddressPattern = "48 8B 05 ?? ?? ?? ?? | 0F 28 40 10 0F 29 43 20";
+static const char* cameraWritePattern = "F3 0F 11 4B 58 | F3 0F 11 53 5C ?? ?? 48 83 C4 28";
+#define CACHE_TEST_CAMERA_ADDRESS_RVA		0x1240
+#define CACHE_TEST_CAMERA_WRITE_RVA			0x2F11
+
+
+template<typename T>
+static void writeValue(uint8_t* address, T value)
+{
+	memcpy(address, &value, sizeof(T));
+}
+
+
+// Creates a 64 bit PE image with an executable .text section filled with random bytes and the test patterns, and a writable .data section.
+static vector<uint8_t> createImage()
+{
+	vector<uint8_t> toReturn(CACHE_TEST_IMAGE_SIZE, 0);
+	uint8_t* image = toReturn.data();
+	writeValue<uint16_t>(image, 0x5A4D);
+	writeValue<uint32_t>(image + 0x3C, CACHE_TEST_NT_HEADERS_OFFSET);
+	uint8_t* ntHeaders = image + CACHE_TEST_NT_HEADERS_OFFSET;
+	writeValue<uint32_t>(ntHeaders, 0x00004550);
+	writeValue<uint16_t>(ntHeaders + 4, 0x8664);
+	writeValue<uint16_t>(ntHeaders + 6, 2);
+	writeValue<uint32_t>(ntHeaders + 8, CACHE_TEST_TIME_DATE_STAMP);
+	writeValue<uint16_t>(ntHeaders + 20, CACHE_TEST_OPTIONAL_HEADER_SIZE);
+	uint8_t* optionalHeader = ntHeaders + 24;
+	writeValue<uint16_t>(optionalHeader, 0x20B);
+	writeValue<uint32_t>(optionalHeader + 56, CACHE_TEST_IMAGE_SIZE);
+	writeValue<uint32_t>(optionalHeader + 60, 0x1000);
+	struct { const char* name; uint32_t rva; uint32_t size; uint32_t characteristics; } sections[] =
+	{
+		{ ".text", CACHE_TEST_TEXT_RVA, CACHE_TEST_TEXT_SIZE, PE_SECTION_CONTAINS_CODE | PE_SECTION_MEM_EXECUTE | PE_SECTION_MEM_READ },
+		{ ".data", CACHE_TEST_DATA_RVA, CACHE_TEST_DATA_SIZE, PE_SECTION_MEM_READ | PE_SECTION_MEM_WRITE },
+	};
+	uint8_t* sectionHeader = optionalHeader + CACHE_TEST_OPTIONAL_HEADER_SIZE;
+	for (auto& section : sections)
+	{
+		memcpy(sectionHeader, section.name, strlen(section.name));
+		writeValue<uint32_t>(sectionHeader + 8, section.size);
+		writeValue<uint32_t>(sectionHeader + 12, section.rva);
+		writeValue<uint32_t>(sectionHeader + 16, section.size);
+		writeValue<uint32_t>(sectionHeader + 20, section.rva);
+		writeValue<uint32_t>(sectionHeader + 36, section.characteristics);
+		sectionHeader += 40;
+	}
+	mt19937 generator(7);
+	uniform_int_distribution<int> byteDistribution(0, 255);
+	for (int i = CACHE_TEST_TEXT_RVA; i < CACHE_TEST_TEXT_RVA + CACHE_TEST_TEXT_SIZE + CACHE_TEST_DATA_SIZE; i++)
+	{
+		toReturn[i] = static_cast<uint8_t>(byteDistribution(generator));
+	}
+	// the planted bytes of the patterns, with the wildcards filled in.
+	const vector<uint8_t> cameraAddressBytes = parseBytes("48 8B 05 A0 11 3C 02 0F 28 40 10 0F 29 43 20");
+	const vector<uint8_t> cameraWriteBytes = parseBytes("F3 0F 11 4B 58 F3 0F 11 53 5C 8B 07 48 83 C4 28");
+	memcpy(image + CACHE_TEST_CAMERA_ADDRESS_RVA, cameraAddressBytes.data(), cameraAddressBytes.size());
+	memcpy(image + CACHE_TEST_CAMERA_WRITE_RVA, cameraWriteBytes.data(), cameraWriteBytes.size());
+	return toReturn;
+}
+
+
+static filesystem::path cacheTestFilename()
+{
+	return filesystem::temp_directory_path() / "IGCS_AOBScanCacheTests.txt";
+}
+
+
+static void writeFile(const filesystem::path& filename, const string& contents)
+{
+	ofstream file(filename, ios::binary | ios::trunc);
+	file << contents;
+}
+
+
+static string readFile(const filesystem::path& filename)
+{
+	ifstream file(filename, ios::binary);
+	return string(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+}
+
+
+static bool locationsAreEqual(const CachedBlockLocation* location, const CachedBlockLocation& expected)
+{
+	return nullptr != location && location->patternHash == expected.patternHash && location->rva == expected.rva &&
+		   location->patternIndex == expected.patternIndex && location->customOffset == expected.customOffset;
+}
+
+
+// Fills the cache with the locations of the test blocks, as the scan would: the cameraWrite block matched with its second pattern.
+static void fillCache(AOBScanCache& cache, const ModuleIdentity& moduleIdentity, const vector<ScanPattern>& cameraAddressPatterns, 
+					  const vector<ScanPattern>& cameraWritePatterns)
+{
+	cache.clear(moduleIdentity);
+	cache.setBlockLocation("cameraAddress", { cameraAddressPatterns[0].patternHash(), CACHE_TEST_CAMERA_ADDRESS_RVA, 0, cameraAddressPatterns[0].customOffset() });
+	cache.setBlockLocation("cameraWrite", { cameraWritePatterns[1].patternHash(), CACHE_TEST_CAMERA_WRITE_RVA, 1, cameraWritePatterns[1].customOffset() });
+	cache.setBlockLocation("timestopRead", { 0x0123456789ABCDEFULL, 0x1FFF, 2, -4 });
+}
+
+
+static void testSaveLoadRoundTrip()
+{
+	const vector<uint8_t> image = createImage();
+	const ModuleIdentity moduleIdentity = AOBScanCache::determineModuleIdentity(image.data(), image.size(), ImageMemorySource());
+	TEST_CHECK(moduleIdentity.timeDateStamp == CACHE_TEST_TIME_DATE_STAMP);
+	TEST_CHECK(moduleIdentity.sizeOfImage == CACHE_TEST_IMAGE_SIZE);
+	TEST_CHECK(moduleIdentity.codeHash != 0);
+	const vector<ScanPattern> cameraAddressPatterns = { ScanPattern(cameraAddressPattern, 1) };
+	const vector<ScanPattern> cameraWritePatterns = { ScanPattern("F3 0F 11 4B 58 | F3 0F 11 53 5C 8B 07", 2), ScanPattern(cameraWritePattern, 1) };
+	AOBScanCache savedCache;
+	fillCache(savedCache, moduleIdentity, cameraAddressPatterns, cameraWritePatterns);
+	TEST_CHECK(savedCache.save(cacheTestFilename()));
+
+	AOBScanCache loadedCache;
+	TEST_CHECK(loadedCache.load(cacheTestFilename(), moduleIdentity));
+	TEST_CHECK(loadedCache.numberOfBlockLocations() == savedCache.numberOfBlockLocations());
+	for (const char* blockName : { "cameraAddress", "cameraWrite", "timestopRead" })
+	{
+		if (!TEST_CHECK(locationsAreEqual(loadedCache.findBlockLocation(blockName), *savedCache.findBlockLocation(blockName))))
+		{
+			printf("  block: %s\n", blockName);
+		}
+	}
+	TEST_CHECK(nullptr == loadedCache.findBlockLocation("fovAddress"));
+	// the loaded locations are valid for the patterns they were saved for.
+	TEST_CHECK(loadedCache.findValidBlockLocation("cameraAddress", cameraAddressPatterns, image.data(), image.size()) != nullptr);
+	TEST_CHECK(loadedCache.findValidBlockLocation("cameraWrite", cameraWritePatterns, image.data(), image.size()) != nullptr);
+	// saving the loaded cache writes the same file.
+	const string savedFile = readFile(cacheTestFilename());
+	TEST_CHECK(loadedCache.save(cacheTestFilename()));
+	TEST_CHECK(readFile(cacheTestFilename()) == savedFile);
+}
+
+
+// A cache saved for one build of the module isn't loaded for another: every part of the identity has to match.
+static void testModuleIdentityMismatch()
+{
+	const vector<uint8_t> image = createImage();
+	const ModuleIdentity moduleIdentity = AOBScanCache::determineModuleIdentity(image.data(), image.size(), ImageMemorySource());
+	const vector<ScanPattern> cameraAddressPatterns = { ScanPattern(cameraAddressPattern, 1) };
+	const vector<ScanPattern> cameraWritePatterns = { ScanPattern(cameraWritePattern, 1), ScanPattern(cameraWritePattern, 1) };
+	AOBScanCache cache;
+	fillCache(cache, moduleIdentity, cameraAddressPatterns, cameraWritePatterns);
+	TEST_CHECK(cache.save(cacheTestFilename()));
+
+	ModuleIdentity otherTimeDateStamp = moduleIdentity;
+	otherTimeDateStamp.timeDateStamp++;
+	ModuleIdentity otherSizeOfImage = moduleIdentity;
+	otherSizeOfImage.sizeOfImage += 0x1000;
+	ModuleIdentity otherCodeHash = moduleIdentity;
+	otherCodeHash.codeHash ^= 1;
+	for (const ModuleIdentity& otherIdentity : { otherTimeDateStamp, otherSizeOfImage, otherCodeHash, ModuleIdentity() })
+	{
+		AOBScanCache loadedCache;
+		fillCache(loadedCache, moduleIdentity, cameraAddressPatterns, cameraWritePatterns);
+		TEST_CHECK(!loadedCache.load(cacheTestFilename(), otherIdentity));
+		TEST_CHECK(0 == loadedCache.numberOfBlockLocations());
+	}
+	// a relinked build with the same code has another timestamp in its headers.
+	vector<uint8_t> relinkedImage = image;
+	writeValue<uint32_t>(relinkedImage.data() + CACHE_TEST_NT_HEADERS_OFFSET + 8, CACHE_TEST_TIME_DATE_STAMP + 3600);
+	const ModuleIdentity relinkedIdentity = AOBScanCache::determineModuleIdentity(relinkedImage.data(), relinkedImage.size(), ImageMemorySource());
+	TEST_CHECK(relinkedIdentity != moduleIdentity);
+	TEST_CHECK(relinkedIdentity.codeHash == moduleIdentity.codeHash);
+	TEST_CHECK(!cache.load(cacheTestFilename(), relinkedIdentity));
+	// an image which isn't a PE image has no identity.
+	vector<uint8_t> corruptImage = image;
+	corruptImage[0] = 0;
+	TEST_CHECK(AOBScanCache::determineModuleIdentity(corruptImage.data(), corruptImage.size(), ImageMemorySource()) == ModuleIdentity());
+}
+
+
+// A cached location is only valid if the pattern which matched is still the same pattern and it still matches at the cached location.
+static void testPatternHashChange()
+{
+	const vector<uint8_t> image = createImage();
+	const ModuleIdentity moduleIdentity = AOBScanCache::determineModuleIdentity(image.data(), image.size(), ImageMemorySource());
+	const vector<ScanPattern> cameraAddressPatterns = { ScanPattern(cameraAddressPattern, 1) };
+	const vector<ScanPattern> cameraWritePatterns = { ScanPattern("F3 0F 11 4B 58 | F3 0F 11 53 5C 8B 07", 2), ScanPattern(cameraWritePattern, 1) };
+	AOBScanCache cache;
+	fillCache(cache, moduleIdentity, cameraAddressPatterns, cameraWritePatterns);
+	TEST_CHECK(cache.save(cacheTestFilename()));
+	TEST_CHECK(cache.load(cacheTestFilename(), moduleIdentity));
+	TEST_CHECK(locationsAreEqual(cache.findValidBlockLocation("cameraAddress", cameraAddressPatterns, image.data(), image.size()),
+								 *cache.findBlockLocation("cameraAddress")));
+
+	// the pattern is changed in the dll, even if it still matches at the location, or only its occurrence or custom offset is changed.
+	const vector<ScanPattern> changedPatterns[] =
+	{
+		{ ScanPattern("48 8B 05 ?? ?? ?? ?? | 0F 28 40 10 0F 29", 1) },
+		{ ScanPattern(cameraAddressPattern, 2) },
+		{ ScanPattern("48 8B 05 ?? ?? ?? ?? 0F 28 40 10 | 0F 29 43 20", 1) },
+	};
+	for (auto& patterns : changedPatterns)
+	{
+		TEST_CHECK(patterns[0].matchesAt(image.data() + CACHE_TEST_CAMERA_ADDRESS_RVA));
+		TEST_CHECK(patterns[0].patternHash() != cameraAddressPatterns[0].patternHash());
+		TEST_CHECK(nullptr == cache.findValidBlockLocation("cameraAddress", patterns, image.data(), image.size()));
+	}
+	// the pattern which matched is no longer at the same index, e.g. as an alternative was removed.
+	TEST_CHECK(nullptr == cache.findValidBlockLocation("cameraWrite", { cameraWritePatterns[1] }, image.data(), image.size()));
+	TEST_CHECK(nullptr == cache.findValidBlockLocation("cameraWrite", { cameraWritePatterns[1], cameraWritePatterns[0] }, image.data(), image.size()));
+	TEST_CHECK(nullptr != cache.findValidBlockLocation("cameraWrite", cameraWritePatterns, image.data(), image.size()));
+	// the bytes at the location don't match the pattern anymore.
+	vector<uint8_t> patchedImage = image;
+	patchedImage[CACHE_TEST_CAMERA_WRITE_RVA + 12] = 0x90;
+	TEST_CHECK(nullptr == cache.findValidBlockLocation("cameraWrite", cameraWritePatterns, patchedImage.data(), patchedImage.size()));
+	// the location, or the end of the pattern at the location, is outside the image.
+	TEST_CHECK(nullptr == cache.findValidBlockLocation("cameraWrite", cameraWritePatterns, image.data(), CACHE_TEST_CAMERA_WRITE_RVA + 15));
+	TEST_CHECK(nullptr != cache.findValidBlockLocation("cameraWrite", cameraWritePatterns, image.data(), CACHE_TEST_CAMERA_WRITE_RVA + 16));
+	// a location with a custom offset which doesn't match the pattern's, which a hand edited file could contain.
+	AOBScanCache editedCache;
+	editedCache.clear(moduleIdentity);
+	editedCache.setBlockLocation("cameraAddress", { cameraAddressPatterns[0].patternHash(), CACHE_TEST_CAMERA_ADDRESS_RVA, 0, 0 });
+	TEST_CHECK(nullptr == editedCache.findValidBlockLocation("cameraAddress", cameraAddressPatterns, image.data(), image.size()));
+	// a block which isn't in the cache.
+	TEST_CHECK(nullptr == cache.findValidBlockLocation("fovAddress", cameraAddressPatterns, image.data(), image.size()));
+}
+
+
+// The identity only covers the code, so the game writing its data section, which it does before the dll is loaded, keeps the cache valid.
+// A change to the code, e.g. a patch of the game, makes it invalid.
+static void testDataSectionChange()
+{
+	const vector<uint8_t> image = createImage();
+	const ModuleIdentity moduleIdentity = AOBScanCache::determineModuleIdentity(image.data(), image.size(), ImageMemorySource());
+	const vector<ScanPattern> cameraAddressPatterns = { ScanPattern(cameraAddressPattern, 1) };
+	const vector<ScanPattern> cameraWritePatterns = { ScanPattern(cameraWritePattern, 1), ScanPattern(cameraWritePattern, 1) };
+	AOBScanCache cache;
+	fillCache(cache, moduleIdentity, cameraAddressPatterns, cameraWritePatterns);
+	TEST_CHECK(cache.save(cacheTestFilename()));
+
+	vector<uint8_t> runningImage = image;
+	for (int i = CACHE_TEST_DATA_RVA; i < CACHE_TEST_DATA_RVA + CACHE_TEST_DATA_SIZE; i += 7)
+	{
+		runningImage[i] ^= 0x5A;
+	}
+	const ModuleIdentity runningIdentity = AOBScanCache::determineModuleIdentity(runningImage.data(), runningImage.size(), ImageMemorySource());
+	TEST_CHECK(runningIdentity == moduleIdentity);
+	AOBScanCache loadedCache;
+	TEST_CHECK(loadedCache.load(cacheTestFilename(), runningIdentity));
+	TEST_CHECK(3 == loadedCache.numberOfBlockLocations());
+	TEST_CHECK(nullptr != loadedCache.findValidBlockLocation("cameraAddress", cameraAddressPatterns, runningImage.data(), runningImage.size()));
+
+	// a single changed byte anywhere in the code, also at the first and last byte of the section, changes the code hash.
+	for (int rva : { CACHE_TEST_TEXT_RVA, CACHE_TEST_TEXT_RVA + 0x777, CACHE_TEST_TEXT_RVA + CACHE_TEST_TEXT_SIZE - 1 })
+	{
+		vector<uint8_t> patchedImage = runningImage;
+		patchedImage[rva] ^= 0x01;
+		const ModuleIdentity patchedIdentity = AOBScanCache::determineModuleIdentity(patchedImage.data(), patchedImage.size(), ImageMemorySource());
+		if (!TEST_CHECK(patchedIdentity.codeHash != moduleIdentity.codeHash))
+		{
+			printf("  changed rva: 0x%X\n", rva);
+		}
+		TEST_CHECK(!loadedCache.load(cacheTestFilename(), patchedIdentity));
+	}
+}
+
+
+// A cache file which is cut off at any point, e.g. because the game was closed while it was written, is either rejected or, if it was cut
+// off right after a line, loads the lines before that. A file which isn't a cache file, or has a corrupt line, is rejected as a whole.
+static void testTruncatedAndCorruptFiles()
+{
+	const vector<uint8_t> image = createImage();
+	const ModuleIdentity moduleIdentity = AOBScanCache::determineModuleIdentity(image.data(), image.size(), ImageMemorySource());
+	const vector<ScanPattern> cameraAddressPatterns = { ScanPattern(cameraAddressPattern, 1) };
+	const vector<ScanPattern> cameraWritePatterns = { ScanPattern(cameraWritePattern, 1), ScanPattern(cameraWritePattern, 1) };
+	AOBScanCache savedCache;
+	fillCache(savedCache, moduleIdentity, cameraAddressPatterns, cameraWritePatterns);
+	TEST_CHECK(savedCache.save(cacheTestFilename()));
+	const string savedFile = readFile(cacheTestFilename());
+	const size_t endOfIdentityLine = savedFile.find('\n', savedFile.find('\n') + 1) + 1;
+
+	int numberOfFailures = 0;
+	for (size_t length = 0; length < savedFile.size(); length++)
+	{
+		writeFile(cacheTestFilename(), savedFile.substr(0, length));
+		AOBScanCache loadedCache;
+		const bool loaded = loadedCache.load(cacheTestFilename(), moduleIdentity);
+		// only a file which is cut off right after a line, after the identity line, is a valid file.
+		const bool shouldLoad = length >= endOfIdentityLine && savedFile[length - 1] == '\n';
+		bool succeeded = (loaded == shouldLoad) && (loaded || 0 == loadedCache.numberOfBlockLocations());
+		for (const char* blockName : { "cameraAddress", "cameraWrite", "timestopRead" })
+		{
+			const CachedBlockLocation* location = loadedCache.findBlockLocation(blockName);
+			succeeded &= (nullptr == location) || locationsAreEqual(location, *savedCache.findBlockLocation(blockName));
+		}
+		if (!succeeded)
+		{
+			numberOfFailures++;
+			printf("  cache file cut off after %d of %d bytes was loaded: %d\n", static_cast<int>(length), static_cast<int>(savedFile.size()), loaded);
+		}
+	}
+	TEST_CHECK(0 == numberOfFailures);
+
+	// each corrupt file is placed after a valid load, so the cache has to be emptied by the failed load.
+	const string identityLine = savedFile.substr(savedFile.find('\n') + 1, endOfIdentityLine - savedFile.find('\n') - 1);
+	const string corruptFiles[] =
+	{
+		"IGCS_AOB_CACHE 2\n" + identityLine + "cameraAddress 1a2b 1240 0 7\n",
+		"igcs_aob_cache 1\n" + identityLine,
+		"IGCS_AOB_CACHE 1\nmodul" + identityLine.substr(6),
+		"IGCS_AOB_CACHE 1\n" + identityLine + "cameraAddress 1a2b 1240 0 7\ncameraWrite 1a2b zz12 1 5\n",
+		"IGCS_AOB_CACHE 1\n" + identityLine + "cameraAddress 1a2b 1240 0 7\ncameraWrite 1a2b 2f11 1\n",
+		"IGCS_AOB_CACHE 1\n" + identityLine + "cameraAddress 1a2b 1240 0 7 12\n",
+		"IGCS_AOB_CACHE 1\n" + identityLine + "\n",
+		string("\x00\x01\x02\x7F\xFF garbage", 14),
+		string(),
+	};
+	for (auto& corruptFile : corruptFiles)
+	{
+		AOBScanCache loadedCache;
+		TEST_CHECK(savedCache.save(cacheTestFilename()));
+		TEST_CHECK(loadedCache.load(cacheTestFilename(), moduleIdentity));
+		writeFile(cacheTestFilename(), corruptFile);
+		if (!TEST_CHECK(!loadedCache.load(cacheTestFilename(), moduleIdentity) && 0 == loadedCache.numberOfBlockLocations()))
+		{
+			printf("  file: %s\n", corruptFile.c_str());
+		}
+	}
+	// a missing file.
+	filesystem::remove(cacheTestFilename());
+	AOBScanCache loadedCache;
+	TEST_CHECK(!loadedCache.load(cacheTestFilename(), moduleIdentity));
+	TEST_CHECK(0 == loadedCache.numberOfBlockLocations());
+}
+
+
+#ifdef __linux__
+// The identity of the image mapped in pages, with the regions taken from /proc/self/maps. A fully readable image has the same identity as 
+// the image in a buffer. A no-access page in .text, as a protector leaves behind, isn't read, so its contents don't change the identity, 
+// while the readable code around it still does.
+static void testUnreadableCode()
+{
+	const vector<uint8_t> image = createImage();
+	uint8_t* mappedImage = static_cast<uint8_t*>(mmap(nullptr, CACHE_TEST_IMAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+	if (!TEST_CHECK(MAP_FAILED != mappedImage))
+	{
+		return;
+	}
+	memcpy(mappedImage, image.data(), CACHE_TEST_IMAGE_SIZE);
+	const ProcMapsMemorySource procMapsSource;
+	const ModuleIdentity moduleIdentity = AOBScanCache::determineModuleIdentity(image.data(), image.size(), ImageMemorySource());
+	TEST_CHECK(AOBScanCache::determineModuleIdentity(mappedImage, CACHE_TEST_IMAGE_SIZE, procMapsSource) == moduleIdentity);
+
+	uint8_t* holeStart = mappedImage + CACHE_TEST_TEXT_RVA + CACHE_TEST_PAGE_SIZE;
+	mprotect(mappedImage + CACHE_TEST_TEXT_RVA, CACHE_TEST_TEXT_SIZE, PROT_READ | PROT_EXEC);
+	mprotect(holeStart, CACHE_TEST_PAGE_SIZE, PROT_NONE);
+	const ModuleIdentity identityWithHole = AOBScanCache::determineModuleIdentity(mappedImage, CACHE_TEST_IMAGE_SIZE, procMapsSource);
+	TEST_CHECK(identityWithHole.timeDateStamp == CACHE_TEST_TIME_DATE_STAMP && identityWithHole.sizeOfImage == CACHE_TEST_IMAGE_SIZE);
+	TEST_CHECK(identityWithHole.codeHash != moduleIdentity.codeHash);
+	TEST_CHECK(AOBScanCache::determineModuleIdentity(mappedImage, CACHE_TEST_IMAGE_SIZE, procMapsSource) == identityWithHole);
+
+	// the contents of the hole are changed while it's briefly writable.
+	mprotect(holeStart, CACHE_TEST_PAGE_SIZE, PROT_READ | PROT_WRITE);
+	holeStart[0x10] ^= 0x01;
+	mprotect(holeStart, CACHE_TEST_PAGE_SIZE, PROT_NONE);
+	TEST_CHECK(AOBScanCache::determineModuleIdentity(mappedImage, CACHE_TEST_IMAGE_SIZE, procMapsSource) == identityWithHole);
+	// a change in the readable code before the hole.
+	mprotect(mappedImage + CACHE_TEST_TEXT_RVA, CACHE_TEST_PAGE_SIZE, PROT_READ | PROT_WRITE);
+	mappedImage[CACHE_TEST_TEXT_RVA + 0x10] ^= 0x01;
+	mprotect(mappedImage + CACHE_TEST_TEXT_RVA, CACHE_TEST_PAGE_SIZE, PROT_READ | PROT_EXEC);
+	TEST_CHECK(AOBScanCache::determineModuleIdentity(mappedImage, CACHE_TEST_IMAGE_SIZE, procMapsSource).codeHash != identityWithHole.codeHash);
+	munmap(mappedImage, CACHE_TEST_IMAGE_SIZE);
+}
+#endif
+
+
+void runAOBScanCacheTests()
+{
+	testSaveLoadRoundTrip();
+	testModuleIdentityMismatch();
+	testPatternHashChange();
+	testDataSectionChange();
+	testTruncatedAndCorruptFiles();
+#ifdef __linux__
+	testUnreadableCode();
+#endif
+	filesystem::remove(cacheTestFilename());
+}
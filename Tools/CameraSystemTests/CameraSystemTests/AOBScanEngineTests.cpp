@@ -0,0 +1,195 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Tests of the AOBScanEngine: a scan in chunks on a worker pool has to find the same matches as the single threaded sweep, also when several
+// threads scan their own image on one shared pool at the same time, as the module scans of the camera do. Both scan methods, the automaton
+// and the search kernels, have to find every match a byte by byte search finds.
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+#include "TestRunner.h"
+#include "AOBScanEngine.h"
+#include "ScanPattern.h"
+#include "WorkerPool.h"
+
+using namespace std;
+using namespace IGCS;
+
+#define SCAN_TEST_NUMBER_OF_IMAGES			6
+#define SCAN_TEST_MINIMUM_IMAGE_SIZE		(3 * 1024 * 1024)
+#define SCAN_TEST_NUMBER_OF_WORKERS			4
+
+static const char* scanTestPatterns[] =
+{
+	"48 8B 05 ?? ?? ?? ?? F3 0F 11 4F 3C",
+	"F3 0F 10 05 ?? ?? ?? ?? 0F 2F C1 76 ??",
+	"C7 43 7C 00 00 80 3F | 48 8D 4C 24 ?? E8",
+	"0F 28 74 24 40 48 83 C4 58 C3",
+};
+
+// An image of random bytes, with the patterns planted at random locations and on the 1MB boundaries the engine chunks on.
+struct ScanTestImage
+{
+	vector<uint8_t> bytes;
+	vector<ScanPattern> patterns;
+};
+
+
+static ScanTestImage createImage(mt19937& generator)
+{
+	ScanTestImage toReturn;
+	uniform_int_distribution<int> byteDistribution(0, 255);
+	uniform_int_distribution<size_t> extraSizeDistribution(0, 3 * 1024 * 1024);
+	toReturn.bytes.resize(SCAN_TEST_MINIMUM_IMAGE_SIZE + extraSizeDistribution(generator));
+	for (auto& imageByte : toReturn.bytes)
+	{
+		imageByte = static_cast<uint8_t>(byteDistribution(generator));
+	}
+	uniform_int_distribution<size_t> locationDistribution(0, toReturn.bytes.size() - 64);
+	for (auto patternAsString : scanTestPatterns)
+	{
+		toReturn.patterns.emplace_back(patternAsString, 1);
+		const ScanPattern& pattern = toReturn.patterns.back();
+		vector<size_t> locations;
+		for (int i = 0; i < 20; i++)
+		{
+			locations.push_back(locationDistribution(generator));
+		}
+		for (size_t boundary = 1024 * 1024; boundary + 64 < toReturn.bytes.size(); boundary += 1024 * 1024)
+		{
+			locations.push_back(boundary - 3);
+		}
+		for (size_t location : locations)
+		{
+			for (int i = 0; i < pattern.patternSize(); i++)
+			{
+				if (pattern.patternMask()[i] != 0)
+				{
+					toReturn.bytes[location + i] = pattern.bytePattern()[i];
+				}
+			}
+		}
+	}
+	return toReturn;
+}
+
+
+// Returns all matches of all patterns of the image, per pattern, found with the single threaded sweep or on the worker pool specified.
+static vector<vector<const uint8_t*>> scanImage(const ScanTestImage& image, WorkerPool* workerPool, AOBScanEngine::ScanMethod scanMethod)
+{
+	AOBScanEngine engine;
+	engine.setScanMethod(scanMethod);
+	vector<int> patternIds;
+	for (auto& pattern : image.patterns)
+	{
+		patternIds.push_back(engine.addPattern(pattern));
+	}
+	engine.compile();
+	if (nullptr == workerPool)
+	{
+		engine.scan(image.bytes.data(), image.bytes.size());
+	}
+	else
+	{
+		engine.scan(image.bytes.data(), image.bytes.size(), *workerPool);
+	}
+	vector<vector<const uint8_t*>> toReturn;
+	for (int patternId : patternIds)
+	{
+		vector<const uint8_t*> matches;
+		for (int i = 0; i < engine.numberOfRecordedMatches(patternId); i++)
+		{
+			matches.push_back(engine.matchLocation(patternId, i));
+		}
+		toReturn.push_back(matches);
+		if (engine.numberOfMatches(patternId) != engine.numberOfRecordedMatches(patternId))
+		{
+			// more matches than are recorded, which shouldn't happen with the number of planted patterns: counted as a difference.
+			toReturn.back().push_back(nullptr);
+		}
+	}
+	return toReturn;
+}
+
+
+// The reference: every location the pattern matches at, one by one. Like the engine, the locations are the start of the pattern.
+static vector<const uint8_t*> findAllMatches(const ScanTestImage& image, const ScanPattern& pattern)
+{
+	vector<const uint8_t*> toReturn;
+	for (size_t location = 0; location + pattern.patternSize() <= image.bytes.size(); location++)
+	{
+		if (pattern.matchesAt(image.bytes.data() + location))
+		{
+			toReturn.push_back(image.bytes.data() + location);
+		}
+	}
+	return toReturn;
+}
+
+
+void runAOBScanEngineTests()
+{
+	mt19937 generator(16);
+	vector<ScanTestImage> images;
+	for (int i = 0; i < SCAN_TEST_NUMBER_OF_IMAGES; i++)
+	{
+		images.push_back(createImage(generator));
+	}
+	vector<vector<vector<const uint8_t*>>> sweepMatchesPerImage;
+	for (auto& image : images)
+	{
+		sweepMatchesPerImage.push_back(scanImage(image, nullptr, AOBScanEngine::ScanMethod::Automaton));
+		for (size_t patternIndex = 0; patternIndex < image.patterns.size(); patternIndex++)
+		{
+			TEST_CHECK(sweepMatchesPerImage.back()[patternIndex] == findAllMatches(image, image.patterns[patternIndex]));
+		}
+		TEST_CHECK(scanImage(image, nullptr, AOBScanEngine::ScanMethod::SearchKernels) == sweepMatchesPerImage.back());
+	}
+	WorkerPool workerPool(SCAN_TEST_NUMBER_OF_WORKERS);
+	for (size_t imageIndex = 0; imageIndex < images.size(); imageIndex++)
+	{
+		TEST_CHECK(scanImage(images[imageIndex], &workerPool, AOBScanEngine::ScanMethod::Automaton) == sweepMatchesPerImage[imageIndex]);
+		TEST_CHECK(scanImage(images[imageIndex], &workerPool, AOBScanEngine::ScanMethod::SearchKernels) == sweepMatchesPerImage[imageIndex]);
+	}
+	// all images at once, each on its own thread, with the chunks of all of them on one pool. Repeated, as a race doesn't show every time.
+	for (int round = 0; round < 10; round++)
+	{
+		vector<vector<vector<const uint8_t*>>> concurrentMatchesPerImage(images.size());
+		vector<thread> scanThreads;
+		for (size_t imageIndex = 0; imageIndex < images.size(); imageIndex++)
+		{
+			scanThreads.emplace_back([&, imageIndex] { concurrentMatchesPerImage[imageIndex] = scanImage(images[imageIndex], &workerPool, AOBScanEngine::ScanMethod::Automatic); });
+		}
+		for (auto& scanThread : scanThreads)
+		{
+			scanThread.join();
+		}
+		TEST_CHECK(concurrentMatchesPerImage == sweepMatchesPerImage);
+	}
+}
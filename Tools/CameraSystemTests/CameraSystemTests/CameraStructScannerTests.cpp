@@ -0,0 +1,261 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Tests of the CameraStructScanner: a camera planted in a buffer of noise and decoys (identity matrices, normals, bones) has to be found with
+// the right layout, position and fov, also when the buffer is scanned in chunks with the margin the discovery scan uses, and the decoys mustn't 
+// outscore it.
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "TestRunner.h"
+#include "CameraStructScanner.h"
+
+using namespace std;
+using namespace IGCS;
+
+#define CAMERA_TEST_BUFFER_SIZE			(8 * 1024 * 1024)
+#define CAMERA_TEST_CHUNK_SIZE			(1024 * 1024)
+#define CAMERA_TEST_NUMBER_OF_DECOYS	20000
+
+// A camera struct like the one of most engines: a 3x4 rotation matrix, its translation row and the fov further on.
+#define CAMERA_TEST_MATRIX_OFFSET		0xB0
+#define CAMERA_TEST_POSITION_OFFSET		0xE0
+#define CAMERA_TEST_FOV_OFFSET			0x1F0
+
+static void createRandomQuaternion(mt19937& generator, float quaternion[4])
+{
+	normal_distribution<float> distribution;
+	float length = 0.0f;
+	for (int i = 0; i < 4; i++)
+	{
+		quaternion[i] = distribution(generator);
+		length += quaternion[i] * quaternion[i];
+	}
+	length = sqrtf(length);
+	for (int i = 0; i < 4; i++)
+	{
+		quaternion[i] /= length;
+	}
+}
+
+
+static void quaternionToMatrix(const float quaternion[4], float matrix[3][3])
+{
+	const float x = quaternion[0], y = quaternion[1], z = quaternion[2], w = quaternion[3];
+	matrix[0][0] = 1 - 2 * (y * y + z * z); matrix[0][1] = 2 * (x * y + w * z);     matrix[0][2] = 2 * (x * z - w * y);
+	matrix[1][0] = 2 * (x * y - w * z);     matrix[1][1] = 1 - 2 * (x * x + z * z); matrix[1][2] = 2 * (y * z + w * x);
+	matrix[2][0] = 2 * (x * z + w * y);     matrix[2][1] = 2 * (y * z - w * x);     matrix[2][2] = 1 - 2 * (x * x + y * y);
+}
+
+
+static void writeFloats(vector<uint8_t>& buffer, size_t offset, const vector<float>& values)
+{
+	memcpy(buffer.data() + offset, values.data(), values.size() * sizeof(float));
+}
+
+
+// Fills the buffer with what a heap looks like: zeros, small integers, floats, pointers and random bits, and decoys which look like camera 
+// data but aren't: identity matrices, runs of normals and bones (a quaternion with an integral position).
+static void fillWithNoiseAndDecoys(mt19937& generator, vector<uint8_t>& buffer, vector<size_t>& identityMatrixOffsets)
+{
+	for (size_t offset = 0; offset < buffer.size(); offset += sizeof(uint32_t))
+	{
+		uint32_t value = generator();
+		switch (value % 8)
+		{
+			case 0:
+				value = 0;
+				break;
+			case 1:
+				value = generator() % 1000;
+				break;
+			case 2:
+				{
+					const float floatValue = static_cast<float>(generator() % 2000) / 10.0f;
+					memcpy(&value, &floatValue, sizeof(value));
+				}
+				break;
+			case 3:
+				value = 0x7FF0;
+				break;
+			default:
+				break;
+		}
+		memcpy(buffer.data() + offset, &value, sizeof(value));
+	}
+	for (int decoy = 0; decoy < CAMERA_TEST_NUMBER_OF_DECOYS; decoy++)
+	{
+		const size_t offset = (generator() % (buffer.size() / 64 - 2)) * 64;
+		float quaternion[4];
+		createRandomQuaternion(generator, quaternion);
+		switch (decoy % 3)
+		{
+			case 0:
+				writeFloats(buffer, offset, { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 });
+				identityMatrixOffsets.push_back(offset);
+				break;
+			case 1:
+				for (int i = 0; i < 5; i++)
+				{
+					createRandomQuaternion(generator, quaternion);
+					const float length = sqrtf(quaternion[0] * quaternion[0] + quaternion[1] * quaternion[1] + quaternion[2] * quaternion[2]);
+					writeFloats(buffer, offset + i * 12, { quaternion[0] / length, quaternion[1] / length, quaternion[2] / length });
+				}
+				break;
+			default:
+				writeFloats(buffer, offset, { static_cast<float>(generator() % 100), static_cast<float>(generator() % 100), static_cast<float>(generator() % 100), 1.0f,
+											  quaternion[0], quaternion[1], quaternion[2], quaternion[3] });
+				break;
+		}
+	}
+}
+
+
+static const CameraStructCandidate* findCandidateAt(const vector<CameraStructCandidate>& candidates, uintptr_t address)
+{
+	for (auto& candidate : candidates)
+	{
+		if (candidate.address == address)
+		{
+			return &candidate;
+		}
+	}
+	return nullptr;
+}
+
+
+// Scans the buffer in chunks, each with CAMERA_SCAN_MARGIN bytes of the neighbouring chunks around it, like the discovery scan does.
+static vector<CameraStructCandidate> scanInChunks(const vector<uint8_t>& buffer, uintptr_t bufferAddress)
+{
+	vector<CameraStructCandidate> toReturn;
+	for (size_t chunkStart = 0; chunkStart < buffer.size(); chunkStart += CAMERA_TEST_CHUNK_SIZE)
+	{
+		const size_t chunkEnd = min(buffer.size(), chunkStart + CAMERA_TEST_CHUNK_SIZE);
+		const size_t copyStart = chunkStart >= CAMERA_SCAN_MARGIN ? chunkStart - CAMERA_SCAN_MARGIN : 0;
+		const size_t copyEnd = min(buffer.size(), chunkEnd + CAMERA_SCAN_MARGIN);
+		// a copy, so a read outside the margin would be noticed by the sanitizers.
+		const vector<uint8_t> chunk(buffer.begin() + copyStart, buffer.begin() + copyEnd);
+		CameraStructScanner::scanBuffer(chunk.data(), chunk.size(), chunkStart - copyStart, chunkEnd - copyStart, bufferAddress + copyStart, toReturn);
+	}
+	return toReturn;
+}
+
+
+void runCameraStructScannerTests()
+{
+	mt19937 generator(3);
+	vector<uint8_t> buffer(CAMERA_TEST_BUFFER_SIZE);
+	vector<size_t> identityMatrixOffsets;
+	fillWithNoiseAndDecoys(generator, buffer, identityMatrixOffsets);
+
+	// a camera struct with a 3x4 matrix, which straddles the boundary of two chunks, so the chunked scan needs the margin to see all of it. 
+	// The memory around it is cleared, so the nearest float which looks like a fov is the fov of the camera.
+	const size_t matrixCameraOffset = 3 * CAMERA_TEST_CHUNK_SIZE - CAMERA_TEST_MATRIX_OFFSET - 0x10;
+	memset(buffer.data() + matrixCameraOffset - CAMERA_SCAN_MARGIN, 0, 0x200 + 2 * CAMERA_SCAN_MARGIN);
+	float quaternion[4];
+	createRandomQuaternion(generator, quaternion);
+	float matrix[3][3];
+	quaternionToMatrix(quaternion, matrix);
+	for (int row = 0; row < 3; row++)
+	{
+		writeFloats(buffer, matrixCameraOffset + CAMERA_TEST_MATRIX_OFFSET + row * 16, { matrix[row][0], matrix[row][1], matrix[row][2], 0.0f });
+	}
+	writeFloats(buffer, matrixCameraOffset + CAMERA_TEST_POSITION_OFFSET, { 123.25f, -45.5f, 10.75f });
+	writeFloats(buffer, matrixCameraOffset + CAMERA_TEST_FOV_OFFSET, { 0.9f });
+	const size_t matrixOffset = matrixCameraOffset + CAMERA_TEST_MATRIX_OFFSET;
+	// a camera with a quaternion after its position, like a transform, at a position which isn't 16 byte aligned.
+	const size_t quaternionCameraOffset = 5 * CAMERA_TEST_CHUNK_SIZE + 0x1234;
+	memset(buffer.data() + quaternionCameraOffset - 0x40, 0, 0x80);
+	createRandomQuaternion(generator, quaternion);
+	writeFloats(buffer, quaternionCameraOffset, { -1034.2f, 2200.7f, 13.1f, 1.0f, quaternion[0], quaternion[1], quaternion[2], quaternion[3] });
+	const size_t quaternionOffset = quaternionCameraOffset + 16;
+
+	const uintptr_t bufferAddress = 0x7FF600000000;
+	vector<CameraStructCandidate> candidates;
+	CameraStructScanner::scanBuffer(buffer.data(), buffer.size(), 0, buffer.size(), bufferAddress, candidates);
+	const CameraStructCandidate* matrixCandidate = findCandidateAt(candidates, bufferAddress + matrixOffset);
+	if (TEST_CHECK(nullptr != matrixCandidate))
+	{
+		TEST_CHECK(matrixCandidate->kind == CameraLayoutKind::Matrix3x4);
+		TEST_CHECK(matrixCandidate->hasPosition && matrixCandidate->positionOffset == CAMERA_TEST_POSITION_OFFSET - CAMERA_TEST_MATRIX_OFFSET);
+		TEST_CHECK(matrixCandidate->hasFov && matrixCandidate->fovOffset == CAMERA_TEST_FOV_OFFSET - CAMERA_TEST_MATRIX_OFFSET);
+	}
+	const CameraStructCandidate* quaternionCandidate = findCandidateAt(candidates, bufferAddress + quaternionOffset);
+	if (TEST_CHECK(nullptr != quaternionCandidate))
+	{
+		TEST_CHECK(quaternionCandidate->kind == CameraLayoutKind::QuaternionAndPosition);
+		TEST_CHECK(quaternionCandidate->hasPosition && quaternionCandidate->positionOffset == -16);
+	}
+	// axis aligned rotations are everywhere, they're never a candidate. Identity matrices overwritten by later decoys or the cameras are skipped.
+	static const float identityMatrix[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	int numberOfIdentityMatrices = 0;
+	int numberOfIdentityCandidates = 0;
+	for (size_t offset : identityMatrixOffsets)
+	{
+		if (0 == memcmp(buffer.data() + offset, identityMatrix, sizeof(identityMatrix)))
+		{
+			numberOfIdentityMatrices++;
+			numberOfIdentityCandidates += (nullptr != findCandidateAt(candidates, bufferAddress + offset)) ? 1 : 0;
+		}
+	}
+	TEST_CHECK(numberOfIdentityMatrices > CAMERA_TEST_NUMBER_OF_DECOYS / 4);
+	TEST_CHECK(0 == numberOfIdentityCandidates);
+
+	// the chunked scan finds the same planted cameras.
+	vector<CameraStructCandidate> chunkedCandidates = scanInChunks(buffer, bufferAddress);
+	const CameraStructCandidate* chunkedMatrixCandidate = findCandidateAt(chunkedCandidates, bufferAddress + matrixOffset);
+	TEST_CHECK(nullptr != chunkedMatrixCandidate && nullptr != matrixCandidate && chunkedMatrixCandidate->score == matrixCandidate->score &&
+			   chunkedMatrixCandidate->fovOffset == matrixCandidate->fovOffset);
+	const CameraStructCandidate* chunkedQuaternionCandidate = findCandidateAt(chunkedCandidates, bufferAddress + quaternionOffset);
+	TEST_CHECK(nullptr != chunkedQuaternionCandidate && nullptr != quaternionCandidate && chunkedQuaternionCandidate->score == quaternionCandidate->score);
+
+	// the planted cameras have the best scores. A unit quaternion next to floats in the noise scores as high as the planted one, so only the
+	// matrix may score higher than it.
+	int numberOfBetterCandidates = 0;
+	for (auto& candidate : candidates)
+	{
+		numberOfBetterCandidates += (nullptr != quaternionCandidate && candidate.score > quaternionCandidate->score) ? 1 : 0;
+	}
+	TEST_CHECK(1 == numberOfBetterCandidates);
+	const size_t numberOfCandidates = candidates.size();
+	CameraStructScanner::keepBestCandidates(candidates, 10);
+	TEST_CHECK(candidates.size() == min<size_t>(10, numberOfCandidates));
+	TEST_CHECK(is_sorted(candidates.begin(), candidates.end(), [](const CameraStructCandidate& a, const CameraStructCandidate& b) { return a.score > b.score; }));
+	TEST_CHECK(!candidates.empty() && candidates[0].address == bufferAddress + matrixOffset);
+
+	// a candidate is re-validated with a fresh copy of its memory: once the camera is gone, it scores 0.
+	CameraStructCandidate toRevalidate;
+	toRevalidate.kind = CameraLayoutKind::Matrix3x4;
+	TEST_CHECK(CameraStructScanner::scoreCandidate(buffer.data(), buffer.size(), matrixOffset, toRevalidate) > 0.0f);
+	writeFloats(buffer, matrixOffset + 16, { matrix[0][0], matrix[0][1], matrix[0][2] });
+	TEST_CHECK(CameraStructScanner::scoreCandidate(buffer.data(), buffer.size(), matrixOffset, toRevalidate) == 0.0f);
+	// a candidate at the end of the buffer doesn't read past it.
+	TEST_CHECK(CameraStructScanner::scoreCandidate(buffer.data(), 12, 0, toRevalidate) == 0.0f);
+}
@@ -0,0 +1,285 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Tests of the HookSiteMigrator of the AOBScanTool: the hook sites of a synthetic build of a game have to be found in a rebuild of it, in 
+// which padding was inserted between the functions and all rip relative displacements and branch offsets changed.
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "TestRunner.h"
+#include "HookSiteMigrator.h"
+#include "ScanPattern.h"
+#include "WorkerPool.h"
+#include "X64InstructionDecoder.h"
+
+using namespace std;
+using namespace IGCS;
+
+#define MIGRATION_TEST_NUMBER_OF_FUNCTIONS		2000
+#define MIGRATION_TEST_NUMBER_OF_SITES			40
+#define MIGRATION_TEST_CODE_START				0x1000
+#define MIGRATION_TEST_HOOK_SIZE				14
+
+// The types of the synthetic builds are only used in this file, the minimizer tests have their own.
+namespace
+{
+	// A function of the synthetic build: its instructions, each with the offset of its displacement or branch offset which changes per build. 
+	struct SyntheticInstruction
+	{
+		vector<uint8_t> bytes;
+		int relocatedOffset = 0;			// offset of the rel32/disp32 which differs per build, 0 if none.
+	};
+
+	struct SyntheticFunction
+	{
+		vector<SyntheticInstruction> instructions;
+	};
+
+	// A build of the functions: the image and the rva of every instruction of every function.
+	struct SyntheticBuild
+	{
+		vector<uint8_t> image;
+		vector<vector<uint32_t>> instructionRvas;
+	};
+}
+
+
+// Creates an instruction from a small set of common x64 forms with random registers, displacements and immediates, so the code has the
+// same variety as compiled code but isn't repetitive.
+static SyntheticInstruction createRandomInstruction(mt19937& generator)
+{
+	// registers which can be a base without a SIB byte or a disp32 only form.
+	static const uint8_t baseRegisters[] = { 0, 1, 2, 3, 6, 7 };
+	uniform_int_distribution<int> byteDistribution(0, 255);
+	uniform_int_distribution<int> kindDistribution(0, 9);
+	const uint8_t reg = static_cast<uint8_t>(byteDistribution(generator) & 0x07);
+	const uint8_t base = baseRegisters[byteDistribution(generator) % 6];
+	const uint8_t disp8 = static_cast<uint8_t>(byteDistribution(generator) & 0xF8);
+	SyntheticInstruction toReturn;
+	switch (kindDistribution(generator))
+	{
+		case 0:	// mov r64,[base+disp8]
+			toReturn.bytes = { 0x48, 0x8B, static_cast<uint8_t>(0x40 | (reg << 3) | base), disp8 };
+			break;
+		case 1:	// mov [base+disp32],r64
+			toReturn.bytes = { 0x48, 0x89, static_cast<uint8_t>(0x80 | (reg << 3) | base), disp8, static_cast<uint8_t>(byteDistribution(generator) & 0x03), 0, 0 };
+			break;
+		case 2:	// movss xmm,[rip+disp32]
+			toReturn.bytes = { 0xF3, 0x0F, 0x10, static_cast<uint8_t>(0x05 | (reg << 3)), 0, 0, 0, 0 };
+			toReturn.relocatedOffset = 4;
+			break;
+		case 3:	// call rel32
+			toReturn.bytes = { 0xE8, 0, 0, 0, 0 };
+			toReturn.relocatedOffset = 1;
+			break;
+		case 4:	// lea r64,[rip+disp32]
+			toReturn.bytes = { 0x48, 0x8D, static_cast<uint8_t>(0x05 | (reg << 3)), 0, 0, 0, 0 };
+			toReturn.relocatedOffset = 3;
+			break;
+		case 5:	// cmp r64,imm8
+			toReturn.bytes = { 0x48, 0x83, static_cast<uint8_t>(0xF8 | reg), static_cast<uint8_t>(byteDistribution(generator)) };
+			break;
+		case 6:	// test r32,r32 / je rel8
+			toReturn.bytes = { 0x85, static_cast<uint8_t>(0xC0 | (reg << 3) | reg), 0x74, static_cast<uint8_t>(byteDistribution(generator) & 0x3F) };
+			break;
+		case 7:	// add r64,r64
+			toReturn.bytes = { 0x48, 0x01, static_cast<uint8_t>(0xC0 | (reg << 3) | base) };
+			break;
+		case 8:	// mov dword [base+disp8],imm32
+			toReturn.bytes = { 0xC7, static_cast<uint8_t>(0x40 | base), disp8, static_cast<uint8_t>(byteDistribution(generator)), 0, 0, 0 };
+			break;
+		default:	// movss [base+disp32],xmm
+			toReturn.bytes = { 0xF3, 0x0F, 0x11, static_cast<uint8_t>(0x80 | (reg << 3) | base), disp8, static_cast<uint8_t>(byteDistribution(generator) & 0x03), 0, 0 };
+			break;
+	}
+	return toReturn;
+}
+
+
+static vector<SyntheticFunction> createRandomFunctions(mt19937& generator, int numberOfFunctions)
+{
+	uniform_int_distribution<int> lengthDistribution(6, 40);
+	vector<SyntheticFunction> toReturn(numberOfFunctions);
+	for (auto& function : toReturn)
+	{
+		// push rbx; sub rsp,20 ... add rsp,20; pop rbx; ret
+		function.instructions.push_back({ { 0x53 }, 0 });
+		function.instructions.push_back({ { 0x48, 0x83, 0xEC, 0x20 }, 0 });
+		const int numberOfInstructions = lengthDistribution(generator);
+		for (int i = 0; i < numberOfInstructions; i++)
+		{
+			function.instructions.push_back(createRandomInstruction(generator));
+		}
+		function.instructions.push_back({ { 0x48, 0x83, 0xC4, 0x20 }, 0 });
+		function.instructions.push_back({ { 0x5B }, 0 });
+		function.instructions.push_back({ { 0xC3 }, 0 });
+	}
+	return toReturn;
+}
+
+
+// Lays out the functions 16 byte aligned with int3 padding in between, like a compiler does. extraPaddingPerFunction is added before a 
+// function; a function with skipFunction set isn't emitted. The rel32/disp32 values are random per build.
+static SyntheticBuild createBuild(const vector<SyntheticFunction>& functions, const vector<int>& extraPaddingPerFunction, const vector<bool>& skipFunction, 
+								  mt19937& generator)
+{
+	uniform_int_distribution<uint32_t> displacementDistribution;
+	SyntheticBuild toReturn;
+	toReturn.image.assign(MIGRATION_TEST_CODE_START, 0);
+	toReturn.instructionRvas.resize(functions.size());
+	for (size_t functionIndex = 0; functionIndex < functions.size(); functionIndex++)
+	{
+		toReturn.image.insert(toReturn.image.end(), extraPaddingPerFunction[functionIndex], 0xCC);
+		if (skipFunction[functionIndex])
+		{
+			continue;
+		}
+		for (auto& instruction : functions[functionIndex].instructions)
+		{
+			toReturn.instructionRvas[functionIndex].push_back(static_cast<uint32_t>(toReturn.image.size()));
+			vector<uint8_t> bytes = instruction.bytes;
+			if (instruction.relocatedOffset > 0)
+			{
+				const uint32_t displacement = displacementDistribution(generator);
+				memcpy(bytes.data() + instruction.relocatedOffset, &displacement, sizeof(displacement));
+			}
+			toReturn.image.insert(toReturn.image.end(), bytes.begin(), bytes.end());
+		}
+		while ((toReturn.image.size() % 16) != 0)
+		{
+			toReturn.image.push_back(0xCC);
+		}
+	}
+	toReturn.image.insert(toReturn.image.end(), 64, 0xCC);
+	return toReturn;
+}
+
+
+void runHookSiteMigratorTests()
+{
+	mt19937 generator(42);
+	const vector<SyntheticFunction> functions = createRandomFunctions(generator, MIGRATION_TEST_NUMBER_OF_FUNCTIONS);
+	const SyntheticBuild oldBuild = createBuild(functions, vector<int>(functions.size(), 0), vector<bool>(functions.size(), false), generator);
+	// the new build has padding inserted before some functions and one function removed.
+	vector<int> extraPaddingPerFunction(functions.size(), 0);
+	uniform_int_distribution<int> paddingDistribution(0, 7);
+	for (auto& padding : extraPaddingPerFunction)
+	{
+		const int paddingKind = paddingDistribution(generator);
+		padding = (paddingKind < 3) ? paddingKind * 16 : 0;
+	}
+	vector<bool> skipFunction(functions.size(), false);
+	const size_t removedFunctionIndex = functions.size() / 2;
+	skipFunction[removedFunctionIndex] = true;
+	const SyntheticBuild newBuild = createBuild(functions, extraPaddingPerFunction, skipFunction, generator);
+
+	// sites at the start of a function and within a function, half with a pattern and a continue offset, half without.
+	vector<MigrationSite> sites;
+	vector<uint32_t> expectedNewAnchorRvas;
+	uniform_int_distribution<size_t> functionDistribution(0, functions.size() - 1);
+	for (int i = 0; i < MIGRATION_TEST_NUMBER_OF_SITES; i++)
+	{
+		size_t functionIndex = functionDistribution(generator);
+		if (functionIndex == removedFunctionIndex)
+		{
+			functionIndex++;
+		}
+		const vector<uint32_t>& oldRvas = oldBuild.instructionRvas[functionIndex];
+		const size_t instructionIndex = (i % 4 == 0) ? 0 : (2 + (i % static_cast<int>(oldRvas.size() - 6)));
+		MigrationSite site;
+		site.name = "site" + to_string(i);
+		site.oldAnchorRva = oldRvas[instructionIndex];
+		if ((i % 2) == 0)
+		{
+			site.patternSize = X64InstructionDecoder::determineInstructionSpan(oldBuild.image.data() + site.oldAnchorRva, oldBuild.image.size() - site.oldAnchorRva, 16);
+			site.customOffset = static_cast<int>(oldRvas[instructionIndex + 1] - oldRvas[instructionIndex]);
+			site.oldContinueOffset = X64InstructionDecoder::determineInstructionSpan(oldBuild.image.data() + site.oldAnchorRva + site.customOffset, 
+																					 oldBuild.image.size() - site.oldAnchorRva - site.customOffset, MIGRATION_TEST_HOOK_SIZE);
+		}
+		sites.push_back(site);
+		expectedNewAnchorRvas.push_back(newBuild.instructionRvas[functionIndex][instructionIndex]);
+	}
+	// a site in the function which was removed.
+	MigrationSite removedSite;
+	removedSite.name = "removed";
+	removedSite.oldAnchorRva = oldBuild.instructionRvas[removedFunctionIndex][2];
+	sites.push_back(removedSite);
+
+	const vector<AOBScanRange> newRangesToScan = { { newBuild.image.data() + MIGRATION_TEST_CODE_START, newBuild.image.size() - MIGRATION_TEST_CODE_START } };
+	HookSiteMigrator migrator(oldBuild.image.data(), oldBuild.image.size(), newBuild.image.data(), newBuild.image.size(), newRangesToScan);
+	WorkerPool workerPool(4);
+	const vector<MigrationResult> results = migrator.migrate(sites, workerPool);
+	if (!TEST_CHECK(results.size() == sites.size()))
+	{
+		return;
+	}
+	for (size_t i = 0; i < expectedNewAnchorRvas.size(); i++)
+	{
+		const MigrationSite& site = sites[i];
+		const MigrationResult& result = results[i];
+		bool passed = TEST_CHECK(result.found);
+		passed &= TEST_CHECK(result.newAnchorRva == expectedNewAnchorRvas[i]);
+		passed &= TEST_CHECK(result.newHookRva == expectedNewAnchorRvas[i] + site.customOffset);
+		passed &= TEST_CHECK(!result.isAmbiguous);
+		// the instructions before the anchor are decoded backwards from a byte window, so the first ones can differ if padding was inserted.
+		passed &= TEST_CHECK(result.score * 2 > result.maxScore);
+		// the pattern created for the new build has to match only at the new location.
+		const ScanPattern newPattern(result.patternAsString, result.occurrence);
+		passed &= TEST_CHECK(newPattern.isValid());
+		passed &= TEST_CHECK(result.newAnchorRva + newPattern.patternSize() <= newBuild.image.size() && newPattern.matchesAt(newBuild.image.data() + result.newAnchorRva));
+		passed &= TEST_CHECK(newPattern.customOffset() == site.customOffset);
+		// random code can contain the pattern more than once: the occurrence has to select the new location among all matches.
+		vector<uint32_t> matchRvas;
+		for (size_t rva = MIGRATION_TEST_CODE_START; rva + newPattern.patternSize() <= newBuild.image.size(); rva++)
+		{
+			if (newPattern.matchesAt(newBuild.image.data() + rva))
+			{
+				matchRvas.push_back(static_cast<uint32_t>(rva));
+			}
+		}
+		passed &= TEST_CHECK(result.numberOfMatches == static_cast<int>(matchRvas.size()));
+		passed &= TEST_CHECK(result.occurrence >= 1 && result.occurrence <= static_cast<int>(matchRvas.size()) && matchRvas[result.occurrence - 1] == result.newAnchorRva);
+		if (site.oldContinueOffset > 0)
+		{
+			// the instructions are the same in both builds.
+			passed &= TEST_CHECK(result.newContinueOffset == site.oldContinueOffset);
+		}
+		else
+		{
+			passed &= TEST_CHECK(result.newContinueOffset >= MIGRATION_TEST_HOOK_SIZE);
+		}
+		if (!passed)
+		{
+			printf("  site %s: old rva %X, expected new rva %X, found %X, score %d/%d, pattern \"%s\"\n", site.name.c_str(), site.oldAnchorRva, expectedNewAnchorRvas[i], 
+				   result.newAnchorRva, result.score, result.maxScore, result.patternAsString.c_str());
+		}
+	}
+	// the instructions of the end of the function before the removed one still match, but that mustn't be reported as a clear match.
+	const MigrationResult& removedResult = results.back();
+	TEST_CHECK(!removedResult.found || removedResult.isAmbiguous || (removedResult.score * 2 <= removedResult.maxScore));
+}
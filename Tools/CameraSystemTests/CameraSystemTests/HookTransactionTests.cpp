@@ -0,0 +1,238 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Tests of HookTransaction on scratch code pages of this process, patched with the backend of the platform: a transaction over several pages,
+// the rollback when a page can't be made writable, the rollback of a transaction which isn't committed and the uninstall of committed
+// patches, which has to skip a patch changed by someone else. The scratch code is called after every step, so the instruction cache flush is
+// tested too, and the pages have to be executable and not writable again after every write.
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "TestRunner.h"
+#include "HookTransaction.h"
+#include "MemorySource.h"
+#ifdef _WIN32
+	#include <windows.h>
+#endif
+#ifdef __linux__
+	#include <sys/mman.h>
+#endif
+
+using namespace std;
+using namespace IGCS;
+
+#define HOOK_TEST_PAGE_SIZE				0x1000
+#define HOOK_TEST_NUMBER_OF_PAGES		3
+
+#ifdef _WIN32
+	typedef VirtualProtectPatchBackend PlatformPatchBackend;
+	typedef VirtualQueryMemorySource PlatformMemorySource;
+#endif
+#ifdef __linux__
+	typedef MprotectPatchBackend PlatformPatchBackend;
+	typedef ProcMapsMemorySource PlatformMemorySource;
+#endif
+
+typedef int (*ScratchFunction)();
+
+// The backend of the platform which can be told to fail making a page writable, and which counts the calls made.
+class TestPatchBackend : public PlatformPatchBackend
+{
+public:
+	bool makePageWritable(uint8_t* pageStart, uint32_t& previousProtection) override
+	{
+		if (numberOfMakeWritableCalls++ == makeWritableCallToFail)
+		{
+			return false;
+		}
+		return PlatformPatchBackend::makePageWritable(pageStart, previousProtection);
+	}
+
+	void flushInstructionCache(const uint8_t* start, size_t size) override
+	{
+		numberOfFlushes++;
+		PlatformPatchBackend::flushInstructionCache(start, size);
+	}
+
+	int makeWritableCallToFail = -1;
+	int numberOfMakeWritableCalls = 0;
+	int numberOfFlushes = 0;
+};
+
+
+// Allocates the scratch pages and makes them read/execute, like the code pages of a loaded image.
+static uint8_t* allocateScratchCode(size_t size)
+{
+#ifdef _WIN32
+	return static_cast<uint8_t*>(VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+#else
+	void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return MAP_FAILED == memory ? nullptr : static_cast<uint8_t*>(memory);
+#endif
+}
+
+
+static void protectScratchCode(uint8_t* scratchCode, size_t size)
+{
+#ifdef _WIN32
+	DWORD previousProtection;
+	VirtualProtect(scratchCode, size, PAGE_EXECUTE_READ, &previousProtection);
+#else
+	mprotect(scratchCode, size, PROT_READ | PROT_EXEC);
+#endif
+}
+
+
+static void freeScratchCode(uint8_t* scratchCode, size_t size)
+{
+#ifdef _WIN32
+	VirtualFree(scratchCode, 0, MEM_RELEASE);
+#else
+	munmap(scratchCode, size);
+#endif
+}
+
+
+// Returns true if all scratch pages are executable and not writable, i.e. their protection was restored after a write.
+static bool isProtectedAsCode(const uint8_t* scratchCode, size_t size)
+{
+	const PlatformMemorySource memorySource;
+	vector<MemoryRegion> regions;
+	if (!memorySource.enumerateRegions(scratchCode, size, regions) || regions.empty())
+	{
+		return false;
+	}
+	for (auto& region : regions)
+	{
+		if (!region.isExecutable || region.isWritable)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+// Returns true if the scratch functions return the values specified.
+static bool returnValuesAre(const ScratchFunction functions[], int expected0, int expected1, int expected2)
+{
+	return functions[0]() == expected0 && functions[1]() == expected1 && functions[2]() == expected2;
+}
+
+
+void runHookTransactionTests()
+{
+	const size_t scratchSize = HOOK_TEST_NUMBER_OF_PAGES * HOOK_TEST_PAGE_SIZE;
+	uint8_t* scratchCode = allocateScratchCode(scratchSize);
+	if (!TEST_CHECK(nullptr != scratchCode))
+	{
+		return;
+	}
+	// three functions returning 1, 'mov eax, 1; ret'. The second one straddles the first and second page, so a patch of its immediate does too.
+	const vector<uint8_t> returnOne = parseBytes("B8 01 00 00 00 C3");
+	uint8_t* functionAddresses[] = { scratchCode, scratchCode + HOOK_TEST_PAGE_SIZE - 3, scratchCode + 2 * HOOK_TEST_PAGE_SIZE };
+	for (auto functionAddress : functionAddresses)
+	{
+		memcpy(functionAddress, returnOne.data(), returnOne.size());
+	}
+	protectScratchCode(scratchCode, scratchSize);
+	ScratchFunction functions[3];
+	for (int i = 0; i < 3; i++)
+	{
+		functions[i] = reinterpret_cast<ScratchFunction>(functionAddresses[i]);
+	}
+	TEST_CHECK(returnValuesAre(functions, 1, 1, 1));
+	const uint8_t immediateTwo[] = { 2, 0, 0, 0 };
+	const uint8_t immediateThree[] = { 3, 0, 0, 0 };
+	TestPatchBackend backend;
+
+	// a transaction over all pages: written with one flush, and rolled back.
+	{
+		HookTransaction transaction(backend);
+		TEST_CHECK(transaction.addPatch(functionAddresses[0] + 1, immediateTwo, sizeof(immediateTwo)));
+		TEST_CHECK(transaction.addPatch(functionAddresses[1] + 1, immediateTwo, sizeof(immediateTwo)));
+		TEST_CHECK(!transaction.addPatch(functionAddresses[0] + 3, immediateThree, sizeof(immediateThree)));		// overlaps the first patch
+		TEST_CHECK(transaction.addPatch(functionAddresses[2] + 1, immediateThree, sizeof(immediateThree)));
+		TEST_CHECK(transaction.numberOfPatches() == 3);
+		TEST_CHECK(transaction.apply());
+		TEST_CHECK(transaction.numberOfPages() == HOOK_TEST_NUMBER_OF_PAGES);
+		TEST_CHECK(backend.numberOfFlushes == 1);
+		TEST_CHECK(returnValuesAre(functions, 2, 2, 3));
+		TEST_CHECK(isProtectedAsCode(scratchCode, scratchSize));
+		TEST_CHECK(transaction.rollback());
+		TEST_CHECK(returnValuesAre(functions, 1, 1, 1));
+		TEST_CHECK(isProtectedAsCode(scratchCode, scratchSize));
+	}
+
+	// the second page can't be made writable: nothing is written and the protection of the first page is restored.
+	{
+		backend.numberOfMakeWritableCalls = 0;
+		backend.makeWritableCallToFail = 1;
+		HookTransaction transaction(backend);
+		transaction.addPatch(functionAddresses[0] + 1, immediateTwo, sizeof(immediateTwo));
+		transaction.addPatch(functionAddresses[2] + 1, immediateThree, sizeof(immediateThree));
+		TEST_CHECK(!transaction.apply());
+		TEST_CHECK(!transaction.errorDescription().empty());
+		TEST_CHECK(returnValuesAre(functions, 1, 1, 1));
+		TEST_CHECK(isProtectedAsCode(scratchCode, scratchSize));
+		backend.makeWritableCallToFail = -1;
+	}
+
+	// applied but not committed: rolled back by the destructor.
+	{
+		HookTransaction transaction(backend);
+		transaction.addPatch(functionAddresses[0] + 1, immediateTwo, sizeof(immediateTwo));
+		TEST_CHECK(transaction.apply());
+		TEST_CHECK(returnValuesAre(functions, 2, 1, 1));
+	}
+	TEST_CHECK(returnValuesAre(functions, 1, 1, 1));
+
+	// committed, then uninstalled after another transaction changed one of the patched sites, which therefore has to be skipped.
+	vector<CodePatch> installedPatches;
+	{
+		HookTransaction transaction(backend);
+		transaction.addPatch(functionAddresses[0] + 1, immediateTwo, sizeof(immediateTwo));
+		transaction.addPatch(functionAddresses[2] + 1, immediateThree, sizeof(immediateThree));
+		TEST_CHECK(transaction.apply());
+		transaction.commit();
+		installedPatches = transaction.patches();
+	}
+	TEST_CHECK(returnValuesAre(functions, 2, 1, 3));
+	{
+		HookTransaction otherTransaction(backend);
+		otherTransaction.addPatch(functionAddresses[2] + 1, immediateTwo, sizeof(immediateTwo));
+		TEST_CHECK(otherTransaction.apply());
+		otherTransaction.commit();
+	}
+	size_t numberOfPatchesSkipped = 0;
+	TEST_CHECK(uninstallCodePatches(backend, installedPatches, numberOfPatchesSkipped) == 1);
+	TEST_CHECK(numberOfPatchesSkipped == 1);
+	TEST_CHECK(returnValuesAre(functions, 1, 1, 2));
+	TEST_CHECK(isProtectedAsCode(scratchCode, scratchSize));
+	freeScratchCode(scratchCode, scratchSize);
+}
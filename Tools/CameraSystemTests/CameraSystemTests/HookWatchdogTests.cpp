@@ -0,0 +1,144 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Tests of HookWatchdog on a scratch buffer with sites of several lengths, among them sites shorter than a lane, exactly one lane and
+// a couple of bytes longer than one or two lanes: every byte of every site has to be detected as tampered, and be reported for the right site,
+// while the bytes around the sites, which the lanes of short sites also read, have to be ignored.
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "TestRunner.h"
+#include "HookWatchdog.h"
+
+using namespace std;
+using namespace IGCS;
+
+#define WATCHDOG_TEST_BUFFER_SIZE		0x4000
+#define WATCHDOG_TEST_FIRST_SITE		0x1000
+#define WATCHDOG_TEST_SITE_DISTANCE		0x100
+
+// The lengths of the sites watched, and the number of lanes a site of that length needs.
+static const size_t siteLengths[] = { 14, 14, 1, 16, 17, 31, 32, 33, 5, 14 };
+static const size_t lanesPerSite[] = { 1, 1, 1, 1, 2, 2, 2, 3, 1, 1 };
+
+
+// Creates the sites in the buffer specified, each with its own bytes, and writes the patched bytes of each site at its address.
+static vector<CodePatch> createSites(vector<uint8_t>& buffer)
+{
+	vector<CodePatch> toReturn;
+	for (size_t siteIndex = 0; siteIndex < sizeof(siteLengths) / sizeof(siteLengths[0]); siteIndex++)
+	{
+		CodePatch site;
+		site.address = buffer.data() + WATCHDOG_TEST_FIRST_SITE + siteIndex * WATCHDOG_TEST_SITE_DISTANCE;
+		for (size_t i = 0; i < siteLengths[siteIndex]; i++)
+		{
+			site.patchedBytes.push_back(static_cast<uint8_t>(siteIndex * 31 + i));
+			site.originalBytes.push_back(0xCC);
+		}
+		memcpy(site.address, site.patchedBytes.data(), site.patchedBytes.size());
+		toReturn.push_back(site);
+	}
+	return toReturn;
+}
+
+
+// Returns true if the watchdog reports exactly the sites specified as tampered.
+static bool tamperedSitesAre(const HookWatchdog& watchdog, const vector<size_t>& expectedSites)
+{
+	return !watchdog.verify() && watchdog.determineTamperedSites() == expectedSites;
+}
+
+
+void runHookWatchdogTests()
+{
+	vector<uint8_t> buffer(WATCHDOG_TEST_BUFFER_SIZE, 0xCC);
+	const vector<CodePatch> sites = createSites(buffer);
+	HookWatchdog watchdog;
+	TEST_CHECK(watchdog.verify());		// nothing watched yet
+	watchdog.watch(sites);
+	TEST_CHECK(watchdog.numberOfSites() == sites.size());
+	size_t expectedNumberOfLanes = 0;
+	for (auto numberOfLanes : lanesPerSite)
+	{
+		expectedNumberOfLanes += numberOfLanes;
+	}
+	TEST_CHECK(watchdog.numberOfLanes() == expectedNumberOfLanes);
+	TEST_CHECK(watchdog.verify());
+	TEST_CHECK(watchdog.determineTamperedSites().empty());
+
+	// the bytes right before and after each site aren't part of it.
+	for (auto& site : sites)
+	{
+		site.address[-1] ^= 0xFF;
+		site.address[site.patchedBytes.size()] ^= 0xFF;
+	}
+	TEST_CHECK(watchdog.verify());
+	for (auto& site : sites)
+	{
+		site.address[-1] ^= 0xFF;
+		site.address[site.patchedBytes.size()] ^= 0xFF;
+	}
+
+	// every byte of every site, one at a time, with a single bit changed.
+	for (size_t siteIndex = 0; siteIndex < sites.size(); siteIndex++)
+	{
+		for (size_t i = 0; i < sites[siteIndex].patchedBytes.size(); i++)
+		{
+			sites[siteIndex].address[i] ^= 0x10;
+			if (!TEST_CHECK(tamperedSitesAre(watchdog, { siteIndex })))
+			{
+				printf("  site %zu, byte %zu\n", siteIndex, i);
+			}
+			sites[siteIndex].address[i] ^= 0x10;
+		}
+	}
+	TEST_CHECK(watchdog.verify());
+
+	// several sites at once, the 33 byte site in its first and last lane, which has to be reported once.
+	sites[1].address[0] = 0x90;
+	sites[7].address[0] = 0x90;
+	sites[7].address[32] = 0x90;
+	sites[9].address[13] = 0x90;
+	TEST_CHECK(tamperedSitesAre(watchdog, { 1, 7, 9 }));
+	memcpy(sites[1].address, sites[1].patchedBytes.data(), sites[1].patchedBytes.size());
+	memcpy(sites[7].address, sites[7].patchedBytes.data(), sites[7].patchedBytes.size());
+	memcpy(sites[9].address, sites[9].patchedBytes.data(), sites[9].patchedBytes.size());
+	TEST_CHECK(watchdog.verify());
+
+	// watching other sites replaces the table: a change of a site which isn't watched anymore isn't reported, and sites watched again are.
+	watchdog.watch({ sites[2], sites[5] });
+	TEST_CHECK(watchdog.numberOfSites() == 2);
+	TEST_CHECK(watchdog.numberOfLanes() == lanesPerSite[2] + lanesPerSite[5]);
+	TEST_CHECK(watchdog.site(1).address == sites[5].address);
+	sites[0].address[0] = 0x90;
+	TEST_CHECK(watchdog.verify());
+	sites[5].address[30] = 0x90;
+	TEST_CHECK(tamperedSitesAre(watchdog, { 1 }));
+	watchdog.watch({});
+	TEST_CHECK(watchdog.numberOfLanes() == 0);
+	TEST_CHECK(watchdog.verify());
+}
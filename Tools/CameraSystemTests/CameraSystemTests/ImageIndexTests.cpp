@@ -0,0 +1,218 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Tests of the ImageIndex: random queries, with wildcards, have to find exactly the locations a byte by byte search of the indexed ranges finds,
+// whether the index is used or the pattern's runs are too short for it and the ranges are scanned instead. Matches which cross the end of
+// a range, into a hole which isn't indexed, must not be found.
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "TestRunner.h"
+#include "ImageIndex.h"
+#include "ScanPattern.h"
+
+using namespace std;
+using namespace IGCS;
+
+#define INDEX_TEST_IMAGE_SIZE				(3 * 1024 * 1024)
+#define INDEX_TEST_NUMBER_OF_QUERIES		400
+#define INDEX_TEST_MAX_PATTERN_LENGTH		16
+
+// Bytes which are common in x64 code. The image is mostly made of these, so short patterns have many matches, like they have in real code.
+static const uint8_t commonCodeBytes[] = { 0x00, 0x48, 0x8B, 0x89, 0x0F, 0xE8, 0xFF, 0xC3, 0x24, 0x44 };
+
+
+static vector<uint8_t> createImage(mt19937& generator)
+{
+	vector<uint8_t> toReturn(INDEX_TEST_IMAGE_SIZE);
+	uniform_int_distribution<int> byteDistribution(0, 255);
+	uniform_int_distribution<int> commonByteDistribution(0, sizeof(commonCodeBytes) - 1);
+	for (auto& imageByte : toReturn)
+	{
+		const int value = byteDistribution(generator);
+		imageByte = value < 180 ? commonCodeBytes[commonByteDistribution(generator)] : static_cast<uint8_t>(value);
+	}
+	return toReturn;
+}
+
+
+// Ranges with holes between them and starts which aren't a multiple of the sample stride, passed in an order the index has to sort.
+static vector<AOBScanRange> createRanges(const vector<uint8_t>& image)
+{
+	return { { image.data() + 1024 * 1024 + 3, 1024 * 1024 - 4099 },
+			 { image.data() + 17, 512 * 1024 },
+			 { image.data() + 2 * 1024 * 1024 + 1, INDEX_TEST_IMAGE_SIZE - 2 * 1024 * 1024 - 1 } };
+}
+
+
+// A query made from the bytes at a random location of the image, so it has at least that match if the location is in a range, with 
+// random bytes replaced by wildcards. Every 4th query has random bytes, which mostly match nowhere.
+static string createQuery(const vector<uint8_t>& image, mt19937& generator, int queryNumber)
+{
+	uniform_int_distribution<size_t> locationDistribution(0, image.size() - INDEX_TEST_MAX_PATTERN_LENGTH);
+	uniform_int_distribution<int> lengthDistribution(2, INDEX_TEST_MAX_PATTERN_LENGTH);
+	uniform_int_distribution<int> percentageDistribution(0, 99);
+	uniform_int_distribution<int> byteDistribution(0, 255);
+	const size_t location = locationDistribution(generator);
+	const int length = lengthDistribution(generator);
+	const int wildcardPercentage = percentageDistribution(generator) / 4;
+	string toReturn;
+	char byteAsString[4];
+	for (int i = 0; i < length; i++)
+	{
+		if (i > 0 && i < length - 1 && percentageDistribution(generator) < wildcardPercentage)
+		{
+			toReturn += "?? ";
+			continue;
+		}
+		const uint8_t patternByte = (queryNumber % 4 == 3) ? static_cast<uint8_t>(byteDistribution(generator)) : image[location + i];
+		snprintf(byteAsString, sizeof(byteAsString), "%02X ", patternByte);
+		toReturn += byteAsString;
+	}
+	return toReturn;
+}
+
+
+// The reference: every location in the ranges the complete pattern matches at, one by one.
+static vector<const uint8_t*> findAllMatches(vector<AOBScanRange> ranges, const ScanPattern& pattern)
+{
+	sort(ranges.begin(), ranges.end(), [](const AOBScanRange& a, const AOBScanRange& b) { return a.start < b.start; });
+	vector<const uint8_t*> toReturn;
+	for (auto& range : ranges)
+	{
+		for (size_t offset = 0; offset + pattern.patternSize() <= range.size; offset++)
+		{
+			if (pattern.matchesAt(range.start + offset))
+			{
+				toReturn.push_back(range.start + offset);
+			}
+		}
+	}
+	return toReturn;
+}
+
+
+static int longestRunOfNonWildcards(const ScanPattern& pattern)
+{
+	int longestRunLength = 0;
+	int runLength = 0;
+	for (int i = 0; i < pattern.patternSize(); i++)
+	{
+		runLength = pattern.patternMask()[i] == 0xFF ? runLength + 1 : 0;
+		longestRunLength = runLength > longestRunLength ? runLength : longestRunLength;
+	}
+	return longestRunLength;
+}
+
+
+static void testRandomQueries()
+{
+	mt19937 generator(2077);
+	vector<uint8_t> image = createImage(generator);
+	const vector<AOBScanRange> ranges = createRanges(image);
+	ImageIndex index;
+	index.build(ranges);
+	size_t numberOfBytesInRanges = 0;
+	for (auto& range : ranges)
+	{
+		numberOfBytesInRanges += range.size;
+	}
+	TEST_CHECK(index.numberOfIndexedBytes() == numberOfBytesInRanges);
+	TEST_CHECK(index.memoryUsageInBytes() >= index.numberOfIndexedGrams() * sizeof(uint32_t) + IMAGE_INDEX_NUMBER_OF_BUCKETS * sizeof(uint32_t));
+
+	int numberOfQueriesWithIndex = 0;
+	int numberOfQueriesWithMatches = 0;
+	int numberOfFailedQueries = 0;
+	for (int queryNumber = 0; queryNumber < INDEX_TEST_NUMBER_OF_QUERIES; queryNumber++)
+	{
+		const string patternAsString = createQuery(image, generator, queryNumber);
+		const ScanPattern pattern(patternAsString, 1);
+		const vector<const uint8_t*> expectedLocations = findAllMatches(ranges, pattern);
+		ImageIndexQueryResult result;
+		index.findAll(pattern, result);
+		vector<const uint8_t*> scannedLocations;
+		ImageIndex::findAllByScanning(ranges, pattern, scannedLocations);
+		const bool usedIndexAsExpected = result.usedIndex == (longestRunOfNonWildcards(pattern) >= IMAGE_INDEX_MIN_RUN_LENGTH);
+		if (!usedIndexAsExpected || result.locations != expectedLocations || scannedLocations != expectedLocations)
+		{
+			numberOfFailedQueries++;
+			printf("  query '%s': %zu location(s) found with the index, %zu by scanning, %zu expected.\n", patternAsString.c_str(), result.locations.size(), 
+				   scannedLocations.size(), expectedLocations.size());
+		}
+		numberOfQueriesWithIndex += result.usedIndex ? 1 : 0;
+		numberOfQueriesWithMatches += expectedLocations.empty() ? 0 : 1;
+	}
+	TEST_CHECK(0 == numberOfFailedQueries);
+	// the queries have to cover both ways of finding the locations, and both queries with and without matches.
+	TEST_CHECK(numberOfQueriesWithIndex > INDEX_TEST_NUMBER_OF_QUERIES / 4);
+	TEST_CHECK(numberOfQueriesWithIndex < INDEX_TEST_NUMBER_OF_QUERIES);
+	TEST_CHECK(numberOfQueriesWithMatches > INDEX_TEST_NUMBER_OF_QUERIES / 2);
+	TEST_CHECK(numberOfQueriesWithMatches < INDEX_TEST_NUMBER_OF_QUERIES);
+}
+
+
+// A pattern planted over the end of a range, partly in the hole after it, and a copy of it inside the range: only the copy may be found.
+static void testMatchesAcrossRangeEnds()
+{
+	mt19937 generator(1);
+	vector<uint8_t> image = createImage(generator);
+	const vector<AOBScanRange> ranges = createRanges(image);
+	const vector<uint8_t> plantedBytes = parseBytes("D9 5A 71 3C 0E B6 2F 91 77 A4 6D 13");
+	const ScanPattern pattern("D9 5A 71 3C 0E B6 2F ?? 77 A4 6D 13", 1);
+	for (auto& range : ranges)
+	{
+		uint8_t* rangeEnd = image.data() + (range.start - image.data()) + range.size;
+		copy(plantedBytes.begin(), plantedBytes.end(), rangeEnd - 5);
+	}
+	uint8_t* copyInRange = image.data() + (ranges[0].start - image.data()) + 4096 + 2;
+	copy(plantedBytes.begin(), plantedBytes.end(), copyInRange);
+
+	ImageIndex index;
+	index.build(ranges);
+	ImageIndexQueryResult result;
+	index.findAll(pattern, result);
+	TEST_CHECK(result.usedIndex);
+	TEST_CHECK(result.locations == vector<const uint8_t*>{ copyInRange });
+	TEST_CHECK(result.locations == findAllMatches(ranges, pattern));
+	// a malformed pattern and an empty index find nothing.
+	index.findAll(ScanPattern("D9 5A 7", 1), result);
+	TEST_CHECK(result.locations.empty());
+	ImageIndex emptyIndex;
+	emptyIndex.build({});
+	emptyIndex.findAll(pattern, result);
+	TEST_CHECK(result.locations.empty());
+	TEST_CHECK(0 == emptyIndex.numberOfIndexedBytes());
+}
+
+
+void runImageIndexTests()
+{
+	testRandomQueries();
+	testMatchesAcrossRangeEnds();
+}
@@ -0,0 +1,461 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Tests of the InterceptorStubBuilder: the stubs of the interceptors of the camera are generated for their hook sites and decoded again. A
+// stub has to contain every overwritten instruction as often as it's executed on the paths of the stub, with its branches and rip relative
+// operands relocated, the captures, the hit counter and the skip checks, and has to end with the jump to the continue address. Descriptors
+// which can't be generated have to be rejected. On x64 Linux stubs are also executed, hooked into scratch functions, to check the flags 
+// the game's code set survive the stub, and the captures and skipped instructions.
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "TestRunner.h"
+#include "InterceptorStubBuilder.h"
+#include "X64InstructionDecoder.h"
+#include "AOBPatterns.h"
+#if defined(__linux__) && defined(__x86_64__)
+	#include <sys/mman.h>
+#endif
+
+using namespace std;
+using namespace IGCS;
+using namespace IGCS::GameSpecific;
+
+#define STUB_TEST_HOOK_SIZE			14
+#define STUB_TEST_STUB_DISTANCE		0x10000000		// the distance between a hook site and its stub.
+#define STUB_TEST_SITE_BUFFER_SIZE	0x100
+
+// The fields the interceptors store their captures in, like the control block of the camera.
+struct TestControlBlock
+{
+	uint8_t cameraEnabled = 0;
+	uint8_t* activeCamStructAddress = nullptr;
+	uint8_t* pmStructAddress = nullptr;
+	uint8_t* resolutionStructAddress = nullptr;
+	uint8_t* todStructAddress = nullptr;
+	uint8_t* playHudWidgetAddress = nullptr;
+	uint8_t* pmHudWidgetAddress = nullptr;
+	uint8_t* timestopStructAddress = nullptr;
+};
+
+static TestControlBlock testControlBlock;
+static uint64_t testHitCounter = 0;
+
+// A hook site of the game with the descriptor of its interceptor, both as in InterceptorHelper.cpp.
+struct StubSite
+{
+	const char* bytes;
+	InterceptorDescriptor descriptor;
+};
+
+static const StubSite stubSites[] =
+{
+	{ "FF 90 58 02 00 00 F3 0F 11 46 20 48 8D 54 24 20 48 8B 03", 
+	  { .blockName = ACTIVECAM_ADDRESS_INTERCEPT_KEY, .captureBefore = { &testControlBlock.activeCamStructAddress, X64Register::Rcx }, .captureAfter = {} } },
+	{ "F2 0F 11 83 E0 00 00 00 0F 28 44 24 30 89 8B E8 00 00 00 0F 11 83 F0 00 00 00 80 BB B1 00 00 00 00", 
+	  { .blockName = ACTIVECAM_CAMERA_WRITE1_INTERCEPT_KEY, .continueOffset = 0x1A, .captureBefore = {}, .captureAfter = {}, 
+		.instructionsSkippedWhileCameraEnabled = 0b1101, .skipOnlyIfRegisterEquals = &testControlBlock.activeCamStructAddress, .skipConditionRegister = X64Register::Rbx } },
+	{ "49 8B 4E 40 48 8D 95 90 00 00 00 41 88 9E FB 02 00 00 E8 63 77 FF FF", 
+	  { .blockName = PMSTRUCT_ADDRESS_INTERCEPT_KEY, .captureBefore = { &testControlBlock.pmStructAddress, X64Register::R14 }, .captureAfter = {} } },
+	{ "F3 0F 11 9F 5C 02 00 00 48 8B 8F B0 01 00 00 0F 2E 59 40", 
+	  { .blockName = FOV_PLAY_WRITE_INTERCEPT_KEY, .captureBefore = {}, .captureAfter = {}, .instructionsSkippedWhileCameraEnabled = 0b1 } },
+	{ "8B 81 84 00 00 00 89 41 44 8B 81 88 00 00 00 89 41 40 8B 81 8C 00 00 00", 
+	  { .blockName = RESOLUTION_STRUCT_ADDRESS_INTERCEPT_KEY, .continueOffset = 0x12, .captureBefore = { &testControlBlock.resolutionStructAddress, X64Register::Rbx }, .captureAfter = {} } },
+	{ "48 8B DA 48 8B 01 FF 90 F8 00 00 00 48 8B C3 48 83 C4 20", 
+	  { .blockName = TOD_READ_INTERCEPT_KEY, .captureBefore = { &testControlBlock.todStructAddress, X64Register::Rcx }, .captureAfter = {} } },
+	{ "88 81 B1 00 00 00 48 89 BC 24 98 00 00 00 48 8B 7C 24 20 48 83 7F 40 00", 
+	  { .blockName = PLAY_WIDGETBUCKET_READ_INTERCEPT_KEY, .continueOffset = 0x13, .captureBefore = {}, 
+		.captureAfter = { &testControlBlock.playHudWidgetAddress, X64Register::Rdi, true, 0x40 } } },
+	{ "74 0A 80 7A 40 00 74 04 B3 01 EB 02 32 DB 48 8B 49 40 0F B6 D3", 
+	  { .blockName = PM_WIDGETBUCKET_READ_INTERCEPT_KEY, .continueOffset = 0x12, .captureBefore = {}, .captureAfter = { &testControlBlock.pmHudWidgetAddress, X64Register::Rcx } } },
+	{ "44 8B 49 1C 48 85 D2 75 07 45 85 C9 0F 95 C0 C3 45 33 C0", 
+	  { .blockName = TIMESTOP_STRUCT_INTERCEPT_KEY, .continueOffset = 0x10, .captureBefore = { &testControlBlock.timestopStructAddress, X64Register::Rcx }, .captureAfter = {} } },
+};
+
+
+// A decoded instruction of a hook site or a stub, with the address it refers to if it's a branch or has a rip relative operand.
+struct DecodedInstruction
+{
+	const uint8_t* bytes;
+	X64Instruction decoded;
+	uintptr_t target;
+};
+
+
+// Decodes the instructions in code, which is placed at address, up to size bytes. Returns false if an instruction doesn't decode.
+static bool decodeInstructions(const uint8_t* code, size_t size, uintptr_t address, vector<DecodedInstruction>& instructions)
+{
+	size_t offset = 0;
+	while (offset < size)
+	{
+		DecodedInstruction instruction{ code + offset, {}, 0 };
+		if (!X64InstructionDecoder::decode(code + offset, size - offset, instruction.decoded))
+		{
+			return false;
+		}
+		const uint8_t* target = instruction.decoded.isRelativeBranch ? X64InstructionDecoder::determineBranchTarget(code + offset, instruction.decoded)
+																	 : X64InstructionDecoder::determineRipRelativeTarget(code + offset, instruction.decoded);
+		if (nullptr != target)
+		{
+			instruction.target = reinterpret_cast<uintptr_t>(target) - reinterpret_cast<uintptr_t>(code) + address;
+		}
+		instructions.push_back(instruction);
+		offset += instruction.decoded.length;
+	}
+	return true;
+}
+
+
+// Returns the kind of a relative branch: 0x100 for call, 0x200 for jmp and the condition code for jcc, as short branches are copied as long ones.
+static int determineBranchKind(const DecodedInstruction& instruction)
+{
+	const uint8_t opcode = instruction.decoded.opcode;
+	if (instruction.decoded.opcodeMap == 0 && opcode == 0xE8)
+	{
+		return 0x100;
+	}
+	if (instruction.decoded.opcodeMap == 0 && (opcode == 0xE9 || opcode == 0xEB))
+	{
+		return 0x200;
+	}
+	return opcode & 0x0F;
+}
+
+
+// Returns the number of times the stub contains the 10 byte mov of the value specified into a register.
+static int countMovesOfImmediate(const vector<DecodedInstruction>& stubInstructions, const void* value)
+{
+	const uint64_t immediate = reinterpret_cast<uintptr_t>(value);
+	int toReturn = 0;
+	for (auto& instruction : stubInstructions)
+	{
+		if (instruction.decoded.length == 10 && (instruction.bytes[0] & 0xF8) == 0x48 && (instruction.bytes[1] & 0xF8) == 0xB8 && 
+			0 == memcmp(instruction.bytes + 2, &immediate, sizeof(immediate)))
+		{
+			toReturn++;
+		}
+	}
+	return toReturn;
+}
+
+
+// Returns true if the instruction of the stub is a copy of the overwritten instruction specified: the same bytes, or for a branch or rip 
+// relative operand, the same kind of instruction referring to the same address. A branch to an overwritten instruction has to refer to a copy
+// of that instruction in the stub instead, and a branch to the continue address to the stub.
+static bool isCopyOf(const DecodedInstruction& instruction, uintptr_t stubAddress, const vector<uint8_t>& stubCode, const DecodedInstruction& original, 
+					 const uint8_t* hookAddress, uint32_t continueOffset)
+{
+	if (original.decoded.isRipRelative)
+	{
+		return instruction.decoded.isRipRelative && instruction.decoded.length == original.decoded.length && instruction.target == original.target;
+	}
+	if (!original.decoded.isRelativeBranch)
+	{
+		return instruction.decoded.length == original.decoded.length && 0 == memcmp(instruction.bytes, original.bytes, original.decoded.length);
+	}
+	if (!instruction.decoded.isRelativeBranch || determineBranchKind(instruction) != determineBranchKind(original))
+	{
+		return false;
+	}
+	const uintptr_t hookStart = reinterpret_cast<uintptr_t>(hookAddress);
+	if (original.target < hookStart || original.target > hookStart + continueOffset)
+	{
+		return instruction.target == original.target;
+	}
+	if (instruction.target < stubAddress || instruction.target >= stubAddress + stubCode.size())
+	{
+		return false;
+	}
+	if (original.target == hookStart + continueOffset)
+	{
+		return true;
+	}
+	// the instruction branched to, which isn't a branch itself in the hook sites.
+	X64Instruction branchedTo;
+	const uint8_t* originalBranchedTo = hookAddress + (original.target - hookStart);
+	return X64InstructionDecoder::decode(originalBranchedTo, continueOffset - (original.target - hookStart), branchedTo) &&
+		   instruction.target + branchedTo.length <= stubAddress + stubCode.size() &&
+		   0 == memcmp(stubCode.data() + (instruction.target - stubAddress), originalBranchedTo, branchedTo.length);
+}
+
+
+static bool checkStub(const StubSite& site)
+{
+	const InterceptorDescriptor& descriptor = site.descriptor;
+	vector<uint8_t> siteBuffer(STUB_TEST_SITE_BUFFER_SIZE, 0xCC);
+	const vector<uint8_t> siteBytes = parseBytes(site.bytes);
+	memcpy(siteBuffer.data(), siteBytes.data(), siteBytes.size());
+	const uint8_t* hookAddress = siteBuffer.data();
+	const uint32_t continueOffset = 0 != descriptor.continueOffset ? descriptor.continueOffset 
+																   : X64InstructionDecoder::determineInstructionSpan(hookAddress, siteBytes.size(), STUB_TEST_HOOK_SIZE);
+	const uintptr_t stubAddress = reinterpret_cast<uintptr_t>(hookAddress) + STUB_TEST_STUB_DISTANCE;
+	vector<uint8_t> stubCode;
+	string errorDescription;
+	bool passed = TEST_CHECK(InterceptorStubBuilder::buildStub(descriptor, hookAddress, continueOffset, &testControlBlock.cameraEnabled, &testHitCounter, 
+															   stubAddress, stubCode, errorDescription));
+	passed &= TEST_CHECK(errorDescription.empty());
+	// the stub ends with jmp qword ptr [rip+0] and the continue address, all bytes before it have to be instructions.
+	if (!TEST_CHECK(passed && stubCode.size() > STUB_TEST_HOOK_SIZE))
+	{
+		return false;
+	}
+	const size_t instructionsSize = stubCode.size() - sizeof(uint64_t);
+	vector<DecodedInstruction> stubInstructions;
+	passed &= TEST_CHECK(decodeInstructions(stubCode.data(), instructionsSize, stubAddress, stubInstructions));
+	passed &= TEST_CHECK(0 == memcmp(stubCode.data() + stubCode.size() - STUB_TEST_HOOK_SIZE, parseBytes("FF 25 00 00 00 00").data(), 6));
+	uint64_t continueAddress;
+	memcpy(&continueAddress, stubCode.data() + instructionsSize, sizeof(continueAddress));
+	passed &= TEST_CHECK(continueAddress == reinterpret_cast<uintptr_t>(hookAddress + continueOffset));
+
+	// without skipped instructions, every overwritten instruction is copied once. With skipped ones, an instruction is also copied for the
+	// path of the enabled camera, unless it's skipped.
+	vector<DecodedInstruction> overwrittenInstructions;
+	passed &= TEST_CHECK(decodeInstructions(hookAddress, continueOffset, reinterpret_cast<uintptr_t>(hookAddress), overwrittenInstructions));
+	// Overwritten instructions which are the same after relocation, e.g. two je's to the same instruction, can't be told apart in the stub, so 
+	// their copies are counted together.
+	const uint32_t skipMask = descriptor.instructionsSkippedWhileCameraEnabled;
+	vector<int> numberOfCopiesPerInstruction;
+	for (size_t i = 0; i < overwrittenInstructions.size(); i++)
+	{
+		numberOfCopiesPerInstruction.push_back((0 == skipMask || 0 != (skipMask & (1u << i))) ? 1 : 2);
+	}
+	for (size_t i = 0; i < overwrittenInstructions.size(); i++)
+	{
+		const DecodedInstruction& original = overwrittenInstructions[i];
+		int expectedNumberOfCopies = 0;
+		for (size_t j = 0; j < overwrittenInstructions.size(); j++)
+		{
+			const DecodedInstruction& other = overwrittenInstructions[j];
+			const bool isSameInstruction = original.decoded.isRelativeBranch || original.decoded.isRipRelative
+											? other.decoded.isRelativeBranch == original.decoded.isRelativeBranch && other.target == original.target && 
+											  (!original.decoded.isRelativeBranch || determineBranchKind(other) == determineBranchKind(original))
+											: other.decoded.length == original.decoded.length && 0 == memcmp(other.bytes, original.bytes, original.decoded.length);
+			expectedNumberOfCopies += isSameInstruction ? numberOfCopiesPerInstruction[j] : 0;
+		}
+		int numberOfCopies = 0;
+		for (auto& instruction : stubInstructions)
+		{
+			numberOfCopies += isCopyOf(instruction, stubAddress, stubCode, original, hookAddress, continueOffset);
+		}
+		if (!TEST_CHECK(numberOfCopies == expectedNumberOfCopies))
+		{
+			printf("  overwritten instruction %zu: ", i);
+			printBytes(overwrittenInstructions[i].bytes, overwrittenInstructions[i].decoded.length);
+			passed = false;
+		}
+	}
+
+	// the hit counter is incremented with the arithmetic flags saved in rax: lahf; seto al ... add al, 7F; sahf.
+	passed &= TEST_CHECK(countMovesOfImmediate(stubInstructions, &testHitCounter) == 1);
+	passed &= TEST_CHECK(stubCode.size() > 8 && 0 == memcmp(stubCode.data(), parseBytes("50 9F 0F 90 C0").data(), 5));
+	const vector<uint8_t> flagsRestore = parseBytes("04 7F 9E 58");
+	passed &= TEST_CHECK(search(stubCode.begin(), stubCode.end(), flagsRestore.begin(), flagsRestore.end()) != stubCode.end());
+	if (nullptr != descriptor.captureBefore.destination)
+	{
+		passed &= TEST_CHECK(countMovesOfImmediate(stubInstructions, descriptor.captureBefore.destination) == 1);
+	}
+	if (nullptr != descriptor.captureAfter.destination)
+	{
+		passed &= TEST_CHECK(countMovesOfImmediate(stubInstructions, descriptor.captureAfter.destination) == 1);
+	}
+	passed &= TEST_CHECK(countMovesOfImmediate(stubInstructions, &testControlBlock.cameraEnabled) == (0 != skipMask ? 1 : 0));
+	if (nullptr != descriptor.skipOnlyIfRegisterEquals)
+	{
+		passed &= TEST_CHECK(countMovesOfImmediate(stubInstructions, descriptor.skipOnlyIfRegisterEquals) == 1);
+	}
+	return passed;
+}
+
+
+static void testStubsOfInterceptors()
+{
+	for (auto& site : stubSites)
+	{
+		if (!checkStub(site))
+		{
+			printf("  interceptor: %s\n", site.descriptor.blockName);
+		}
+	}
+}
+
+
+// Returns true if buildStub rejects the descriptor for the hook site specified with an error description.
+static bool isRejected(const char* siteBytes, uint32_t continueOffset, const InterceptorDescriptor& descriptor)
+{
+	const vector<uint8_t> bytes = parseBytes(siteBytes);
+	vector<uint8_t> stubCode;
+	string errorDescription;
+	const bool result = InterceptorStubBuilder::buildStub(descriptor, bytes.data(), continueOffset, &testControlBlock.cameraEnabled, nullptr, 
+														  reinterpret_cast<uintptr_t>(bytes.data()) + STUB_TEST_STUB_DISTANCE, stubCode, errorDescription);
+	return !result && !errorDescription.empty() && stubCode.empty();
+}
+
+
+static void testRejectedDescriptors()
+{
+	// mov rbx,rdx; mov rax,[rcx]; call [rax+F8]; mov rax,rbx; add rsp,20
+	const char* todSite = "48 8B DA 48 8B 01 FF 90 F8 00 00 00 48 8B C3 48 83 C4 20";
+	// the continue offset in the middle of the call.
+	TEST_CHECK(isRejected(todSite, 0x0A, {}));
+	// instructions skipped which aren't overwritten: the hook overwrites 4 instructions.
+	TEST_CHECK(isRejected(todSite, 0x0F, { .captureBefore = {}, .captureAfter = {}, .instructionsSkippedWhileCameraEnabled = 0b10000 }));
+	// rsp itself can't be captured, nor be the skip condition register.
+	TEST_CHECK(isRejected(todSite, 0x0F, { .captureBefore = { &testControlBlock.todStructAddress, X64Register::Rsp }, .captureAfter = {} }));
+	TEST_CHECK(isRejected(todSite, 0x0F, { .captureBefore = {}, .captureAfter = {}, .instructionsSkippedWhileCameraEnabled = 0b1, .skipConditionRegister = X64Register::Rsp }));
+	// jmp +1, into the middle of the mov after it.
+	TEST_CHECK(isRejected("EB 01 48 8B 01 48 8B 01 48 8B 01 48 8B 01 90", 0x0F, {}));
+	// jrcxz can't be relocated.
+	TEST_CHECK(isRejected("E3 02 48 8B 01 48 8B 01 48 8B 01 48 8B 01 90", 0x0F, {}));
+}
+
+
+#if defined(__linux__) && defined(__x86_64__)
+// Hooks the code specified, copied to scratch code pages, at hookOffset with a stub generated for the descriptor and returns the address of the 
+// code, or nullptr if that failed. The stub is placed on the page after the code. The pages are unmapped with unmapScratchCode.
+static uint8_t* hookScratchCode(const char* codeBytes, uint32_t hookOffset, uint32_t continueOffset, const InterceptorDescriptor& descriptor, 
+								uint64_t* hitCounter)
+{
+	uint8_t* scratchCode = static_cast<uint8_t*>(mmap(nullptr, 0x2000, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+	if (MAP_FAILED == scratchCode)
+	{
+		return nullptr;
+	}
+	const vector<uint8_t> code = parseBytes(codeBytes);
+	memcpy(scratchCode, code.data(), code.size());
+	uint8_t* hookAddress = scratchCode + hookOffset;
+	uint8_t* stubAddress = scratchCode + 0x1000;
+	vector<uint8_t> stubCode;
+	string errorDescription;
+	if (!InterceptorStubBuilder::buildStub(descriptor, hookAddress, continueOffset, &testControlBlock.cameraEnabled, hitCounter, 
+										   reinterpret_cast<uintptr_t>(stubAddress), stubCode, errorDescription))
+	{
+		printf("  %s\n", errorDescription.c_str());
+		munmap(scratchCode, 0x2000);
+		return nullptr;
+	}
+	memcpy(stubAddress, stubCode.data(), stubCode.size());
+	// jmp qword ptr [rip+0] to the stub.
+	memcpy(hookAddress, parseBytes("FF 25 00 00 00 00").data(), 6);
+	memcpy(hookAddress + 6, &stubAddress, sizeof(stubAddress));
+	mprotect(scratchCode, 0x2000, PROT_READ | PROT_EXEC);
+	return scratchCode;
+}
+
+
+static void unmapScratchCode(uint8_t* scratchCode)
+{
+	munmap(scratchCode, 0x2000);
+}
+
+
+// The flags are set from rdi, the hook replays 14 nops and the flags are returned afterwards. The hit counter is incremented in the stub, 
+// which mustn't change any of the arithmetic flags.
+static void testFlagsAreKept()
+{
+	// push rdi; popfq; <14 nops, hooked>; pushfq; pop rax; ret
+	uint8_t* scratchCode = hookScratchCode("57 9D 90 90 90 90 90 90 90 90 90 90 90 90 90 90 9C 58 C3", 2, 14, {}, &testHitCounter);
+	if (!TEST_CHECK(nullptr != scratchCode))
+	{
+		return;
+	}
+	auto function = reinterpret_cast<uint64_t(*)(uint64_t)>(scratchCode);
+	// carry, parity, auxiliary carry, zero, sign and overflow.
+	const uint64_t flagBits[] = { 0x1, 0x4, 0x10, 0x40, 0x80, 0x800 };
+	const uint64_t arithmeticFlagsMask = 0x8D5;
+	testHitCounter = 0;
+	int numberOfFlagCombinationsKept = 0;
+	for (int combination = 0; combination < 64; combination++)
+	{
+		uint64_t flags = 0x202;
+		for (int bit = 0; bit < 6; bit++)
+		{
+			if (0 != (combination & (1 << bit)))
+			{
+				flags |= flagBits[bit];
+			}
+		}
+		numberOfFlagCombinationsKept += (function(flags) & arithmeticFlagsMask) == (flags & arithmeticFlagsMask);
+	}
+	TEST_CHECK(numberOfFlagCombinationsKept == 64);
+	TEST_CHECK(testHitCounter == 64);
+	unmapScratchCode(scratchCode);
+}
+
+
+// uint64_t function(uint64_t* values, uint64_t value) stores value in values[1] in the hooked code, unless the store is skipped, and returns 
+// values[1] + 0x10, or + 0x11 if value is 0, decided by a jne over an inc in the hooked code, with the flags of a test before the hook.
+static void testCapturesAndSkips()
+{
+	// mov rcx,rdi; test rsi,rsi; <hook: mov [rcx+8],rsi; mov rax,[rcx+8]; jne cont; inc rax; nop>; cont: add rax,10; ret
+	uint8_t* capturedBefore = nullptr;
+	uint8_t* capturedAfter = nullptr;
+	uint8_t* cameraStructAddress = nullptr;
+	const InterceptorDescriptor descriptor = { .continueOffset = 14, .captureBefore = { &capturedBefore, X64Register::Rcx }, 
+											   .captureAfter = { &capturedAfter, X64Register::Rcx, true, 8 }, .instructionsSkippedWhileCameraEnabled = 0b1,
+											   .skipOnlyIfRegisterEquals = &cameraStructAddress, .skipConditionRegister = X64Register::Rcx };
+	uint8_t* scratchCode = hookScratchCode("48 89 F9 48 85 F6 48 89 71 08 48 8B 41 08 75 04 48 FF C0 90 48 83 C0 10 C3", 6, 14, descriptor, &testHitCounter);
+	if (!TEST_CHECK(nullptr != scratchCode))
+	{
+		return;
+	}
+	auto function = reinterpret_cast<uint64_t(*)(uint64_t*, uint64_t)>(scratchCode);
+	uint64_t values[2] = { 0, 0x55 };
+	uint64_t cameraStruct[2] = { 0, 0x55 };
+	testHitCounter = 0;
+	testControlBlock.cameraEnabled = 0;
+	// camera disabled: the store is executed.
+	TEST_CHECK(function(values, 7) == 7 + 0x10 && values[1] == 7);
+	TEST_CHECK(capturedBefore == reinterpret_cast<uint8_t*>(values));
+	TEST_CHECK(capturedAfter == reinterpret_cast<uint8_t*>(7));
+	// the flags of the test before the hook decide the jne in the hooked code.
+	TEST_CHECK(function(values, 0) == 1 + 0x10 && values[1] == 0);
+	testControlBlock.cameraEnabled = 1;
+	cameraStructAddress = reinterpret_cast<uint8_t*>(cameraStruct);
+	// camera enabled, but not the camera struct: the store is executed.
+	TEST_CHECK(function(values, 9) == 9 + 0x10 && values[1] == 9);
+	// camera enabled and the camera struct: the store is skipped, the rest is executed with the flags of the test.
+	TEST_CHECK(function(cameraStruct, 9) == 0x55 + 0x10 && cameraStruct[1] == 0x55);
+	TEST_CHECK(capturedAfter == reinterpret_cast<uint8_t*>(0x55));
+	TEST_CHECK(function(cameraStruct, 0) == 0x56 + 0x10 && cameraStruct[1] == 0x55);
+	TEST_CHECK(testHitCounter == 5);
+	testControlBlock.cameraEnabled = 0;
+	unmapScratchCode(scratchCode);
+}
+#endif
+
+
+void runInterceptorStubBuilderTests()
+{
+	testStubsOfInterceptors();
+	testRejectedDescriptors();
+#if defined(__linux__) && defined(__x86_64__)
+	testFlagsAreKept();
+	testCapturesAndSkips();
+#endif
+}
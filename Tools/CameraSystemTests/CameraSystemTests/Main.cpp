@@ -0,0 +1,171 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Unit tests for the portable parts of the Cyberpunk 2077 camera: the code which doesn't depend on the windows headers and can therefore
+// be built and run on Windows and Linux alike. See the ReadMe.md for how to build it.
+//
+// Usage: CameraSystemTests [--list] [suite names]
+//
+// Without suite names all suites are run. The exit code is 0 if all checks passed and 1 if one or more checks failed, so the tool can be 
+// used as a regression test after changing the camera's code.
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "TestRunner.h"
+
+using namespace std;
+
+#define EXIT_CODE_ALL_CHECKS_PASSED			0
+#define EXIT_CODE_CHECKS_FAILED				1
+#define EXIT_CODE_USAGE_ERROR				2
+
+struct TestSuite
+{
+	const char* name;
+	void (*run)();
+};
+
+static const TestSuite testSuites[] =
+{
+	{ "X64InstructionDecoder", runX64InstructionDecoderTests },
+	{ "X64Emitter", runX64EmitterTests },
+	{ "InterceptorStubBuilder", runInterceptorStubBuilderTests },
+	{ "AOBScanEngine", runAOBScanEngineTests },
+	{ "CameraStructScanner", runCameraStructScannerTests },
+	{ "HookSiteMigrator", runHookSiteMigratorTests },
+	{ "HookTransaction", runHookTransactionTests },
+	{ "HookWatchdog", runHookWatchdogTests },
+	{ "MemorySource", runMemorySourceTests },
+	{ "ValueHunt", runValueHuntTests },
+	{ "AOBPatternMinimizer", runAOBPatternMinimizerTests },
+	{ "AOBScanCache", runAOBScanCacheTests },
+	{ "AOBApproximateScanner", runAOBApproximateScannerTests },
+	{ "ImageIndex", runImageIndexTests },
+};
+
+static int numberOfChecks = 0;
+static int numberOfFailedChecks = 0;
+
+
+bool checkCondition(bool condition, const char* expression, const char* file, int line)
+{
+	numberOfChecks++;
+	if (!condition)
+	{
+		numberOfFailedChecks++;
+		printf("FAILED %s(%d): %s\n", file, line, expression);
+	}
+	return condition;
+}
+
+
+// Parses a string of hex bytes, e.g. "48 8B 05 10 00 00 00", as they're written in the comments of the interceptors.
+vector<uint8_t> parseBytes(const char* bytesAsString)
+{
+	vector<uint8_t> toReturn;
+	const char* current = bytesAsString;
+	while (*current != '\0')
+	{
+		char* end = nullptr;
+		const unsigned long value = strtoul(current, &end, 16);
+		if (end == current)
+		{
+			current++;
+			continue;
+		}
+		toReturn.push_back(static_cast<uint8_t>(value));
+		current = end;
+	}
+	return toReturn;
+}
+
+
+void printBytes(const uint8_t* bytes, size_t numberOfBytes)
+{
+	for (size_t i = 0; i < numberOfBytes; i++)
+	{
+		printf("%02X ", bytes[i]);
+	}
+	printf("\n");
+}
+
+
+static void displayUsage()
+{
+	printf("Usage: CameraSystemTests [--list] [suite names]\n");
+	printf("Without suite names all suites are run.\n");
+}
+
+
+int main(int argc, char* argv[])
+{
+	vector<const TestSuite*> suitesToRun;
+	for (int i = 1; i < argc; i++)
+	{
+		const string argument = argv[i];
+		if (argument == "--list")
+		{
+			for (auto& suite : testSuites)
+			{
+				printf("%s\n", suite.name);
+			}
+			return EXIT_CODE_ALL_CHECKS_PASSED;
+		}
+		const TestSuite* suiteToRun = nullptr;
+		for (auto& suite : testSuites)
+		{
+			if (argument == suite.name)
+			{
+				suiteToRun = &suite;
+			}
+		}
+		if (nullptr == suiteToRun)
+		{
+			printf("Unknown test suite '%s'\n", argument.c_str());
+			displayUsage();
+			return EXIT_CODE_USAGE_ERROR;
+		}
+		suitesToRun.push_back(suiteToRun);
+	}
+	if (suitesToRun.empty())
+	{
+		for (auto& suite : testSuites)
+		{
+			suitesToRun.push_back(&suite);
+		}
+	}
+	for (auto suite : suitesToRun)
+	{
+		const int numberOfFailedChecksBefore = numberOfFailedChecks;
+		const int numberOfChecksBefore = numberOfChecks;
+		suite->run();
+		printf("%-24s %5d checks, %d failed\n", suite->name, numberOfChecks - numberOfChecksBefore, numberOfFailedChecks - numberOfFailedChecksBefore);
+	}
+	printf("%d checks, %d failed\n", numberOfChecks, numberOfFailedChecks);
+	return numberOfFailedChecks == 0 ? EXIT_CODE_ALL_CHECKS_PASSED : EXIT_CODE_CHECKS_FAILED;
+}
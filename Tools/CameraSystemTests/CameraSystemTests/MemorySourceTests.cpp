@@ -0,0 +1,263 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Tests of the MemorySource implementations: the ranges to scan of a synthetic PE image with no-access holes, executable regions outside the
+// code sections and unreadable headers. On Linux the regions of the image are also taken from /proc/self/maps after changing the protection
+// of its pages, so determineScanRanges is tested on real mappings, and a scan of the ranges mustn't touch the no-access pages.
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "TestRunner.h"
+#include "AOBScanEngine.h"
+#include "MemorySource.h"
+#include "PEImageInfo.h"
+#ifdef __linux__
+	#include <sys/mman.h>
+#endif
+
+using namespace std;
+using namespace IGCS;
+
+#define MEMORY_TEST_PAGE_SIZE			0x1000
+#define MEMORY_TEST_IMAGE_SIZE			0x10000
+#define MEMORY_TEST_TEXT_RVA			0x1000
+#define MEMORY_TEST_TEXT_SIZE			0x6000
+#define MEMORY_TEST_RDATA_RVA			0x7000
+#define MEMORY_TEST_RDATA_SIZE			0x3000
+#define MEMORY_TEST_DATA_RVA			0xA000
+#define MEMORY_TEST_DATA_SIZE			0x6000
+#define MEMORY_TEST_NT_HEADERS_OFFSET	0x80
+#define MEMORY_TEST_OPTIONAL_HEADER_SIZE	0xF0
+
+// A memory source with fixed regions, to simulate the memory of a packed or protected process.
+class FixedRegionsMemorySource : public MemorySource
+{
+public:
+	FixedRegionsMemorySource(const vector<MemoryRegion>& regions, bool succeeds) : _regions{ regions }, _succeeds{ succeeds }
+	{
+	}
+
+	bool enumerateRegions(const uint8_t*, size_t, vector<MemoryRegion>& regions) const override
+	{
+		regions = _succeeds ? _regions : vector<MemoryRegion>();
+		return _succeeds;
+	}
+
+private:
+	vector<MemoryRegion> _regions;
+	bool _succeeds;
+};
+
+
+template<typename T>
+static void writeValue(uint8_t* address, T value)
+{
+	memcpy(address, &value, sizeof(T));
+}
+
+
+// Writes the headers of a 64 bit PE image with a .text, .rdata and .data section to image.
+static void writeHeaders(uint8_t* image)
+{
+	writeValue<uint16_t>(image, 0x5A4D);
+	writeValue<uint32_t>(image + 0x3C, MEMORY_TEST_NT_HEADERS_OFFSET);
+	uint8_t* ntHeaders = image + MEMORY_TEST_NT_HEADERS_OFFSET;
+	writeValue<uint32_t>(ntHeaders, 0x00004550);
+	writeValue<uint16_t>(ntHeaders + 4, 0x8664);
+	writeValue<uint16_t>(ntHeaders + 6, 3);
+	writeValue<uint16_t>(ntHeaders + 20, MEMORY_TEST_OPTIONAL_HEADER_SIZE);
+	uint8_t* optionalHeader = ntHeaders + 24;
+	writeValue<uint16_t>(optionalHeader, 0x20B);
+	writeValue<uint32_t>(optionalHeader + 56, MEMORY_TEST_IMAGE_SIZE);
+	writeValue<uint32_t>(optionalHeader + 60, MEMORY_TEST_PAGE_SIZE);
+	struct { const char* name; uint32_t rva; uint32_t size; uint32_t characteristics; } sections[] =
+	{
+		{ ".text", MEMORY_TEST_TEXT_RVA, MEMORY_TEST_TEXT_SIZE, PE_SECTION_CONTAINS_CODE | PE_SECTION_MEM_EXECUTE | PE_SECTION_MEM_READ },
+		{ ".rdata", MEMORY_TEST_RDATA_RVA, MEMORY_TEST_RDATA_SIZE, PE_SECTION_MEM_READ },
+		{ ".data", MEMORY_TEST_DATA_RVA, MEMORY_TEST_DATA_SIZE, PE_SECTION_MEM_READ | PE_SECTION_MEM_WRITE },
+	};
+	uint8_t* sectionHeader = optionalHeader + MEMORY_TEST_OPTIONAL_HEADER_SIZE;
+	for (auto& section : sections)
+	{
+		memcpy(sectionHeader, section.name, strlen(section.name));
+		writeValue<uint32_t>(sectionHeader + 8, section.size);
+		writeValue<uint32_t>(sectionHeader + 12, section.rva);
+		writeValue<uint32_t>(sectionHeader + 16, section.size);
+		writeValue<uint32_t>(sectionHeader + 20, section.rva);
+		writeValue<uint32_t>(sectionHeader + 36, section.characteristics);
+		sectionHeader += 40;
+	}
+}
+
+
+// Compares the ranges with the expected ranges, given as pairs of rva and size. Prints both if they differ.
+static bool checkRanges(const char* description, const vector<AOBScanRange>& ranges, const uint8_t* imageBase, const vector<pair<size_t, size_t>>& expectedRanges)
+{
+	bool areEqual = ranges.size() == expectedRanges.size();
+	for (size_t i = 0; i < ranges.size() && areEqual; i++)
+	{
+		areEqual = static_cast<size_t>(ranges[i].start - imageBase) == expectedRanges[i].first && ranges[i].size == expectedRanges[i].second;
+	}
+	if (!areEqual)
+	{
+		printf("  %s: got", description);
+		for (auto& range : ranges)
+		{
+			printf(" [%zX, +%zX)", static_cast<size_t>(range.start - imageBase), range.size);
+		}
+		printf(", expected");
+		for (auto& expectedRange : expectedRanges)
+		{
+			printf(" [%zX, +%zX)", expectedRange.first, expectedRange.second);
+		}
+		printf("\n");
+	}
+	return areEqual;
+}
+
+
+static MemoryRegion createRegion(const uint8_t* imageBase, size_t rva, size_t size, bool isReadable, bool isExecutable)
+{
+	return { imageBase + rva, size, isReadable, isExecutable, false };
+}
+
+
+static void testImageMemorySource(const uint8_t* image)
+{
+	PEImageInfo imageInfo;
+	TEST_CHECK(imageInfo.parse(image, MEMORY_TEST_IMAGE_SIZE));
+	TEST_CHECK(imageInfo.sections().size() == 3);
+	vector<MemoryRegion> regions;
+	TEST_CHECK(ImageMemorySource().enumerateRegions(image, MEMORY_TEST_IMAGE_SIZE, regions));
+	TEST_CHECK(regions.size() == 3);
+	if (regions.size() == 3)
+	{
+		TEST_CHECK(regions[0].start == image && regions[0].size == MEMORY_TEST_TEXT_RVA && !regions[0].isExecutable);
+		TEST_CHECK(regions[1].start == image + MEMORY_TEST_TEXT_RVA && regions[1].size == MEMORY_TEST_TEXT_SIZE && regions[1].isExecutable);
+		TEST_CHECK(regions[2].start == image + MEMORY_TEST_RDATA_RVA && regions[2].size == MEMORY_TEST_IMAGE_SIZE - MEMORY_TEST_RDATA_RVA && !regions[2].isExecutable);
+	}
+	const ImageMemorySource imageSource;
+	TEST_CHECK(checkRanges("image, code", imageSource.determineScanRanges(image, MEMORY_TEST_IMAGE_SIZE, false), image, { { MEMORY_TEST_TEXT_RVA, MEMORY_TEST_TEXT_SIZE } }));
+	TEST_CHECK(checkRanges("image, all", imageSource.determineScanRanges(image, MEMORY_TEST_IMAGE_SIZE, true), image, { { 0, MEMORY_TEST_IMAGE_SIZE } }));
+	// the sections are clipped to the size of the image.
+	TEST_CHECK(checkRanges("image, clipped", imageSource.determineScanRanges(image, MEMORY_TEST_TEXT_RVA + 0x2000, false), image, { { MEMORY_TEST_TEXT_RVA, 0x2000 } }));
+	// an image without valid headers is scanned as a whole.
+	vector<uint8_t> noHeaders(image, image + MEMORY_TEST_IMAGE_SIZE);
+	noHeaders[0] = 0;
+	TEST_CHECK(checkRanges("no headers", imageSource.determineScanRanges(noHeaders.data(), noHeaders.size(), false), noHeaders.data(), { { 0, MEMORY_TEST_IMAGE_SIZE } }));
+}
+
+
+static void testRegions(const uint8_t* image)
+{
+	// a no-access hole in .text.
+	const FixedRegionsMemorySource withHole({ createRegion(image, 0, MEMORY_TEST_TEXT_RVA, true, false), createRegion(image, MEMORY_TEST_TEXT_RVA, 0x2000, true, true),
+											  createRegion(image, 0x3000, 0x1000, false, false), createRegion(image, 0x4000, 0x3000, true, true),
+											  createRegion(image, MEMORY_TEST_RDATA_RVA, 0x9000, true, false) }, true);
+	TEST_CHECK(checkRanges("hole, code", withHole.determineScanRanges(image, MEMORY_TEST_IMAGE_SIZE, false), image, { { 0x1000, 0x2000 }, { 0x4000, 0x3000 } }));
+	TEST_CHECK(checkRanges("hole, all", withHole.determineScanRanges(image, MEMORY_TEST_IMAGE_SIZE, true), image, { { 0, 0x3000 }, { 0x4000, 0xC000 } }));
+
+	// adjacent readable regions with a different protection are merged, so a pattern spanning both is found.
+	const FixedRegionsMemorySource split({ createRegion(image, 0, MEMORY_TEST_TEXT_RVA, true, false), createRegion(image, MEMORY_TEST_TEXT_RVA, 0x3000, true, true),
+										   createRegion(image, 0x4000, 0x3000, true, true), createRegion(image, MEMORY_TEST_RDATA_RVA, 0x9000, true, false) }, true);
+	TEST_CHECK(checkRanges("split", split.determineScanRanges(image, MEMORY_TEST_IMAGE_SIZE, false), image, { { MEMORY_TEST_TEXT_RVA, MEMORY_TEST_TEXT_SIZE } }));
+
+	// code unpacked in .data by a protector is scanned after the code sections.
+	const FixedRegionsMemorySource unpacked({ createRegion(image, 0, MEMORY_TEST_TEXT_RVA, true, false), createRegion(image, MEMORY_TEST_TEXT_RVA, MEMORY_TEST_TEXT_SIZE, true, true),
+											  createRegion(image, MEMORY_TEST_RDATA_RVA, 0x5000, true, false), createRegion(image, 0xC000, 0x2000, true, true),
+											  createRegion(image, 0xE000, 0x2000, true, false) }, true);
+	TEST_CHECK(checkRanges("unpacked", unpacked.determineScanRanges(image, MEMORY_TEST_IMAGE_SIZE, false), image, { { MEMORY_TEST_TEXT_RVA, MEMORY_TEST_TEXT_SIZE }, { 0xC000, 0x2000 } }));
+
+	// unreadable headers: the sections can't be read, so only the executable regions are scanned.
+	const FixedRegionsMemorySource noHeaders({ createRegion(image, 0, MEMORY_TEST_TEXT_RVA, false, false), createRegion(image, MEMORY_TEST_TEXT_RVA, MEMORY_TEST_TEXT_SIZE, true, true),
+											   createRegion(image, MEMORY_TEST_RDATA_RVA, 0x9000, true, false) }, true);
+	TEST_CHECK(checkRanges("unreadable headers", noHeaders.determineScanRanges(image, MEMORY_TEST_IMAGE_SIZE, false), image, { { MEMORY_TEST_TEXT_RVA, MEMORY_TEST_TEXT_SIZE } }));
+	// ... and without executable regions, all readable memory.
+	const FixedRegionsMemorySource noHeadersNoCode({ createRegion(image, 0, MEMORY_TEST_TEXT_RVA, false, false), createRegion(image, MEMORY_TEST_TEXT_RVA, 0xF000, true, false) }, true);
+	TEST_CHECK(checkRanges("unreadable headers, no code", noHeadersNoCode.determineScanRanges(image, MEMORY_TEST_IMAGE_SIZE, false), image, { { MEMORY_TEST_TEXT_RVA, 0xF000 } }));
+
+	// if the regions can't be determined, the image is treated as readable.
+	const FixedRegionsMemorySource failing({}, false);
+	TEST_CHECK(checkRanges("failing", failing.determineScanRanges(image, MEMORY_TEST_IMAGE_SIZE, false), image, { { MEMORY_TEST_TEXT_RVA, MEMORY_TEST_TEXT_SIZE } }));
+}
+
+
+#ifdef __linux__
+// Maps the image in pages and changes the protection of them the way a loader and a protector would, then compares the ranges determined from
+// /proc/self/maps with the expected ranges. The ranges are scanned for a pattern which is planted before, in and after a no-access hole.
+static void testProcMapsMemorySource(const uint8_t* image)
+{
+	uint8_t* mappedImage = static_cast<uint8_t*>(mmap(nullptr, MEMORY_TEST_IMAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+	if (!TEST_CHECK(MAP_FAILED != mappedImage))
+	{
+		return;
+	}
+	memcpy(mappedImage, image, MEMORY_TEST_IMAGE_SIZE);
+	static const uint8_t plantedBytes[] = { 0x48, 0x8B, 0x05, 0x12, 0x34, 0x56, 0x78, 0xF3, 0x0F, 0x11, 0x4F, 0x3C };
+	for (size_t rva : { 0x1100, 0x3100, 0x5100 })
+	{
+		memcpy(mappedImage + rva, plantedBytes, sizeof(plantedBytes));
+	}
+	const ProcMapsMemorySource procMapsSource;
+	// a fully readable image has the same ranges as when it's loaded by a tool.
+	TEST_CHECK(checkRanges("maps, readable", procMapsSource.determineScanRanges(mappedImage, MEMORY_TEST_IMAGE_SIZE, false), mappedImage, 
+						   { { MEMORY_TEST_TEXT_RVA, MEMORY_TEST_TEXT_SIZE } }));
+	TEST_CHECK(checkRanges("maps, readable, all", procMapsSource.determineScanRanges(mappedImage, MEMORY_TEST_IMAGE_SIZE, true), mappedImage, { { 0, MEMORY_TEST_IMAGE_SIZE } }));
+
+	mprotect(mappedImage + MEMORY_TEST_TEXT_RVA, MEMORY_TEST_TEXT_SIZE, PROT_READ | PROT_EXEC);
+	mprotect(mappedImage + 0x3000, MEMORY_TEST_PAGE_SIZE, PROT_NONE);
+	const vector<AOBScanRange> rangesWithHole = procMapsSource.determineScanRanges(mappedImage, MEMORY_TEST_IMAGE_SIZE, false);
+	TEST_CHECK(checkRanges("maps, hole", rangesWithHole, mappedImage, { { 0x1000, 0x2000 }, { 0x4000, 0x3000 } }));
+	AOBScanEngine engine;
+	const int patternId = engine.addPattern(ScanPattern("48 8B 05 ?? ?? ?? ?? F3 0F 11 4F 3C", 1));
+	engine.compile();
+	engine.scan(rangesWithHole);
+	TEST_CHECK(engine.numberOfMatches(patternId) == 2);
+
+	// code in .data
+	mprotect(mappedImage + 0xC000, MEMORY_TEST_PAGE_SIZE, PROT_READ | PROT_EXEC);
+	TEST_CHECK(checkRanges("maps, unpacked", procMapsSource.determineScanRanges(mappedImage, MEMORY_TEST_IMAGE_SIZE, false), mappedImage, 
+						   { { 0x1000, 0x2000 }, { 0x4000, 0x3000 }, { 0xC000, MEMORY_TEST_PAGE_SIZE } }));
+	// no-access headers
+	mprotect(mappedImage, MEMORY_TEST_PAGE_SIZE, PROT_NONE);
+	TEST_CHECK(checkRanges("maps, no headers", procMapsSource.determineScanRanges(mappedImage, MEMORY_TEST_IMAGE_SIZE, false), mappedImage, 
+						   { { 0x1000, 0x2000 }, { 0x4000, 0x3000 }, { 0xC000, MEMORY_TEST_PAGE_SIZE } }));
+	munmap(mappedImage, MEMORY_TEST_IMAGE_SIZE);
+}
+#endif
+
+
+void runMemorySourceTests()
+{
+	vector<uint8_t> image(MEMORY_TEST_IMAGE_SIZE, 0);
+	writeHeaders(image.data());
+	testImageMemorySource(image.data());
+	testRegions(image.data());
+#ifdef __linux__
+	testProcMapsMemorySource(image.data());
+#endif
+}
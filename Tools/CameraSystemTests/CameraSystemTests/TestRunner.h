@@ -0,0 +1,54 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Reports a check which failed with its location and returns the condition, so a test can add details of the case which failed, e.g.
+// if (!TEST_CHECK(length == 5)) { printf("  instruction: %s\n", name); }
+#define TEST_CHECK(condition)		checkCondition((condition), #condition, __FILE__, __LINE__)
+
+bool checkCondition(bool condition, const char* expression, const char* file, int line);
+std::vector<uint8_t> parseBytes(const char* bytesAsString);
+void printBytes(const uint8_t* bytes, size_t numberOfBytes);
+
+// The test suites, one per tested part of the camera. See Main.cpp for the names to run them with.
+void runX64InstructionDecoderTests();
+void runX64EmitterTests();
+void runInterceptorStubBuilderTests();
+void runAOBScanEngineTests();
+void runCameraStructScannerTests();
+void runHookSiteMigratorTests();
+void runHookTransactionTests();
+void runHookWatchdogTests();
+void runMemorySourceTests();
+void runValueHuntTests();
+void runAOBPatternMinimizerTests();
+void runAOBScanCacheTests();
+void runAOBApproximateScannerTests();
+void runImageIndexTests();
@@ -0,0 +1,279 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Tests of the ValueHunt: every narrowing step has to keep exactly the candidates a brute force comparison of all values with the previous
+// snapshot keeps, for floats and ints, while the memory changes between the steps and pages become unreadable.
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <set>
+#include <vector>
+#include "TestRunner.h"
+#include "ValueHunt.h"
+
+using namespace std;
+using namespace IGCS;
+
+#define HUNT_TEST_MEMORY_SIZE			(64 * 1024 * 1024)
+#define HUNT_TEST_NUMBER_OF_WORKERS		4
+#define HUNT_TEST_FOV_OFFSET			(HUNT_TEST_MEMORY_SIZE / 3 + 0x1F0)
+
+// The memory the hunt reads, with the pages which have been 'freed', which can't be read anymore.
+struct HuntTestMemory
+{
+	uint8_t* start = nullptr;
+	set<uintptr_t> unreadablePages;
+
+	uint32_t valueAt(size_t index) const
+	{
+		uint32_t toReturn;
+		memcpy(&toReturn, start + index * sizeof(uint32_t), sizeof(toReturn));
+		return toReturn;
+	}
+
+	void setValueAt(size_t index, uint32_t value)
+	{
+		memcpy(start + index * sizeof(uint32_t), &value, sizeof(value));
+	}
+};
+
+// A step of a hunt: how the memory changes before it, and the comparison to narrow with.
+struct HuntTestStep
+{
+	const char* name;
+	HuntComparison comparison;
+	double value;
+	double epsilon;
+	uint32_t plantedValue;		// the new value of the value hunted for
+	double fractionOfPagesToChange;
+	int numberOfPagesToFree;
+};
+
+
+// Values as the hunt sees them when comparing floats: denormals are flushed to zero.
+static float toComparedFloat(uint32_t bits)
+{
+	float toReturn;
+	memcpy(&toReturn, &bits, sizeof(toReturn));
+	return fpclassify(toReturn) == FP_SUBNORMAL ? 0.0f : toReturn;
+}
+
+
+static bool isReferenceMatch(HuntValueType valueType, const HuntTestStep& step, uint32_t previousBits, uint32_t currentBits)
+{
+	if (HuntValueType::Float == valueType)
+	{
+		const float previousValue = toComparedFloat(previousBits);
+		const float currentValue = toComparedFloat(currentBits);
+		switch (step.comparison)
+		{
+			case HuntComparison::Changed:
+				return previousBits != currentBits;
+			case HuntComparison::Unchanged:
+				return previousBits == currentBits || fabsf(currentValue - previousValue) <= static_cast<float>(step.epsilon);
+			case HuntComparison::Increased:
+				return currentValue > previousValue;
+			case HuntComparison::Decreased:
+				return currentValue < previousValue;
+			default:
+				return fabsf(currentValue - static_cast<float>(step.value)) <= static_cast<float>(step.epsilon);
+		}
+	}
+	const int32_t previousValue = static_cast<int32_t>(previousBits);
+	const int32_t currentValue = static_cast<int32_t>(currentBits);
+	switch (step.comparison)
+	{
+		case HuntComparison::Changed:
+			return previousValue != currentValue;
+		case HuntComparison::Unchanged:
+			return previousValue == currentValue;
+		case HuntComparison::Increased:
+			return currentValue > previousValue;
+		case HuntComparison::Decreased:
+			return currentValue < previousValue;
+		default:
+			return currentValue == static_cast<int32_t>(llround(step.value));
+	}
+}
+
+
+// Changes values in a fraction of the pages: floats a bit up or down, ints by one, or to random bits. Most pages stay the same, like in a game.
+static void changeMemory(mt19937& generator, HuntTestMemory& memory, HuntValueType valueType, double fractionOfPagesToChange)
+{
+	const size_t numberOfPages = HUNT_TEST_MEMORY_SIZE / VALUE_HUNT_PAGE_SIZE;
+	const size_t numberOfPagesToChange = static_cast<size_t>(numberOfPages * fractionOfPagesToChange);
+	for (size_t i = 0; i < numberOfPagesToChange; i++)
+	{
+		const size_t pageIndex = generator() % numberOfPages;
+		for (int j = 0; j < 50; j++)
+		{
+			const size_t valueIndex = pageIndex * VALUE_HUNT_VALUES_PER_PAGE + generator() % VALUE_HUNT_VALUES_PER_PAGE;
+			uint32_t bits = memory.valueAt(valueIndex);
+			const int delta = static_cast<int>(generator() % 3) - 1;
+			if (0 == generator() % 2)
+			{
+				bits = generator();
+			}
+			else if (HuntValueType::Float == valueType)
+			{
+				float value;
+				memcpy(&value, &bits, sizeof(value));
+				value += static_cast<float>(delta);
+				memcpy(&bits, &value, sizeof(bits));
+			}
+			else
+			{
+				bits = static_cast<uint32_t>(static_cast<int32_t>(bits) + delta);
+			}
+			memory.setValueAt(valueIndex, bits);
+		}
+	}
+}
+
+
+static void runHunt(mt19937& generator, HuntTestMemory& memory, HuntValueType valueType, const vector<HuntTestStep>& steps)
+{
+	const size_t numberOfValues = HUNT_TEST_MEMORY_SIZE / sizeof(uint32_t);
+	memory.unreadablePages.clear();
+	ValueHunt hunt([&memory](uintptr_t address, uint8_t* buffer, size_t size)
+		{
+			if (memory.unreadablePages.count(address) > 0)
+			{
+				return false;
+			}
+			memcpy(buffer, reinterpret_cast<const void*>(address), size);
+			return true;
+		}, HUNT_TEST_NUMBER_OF_WORKERS);
+	hunt.start({ { memory.start, HUNT_TEST_MEMORY_SIZE } }, valueType);
+	TEST_CHECK(hunt.numberOfCandidates() == numberOfValues);
+	const size_t memoryUsageAtStart = hunt.memoryUsageInBytes();
+
+	vector<uint32_t> previousValues(numberOfValues);
+	memcpy(previousValues.data(), memory.start, HUNT_TEST_MEMORY_SIZE);
+	vector<char> isReferenceCandidate(numberOfValues, 1);
+	const size_t plantedIndex = HUNT_TEST_FOV_OFFSET / sizeof(uint32_t);
+	for (auto& step : steps)
+	{
+		changeMemory(generator, memory, valueType, step.fractionOfPagesToChange);
+		memory.setValueAt(plantedIndex, step.plantedValue);
+		for (int i = 0; i < step.numberOfPagesToFree; i++)
+		{
+			uintptr_t pageAddress = reinterpret_cast<uintptr_t>(memory.start) + (generator() % (HUNT_TEST_MEMORY_SIZE / VALUE_HUNT_PAGE_SIZE)) * VALUE_HUNT_PAGE_SIZE;
+			if (pageAddress != (reinterpret_cast<uintptr_t>(memory.start) + HUNT_TEST_FOV_OFFSET) / VALUE_HUNT_PAGE_SIZE * VALUE_HUNT_PAGE_SIZE)
+			{
+				memory.unreadablePages.insert(pageAddress);
+			}
+		}
+		hunt.narrow(step.comparison, step.value, step.epsilon);
+
+		size_t numberOfReferenceCandidates = 0;
+		for (size_t i = 0; i < numberOfValues; i++)
+		{
+			const uint32_t currentBits = memory.valueAt(i);
+			const uintptr_t pageAddress = reinterpret_cast<uintptr_t>(memory.start + i * sizeof(uint32_t)) & ~static_cast<uintptr_t>(VALUE_HUNT_PAGE_SIZE - 1);
+			if (isReferenceCandidate[i])
+			{
+				isReferenceCandidate[i] = memory.unreadablePages.count(pageAddress) == 0 && isReferenceMatch(valueType, step, previousValues[i], currentBits);
+			}
+			numberOfReferenceCandidates += isReferenceCandidate[i] ? 1 : 0;
+			previousValues[i] = currentBits;
+		}
+		vector<HuntCandidate> candidates;
+		hunt.collectCandidates(candidates, SIZE_MAX);
+		size_t numberOfMismatches = candidates.size() != numberOfReferenceCandidates ? 1 : 0;
+		for (auto& candidate : candidates)
+		{
+			const size_t index = (candidate.address - reinterpret_cast<uintptr_t>(memory.start)) / sizeof(uint32_t);
+			numberOfMismatches += (index >= numberOfValues || !isReferenceCandidate[index] || candidate.rawValue != memory.valueAt(index)) ? 1 : 0;
+		}
+		if (!TEST_CHECK(0 == numberOfMismatches))
+		{
+			printf("  step '%s': %zu candidates, %zu expected, %zu mismatches\n", step.name, candidates.size(), numberOfReferenceCandidates, numberOfMismatches);
+		}
+		TEST_CHECK(hunt.numberOfCandidates() == numberOfReferenceCandidates);
+		TEST_CHECK(isReferenceCandidate[plantedIndex]);
+	}
+	// the snapshot shrinks with the candidates. The page store is compacted in slabs of 16MB, so that's what's left of the snapshot of 64MB.
+	TEST_CHECK(hunt.memoryUsageInBytes() < memoryUsageAtStart / 3);
+}
+
+
+void runValueHuntTests()
+{
+	// page aligned, like the memory of the game.
+	vector<uint8_t> buffer(HUNT_TEST_MEMORY_SIZE + VALUE_HUNT_PAGE_SIZE);
+	HuntTestMemory memory;
+	memory.start = reinterpret_cast<uint8_t*>((reinterpret_cast<uintptr_t>(buffer.data()) + VALUE_HUNT_PAGE_SIZE - 1) & ~static_cast<uintptr_t>(VALUE_HUNT_PAGE_SIZE - 1));
+	mt19937 generator(5);
+	// zeros, floats, small ints (denormals when read as floats) and random bits, with an area of zero pages.
+	for (size_t i = 0; i < HUNT_TEST_MEMORY_SIZE / sizeof(uint32_t); i++)
+	{
+		uint32_t bits = generator();
+		switch (bits % 6)
+		{
+			case 0:
+				bits = 0;
+				break;
+			case 1:
+				{
+					const float value = static_cast<float>(generator() % 1000) / 7.0f;
+					memcpy(&bits, &value, sizeof(bits));
+				}
+				break;
+			case 2:
+				bits = generator() % 100;
+				break;
+			default:
+				break;
+		}
+		memory.setValueAt(i, bits);
+	}
+	memset(memory.start + HUNT_TEST_MEMORY_SIZE / 2, 0, 4 * 1024 * 1024);
+	const vector<uint8_t> initialMemory(memory.start, memory.start + HUNT_TEST_MEMORY_SIZE);
+
+	const auto floatBits = [](float value) { uint32_t toReturn; memcpy(&toReturn, &value, sizeof(toReturn)); return toReturn; };
+	runHunt(generator, memory, HuntValueType::Float,
+			{
+				{ "changed", HuntComparison::Changed, 0, 0, floatBits(80.0f), 0.05, 0 },
+				{ "increased", HuntComparison::Increased, 0, 0, floatBits(85.0f), 0.05, 20 },
+				{ "unchanged", HuntComparison::Unchanged, 0, 0.001, floatBits(85.0005f), 0.05, 0 },
+				{ "unchanged, clean", HuntComparison::Unchanged, 0, 0, floatBits(85.0005f), 0.0, 0 },
+				{ "decreased", HuntComparison::Decreased, 0, 0, floatBits(60.0f), 0.05, 20 },
+				{ "equal to", HuntComparison::EqualTo, 60.0, 0.01, floatBits(60.0f), 0.05, 0 },
+				{ "changed, clean", HuntComparison::Changed, 0, 0, floatBits(61.0f), 0.0, 0 },
+			});
+	memcpy(memory.start, initialMemory.data(), HUNT_TEST_MEMORY_SIZE);
+	runHunt(generator, memory, HuntValueType::Int32,
+			{
+				{ "changed", HuntComparison::Changed, 0, 0, 1200, 0.05, 0 },
+				{ "increased", HuntComparison::Increased, 0, 0, 1300, 0.05, 20 },
+				{ "unchanged", HuntComparison::Unchanged, 0, 0, 1300, 0.05, 0 },
+				{ "decreased", HuntComparison::Decreased, 0, 0, static_cast<uint32_t>(-5), 0.05, 20 },
+				{ "equal to", HuntComparison::EqualTo, -5.0, 0, static_cast<uint32_t>(-5), 0.05, 0 },
+			});
+}
@@ -0,0 +1,212 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Tests of the X64Emitter: the encodings of the instructions the interceptor stubs are built from, with the base registers which need a SIB
+// byte (rsp, r12) or a displacement even when it's 0 (rbp, r13), 8 and 32 bit displacements and the extended registers, and the relocation
+// of copied instructions: rip relative operands, branches widened to 32 bit offsets and the branches which can't be relocated. The expected
+// encodings are the ones GNU as generates for the instructions in the names.
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+#include "TestRunner.h"
+#include "X64Emitter.h"
+
+using namespace std;
+using namespace IGCS;
+
+#define EMITTER_TEST_BASE_ADDRESS		0x140001000ull
+#define EMITTER_TEST_COPY_DISTANCE		0x12345678		// the distance between a copied instruction and its copy.
+
+struct KnownEmission
+{
+	const char* name;
+	const char* expectedBytes;
+	function<void(X64Emitter&)> emit;
+};
+
+static const KnownEmission knownEmissions[] =
+{
+	{ "push rax", "50", [](X64Emitter& e) { e.push(X64Register::Rax); } },
+	{ "push r12", "41 54", [](X64Emitter& e) { e.push(X64Register::R12); } },
+	{ "pop r13", "41 5D", [](X64Emitter& e) { e.pop(X64Register::R13); } },
+	{ "movabs r9, 0x1122334455667788", "49 B9 88 77 66 55 44 33 22 11", [](X64Emitter& e) { e.moveImmediate(X64Register::R9, 0x1122334455667788ull); } },
+	// rsp and r12 as base need a SIB byte.
+	{ "mov rax, [rsp]", "48 8B 04 24", [](X64Emitter& e) { e.load(X64Register::Rax, X64Register::Rsp, 0); } },
+	{ "mov [rsp+127], rax", "48 89 44 24 7F", [](X64Emitter& e) { e.store(X64Register::Rsp, 127, X64Register::Rax); } },
+	{ "mov rax, [rsp+128]", "48 8B 84 24 80 00 00 00", [](X64Emitter& e) { e.load(X64Register::Rax, X64Register::Rsp, 128); } },
+	{ "mov rax, [rsp-128]", "48 8B 44 24 80", [](X64Emitter& e) { e.load(X64Register::Rax, X64Register::Rsp, -128); } },
+	{ "mov [rsp+8], r15", "4C 89 7C 24 08", [](X64Emitter& e) { e.store(X64Register::Rsp, 8, X64Register::R15); } },
+	{ "mov r12, [rsp]", "4C 8B 24 24", [](X64Emitter& e) { e.load(X64Register::R12, X64Register::Rsp, 0); } },
+	{ "mov rax, [r12]", "49 8B 04 24", [](X64Emitter& e) { e.load(X64Register::Rax, X64Register::R12, 0); } },
+	{ "mov r11, [r12]", "4D 8B 1C 24", [](X64Emitter& e) { e.load(X64Register::R11, X64Register::R12, 0); } },
+	{ "mov [r12-4096], r13", "4D 89 AC 24 00 F0 FF FF", [](X64Emitter& e) { e.store(X64Register::R12, -4096, X64Register::R13); } },
+	{ "lock inc qword [rsp]", "F0 48 FF 04 24", [](X64Emitter& e) { e.lockIncrement(X64Register::Rsp, 0); } },
+	{ "lock inc qword [r12+128]", "F0 49 FF 84 24 80 00 00 00", [](X64Emitter& e) { e.lockIncrement(X64Register::R12, 128); } },
+	{ "cmp byte [rsp], 0x7f", "80 3C 24 7F", [](X64Emitter& e) { e.compareByte(X64Register::Rsp, 0, 0x7F); } },
+	{ "cmp byte [r12+127], 0x7f", "41 80 7C 24 7F 7F", [](X64Emitter& e) { e.compareByte(X64Register::R12, 127, 0x7F); } },
+	// rbp and r13 as base without a displacement need a displacement of 0.
+	{ "mov rax, [rbp]", "48 8B 45 00", [](X64Emitter& e) { e.load(X64Register::Rax, X64Register::Rbp, 0); } },
+	{ "mov [rbp+127], rax", "48 89 45 7F", [](X64Emitter& e) { e.store(X64Register::Rbp, 127, X64Register::Rax); } },
+	{ "mov rax, [rbp+128]", "48 8B 85 80 00 00 00", [](X64Emitter& e) { e.load(X64Register::Rax, X64Register::Rbp, 128); } },
+	{ "cmp r10, [rbp-129]", "4C 3B 95 7F FF FF FF", [](X64Emitter& e) { e.compare(X64Register::R10, X64Register::Rbp, -129); } },
+	{ "mov rax, [r13]", "49 8B 45 00", [](X64Emitter& e) { e.load(X64Register::Rax, X64Register::R13, 0); } },
+	{ "cmp rcx, [r13]", "49 3B 4D 00", [](X64Emitter& e) { e.compare(X64Register::Rcx, X64Register::R13, 0); } },
+	{ "mov [r13+128], rax", "49 89 85 80 00 00 00", [](X64Emitter& e) { e.store(X64Register::R13, 128, X64Register::Rax); } },
+	{ "lock inc qword [rbp]", "F0 48 FF 45 00", [](X64Emitter& e) { e.lockIncrement(X64Register::Rbp, 0); } },
+	{ "cmp byte [r13], 0x7f", "41 80 7D 00 7F", [](X64Emitter& e) { e.compareByte(X64Register::R13, 0, 0x7F); } },
+	{ "cmp rdx, [r8+604]", "49 3B 90 5C 02 00 00", [](X64Emitter& e) { e.compare(X64Register::Rdx, X64Register::R8, 604); } },
+	// the flags: all of them, and the arithmetic flags only, saved in rax.
+	{ "pushfq", "9C", [](X64Emitter& e) { e.pushFlags(); } },
+	{ "popfq", "9D", [](X64Emitter& e) { e.popFlags(); } },
+	{ "lahf; seto al", "9F 0F 90 C0", [](X64Emitter& e) { e.saveArithmeticFlagsInRax(); } },
+	{ "add al, 0x7f; sahf", "04 7F 9E", [](X64Emitter& e) { e.restoreArithmeticFlagsFromRax(); } },
+	{ "jmp [rip+0]; dq 0x1122334455667788", "FF 25 00 00 00 00 88 77 66 55 44 33 22 11", [](X64Emitter& e) { e.jumpAbsolute(0x1122334455667788ull); } },
+	{ "1: nop; jmp 1b", "90 E9 FA FF FF FF", [](X64Emitter& e) { const int label = e.createLabel(); e.bindLabel(label); e.emitBytes(parseBytes("90").data(), 1); e.jump(label); } },
+	{ "jne 1f; nop; 1:", "0F 85 01 00 00 00 90", [](X64Emitter& e) { const int label = e.createLabel(); e.jumpIf(X64Condition::NotEqual, label); e.emitBytes(parseBytes("90").data(), 1); e.bindLabel(label); } },
+	{ "jo 1f; 1:", "0F 80 00 00 00 00", [](X64Emitter& e) { const int label = e.createLabel(); e.jumpIf(X64Condition::Overflow, label); e.bindLabel(label); } },
+};
+
+
+static void testKnownEmissions()
+{
+	for (auto& emission : knownEmissions)
+	{
+		X64Emitter emitter(EMITTER_TEST_BASE_ADDRESS);
+		emission.emit(emitter);
+		bool passed = TEST_CHECK(emitter.finish());
+		passed &= TEST_CHECK(emitter.code() == parseBytes(emission.expectedBytes));
+		if (!passed)
+		{
+			printf("  instruction: %s, emitted: ", emission.name);
+			printBytes(emitter.code().data(), emitter.code().size());
+		}
+	}
+}
+
+
+// Returns the address the rip relative operand or branch of the instruction emitted at offsetInCode refers to, at the emitter's base address.
+static uintptr_t determineEmittedTarget(const X64Emitter& emitter, uintptr_t baseAddress, size_t offsetInCode, X64Instruction& decoded)
+{
+	const uint8_t* emittedInstruction = emitter.code().data() + offsetInCode;
+	if (!X64InstructionDecoder::decode(emittedInstruction, emitter.code().size() - offsetInCode, decoded))
+	{
+		return 0;
+	}
+	const uint8_t* target = decoded.isRelativeBranch ? X64InstructionDecoder::determineBranchTarget(emittedInstruction, decoded)
+													 : X64InstructionDecoder::determineRipRelativeTarget(emittedInstruction, decoded);
+	return reinterpret_cast<uintptr_t>(target) - reinterpret_cast<uintptr_t>(emitter.code().data()) + baseAddress;
+}
+
+
+// Copies the instruction at instructionAddress to an emitter placed EMITTER_TEST_COPY_DISTANCE further, after a few bytes, and checks the copy 
+// starts with the opcode bytes specified, has the length specified and refers to the same target as the original.
+static void checkRelocatedCopy(const char* name, const uint8_t* instructionAddress, size_t numberOfBytesAvailable, const char* expectedOpcodeBytes, 
+							   int expectedLength)
+{
+	X64Instruction original;
+	TEST_CHECK(X64InstructionDecoder::decode(instructionAddress, numberOfBytesAvailable, original));
+	const uint8_t* originalTarget = original.isRelativeBranch ? X64InstructionDecoder::determineBranchTarget(instructionAddress, original)
+															  : X64InstructionDecoder::determineRipRelativeTarget(instructionAddress, original);
+	const uintptr_t baseAddress = reinterpret_cast<uintptr_t>(instructionAddress) + EMITTER_TEST_COPY_DISTANCE;
+	X64Emitter emitter(baseAddress);
+	emitter.emitBytes(parseBytes("90 90 90").data(), 3);
+	bool passed = TEST_CHECK(emitter.copyInstruction(instructionAddress, original));
+	passed &= TEST_CHECK(emitter.finish());
+	X64Instruction copy;
+	passed &= TEST_CHECK(determineEmittedTarget(emitter, baseAddress, 3, copy) == reinterpret_cast<uintptr_t>(originalTarget));
+	passed &= TEST_CHECK(copy.length == expectedLength && emitter.code().size() == 3 + static_cast<size_t>(expectedLength));
+	const vector<uint8_t> expectedOpcode = parseBytes(expectedOpcodeBytes);
+	passed &= TEST_CHECK(emitter.code().size() >= 3 + expectedOpcode.size() && 0 == memcmp(emitter.code().data() + 3, expectedOpcode.data(), expectedOpcode.size()));
+	if (!passed)
+	{
+		printf("  instruction: %s, emitted: ", name);
+		printBytes(emitter.code().data(), emitter.code().size());
+	}
+}
+
+
+static void testCopyInstruction()
+{
+	// mulss xmm2,[rip+0267352A]; call +000B1CD2; je +0A; jmp -2; jne rel32 +100; movss xmm11,[rip+10]; jrcxz +2; jne rel32 with a 66 prefix
+	static const uint8_t code[] = { 0xF3, 0x0F, 0x59, 0x15, 0x2A, 0x35, 0x67, 0x02, 0xE8, 0xD2, 0x1C, 0x0B, 0x00, 0x74, 0x0A, 0xEB, 0xFE, 
+									0x0F, 0x85, 0x00, 0x01, 0x00, 0x00, 0xF3, 0x44, 0x0F, 0x10, 0x1D, 0x10, 0x00, 0x00, 0x00, 0xE3, 0x02, 
+									0x66, 0x0F, 0x85, 0x10, 0x00, 0x00, 0x00 };
+	checkRelocatedCopy("mulss xmm2,[rip+x]", code, sizeof(code), "F3 0F 59 15", 8);
+	checkRelocatedCopy("call rel32", code + 8, sizeof(code) - 8, "E8", 5);
+	// short branches are widened to a 32 bit offset.
+	checkRelocatedCopy("je rel8", code + 13, sizeof(code) - 13, "0F 84", 6);
+	checkRelocatedCopy("jmp rel8", code + 15, sizeof(code) - 15, "E9", 5);
+	checkRelocatedCopy("jne rel32", code + 17, sizeof(code) - 17, "0F 85", 6);
+	checkRelocatedCopy("movss xmm11,[rip+x]", code + 23, sizeof(code) - 23, "F3 44 0F 10 1D", 9);
+	X64Instruction decoded;
+	// a branch copied with a label jumps to the label.
+	{
+		X64Emitter emitter(EMITTER_TEST_BASE_ADDRESS);
+		const int label = emitter.createLabel();
+		X64InstructionDecoder::decode(code + 13, 2, decoded);
+		TEST_CHECK(emitter.copyInstruction(code + 13, decoded, label));
+		emitter.bindLabel(label);
+		TEST_CHECK(emitter.finish());
+		TEST_CHECK(emitter.code() == parseBytes("0F 84 00 00 00 00"));
+	}
+	// jrcxz can't be relocated, nor can a branch with an operand size prefix, which makes the offset 16 bit on some cpus.
+	{
+		X64Emitter emitter(EMITTER_TEST_BASE_ADDRESS);
+		TEST_CHECK(X64InstructionDecoder::decode(code + 32, 2, decoded));
+		TEST_CHECK(!emitter.copyInstruction(code + 32, decoded));
+		TEST_CHECK(!emitter.finish());
+		TEST_CHECK(!emitter.errorDescription().empty());
+	}
+	{
+		X64Emitter emitter(EMITTER_TEST_BASE_ADDRESS);
+		if (TEST_CHECK(X64InstructionDecoder::decode(code + 34, 7, decoded)))
+		{
+			TEST_CHECK(!emitter.copyInstruction(code + 34, decoded));
+		}
+	}
+	// a rip relative operand more than 2GB away from the copy.
+	{
+		X64Emitter emitter(reinterpret_cast<uintptr_t>(code) + 0x100000000ull);
+		X64InstructionDecoder::decode(code, 8, decoded);
+		TEST_CHECK(!emitter.copyInstruction(code, decoded));
+	}
+	// a jump to a label which is never bound.
+	{
+		X64Emitter emitter(EMITTER_TEST_BASE_ADDRESS);
+		emitter.jump(emitter.createLabel());
+		TEST_CHECK(!emitter.finish());
+	}
+}
+
+
+void runX64EmitterTests()
+{
+	testKnownEmissions();
+	testCopyInstruction();
+}
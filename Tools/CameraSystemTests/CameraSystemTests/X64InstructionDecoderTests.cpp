@@ -0,0 +1,296 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Part of Injectable Generic Camera System
+// Copyright(c) 2020, Frans Bouma
+// All rights reserved.
+// https://github.com/FransBouma/InjectableGenericCameraSystem
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met :
+//
+//  * Redistributions of source code must retain the above copyright notice, this
+//	  list of conditions and the following disclaimer.
+//
+//  * Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and / or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Tests of the X64InstructionDecoder: lengths and operand layouts of known encodings, and the instruction spans of the game's hook sites.
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "TestRunner.h"
+#include "X64InstructionDecoder.h"
+#include "AOBPatterns.h"
+
+using namespace std;
+using namespace IGCS;
+using namespace IGCS::GameSpecific;
+
+#define HOOK_JMP_SIZE		14
+
+struct KnownEncoding
+{
+	const char* name;
+	const char* bytes;
+	int length;					// 0: the decoder has to reject the bytes.
+	bool isRipRelative;
+	int displacementSize;
+	int immediateSize;
+	bool isRelativeBranch;
+};
+
+static const KnownEncoding knownEncodings[] =
+{
+	{ "nop", "90", 1, false, 0, 0, false },
+	{ "mov rax,[rip+x]", "48 8B 05 01 02 03 04", 7, true, 4, 0, false },
+	{ "movss xmm11,[rip+x]", "F3 44 0F 10 1D 01 02 03 04", 9, true, 4, 0, false },
+	{ "mov rax,imm64", "48 B8 01 02 03 04 05 06 07 08", 10, false, 0, 8, false },
+	{ "mov eax,imm32", "B8 01 02 03 04", 5, false, 0, 4, false },
+	{ "mov ax,imm16", "66 B8 01 02", 4, false, 0, 2, false },
+	{ "call rel32", "E8 01 02 03 04", 5, false, 0, 4, true },
+	{ "je rel32", "0F 84 01 02 03 04", 6, false, 0, 4, true },
+	{ "je rel8", "74 38", 2, false, 0, 1, true },
+	{ "jmp rel8", "EB FE", 2, false, 0, 1, true },
+	{ "mov dword [rip+x],imm32", "C7 05 01 02 03 04 05 06 07 08", 10, true, 4, 4, false },
+	{ "mov word [rip+x],imm16", "66 C7 05 01 02 03 04 05 06", 9, true, 4, 2, false },
+	{ "test byte [rip+x],imm8", "F6 05 01 02 03 04 09", 7, true, 4, 1, false },
+	{ "neg eax", "F7 D8", 2, false, 0, 0, false },
+	{ "mov rax,[rsp+20]", "48 8B 44 24 20", 5, false, 1, 0, false },
+	{ "mov rax,[disp32]", "48 8B 04 25 01 02 03 04", 8, false, 4, 0, false },
+	{ "mov rax,[rsp+disp32]", "48 8B 84 24 01 02 03 04", 8, false, 4, 0, false },
+	{ "mov rax,[rbp+0]", "48 8B 45 00", 4, false, 1, 0, false },
+	{ "mov rax,[r13+0]", "49 8B 45 00", 4, false, 1, 0, false },
+	{ "mov rax,[r12]", "49 8B 04 24", 4, false, 0, 0, false },
+	{ "mov rax,[moffs64]", "48 A1 01 02 03 04 05 06 07 08", 10, false, 8, 0, false },
+	{ "enter", "C8 01 02 03", 4, false, 0, 3, false },
+	{ "shufps", "0F C6 C1 1B", 4, false, 0, 1, false },
+	{ "palignr", "0F 3A 0F C1 08", 5, false, 0, 1, false },
+	{ "pshufb", "66 0F 38 00 C1", 5, false, 0, 0, false },
+	{ "nop dword [rax+rax+0]", "0F 1F 44 00 00", 5, false, 1, 0, false },
+	{ "vmovups xmm0,[rsp+10]", "C5 F8 10 44 24 10", 6, false, 1, 0, false },
+	{ "vpermilps xmm0,xmm0,1", "C4 E3 79 04 C0 01", 6, false, 0, 1, false },
+	{ "vzeroupper", "C5 F8 77", 3, false, 0, 0, false },
+	{ "vmovups zmm0,[rip+x]", "62 F1 7C 48 10 05 01 02 03 04", 10, true, 4, 0, false },
+	{ "VEX map 0 (reserved)", "C4 E0 79 10 C0", 0, false, 0, 0, false },
+	{ "VEX map 0 with a one byte opcode", "C4 E0 79 B8 01 02 03 04", 0, false, 0, 0, false },
+	{ "EVEX map 0 (reserved)", "62 F0 7C 48 10 C0", 0, false, 0, 0, false },
+	{ "push es (invalid in 64 bit)", "06", 0, false, 0, 0, false },
+	{ "truncated ModRM", "48 8B", 0, false, 0, 0, false },
+	{ "truncated displacement", "48 8B 05 01 02", 0, false, 0, 0, false },
+	{ "truncated VEX prefix", "C4 E3", 0, false, 0, 0, false },
+};
+
+// A hook site of the game: the bytes at the hook up to and including the instruction the interceptor continues at, from the comments in
+// InterceptorHelper.cpp and Interceptor.asm. minimumSpan is the smallest span of whole instructions the hook's jmp fits in.
+struct HookSite
+{
+	const char* blockName;
+	const char* bytes;
+	int continueOffset;
+	int minimumSpan;
+};
+
+static const HookSite hookSites[] =
+{
+	{ ACTIVECAM_ADDRESS_INTERCEPT_KEY, "FF 90 58 02 00 00 F3 0F 11 46 20 48 8D 54 24 20 48 8B 03", 0x10, 0x10 },
+	{ ACTIVECAM_CAMERA_WRITE1_INTERCEPT_KEY, "F2 0F 11 83 E0 00 00 00 0F 28 44 24 30 89 8B E8 00 00 00 0F 11 83 F0 00 00 00 80 BB B1 00 00 00 00", 0x1A, 0x13 },
+	{ PMSTRUCT_ADDRESS_INTERCEPT_KEY, "49 8B 4E 40 48 8D 95 90 00 00 00 41 88 9E FB 02 00 00 E8 63 77 FF FF", 0x12, 0x12 },
+	{ FOV_PLAY_WRITE_INTERCEPT_KEY, "F3 0F 11 9F 5C 02 00 00 48 8B 8F B0 01 00 00 0F 2E 59 40", 0x0F, 0x0F },
+	{ RESOLUTION_STRUCT_ADDRESS_INTERCEPT_KEY, "8B 81 84 00 00 00 89 41 44 8B 81 88 00 00 00 89 41 40 8B 81 8C 00 00 00", 0x12, 0x0F },
+	{ TOD_READ_INTERCEPT_KEY, "48 8B DA 48 8B 01 FF 90 F8 00 00 00 48 8B C3 48 83 C4 20", 0x0F, 0x0F },
+	{ PLAY_WIDGETBUCKET_READ_INTERCEPT_KEY, "88 81 B1 00 00 00 48 89 BC 24 98 00 00 00 48 8B 7C 24 20 48 83 7F 40 00", 0x13, 0x0E },
+	{ PM_WIDGETBUCKET_READ_INTERCEPT_KEY, "74 0A 80 7A 40 00 74 04 B3 01 EB 02 32 DB 48 8B 49 40 0F B6 D3", 0x12, 0x0E },
+	{ TIMESTOP_STRUCT_INTERCEPT_KEY, "44 8B 49 1C 48 85 D2 75 07 45 85 C9 0F 95 C0 C3 45 33 C0", 0x10, 0x0F },
+	{ WEATHER_STRUCT_INTERCEPT_KEY, "F3 0F 11 96 F0 00 00 00 F3 0F 5C C2 F3 0F 10 8D 3C 0A 00 00 F3 0F 11 8E F4 00 00 00 8B 85 40 0A 00 00 89 86 F8 00 00 00 "
+									"F3 0F 59 86 D0 00 00 00", 0x28, 0x14 },
+};
+
+
+static void testKnownEncodings()
+{
+	for (auto& encoding : knownEncodings)
+	{
+		const vector<uint8_t> bytes = parseBytes(encoding.bytes);
+		X64Instruction decoded;
+		const bool result = X64InstructionDecoder::decode(bytes.data(), bytes.size(), decoded);
+		bool passed = TEST_CHECK(result == (encoding.length > 0));
+		passed &= TEST_CHECK(decoded.length == encoding.length);
+		if (result && encoding.length > 0)
+		{
+			passed &= TEST_CHECK(decoded.isRipRelative == encoding.isRipRelative);
+			passed &= TEST_CHECK(decoded.displacementSize == encoding.displacementSize);
+			passed &= TEST_CHECK(decoded.immediateSize == encoding.immediateSize);
+			passed &= TEST_CHECK(decoded.isRelativeBranch == encoding.isRelativeBranch);
+			// the displacement and immediate are the last bytes of the instruction, in that order.
+			if (decoded.immediateSize > 0)
+			{
+				passed &= TEST_CHECK(decoded.immediateOffset + decoded.immediateSize == decoded.length);
+			}
+			if (decoded.displacementSize > 0)
+			{
+				passed &= TEST_CHECK(decoded.displacementOffset + decoded.displacementSize + decoded.immediateSize == decoded.length);
+			}
+		}
+		if (!passed)
+		{
+			printf("  instruction: %s, decoded length %d\n", encoding.name, decoded.length);
+		}
+		// every encoding cut short has to be rejected, never read past the bytes available.
+		for (int available = 0; available < encoding.length; available++)
+		{
+			X64Instruction truncated;
+			if (!TEST_CHECK(!X64InstructionDecoder::decode(bytes.data(), available, truncated)))
+			{
+				printf("  instruction: %s, truncated to %d bytes\n", encoding.name, available);
+			}
+		}
+	}
+}
+
+
+static void testTargets()
+{
+	// jmp to itself
+	const vector<uint8_t> jumpToSelf = parseBytes("EB FE");
+	X64Instruction decoded;
+	TEST_CHECK(X64InstructionDecoder::decode(jumpToSelf.data(), jumpToSelf.size(), decoded));
+	TEST_CHECK(X64InstructionDecoder::determineBranchTarget(jumpToSelf.data(), decoded) == jumpToSelf.data());
+	// call backwards: the target is relative to the next instruction.
+	const vector<uint8_t> callBackwards = parseBytes("E8 63 77 FF FF");
+	TEST_CHECK(X64InstructionDecoder::decode(callBackwards.data(), callBackwards.size(), decoded));
+	TEST_CHECK(X64InstructionDecoder::determineBranchTarget(callBackwards.data(), decoded) == callBackwards.data() + 5 - 0x889D);
+	// the coord factor read: movss xmm11,[rip+10], followed by other instructions.
+	const vector<uint8_t> factorRead = parseBytes("F3 44 0F 10 1D 10 00 00 00 48 85 C0 74 38");
+	TEST_CHECK(X64InstructionDecoder::decode(factorRead.data(), factorRead.size(), decoded));
+	TEST_CHECK(X64InstructionDecoder::determineRipRelativeTarget(factorRead.data(), decoded) == factorRead.data() + 9 + 0x10);
+	// the rip relative target is relative to the end of the instruction, so after the immediate.
+	const vector<uint8_t> storeImmediate = parseBytes("C7 05 F0 FF FF FF 01 00 00 00");
+	TEST_CHECK(X64InstructionDecoder::decode(storeImmediate.data(), storeImmediate.size(), decoded));
+	TEST_CHECK(X64InstructionDecoder::determineRipRelativeTarget(storeImmediate.data(), decoded) == storeImmediate.data() + 10 - 0x10);
+	// not a rip relative instruction / not a branch
+	const vector<uint8_t> notRipRelative = parseBytes("48 8B 44 24 20");
+	TEST_CHECK(X64InstructionDecoder::decode(notRipRelative.data(), notRipRelative.size(), decoded));
+	TEST_CHECK(X64InstructionDecoder::determineRipRelativeTarget(notRipRelative.data(), decoded) == nullptr);
+	TEST_CHECK(X64InstructionDecoder::determineBranchTarget(notRipRelative.data(), decoded) == nullptr);
+}
+
+
+static void testCalls()
+{
+	// the replayed calls of the active camera and time of day hooks, a relative call and the indirect far call are calls.
+	const vector<const char*> calls = { "FF 90 58 02 00 00", "FF 90 F8 00 00 00", "E8 63 77 FF FF", "41 FF D3", "FF 1C 24" };
+	for (const char* encoding : calls)
+	{
+		const vector<uint8_t> bytes = parseBytes(encoding);
+		X64Instruction decoded;
+		TEST_CHECK(X64InstructionDecoder::decode(bytes.data(), bytes.size(), decoded));
+		if (!TEST_CHECK(X64InstructionDecoder::isCall(decoded)))
+		{
+			printf("  instruction: %s\n", encoding);
+		}
+	}
+	// jmp rax (FF /4), inc dword ptr [rax] (FF /0), push qword ptr [rax] (FF /6), a relative jmp and a 0F E8 (psubsb) aren't.
+	const vector<const char*> nonCalls = { "FF E0", "FF 00", "FF 30", "E9 00 00 00 00", "0F E8 C1" };
+	for (const char* encoding : nonCalls)
+	{
+		const vector<uint8_t> bytes = parseBytes(encoding);
+		X64Instruction decoded;
+		TEST_CHECK(X64InstructionDecoder::decode(bytes.data(), bytes.size(), decoded));
+		if (!TEST_CHECK(!X64InstructionDecoder::isCall(decoded)))
+		{
+			printf("  instruction: %s\n", encoding);
+		}
+	}
+}
+
+
+static void testSpans()
+{
+	// nop, mov rax,[rip+0], je +38, call +0, nop
+	const vector<uint8_t> code = parseBytes("90 48 8B 05 00 00 00 00 74 38 E8 00 00 00 00 90");
+	TEST_CHECK(X64InstructionDecoder::determineInstructionSpan(code.data(), code.size(), 1) == 1);
+	TEST_CHECK(X64InstructionDecoder::determineInstructionSpan(code.data(), code.size(), 2) == 8);
+	TEST_CHECK(X64InstructionDecoder::determineInstructionSpan(code.data(), code.size(), 9) == 10);
+	TEST_CHECK(X64InstructionDecoder::determineInstructionSpan(code.data(), code.size(), 15) == 15);
+	// the span can't extend past the bytes available.
+	TEST_CHECK(X64InstructionDecoder::determineInstructionSpan(code.data(), 12, 11) == -1);
+	TEST_CHECK(X64InstructionDecoder::isInstructionBoundary(code.data(), code.size(), 0));
+	TEST_CHECK(X64InstructionDecoder::isInstructionBoundary(code.data(), code.size(), 8));
+	TEST_CHECK(!X64InstructionDecoder::isInstructionBoundary(code.data(), code.size(), 7));
+	TEST_CHECK(!X64InstructionDecoder::isInstructionBoundary(code.data(), code.size(), 11));
+}
+
+
+// The hook sites have to be decodable, the continue offsets have to be on an instruction boundary and the spans have to be the ones the
+// interceptors replicate. The bytes of every site are checked against the pattern of its block, so the sites here stay the game's code.
+static void testHookSites()
+{
+	for (auto& site : hookSites)
+	{
+		vector<uint8_t> bytes = parseBytes(site.bytes);
+		const ScanPattern* pattern = nullptr;
+		for (auto& definition : aobPatternDefinitions)
+		{
+			if (strcmp(definition.blockName, site.blockName) == 0)
+			{
+				pattern = &definition.pattern;
+				break;
+			}
+		}
+		bool passed = TEST_CHECK(nullptr != pattern);
+		if (nullptr != pattern)
+		{
+			// the hook is at the custom offset of the pattern, the bytes of the site have to match the rest of the pattern.
+			const int numberOfBytesToCompare = min(pattern->patternSize() - pattern->customOffset(), static_cast<int>(bytes.size()));
+			bool bytesMatchPattern = true;
+			for (int i = 0; i < numberOfBytesToCompare; i++)
+			{
+				const int patternIndex = pattern->customOffset() + i;
+				bytesMatchPattern &= (bytes[i] & pattern->patternMask()[patternIndex]) == pattern->bytePattern()[patternIndex];
+			}
+			passed &= TEST_CHECK(bytesMatchPattern);
+		}
+		passed &= TEST_CHECK(X64InstructionDecoder::determineInstructionSpan(bytes.data(), bytes.size(), HOOK_JMP_SIZE) == site.minimumSpan);
+		passed &= TEST_CHECK(X64InstructionDecoder::isInstructionBoundary(bytes.data(), bytes.size(), site.continueOffset));
+		passed &= TEST_CHECK(site.continueOffset >= HOOK_JMP_SIZE);
+		// every instruction up to the continue offset has to decode.
+		int offset = 0;
+		while (offset < site.continueOffset)
+		{
+			X64Instruction decoded;
+			if (!X64InstructionDecoder::decode(bytes.data() + offset, bytes.size() - offset, decoded))
+			{
+				break;
+			}
+			offset += decoded.length;
+		}
+		passed &= TEST_CHECK(offset == site.continueOffset);
+		if (!passed)
+		{
+			printf("  hook site: %s\n", site.blockName);
+		}
+	}
+}
+
+
+void runX64InstructionDecoderTests()
+{
+	testKnownEncodings();
+	testTargets();
+	testCalls();
+	testSpans();
+	testHookSites();
+}